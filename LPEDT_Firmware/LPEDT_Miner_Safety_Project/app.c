@@ -40,11 +40,13 @@
 #include "src/lcd.h"
 
 #include "src/timers.h"
+#include "src/clock.h"
 #include "src/scheduler.h"
 #include "src/i2c.h"
 #include "src/ble.h"
 #include "src/Si7021.h"
 #include "src/SPI.h"
+#include "src/bmi270.h"
 
 // Include logging specifically for this .c file
 #define INCLUDE_LOG_DEBUG 1
@@ -132,21 +134,30 @@ sl_power_manager_on_isr_exit_t app_sleep_on_isr_exit(void)
 
 SL_WEAK void app_init(void)
 {
+  // Time base for the log, event and sample timestamps
+  clockInit();
+
   gpioInit();
 
   // Enable the LETIMER0 module and Si7021 temperature sensor over I2C
   LETIMER0_Enable(LOWEST_ENERGY_MODE);
 
+  schedulerStateMachinesInit();
+
 #if BUILD_INCLUDES_BLE_SERVER == 1
 //  I2C_Init_Si7021();
 //  I2C_Init_BMI270();
 
-  // Initialize USART1 as SPI slave
-//  initUSART0();
-//  SPI_Trial_Init();
-
+  // Switch the BMI270 to SPI, USART1 is run by the SPIDRV instance
   SPI_Init();
 
+#if BMI270_RUN_BENCHMARK == 1
+  // Same register block over both buses, results go to the log
+  I2C_Init_BMI270();
+  BMI270_Benchmark(&bmi270_spi, BMI270_BENCHMARK_READS, NULL);
+  BMI270_Benchmark(&bmi270_i2c, BMI270_BENCHMARK_READS, NULL);
+#endif
+
 #endif
 
   // Set the required parameters as per the desired energy mode
@@ -161,26 +172,78 @@ SL_WEAK void app_init(void)
   }
 } // app_init()
 
+/**
+ * @brief   Handler for the events drained from the scheduler queue
+ * @param   evt -   event with the data its IRQ attached
+ * @return  none
+ */
+static void app_handle_event(const Scheduler_Event_t *evt)
+{
+  switch(evt->id){
+    case EVENT_I2C_TRANSFER_COMPLETE:
+            if(evt->data.i2c_status < 0){
+                LOG_ERROR("I2C transfer failed at %u ms, status=%d\r\n",
+                          (unsigned int) evt->timestamp, (int) evt->data.i2c_status);
+            }
+            break;
+    default:
+            break;
+  }
+}
+
+/**
+ * @brief   Warns once the scheduler queue backs up past
+ *          SCHEDULER_QUEUE_HWM_MAX or drops an event. The queue is drained on
+ *          every pass in both builds, so either means a pass took too long.
+ * @return  none
+ */
+static void app_check_event_queue(void)
+{
+  static uint32_t reported_hwm = SCHEDULER_QUEUE_HWM_MAX;
+  static uint32_t reported_dropped = 0;
+  Scheduler_Stats_t stats;
+  uint32_t hwm = 0;
+
+  schedulerGetStats(&stats);
+  for(uint32_t p = 0; p < EVENT_PRIORITY_COUNT; p++){
+    if(stats.high_water[p] > hwm)
+      hwm = stats.high_water[p];
+  }
+
+  if(hwm > reported_hwm || stats.dropped != reported_dropped){
+    LOG_WARN("Event queue high water %u of %u, %u dropped\r\n",
+             (unsigned int) hwm, (unsigned int) SCHEDULER_QUEUE_SIZE,
+             (unsigned int) stats.dropped);
+    if(hwm > reported_hwm)
+      reported_hwm = hwm;
+    reported_dropped = stats.dropped;
+  }
+}
+
 /**************************************************************************//**
  * Application Process Action.
  *****************************************************************************/
 SL_WEAK void app_process_action(void)
 {
-#if BT_COMM == 0
-  uint32_t event;
-
-  // Get the event to handle from the scheduler and call the state machine
-  event = getNextEvent();
+  // Handle every event the IRQs queued since the last pass. The BT state
+  // machines run on the external signals, but the queue is still drained
+  // here in both builds or it fills up and only counts drops.
+  schedulerDrainEvents(app_handle_event);
+  app_check_event_queue();
 
+#if BT_COMM == 0
 //  temperature_state_machine(event);
 //  temperature_state_machine(event);
 
-//    Send_tx();
-//  SPI_Trial();
   SPI_Get_Chip_Id();
 
-
 #endif
+
+  // Send the LCD rows the events of this pass changed in one refresh
+  displayFlush();
+
+  // Idle, send the deferred LOG_xxx() records to VCOM
+  TLOG_DRAIN();
 } // app_process_action()
 
 /**************************************************************************//**
@@ -21,7 +21,8 @@ extern const sli_bt_gattdb_t gattdb;
 #define gattdb_measurement_interval           29
 #define gattdb_valid_range                    30
 #define gattdb_button_state                   33
-#define gattdb_ota_control                    37
+#define gattdb_telemetry_stream               37
+#define gattdb_ota_control                    41
 
 
 #endif // __GATT_DB_H
@@ -27,6 +27,7 @@ static const struct sli_bgapi_class * const bt_class_table[] =
   SL_BT_BGAPI_CLASS(connection),
   SL_BT_BGAPI_CLASS(gatt),
   SL_BT_BGAPI_CLASS(gatt_server),
+  SL_BT_BGAPI_CLASS(nvm),
   SL_BT_BGAPI_CLASS(sm),
   NULL
 };
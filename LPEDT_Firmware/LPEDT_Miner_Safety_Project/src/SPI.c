@@ -3,164 +3,233 @@
  *
  *  Created on: Oct 12, 2024
  *      Author: vishn
+ *
+ *  Register burst driver for the BMI270 on USART1 (EXP header), built on the
+ *  sl_spidrv_exp SPIDRV instance. SPIDRV moves the bytes with LDMA, so the
+ *  core only sets up a burst and runs the completion callback. CS is driven
+ *  by hand with gpioSpiCs(), SPIDRV never touches it
+ *  (SL_SPIDRV_EXP_CS_CONTROL is spidrvCsControlApplication), so a burst can
+ *  cover the command byte, the BMI270 dummy byte and the data in one
+ *  transfer.
  */
 
+#include <string.h>
+
 #include "em_device.h"
-#include "em_chip.h"
-#include "em_cmu.h"
-#include "em_gpio.h"
-#include "em_usart.h"
+#include "em_core.h"
 
-#include "GPIO.h"
+#include "clock.h"
+#include "gpio.h"
 #include "SPI.h"
 
-#include "spidrv.h"
+#include "sl_spidrv_instances.h"
 
 // Include logging specifically for this .c file
 #define INCLUDE_LOG_DEBUG 1
 #include "src/log.h"
 
-uint8_t TxBuffer[TX_BUFFER_SIZE] = {0x80};
-uint8_t RxBuffer[RX_BUFFER_SIZE];
-
-SPIDRV_HandleData_t handleData;
-SPIDRV_Handle_t handle = &handleData;
-
-uint8_t buffer[1] = {0x80};
-uint8_t buffer_rx[2];
-SPIDRV_Init_t initData = SPIDRV_MASTER_USART1;
-
-/**************************************************************************//**
- * @brief Initialize USART1
- *****************************************************************************/
-void initUSART0 (void)
-{
-  CMU_ClockEnable(cmuClock_GPIO, true);
-  CMU_ClockEnable(cmuClock_USART1, true);
-
-  // Configure GPIO mode
-//  GPIO_PinModeSet(gpioPortC, 8, gpioModePushPull, 0); // US1_CLK is push pull
-//  GPIO_PinModeSet(gpioPortC, 9, gpioModePushPull, 1); // US1_CS is push pull
-//  GPIO_PinModeSet(gpioPortC, 6, gpioModePushPull, 1); // US1_TX (MOSI) is push pull
-//  GPIO_PinModeSet(gpioPortC, 7, gpioModeInput, 1);    // US1_RX (MISO) is input
-
-  // Start with default config, then modify as necessary
-  USART_InitSync_TypeDef config = USART_INITSYNC_DEFAULT;
-  config.master       = true;            // master mode
-  config.baudrate     = 1000000;         // CLK freq is 1 MHz
-  config.autoCsEnable = false;            // CS pin controlled by hardware, not firmware
-  config.clockMode    = usartClockMode0; // clock idle low, sample on rising/first edge
-  config.msbf         = true;            // send MSB first
-  config.enable       = usartDisable;    // Make sure to keep USART disabled until it's all set up
-  USART_InitSync(USART1, &config);
-
-  // Set USART pin locations
-  USART1->ROUTELOC0 = (USART_ROUTELOC0_CLKLOC_LOC11) | // US1_CLK       on location 11 = PC8 per datasheet section 6.4 = EXP Header pin 8
-                      (USART_ROUTELOC0_CSLOC_LOC11)  | // US1_CS        on location 11 = PC9 per datasheet section 6.4 = EXP Header pin 10
-                      (USART_ROUTELOC0_TXLOC_LOC11)  | // US1_TX (MOSI) on location 11 = PC6 per datasheet section 6.4 = EXP Header pin 4
-                      (USART_ROUTELOC0_RXLOC_LOC11);   // US1_RX (MISO) on location 11 = PC7 per datasheet section 6.4 = EXP Header pin 6
-
-  // Enable USART pins
-  USART1->ROUTEPEN = USART_ROUTEPEN_CLKPEN | USART_ROUTEPEN_CSPEN | USART_ROUTEPEN_TXPEN | USART_ROUTEPEN_RXPEN;
-
-  // Enable USART1
-  USART_Enable(USART1, usartEnable);
+// A read is the command byte, one dummy byte, then the data
+#define SPI_READ_OVERHEAD (2)
+
+static uint8_t spi_tx[SPI_BURST_MAX_LEN + SPI_READ_OVERHEAD];
+static uint8_t spi_rx[SPI_BURST_MAX_LEN + SPI_READ_OVERHEAD];
+
+static volatile bool spi_busy = false;
+static SPI_Burst_Callback_t spi_callback = NULL;
+static SPI_Burst_Stats_t spi_stats;
+
+/**
+ * @brief   SPIDRV completion of an SPI_Burst_Read(), in IRQ context. Ends
+ *          the burst and hands the data to the caller's callback.
+ * @return  none
+ */
+static void spi_burst_done(SPIDRV_Handle_t handle, Ecode_t status, int items){
+  uint32_t start = DWT->CYCCNT;
+  SPI_Burst_Callback_t callback = spi_callback;
+
+  (void) handle;
+  gpioSpiCs(1);
+
+  if(status == ECODE_EMDRV_SPIDRV_OK){
+    spi_stats.bytes += (uint32_t) items;
+  }
+  else{
+    spi_stats.errors++;
+  }
+
+  spi_busy = false;
+
+  // A failed transfer may end before the command and dummy bytes, no data
+  if(callback != NULL)
+    callback(status, &spi_rx[SPI_READ_OVERHEAD],
+             (status == ECODE_EMDRV_SPIDRV_OK) ? (uint16_t)(items - SPI_READ_OVERHEAD) : 0);
+
+  spi_stats.callback_cycles += DWT->CYCCNT - start;
 }
 
-void Send_tx(void)
-{
-  uint32_t i;
-    for (i = 0; i < TX_BUFFER_SIZE; i++)
-    {
-     RxBuffer[i] = USART_SpiTransfer(USART1, TxBuffer[i]);
-     RxBuffer[i] = USART_Rx(USART1);
-     LOG_INFO("returned: %d\r\n", (uint8_t) RxBuffer[i]);
-    }
-    // Place breakpoint here and observe RxBuffer
-    // RxBuffer should contain 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9
+/**
+ * @brief   Claims the driver for one burst
+ * @return  false if a burst is already in progress
+ */
+static bool spi_claim(){
+  bool claimed = false;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  if(!spi_busy){
+    spi_busy = true;
+    claimed = true;
+  }
+  CORE_EXIT_CRITICAL();
+  return claimed;
 }
 
+/**
+ * @brief   Switches the BMI270 to SPI. It powers up in I2C mode and changes
+ *          on the first rising CS edge, the datasheet asks for a dummy read
+ *          to make that edge. USART1 itself is set up by SPIDRV in
+ *          sl_system_init() from sl_spidrv_exp_config.h.
+ * @return  none
+ */
+void SPI_Init(){
+  uint8_t dummy;
+
+  // Cycle counter for the stats
+  clockCycleCounterInit();
+
+  memset(&spi_stats, 0, sizeof(spi_stats));
+  gpioSpiCs(1);
+  SPI_Burst_ReadB(BMI270_REG_CHIP_ID, &dummy, 1);
+}
+
+/**
+ * @brief   Starts reading len registers from reg on, without blocking. The
+ *          data is passed to callback, called from the LDMA IRQ.
+ * @param   len   -   1 to SPI_BURST_MAX_LEN bytes
+ * @return  ECODE_EMDRV_SPIDRV_OK, ECODE_EMDRV_SPIDRV_BUSY if a burst is in
+ *          progress, or the SPIDRV error
+ */
+Ecode_t SPI_Burst_Read(uint8_t reg, uint16_t len, SPI_Burst_Callback_t callback){
+  Ecode_t status;
+
+  if((len == 0) || (len > SPI_BURST_MAX_LEN))
+    return ECODE_EMDRV_SPIDRV_PARAM_ERROR;
+
+  if(!spi_claim())
+    return ECODE_EMDRV_SPIDRV_BUSY;
 
-void TransferComplete(SPIDRV_Handle_t handle,
-                      Ecode_t transferStatus,
-                      int itemsTransferred)
-{
-  if (transferStatus == ECODE_EMDRV_SPIDRV_OK) {
-   // Success !
-//      SPIDRV_MReceiveB(handle, &buffer_rx[0], 1);
-//      SPIDRV_MReceiveB(handle, &buffer_rx[1], 1);
-//      LOG_INFO("returned: %d, %d\r\n", (uint8_t) RxBuffer[0], (uint8_t) buffer_rx[1]);
-      LOG_INFO("Tx success\r\n");
+  // Only the command byte matters, the rest of spi_tx is never written
+  spi_tx[0] = reg | BMI270_SPI_READ;
+  spi_callback = callback;
+  spi_stats.transfers++;
+
+  gpioSpiCs(0);
+  status = SPIDRV_MTransfer(sl_spidrv_exp_handle, spi_tx, spi_rx,
+                            len + SPI_READ_OVERHEAD, spi_burst_done);
+  if(status != ECODE_EMDRV_SPIDRV_OK){
+    LOG_ERROR("SPIDRV_MTransfer() returned != 0 status=0x%04x\r\n", (unsigned int) status);
+    gpioSpiCs(1);
+    spi_stats.errors++;
+    spi_busy = false;
   }
+  return status;
 }
 
-void SPI_Trial_Init(){
+/**
+ * @brief   Reads len registers from reg on and waits for the data
+ * @param   len   -   1 to SPI_BURST_MAX_LEN bytes
+ * @return  ECODE_EMDRV_SPIDRV_OK or the error
+ */
+Ecode_t SPI_Burst_ReadB(uint8_t reg, uint8_t *data, uint16_t len){
+  Ecode_t status;
+
+  if((len == 0) || (len > SPI_BURST_MAX_LEN))
+    return ECODE_EMDRV_SPIDRV_PARAM_ERROR;
 
-  // Initialize an SPI driver instance.
-  SPIDRV_Init(handle, &initData);
+  if(!spi_claim())
+    return ECODE_EMDRV_SPIDRV_BUSY;
+
+  spi_tx[0] = reg | BMI270_SPI_READ;
+  spi_stats.transfers++;
+
+  gpioSpiCs(0);
+  status = SPIDRV_MTransferB(sl_spidrv_exp_handle, spi_tx, spi_rx, len + SPI_READ_OVERHEAD);
+  gpioSpiCs(1);
+
+  if(status == ECODE_EMDRV_SPIDRV_OK){
+    memcpy(data, &spi_rx[SPI_READ_OVERHEAD], len);
+    spi_stats.bytes += len + SPI_READ_OVERHEAD;
+  }
+  else{
+    LOG_ERROR("SPIDRV_MTransferB() returned != 0 status=0x%04x\r\n", (unsigned int) status);
+    spi_stats.errors++;
+  }
+
+  spi_busy = false;
+  return status;
 }
 
-void SPI_Trial(){
-  // Transmit data using a blocking transmit function.
-//  SPIDRV_MTransmitB(handle, buffer, 10);
+/**
+ * @brief   Writes len registers from reg on and waits for the end of the
+ *          burst
+ * @param   len   -   1 to SPI_BURST_MAX_LEN bytes
+ * @return  ECODE_EMDRV_SPIDRV_OK or the error
+ */
+Ecode_t SPI_Burst_WriteB(uint8_t reg, const uint8_t *data, uint16_t len){
+  Ecode_t status;
+
+  if((len == 0) || (len > SPI_BURST_MAX_LEN))
+    return ECODE_EMDRV_SPIDRV_PARAM_ERROR;
 
-  // Transmit data using a callback to catch transfer completion.
-//  SPIDRV_MTransmit(handle, buffer, 1, TransferComplete);
-  uint8_t txData[2];  // TX buffer
-  uint8_t rxData[2];  // RX buffer
+  if(!spi_claim())
+    return ECODE_EMDRV_SPIDRV_BUSY;
 
-  txData[0] = 0x00 | 0x80;  // Set the read bit
-  txData[1] = 0;           // Dummy byte for the read
+  // A write has no dummy byte
+  spi_tx[0] = reg & ~BMI270_SPI_READ;
+  memcpy(&spi_tx[1], data, len);
+  spi_stats.transfers++;
 
-  // Transmit and receive
-  SPIDRV_MTransfer(handle, txData, rxData, sizeof(txData), TransferComplete);
+  gpioSpiCs(0);
+  status = SPIDRV_MTransmitB(sl_spidrv_exp_handle, spi_tx, len + 1);
+  gpioSpiCs(1);
 
-  LOG_INFO("returned: %d, %d\r\n", (uint8_t) rxData[0], (uint8_t) rxData[1]);
+  if(status == ECODE_EMDRV_SPIDRV_OK){
+    spi_stats.bytes += len + 1;
+  }
+  else{
+    LOG_ERROR("SPIDRV_MTransmitB() returned != 0 status=0x%04x\r\n", (unsigned int) status);
+    spi_stats.errors++;
+  }
+
+  spi_busy = false;
+  return status;
 }
 
+/**
+ * @brief   true while a burst is in progress
+ */
+bool SPI_Burst_Busy(){
+  return spi_busy;
+}
 
-void SPI_Init(){
-//    CMU_ClockEnable(cmuClock_GPIO, true);
-    CMU_ClockEnable(cmuClock_USART1, true);
-
-    // Configure GPIO mode
-//    GPIO_PinModeSet(gpioPortC, 8, gpioModePushPull, 0); // US1_CLK is push pull
-//    GPIO_PinModeSet(gpioPortC, 9, gpioModePushPull, 1); // US1_CS is push pull
-//    GPIO_PinModeSet(gpioPortC, 6, gpioModePushPull, 1); // US1_TX (MOSI) is push pull
-//    GPIO_PinModeSet(gpioPortC, 7, gpioModeInput, 1);    // US1_RX (MISO) is input
-
-    // Start with default config, then modify as necessary
-    USART_InitSync_TypeDef config = USART_INITSYNC_DEFAULT;
-    config.master       = true;            // master mode
-    config.baudrate     = 1000000;         // CLK freq is 1 MHz
-    config.autoCsEnable = false;            // CS pin controlled by hardware, not firmware
-    config.clockMode    = usartClockMode0; // clock idle low, sample on rising/first edge
-    config.msbf         = true;            // send MSB first
-    config.enable       = usartDisable;    // Make sure to keep USART disabled until it's all set up
-    USART_InitSync(USART1, &config);
-
-    // Set USART pin locations
-    USART1->ROUTELOC0 = (USART_ROUTELOC0_CLKLOC_LOC11) | // US1_CLK       on location 11 = PC8 per datasheet section 6.4 = EXP Header pin 8
-                    //    (USART_ROUTELOC0_CSLOC_LOC11)  | // US1_CS        on location 11 = PC9 per datasheet section 6.4 = EXP Header pin 10
-                        (USART_ROUTELOC0_TXLOC_LOC11)  | // US1_TX (MOSI) on location 11 = PC6 per datasheet section 6.4 = EXP Header pin 4
-                        (USART_ROUTELOC0_RXLOC_LOC11);   // US1_RX (MISO) on location 11 = PC7 per datasheet section 6.4 = EXP Header pin 6
-
-    // Enable USART pins
-//    USART1->ROUTEPEN = USART_ROUTEPEN_CLKPEN | USART_ROUTEPEN_CSPEN | USART_ROUTEPEN_TXPEN | USART_ROUTEPEN_RXPEN;
-
-    // Enable USART pins
-    USART1->ROUTEPEN = USART_ROUTEPEN_CLKPEN | USART_ROUTEPEN_TXPEN | USART_ROUTEPEN_RXPEN;
-
-    // Enable USART1
-    USART_Enable(USART1, usartEnable);
+/**
+ * @brief   Copies the burst counters
+ * @return  none
+ */
+void SPI_Burst_Get_Stats(SPI_Burst_Stats_t *stats){
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  *stats = spi_stats;
+  CORE_EXIT_CRITICAL();
 }
 
+/**
+ * @brief   Reads and logs the BMI270 chip id over SPI
+ * @return  none
+ */
 void SPI_Get_Chip_Id(){
+  uint8_t chip_id = 0;
 
-  uint8_t TxBuffer = {0x00};
-  uint8_t RxBuffer;
-  gpioSpiCs(0);
-  RxBuffer = USART_SpiTransfer(USART1, TxBuffer);
-  gpioSpiCs(1);
-  LOG_INFO("Got: %02x", RxBuffer);
+  if(SPI_Burst_ReadB(BMI270_REG_CHIP_ID, &chip_id, 1) == ECODE_EMDRV_SPIDRV_OK)
+    LOG_INFO("Got: %02x", chip_id);
 }
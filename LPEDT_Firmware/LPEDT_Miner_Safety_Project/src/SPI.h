@@ -8,20 +8,82 @@
 #ifndef SRC_SPI_H_
 #define SRC_SPI_H_
 
-#define TX_BUFFER_SIZE   1
-#define RX_BUFFER_SIZE   TX_BUFFER_SIZE
+#include <stdbool.h>
+#include <stdint.h>
 
+#include "spidrv.h"
 
-void initUSART0();
+// Longest register burst, e.g. a chunk of the BMI270 FIFO
+#define SPI_BURST_MAX_LEN   (256)
 
-void Send_tx(void);
+// Register address bit that makes an access a read
+#define BMI270_SPI_READ     (0x80)
 
-void SPI_Trial_Init();
+#define BMI270_REG_CHIP_ID  (0x00)
 
-void SPI_Trial();
+/**
+ * @brief   Completion of SPI_Burst_Read(), called from the LDMA IRQ
+ * @param   status  -   ECODE_EMDRV_SPIDRV_OK on success
+ * @param   data    -   registers read, valid until the next burst starts
+ * @param   len     -   bytes in data, 0 if the burst failed
+ */
+typedef void (*SPI_Burst_Callback_t)(Ecode_t status, const uint8_t *data, uint16_t len);
+
+typedef struct {
+  uint32_t transfers;       // bursts started
+  uint32_t bytes;           // bytes clocked, command and dummy bytes included
+  uint32_t errors;
+  uint32_t callback_cycles; // core cycles spent in the completion IRQ
+} SPI_Burst_Stats_t;
 
+/**
+ * @brief   Switches the BMI270 to SPI. It powers up in I2C mode and changes
+ *          on the first rising CS edge, the datasheet asks for a dummy read
+ *          to make that edge. USART1 itself is set up by SPIDRV in
+ *          sl_system_init() from sl_spidrv_exp_config.h.
+ * @return  none
+ */
 void SPI_Init();
 
+/**
+ * @brief   Starts reading len registers from reg on, without blocking. The
+ *          data is passed to callback, called from the LDMA IRQ.
+ * @param   len   -   1 to SPI_BURST_MAX_LEN bytes
+ * @return  ECODE_EMDRV_SPIDRV_OK, ECODE_EMDRV_SPIDRV_BUSY if a burst is in
+ *          progress, or the SPIDRV error
+ */
+Ecode_t SPI_Burst_Read(uint8_t reg, uint16_t len, SPI_Burst_Callback_t callback);
+
+/**
+ * @brief   Reads len registers from reg on and waits for the data
+ * @param   len   -   1 to SPI_BURST_MAX_LEN bytes
+ * @return  ECODE_EMDRV_SPIDRV_OK or the error
+ */
+Ecode_t SPI_Burst_ReadB(uint8_t reg, uint8_t *data, uint16_t len);
+
+/**
+ * @brief   Writes len registers from reg on and waits for the end of the
+ *          burst
+ * @param   len   -   1 to SPI_BURST_MAX_LEN bytes
+ * @return  ECODE_EMDRV_SPIDRV_OK or the error
+ */
+Ecode_t SPI_Burst_WriteB(uint8_t reg, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief   true while a burst is in progress
+ */
+bool SPI_Burst_Busy();
+
+/**
+ * @brief   Copies the burst counters
+ * @return  none
+ */
+void SPI_Burst_Get_Stats(SPI_Burst_Stats_t *stats);
+
+/**
+ * @brief   Reads and logs the BMI270 chip id over SPI
+ * @return  none
+ */
 void SPI_Get_Chip_Id();
 
 #endif /* SRC_SPI_H_ */
@@ -11,6 +11,7 @@
 #include "src/gpio.h"
 #include "src/timers.h"
 #include "i2c.h"
+#include "src/Si7021.h"
 
 // Include logging specifically for this .c file
 #define INCLUDE_LOG_DEBUG 1
@@ -18,6 +19,10 @@
 
 #define NUM_STATES 5
 
+static Si7021_Resolution_t si7021_res = SI7021_RES_RH12_T14;
+static bool si7021_powered = false;
+static bool si7021_configured = false;
+
 // enum declarations used for temperature state machines
 typedef enum uint32_t {
   stateIdle,
@@ -125,3 +130,115 @@ void temperature_state_machine(uint32_t event){
             break;
   } // switch
 } // state_machine()
+
+/**
+ * @brief   Selects the resolution, written to the user register before the
+ *          next conversion
+ * @return  none
+ */
+void Si7021_Set_Resolution(Si7021_Resolution_t res){
+  if(res != si7021_res)
+    si7021_configured = false;
+  si7021_res = res;
+}
+
+/**
+ * @brief   Powers the Si7021 on unless it still is
+ * @return  microseconds to wait for POR, 0 if the part is already up
+ */
+uint32_t Si7021_Power_On(){
+  if(si7021_powered)
+    return 0;
+
+  si7021TurnOn();
+  si7021_powered = true;
+
+  // The user register is back to its reset value after POR
+  si7021_configured = false;
+  return SI7021_POR_TIME_US;
+}
+
+/**
+ * @brief   Writes the resolution to the user register if the part lost it
+ *          through a power cycle or a new one was selected. Blocking, one
+ *          short I2C transfer, so call it with the bus idle.
+ * @return  true if the part is configured
+ */
+bool Si7021_Configure(){
+  uint8_t user_reg;
+
+  if(si7021_configured)
+    return true;
+
+  // Read-modify-write, the other bits are reserved or the heater
+  if(I2C_Burst_Read(SI7021_DEVICE_ADDR, SI7021_CMD_READ_USER_REG, &user_reg, 1) != 0)
+    return false;
+
+  user_reg = (user_reg & ~SI7021_USER_REG_RES_MASK) | (uint8_t) si7021_res;
+  if(I2C_Burst_Write(SI7021_DEVICE_ADDR, SI7021_CMD_WRITE_USER_REG, &user_reg, 1) != 0)
+    return false;
+
+  si7021_configured = true;
+  return true;
+}
+
+/**
+ * @brief   Longest conversion time of one sample at the current resolution,
+ *          from the datasheet. An RH conversion includes a temperature one.
+ * @return  microseconds
+ */
+uint32_t Si7021_Conversion_Time_Us(){
+  uint32_t temp_us, rh_us;
+
+  switch(si7021_res){
+    case SI7021_RES_RH8_T12:  rh_us = 3100;  temp_us = 3800;  break;
+    case SI7021_RES_RH10_T13: rh_us = 4500;  temp_us = 6200;  break;
+    case SI7021_RES_RH11_T11: rh_us = 7000;  temp_us = 2400;  break;
+    case SI7021_RES_RH12_T14:
+    default:                  rh_us = 12000; temp_us = 10800; break;
+  }
+
+#if SI7021_SINGLE_CONVERSION == 1
+  return rh_us + temp_us;
+#else
+  (void) rh_us;
+  return temp_us;
+#endif
+}
+
+/**
+ * @brief   Ends a sample. The part is only powered off when the next one is
+ *          further away than SI7021_KEEP_POWERED_MS.
+ * @param   next_sample_ms  -   time until the next sample
+ * @return  none
+ */
+void Si7021_Power_Off(uint32_t next_sample_ms){
+  if(next_sample_ms <= SI7021_KEEP_POWERED_MS)
+    return;
+
+  si7021TurnOff();
+  si7021_powered = false;
+}
+
+/**
+ * @brief   Converts a temperature code, formula from the datasheet
+ * @return  temperature in 0.01 degC
+ */
+int32_t Si7021_Temp_Centi_C(uint16_t code){
+  return (int32_t)((17572 * (uint32_t) code) >> 16) - 4685;
+}
+
+/**
+ * @brief   Converts an RH code, formula from the datasheet, clamped to
+ *          0-100 %RH
+ * @return  relative humidity in 0.01 %RH
+ */
+int32_t Si7021_RH_Centi_Percent(uint16_t code){
+  int32_t rh = (int32_t)((12500 * (uint32_t) code) >> 16) - 600;
+
+  if(rh < 0)
+    rh = 0;
+  if(rh > 10000)
+    rh = 10000;
+  return rh;
+}
@@ -8,6 +8,9 @@
 #ifndef SRC_SI7021_H_
 #define SRC_SI7021_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #define EVENT_LETIMER_UF 0
 #define EVENT_LETIMER_COMP1 1
 #define EVENT_I2C_TRANSFER_COMPLETE 2
@@ -16,6 +19,78 @@
 #define PB0_BIT_POS 4
 #define PB1_BIT_POS 5
 
+// 1: one RH conversion per sample, the temperature of that same conversion
+// is read back with SI7021_CMD_READ_TEMP_FROM_RH. 0: temperature only.
+#define SI7021_SINGLE_CONVERSION 1
+
+#define SI7021_CMD_MEASURE_RH_NO_HOLD 0xF5
+#define SI7021_CMD_READ_TEMP_FROM_RH 0xE0
+#define SI7021_CMD_WRITE_USER_REG 0xE6
+#define SI7021_CMD_READ_USER_REG 0xE7
+
+// Resolution bits of the user register, D7 and D0
+#define SI7021_USER_REG_RES_MASK 0x81
+
+// Samples closer together than this keep the part powered. Standby is
+// ~0.06 uA, far less than paying the 80 ms POR window on every sample.
+#define SI7021_KEEP_POWERED_MS 10000
+
+typedef enum {
+  SI7021_RES_RH12_T14 = 0x00,
+  SI7021_RES_RH8_T12  = 0x01,
+  SI7021_RES_RH10_T13 = 0x80,
+  SI7021_RES_RH11_T11 = 0x81
+} Si7021_Resolution_t;
+
+/**
+ * @brief   Selects the resolution, written to the user register before the
+ *          next conversion
+ * @return  none
+ */
+void Si7021_Set_Resolution(Si7021_Resolution_t res);
+
+/**
+ * @brief   Powers the Si7021 on unless it still is
+ * @return  microseconds to wait for POR, 0 if the part is already up
+ */
+uint32_t Si7021_Power_On();
+
+/**
+ * @brief   Writes the resolution to the user register if the part lost it
+ *          through a power cycle or a new one was selected. Blocking, one
+ *          short I2C transfer, so call it with the bus idle.
+ * @return  true if the part is configured
+ */
+bool Si7021_Configure();
+
+/**
+ * @brief   Longest conversion time of one sample at the current resolution,
+ *          from the datasheet. An RH conversion includes a temperature one.
+ * @return  microseconds
+ */
+uint32_t Si7021_Conversion_Time_Us();
+
+/**
+ * @brief   Ends a sample. The part is only powered off when the next one is
+ *          further away than SI7021_KEEP_POWERED_MS.
+ * @param   next_sample_ms  -   time until the next sample
+ * @return  none
+ */
+void Si7021_Power_Off(uint32_t next_sample_ms);
+
+/**
+ * @brief   Converts a temperature code, formula from the datasheet
+ * @return  temperature in 0.01 degC
+ */
+int32_t Si7021_Temp_Centi_C(uint16_t code);
+
+/**
+ * @brief   Converts an RH code, formula from the datasheet, clamped to
+ *          0-100 %RH
+ * @return  relative humidity in 0.01 %RH
+ */
+int32_t Si7021_RH_Centi_Percent(uint16_t code);
+
 /**
  * @brief   State machine to get the temperature from Si7021 chip over I2C using
  *          IRQs
@@ -20,6 +20,9 @@
 #include "lcd.h"
 #include "scheduler.h"
 #include "gpio.h"
+#include "indication_queue.h"
+#include "telemetry.h"
+#include "gatt_cache.h"
 #include <math.h>
 #include <string.h> // for memcpy()
 
@@ -74,35 +77,9 @@ typedef enum uint16_t{
 
 #if BUILD_INCLUDES_BLE_SERVER == 1
 
-// Declare memory for the queue/buffer, and our write and read pointers.
-queue_struct_t   my_queue[QUEUE_DEPTH]; // the queue
-uint32_t         wptr = 0;              // write pointer
-uint32_t         rptr = 0;              // read pointer
-
-// Student edit:
-// Decide how will you handle the full condition.
-
-bool         queue_full = false;  // flag to denote the queue is full
-bool         queue_empty = true;  // flag to denote the queue is empty
-
-
-
-// ---------------------------------------------------------------------
-// Private function used only by this .c file.
-// Compute the next ptr value. Given a valid ptr value, compute the next valid
-// value of the ptr and return it.
-// Isolation of functionality: This defines "how" a pointer advances.
-// ---------------------------------------------------------------------
-static uint32_t nextPtr(uint32_t ptr) {
-
-  // Student edit:
-  // Create this function
-  if(ptr+1 == QUEUE_DEPTH)
-    return 0;
-  else
-    return ptr+1;
-
-} // nextPtr()
+// Pending indications, byte packed with coalescing per characteristic,
+// see indication_queue.h
+static indication_queue_t my_queue;
 
 // ---------------------------------------------------------------------
 // Public function.
@@ -110,187 +87,73 @@ static uint32_t nextPtr(uint32_t ptr) {
 // ---------------------------------------------------------------------
 void reset_queue (void) {
 
-  // Student edit:
-  // Create this function
-
-  // Creating an array with value 0 which can be used to overwrite any existing
-  // data in the queue
-  uint8_t reset_buffer[MAX_BUFFER_LENGTH];
-  for(uint32_t i=0; i<MAX_BUFFER_LENGTH; i++){
-    reset_buffer[i] = 0;
-  }
-
-  // Iterate through the queue and reset all variables
-  for(uint32_t i=0; i<QUEUE_DEPTH; i++){
-    my_queue[i].charHandle = 0;
-    my_queue[i].bufLength = 0;
-    memcpy(&my_queue[i].buffer, &reset_buffer, MAX_BUFFER_LENGTH);
-  }
-
-  // reset the read/write pointers and queue flags
-  wptr = 0;
-  rptr = 0;
-  queue_full = false;
-  queue_empty = true;
+  indication_queue_reset(&my_queue);
 
 } // reset_queue()
 
 // ---------------------------------------------------------------------
 // Public function.
-// This function writes an entry to the queue if the the queue is not full.
-// Input parameter "charHandle" should be written to queue_struct_t element "charHandle".
-// Input parameter "bufLength" should be written to queue_struct_t element "bufLength"
-// The bytes pointed at by input parameter "buffer" should be written to queue_struct_t element "buffer"
+// This function writes an entry to the queue if there is room for it. If an
+// entry for charHandle is still pending, its data is replaced instead, so
+// the client only ever gets the newest value.
 // Returns bool false if successful or true if writing to a full fifo.
 // i.e. false means no error, true means an error occurred.
 // ---------------------------------------------------------------------
 bool write_queue (uint16_t charHandle, uint32_t bufLength, uint8_t *buffer) {
 
-  // Student edit:
-  // Create this function
-  // Decide how you want to handle the "full" condition.
-
-  // Don't forget to range check bufLength.
-  // Isolation of functionality:
-  //     Create the logic for "when" a pointer advances.
-
-  // Check if the queue is full and return error if true
-  if(queue_full)
-    return true;
-
   // Check if the given buffer length is within the defined limits
   if((bufLength > MAX_BUFFER_LENGTH) || (bufLength < MIN_BUFFER_LENGTH))
     return true;
 
-  // Set the queue full flag if the queue would be full after the current data
-  // insertion
-  if(nextPtr(wptr) == rptr){
-    queue_full = true;
-  }
-
-  // Insert the data
-  my_queue[wptr].charHandle = charHandle;
-  my_queue[wptr].bufLength = bufLength;
-
-  for(uint32_t i=0; i<bufLength; i++){
-    my_queue[wptr].buffer[i] = buffer[i];
-  }
-
-  if(queue_empty)
-    queue_empty = false;
-
-  // Increment the write pointer if the queue is not full
-  if(!queue_full)
-    wptr = nextPtr(wptr);
+  return !indication_queue_write(&my_queue, charHandle, buffer, (uint8_t)bufLength);
 
-  return false;
 } // write_queue()
 
 // ---------------------------------------------------------------------
 // Public function.
-// This function reads an entry from the queue, and returns values to the
-// caller. The values from the queue entry are returned by writing
-// the values to variables declared by the caller, where the caller is passing
-// in pointers to charHandle, bufLength and buffer. The caller's code will look like this:
-//
-//   uint16_t     charHandle;
-//   uint32_t     bufLength;
-//   uint8_t      buffer[5];
-//
-//   status = read_queue (&charHandle, &bufLength, &buffer[0]);
-//
-// *** If the code above doesn't make sense to you, you probably lack the
-// necessary prerequisite knowledge to be successful in this course.
-//
-// Write the values of charHandle, bufLength, and buffer from my_queue[rptr] to
-// the memory addresses pointed at by charHandle, bufLength and buffer, like this :
-//      *charHandle = <something>;
-//      *bufLength  = <something_else>;
-//      *buffer     = <something_else_again>; // perhaps memcpy() would be useful?
-//
-// In this implementation, we do it this way because
-// standard C does not provide a mechanism for a C function to return multiple
-// values, as is common in perl or python.
+// This function reads the oldest entry from the queue, and returns values to
+// the caller through the pointers charHandle, bufLength and buffer. buffer
+// must have room for MAX_BUFFER_LENGTH bytes.
 // Returns bool false if successful or true if reading from an empty fifo.
 // i.e. false means no error, true means an error occurred.
 // ---------------------------------------------------------------------
 bool read_queue (uint16_t *charHandle, uint32_t *bufLength, uint8_t *buffer) {
 
-  // Student edit:
-  // Create this function
+  uint8_t len;
 
-  // Isolation of functionality:
-  //     Create the logic for "when" a pointer advances
-
-  // Check if the queue is empty and return error if true
-  if(queue_empty)
+  if(!indication_queue_read(&my_queue, charHandle, buffer, &len, MAX_BUFFER_LENGTH))
     return true;
 
-  // Set the queue empty flag if the queue shall be empty after the current read
-  // operation
-  if(nextPtr(rptr) == wptr)
-    queue_empty = true;
-
-  // Copy the data from queue to the user arguments
-  *charHandle = my_queue[rptr].charHandle;
-  *bufLength = my_queue[rptr].bufLength;
-  memcpy(buffer, &my_queue[rptr].buffer, my_queue[rptr].bufLength);
-
-  // Increment the read pointer and if the queue is full, clear that flag and
-  // increment the write pointer
-  rptr = nextPtr(rptr);
-
-  if(queue_full){
-    queue_full = false;
-    wptr = nextPtr(wptr);
-  }
-
+  *bufLength = len;
   return false;
+
 } // read_queue()
 
 // ---------------------------------------------------------------------
 // Public function.
-// This function returns the wptr, rptr, full and empty values, writing
-// to memory using the pointer values passed in, same rationale as read_queue()
-// The "_" characters are used to disambiguate the global variable names from
-// the input parameter names, such that there is no room for the compiler to make a
-// mistake in interpreting your intentions.
+// This function returns the write and read positions (byte offsets in the
+// ring) and the full and empty state, writing to memory using the pointer
+// values passed in. Full means an entry of MAX_BUFFER_LENGTH bytes would not
+// fit.
 // ---------------------------------------------------------------------
 void get_queue_status (uint32_t *_wptr, uint32_t *_rptr, bool *_full, bool *_empty) {
 
-  // Student edit:
-  // Create this function
-
-  *_wptr = wptr;
-  *_rptr = rptr;
-  *_full = queue_full;
-  *_empty = queue_empty;
+  *_wptr = my_queue.wr & (INDICATION_QUEUE_BYTES - 1);
+  *_rptr = my_queue.rd & (INDICATION_QUEUE_BYTES - 1);
+  *_full = indication_queue_free(&my_queue) < (INDICATION_QUEUE_HEADER + MAX_BUFFER_LENGTH);
+  *_empty = (indication_queue_depth(&my_queue) == 0);
 
 } // get_queue_status()
 
 // ---------------------------------------------------------------------
 // Public function.
-// Function that computes the number of written entries currently in the queue. If there
-// are 3 entries in the queue, it should return 3. If the queue is empty it should
-// return 0. If the queue is full it should return either QUEUE_DEPTH if
-// USE_ALL_ENTRIES==1 otherwise returns QUEUE_DEPTH-1.
+// Function that returns the number of entries currently in the queue, in
+// constant time. If there are 3 entries in the queue, it returns 3. If the
+// queue is empty it returns 0.
 // ---------------------------------------------------------------------
 uint32_t get_queue_depth() {
 
-  // Student edit:
-  // Create this function
-  if(queue_empty)
-    return 0;
-  else if(queue_full)
-    return QUEUE_DEPTH;
-  else{
-    uint32_t queue_depth_ctr = 0, i=rptr;
-    while(i != wptr){
-      queue_depth_ctr++;
-      i = nextPtr(i);
-    }
-    return queue_depth_ctr;
-  }
+  return indication_queue_depth(&my_queue);
 
 } // get_queue_depth()
 
@@ -366,6 +229,14 @@ void handle_ble_event(sl_bt_msg_t *evt){
       }
 
 #if BUILD_INCLUDES_BLE_SERVER == 1
+      // Offer the largest ATT MTU so a telemetry notification can carry a
+      // full batch of samples. The client starts the exchange.
+      uint16_t max_mtu;
+      sc = sl_bt_gatt_server_set_max_mtu(TELEMETRY_ATT_MTU, &max_mtu);
+      if (sc != SL_STATUS_OK) {
+          LOG_ERROR("sl_bt_gatt_server_set_max_mtu() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      }
+
       // Get ble_data.advertisingSetHandle
       sc = sl_bt_advertiser_create_set(&ble_data->advertisingSetHandle);
       if (sc != SL_STATUS_OK) {
@@ -399,6 +270,8 @@ void handle_ble_event(sl_bt_msg_t *evt){
       }
 #endif
 #if BUILD_INCLUDES_BLE_CLIENT == 1
+      // Handles of the servers discovered before a reset
+      gatt_cache_init();
 
       // Set phy to 1M and mode to passive scanning
       sc = sl_bt_scanner_set_mode(sl_bt_gap_1m_phy, SCAN_PASSIVE);
@@ -597,6 +470,9 @@ void handle_ble_event(sl_bt_msg_t *evt){
       // clear LED status
       gpioLed0SetOff();
       gpioLed1SetOff();
+
+      // drop the samples of the old connection
+      telemetry_reset();
 #endif
 
 #if BUILD_INCLUDES_BLE_CLIENT == 1
@@ -675,6 +551,9 @@ void handle_ble_event(sl_bt_msg_t *evt){
                   }
                 }
             }
+
+            // Send the telemetry batches that are full or have waited long enough
+            telemetry_poll();
             break;
 #endif
         }
@@ -845,6 +724,7 @@ void handle_ble_event(sl_bt_msg_t *evt){
     /*  ------------------------------------------------------------------------
     *  Server Events:
     *    sl_bt_evt_system_external_signal_id
+    *    sl_bt_evt_gatt_mtu_exchanged_id
     *    sl_bt_evt_gatt_server_characteristic_status_id
     *    sl_bt_evt_gatt_server_indication_timeout_id
     *
@@ -852,6 +732,11 @@ void handle_ble_event(sl_bt_msg_t *evt){
     */
 #if BUILD_INCLUDES_BLE_SERVER == 1
 
+    // This event indicates the client finished the ATT MTU exchange
+    case sl_bt_evt_gatt_mtu_exchanged_id:
+      telemetry_set_mtu(evt->data.evt_gatt_mtu_exchanged.mtu);
+      break;
+
     // This event indicates that either a CCCD has been changed by the GATT
     // client or we have received a confirmation from the remote GATT Client
     // was received upon a successful reception of the indication
@@ -902,6 +787,15 @@ void handle_ble_event(sl_bt_msg_t *evt){
           }
       }
 
+      // Check if the event is related to the telemetry stream and if change
+      // is done by the GATT client. While it is enabled the temperature goes
+      // out in batched notifications instead of HTM indications.
+      if (evt->data.evt_gatt_server_characteristic_status.characteristic == gattdb_telemetry_stream
+          && evt->data.evt_gatt_server_characteristic_status.status_flags == sl_bt_gatt_server_client_config)
+      {
+          telemetry_set_enabled(evt->data.evt_gatt_server_characteristic_status.client_config_flags == sl_bt_gatt_server_notification);
+      }
+
       // Check if the event is related to the htm or the custom button characteristic and if we
       // received confirmation of reception from GATT client for a previously
       // transmitted indication.
@@ -1022,6 +916,20 @@ void handle_ble_event(sl_bt_msg_t *evt){
           }
       }
 
+      // Service Changed, the discovery state machine drops the cached
+      // handles. Any other indication the server sends is confirmed as
+      // well so its ATT queue does not stall, but otherwise ignored.
+      if((evt->data.evt_gatt_characteristic_value.characteristic != ble_data->characteristicHandleHTM)&&
+          (evt->data.evt_gatt_characteristic_value.characteristic != ble_data->characteristicHandleButton)&&
+          (evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_handle_value_indication)){
+          sc = sl_bt_gatt_send_characteristic_confirmation(evt->data.evt_gatt_characteristic_value.connection);
+          if((ble_data->characteristicHandleServiceChanged == 0) ||
+             (evt->data.evt_gatt_characteristic_value.characteristic != ble_data->characteristicHandleServiceChanged)){
+              LOG_WARN("Unexpected indication on handle %u\r\n",
+                       (unsigned int) evt->data.evt_gatt_characteristic_value.characteristic);
+          }
+      }
+
       break;
 
 #endif
@@ -67,6 +67,7 @@ typedef struct {
 
   uint16_t characteristicHandleHTM;
   uint16_t characteristicHandleButton;
+  uint16_t characteristicHandleServiceChanged; // 0 until discovered
 
   uint16_t resultGATTProcedue;
 
@@ -89,14 +90,9 @@ ble_data_struct_t* get_ble_data_ptr();
 void handle_ble_event(sl_bt_msg_t *evt);
 
 
-// This is the number of entries in the queue. Please leave
-// this value set to 16.
-#define QUEUE_DEPTH      (16)
-
-// Student edit:
-//   define this to 1 if your design uses all array entries
-//   define this to 0 if your design leaves 1 array entry empty
-#define USE_ALL_ENTRIES  (1)
+// The queue is a byte ring of INDICATION_QUEUE_BYTES (indication_queue.h),
+// 16 entries of MAX_BUFFER_LENGTH bytes fit in it. With coalescing there is
+// at most one entry per characteristic.
 
 #define MAX_BUFFER_LENGTH  (5)
 #define MIN_BUFFER_LENGTH  (1)
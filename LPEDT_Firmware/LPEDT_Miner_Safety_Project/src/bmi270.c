@@ -0,0 +1,164 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    bmi270.c
+ * @brief   Implementation of the BMI270 register access and the I2C/SPI
+ *          benchmark
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include <stddef.h>
+
+#include "em_device.h"
+#include "em_cmu.h"
+
+#include "src/clock.h"
+#include "src/i2c.h"
+#include "src/SPI.h"
+#include "src/bmi270.h"
+
+// Include logging specifically for this .c file
+#define INCLUDE_LOG_DEBUG 1
+#include "src/log.h"
+
+static int i2c_read(uint8_t reg, uint8_t *data, uint16_t len){
+  return I2C_Burst_Read(BMI270_I2C_ADDR, reg, data, len);
+}
+
+static int i2c_write(uint8_t reg, const uint8_t *data, uint16_t len){
+  return I2C_Burst_Write(BMI270_I2C_ADDR, reg, data, len);
+}
+
+static int spi_read(uint8_t reg, uint8_t *data, uint16_t len){
+  return (int) SPI_Burst_ReadB(reg, data, len);
+}
+
+static int spi_write(uint8_t reg, const uint8_t *data, uint16_t len){
+  return (int) SPI_Burst_WriteB(reg, data, len);
+}
+
+const BMI270_Transport_t bmi270_i2c = { "I2C", i2c_read, i2c_write };
+const BMI270_Transport_t bmi270_spi = { "SPI", spi_read, spi_write };
+
+static const BMI270_Transport_t *bmi270_bus = &bmi270_spi;
+
+/**
+ * @brief   Selects the bus the register functions use, the SPI one by
+ *          default
+ * @return  none
+ */
+void BMI270_Set_Transport(const BMI270_Transport_t *transport){
+  bmi270_bus = transport;
+}
+
+/**
+ * @brief   Reads len registers from reg on through the selected bus
+ * @return  0 on success
+ */
+int BMI270_Read(uint8_t reg, uint8_t *data, uint16_t len){
+  return bmi270_bus->read(reg, data, len);
+}
+
+/**
+ * @brief   Writes len registers from reg on through the selected bus
+ * @return  0 on success
+ */
+int BMI270_Write(uint8_t reg, const uint8_t *data, uint16_t len){
+  return bmi270_bus->write(reg, data, len);
+}
+
+static volatile int bench_status;
+static volatile int bench_done;
+
+/**
+ * @brief   SPI_Burst_Read() completion for the benchmark
+ * @return  none
+ */
+static void bench_spi_done(Ecode_t status, const uint8_t *data, uint16_t len){
+  (void) data;
+  (void) len;
+  bench_status = (int) status;
+  bench_done = 1;
+}
+
+/**
+ * @brief   Reads the acc+gyr data block reads times over a bus and logs the
+ *          throughput and the share of the run the core was busy.
+ *
+ *          I2CSPM polls, so an I2C read keeps the core busy for the whole
+ *          transfer. Over SPI the read is started with SPI_Burst_Read() and
+ *          the core only pays for the setup and the LDMA completion IRQ, the
+ *          time spent waiting for it is what a caller would get back.
+ * @param   result    -   filled with the raw counts, may be NULL
+ * @return  none
+ */
+void BMI270_Benchmark(const BMI270_Transport_t *transport, uint32_t reads, BMI270_Bench_t *result){
+  BMI270_Bench_t bench = { 0 };
+  SPI_Burst_Stats_t spi_before, spi_after;
+  uint8_t data[BMI270_DATA_LEN];
+  uint32_t start, t;
+  uint32_t hz = CMU_ClockFreqGet(cmuClock_CORE);
+
+  clockCycleCounterInit();
+
+  SPI_Burst_Get_Stats(&spi_before);
+  start = DWT->CYCCNT;
+
+  for(uint32_t i = 0; i < reads; i++){
+    int status;
+
+    if(transport == &bmi270_spi){
+      t = DWT->CYCCNT;
+      bench_done = 0;
+      status = (int) SPI_Burst_Read(BMI270_REG_DATA_8, BMI270_DATA_LEN, bench_spi_done);
+      bench.cycles += DWT->CYCCNT - t;
+
+      if(status == ECODE_EMDRV_SPIDRV_OK){
+        while(!bench_done)
+          ;
+        status = bench_status;
+      }
+    }
+    else{
+      t = DWT->CYCCNT;
+      status = transport->read(BMI270_REG_DATA_8, data, BMI270_DATA_LEN);
+      bench.cycles += DWT->CYCCNT - t;
+    }
+
+    bench.reads++;
+    if(status != 0)
+      bench.errors++;
+    else
+      bench.bytes += BMI270_DATA_LEN;
+  }
+
+  bench.elapsed_cycles = DWT->CYCCNT - start;
+
+  if(transport == &bmi270_spi){
+    SPI_Burst_Get_Stats(&spi_after);
+    bench.cycles += spi_after.callback_cycles - spi_before.callback_cycles;
+  }
+
+  if((bench.elapsed_cycles != 0) && (hz != 0)){
+    uint32_t us = (uint32_t)(((uint64_t) bench.elapsed_cycles * 1000000) / hz);
+    uint32_t bytes_per_s = (uint32_t)(((uint64_t) bench.bytes * hz) / bench.elapsed_cycles);
+    uint32_t cpu_pct = (uint32_t)(((uint64_t) bench.cycles * 100) / bench.elapsed_cycles);
+
+    LOG_INFO("BMI270 %s: %u reads, %u errors, %u us, %u B/s, CPU %u%%\r\n",
+             transport->name, (unsigned int) bench.reads, (unsigned int) bench.errors,
+             (unsigned int) us, (unsigned int) bytes_per_s, (unsigned int) cpu_pct);
+  }
+
+  if(result != NULL)
+    *result = bench;
+}
@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    bmi270.h
+ * @brief   Register access to the BMI270 IMU over either of its buses, I2C
+ *          for bring-up or the SPI burst driver for high-rate streaming
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef SRC_BMI270_H_
+#define SRC_BMI270_H_
+
+#include <stdint.h>
+
+#define BMI270_I2C_ADDR         (0x68)
+
+#define BMI270_CHIP_ID          (0x24)
+
+// ACC_X_LSB, the accelerometer and gyroscope samples follow back to back
+#define BMI270_REG_DATA_8       (0x0C)
+#define BMI270_DATA_LEN         (12)
+
+// 1 to compare the two buses once at boot, see BMI270_Benchmark()
+#define BMI270_RUN_BENCHMARK    (0)
+#define BMI270_BENCHMARK_READS  (1000)
+
+typedef struct {
+  const char *name;
+  int (*read)(uint8_t reg, uint8_t *data, uint16_t len);
+  int (*write)(uint8_t reg, const uint8_t *data, uint16_t len);
+} BMI270_Transport_t;
+
+extern const BMI270_Transport_t bmi270_i2c;
+extern const BMI270_Transport_t bmi270_spi;
+
+typedef struct {
+  uint32_t reads;
+  uint32_t errors;
+  uint32_t bytes;
+  uint32_t cycles;          // core cycles spent inside the transport
+  uint32_t elapsed_cycles;  // wall time of the whole run
+} BMI270_Bench_t;
+
+/**
+ * @brief   Selects the bus the register functions use, the SPI one by
+ *          default
+ * @return  none
+ */
+void BMI270_Set_Transport(const BMI270_Transport_t *transport);
+
+/**
+ * @brief   Reads len registers from reg on through the selected bus
+ * @return  0 on success
+ */
+int BMI270_Read(uint8_t reg, uint8_t *data, uint16_t len);
+
+/**
+ * @brief   Writes len registers from reg on through the selected bus
+ * @return  0 on success
+ */
+int BMI270_Write(uint8_t reg, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief   Reads the acc+gyr data block reads times over a bus and logs the
+ *          throughput and the share of the run the core was busy
+ * @param   result    -   filled with the raw counts, may be NULL
+ * @return  none
+ */
+void BMI270_Benchmark(const BMI270_Transport_t *transport, uint32_t reads, BMI270_Bench_t *result);
+
+#endif /* SRC_BMI270_H_ */
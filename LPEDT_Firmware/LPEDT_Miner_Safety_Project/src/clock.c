@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    clock.c
+ * @brief   Implementation of the 64 bit time base. With the usual 32768 Hz
+ *          clock the tick conversions are a multiply and a shift, a 64 bit
+ *          division is only needed for other frequencies.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "em_device.h"
+#include "sl_sleeptimer.h"
+#include "src/clock.h"
+
+static uint32_t clock_hz = 0;
+static int8_t clock_shift = -1;   // log2(clock_hz), -1 if not a power of 2
+
+/**
+ * @brief   Caches the sleeptimer frequency, call once after
+ *          sl_sleeptimer_init(). Reads before it return 0.
+ * @return  none
+ */
+void clockInit(void){
+  clock_hz = sl_sleeptimer_get_timer_frequency();
+
+  clock_shift = -1;
+  for(int8_t i = 0; i < 32; i++){
+    if(clock_hz == (1ul << i)){
+      clock_shift = i;
+      break;
+    }
+  }
+}
+
+/**
+ * @brief   Sleeptimer ticks since boot
+ */
+uint64_t clockNowTicks(void){
+  return sl_sleeptimer_get_tick_count64();
+}
+
+/**
+ * @brief   Converts a tick count to microseconds, e.g. for an interval
+ */
+uint64_t clockTicksToUs(uint64_t ticks){
+  if(clock_shift >= 0)
+    return (ticks * 1000000) >> clock_shift;
+  if(clock_hz == 0)
+    return 0;
+  return ticks * 1000000 / clock_hz;
+}
+
+/**
+ * @brief   Microseconds since boot, at the resolution of one tick (~30.5 us
+ *          at 32768 Hz)
+ */
+uint64_t clockNowUs(void){
+  return clockTicksToUs(clockNowTicks());
+}
+
+/**
+ * @brief   Milliseconds since boot
+ */
+uint64_t clockNowMs(void){
+  uint64_t ticks = clockNowTicks();
+
+  if(clock_shift >= 0)
+    return (ticks * 1000) >> clock_shift;
+  if(clock_hz == 0)
+    return 0;
+  return ticks * 1000 / clock_hz;
+}
+
+/**
+ * @brief   Starts the DWT cycle counter (DWT->CYCCNT) the FSM, SPI and BMI270
+ *          timing reads. Safe to call more than once.
+ * @return  none
+ */
+void clockCycleCounterInit(void){
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
@@ -0,0 +1,61 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    clock.h
+ * @brief   Monotonic 64 bit time base on the sleeptimer (RTCC), which keeps
+ *          counting in EM2 and extends its counter to 64 bits itself, so
+ *          the time never wraps. Every read is safe from an IRQ.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef SRC_CLOCK_H_
+#define SRC_CLOCK_H_
+
+#include <stdint.h>
+
+/**
+ * @brief   Caches the sleeptimer frequency, call once after
+ *          sl_sleeptimer_init(). Reads before it return 0.
+ * @return  none
+ */
+void clockInit(void);
+
+/**
+ * @brief   Sleeptimer ticks since boot
+ */
+uint64_t clockNowTicks(void);
+
+/**
+ * @brief   Microseconds since boot, at the resolution of one tick (~30.5 us
+ *          at 32768 Hz)
+ */
+uint64_t clockNowUs(void);
+
+/**
+ * @brief   Milliseconds since boot
+ */
+uint64_t clockNowMs(void);
+
+/**
+ * @brief   Converts a tick count to microseconds, e.g. for an interval
+ */
+uint64_t clockTicksToUs(uint64_t ticks);
+
+/**
+ * @brief   Starts the DWT cycle counter (DWT->CYCCNT) the FSM, SPI and BMI270
+ *          timing reads. Safe to call more than once.
+ * @return  none
+ */
+void clockCycleCounterInit(void);
+
+#endif /* SRC_CLOCK_H_ */
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    fsm.c
+ * @brief   Implementation of the table driven state machine engine
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include <stddef.h>
+#include "em_device.h"
+#include "src/clock.h"
+#include "src/fsm.h"
+#include "src/irq.h"
+
+// Include logging specifically for this .c file
+#define INCLUDE_LOG_DEBUG 1
+#include "src/log.h"
+
+/**
+ * @brief   Sets up an instance in the initial state of its table
+ * @param   fsm   -   instance
+ * @param   def   -   table the instance runs
+ * @param   ctx   -   context for the actions, may be NULL
+ * @param   stats -   def->count entries for the timing of each row, or NULL
+ * @return  none
+ */
+void fsm_init(fsm_t *fsm, const fsm_def_t *def, void *ctx, fsm_transition_stats_t *stats){
+  fsm->def = def;
+  fsm->ctx = ctx;
+  fsm->stats = stats;
+
+  if(stats != NULL){
+    for(uint16_t i = 0; i < def->count; i++){
+      stats[i] = (fsm_transition_stats_t){ 0 };
+    }
+    clockCycleCounterInit();
+  }
+
+  fsm_reset(fsm);
+}
+
+/**
+ * @brief   Puts an instance back in the initial state, the stats are kept
+ * @return  none
+ */
+void fsm_reset(fsm_t *fsm){
+  fsm->state = fsm->def->initial;
+  fsm->entered_ms = letimerMilliseconds();
+}
+
+/**
+ * @brief   Feeds an event to an instance. The first row matching the current
+ *          state and event is taken.
+ * @param   arg   -   passed to the action
+ * @return  true if a transition was taken
+ */
+bool fsm_dispatch(fsm_t *fsm, uint32_t event, void *arg){
+  const fsm_def_t *def = fsm->def;
+
+  for(uint16_t i = 0; i < def->count; i++){
+    const fsm_transition_t *t = &def->table[i];
+
+    if((t->event != event) ||
+       ((t->state != fsm->state) && (t->state != FSM_ANY_STATE)))
+      continue;
+
+    uint32_t now_ms = letimerMilliseconds();
+    uint32_t start = DWT->CYCCNT;
+
+    if(t->action != NULL)
+      t->action(fsm, arg);
+
+    uint32_t cycles = DWT->CYCCNT - start;
+
+    if(fsm->stats != NULL){
+      fsm_transition_stats_t *s = &fsm->stats[i];
+      uint32_t dwell_ms = now_ms - fsm->entered_ms;
+
+      s->count++;
+      s->cycles_last = cycles;
+      if(cycles > s->cycles_max)
+        s->cycles_max = cycles;
+      if(dwell_ms > s->dwell_ms_max)
+        s->dwell_ms_max = dwell_ms;
+    }
+
+    fsm->state = t->next;
+    fsm->entered_ms = now_ms;
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * @brief   Logs the timing of every row that has been taken
+ * @return  none
+ */
+void fsm_log_stats(const fsm_t *fsm){
+  if(fsm->stats == NULL)
+    return;
+
+  for(uint16_t i = 0; i < fsm->def->count; i++){
+    const fsm_transition_t *t = &fsm->def->table[i];
+    const fsm_transition_stats_t *s = &fsm->stats[i];
+
+    if(s->count == 0)
+      continue;
+
+    LOG_INFO("%s %u->%u ev %u: n=%u cyc last %u max %u, dwell max %u ms\r\n",
+             fsm->def->name, (unsigned int) t->state, (unsigned int) t->next,
+             (unsigned int) t->event, (unsigned int) s->count,
+             (unsigned int) s->cycles_last, (unsigned int) s->cycles_max,
+             (unsigned int) s->dwell_ms_max);
+  }
+}
@@ -0,0 +1,104 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    fsm.h
+ * @brief   Table driven state machine engine.
+ *
+ *          A machine is a const table of (state, event) -> (action, next
+ *          state) rows. Any number of instances can run off the same table,
+ *          each with its own current state and context pointer, so several
+ *          sensors or connections are sequenced at once. An event without a
+ *          row for the current state is ignored.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef SRC_FSM_H_
+#define SRC_FSM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Row state matching every state, e.g. for a connection closed event
+#define FSM_ANY_STATE (0xFF)
+
+typedef struct fsm fsm_t;
+
+/**
+ * @brief   Action run on a transition, before the instance enters the next
+ *          state
+ * @param   fsm   -   instance taking the transition, fsm->ctx is its context
+ * @param   arg   -   argument given to fsm_dispatch()
+ */
+typedef void (*fsm_action_t)(fsm_t *fsm, void *arg);
+
+typedef struct {
+  uint8_t       state;    // current state or FSM_ANY_STATE
+  uint32_t      event;
+  fsm_action_t  action;   // NULL for none
+  uint8_t       next;
+} fsm_transition_t;
+
+typedef struct {
+  const char             *name;
+  const fsm_transition_t *table;
+  uint16_t                count;    // rows in table
+  uint8_t                 initial;
+} fsm_def_t;
+
+// Timing of one transition of one instance
+typedef struct {
+  uint32_t count;           // times taken
+  uint32_t cycles_last;     // action run time in core clock cycles
+  uint32_t cycles_max;
+  uint32_t dwell_ms_max;    // longest wait in the state before the transition
+} fsm_transition_stats_t;
+
+struct fsm {
+  const fsm_def_t        *def;
+  uint8_t                 state;
+  void                   *ctx;
+  uint32_t                entered_ms;   // letimerMilliseconds() at state entry
+  fsm_transition_stats_t *stats;        // def->count entries or NULL
+};
+
+/**
+ * @brief   Sets up an instance in the initial state of its table
+ * @param   fsm   -   instance
+ * @param   def   -   table the instance runs
+ * @param   ctx   -   context for the actions, may be NULL
+ * @param   stats -   def->count entries for the timing of each row, or NULL
+ * @return  none
+ */
+void fsm_init(fsm_t *fsm, const fsm_def_t *def, void *ctx, fsm_transition_stats_t *stats);
+
+/**
+ * @brief   Feeds an event to an instance. The first row matching the current
+ *          state and event is taken.
+ * @param   arg   -   passed to the action
+ * @return  true if a transition was taken
+ */
+bool fsm_dispatch(fsm_t *fsm, uint32_t event, void *arg);
+
+/**
+ * @brief   Puts an instance back in the initial state, the stats are kept
+ * @return  none
+ */
+void fsm_reset(fsm_t *fsm);
+
+/**
+ * @brief   Logs the timing of every row that has been taken
+ * @return  none
+ */
+void fsm_log_stats(const fsm_t *fsm);
+
+#endif /* SRC_FSM_H_ */
@@ -0,0 +1,153 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    gatt_cache.c
+ * @brief   Implementation of the GATT handle cache. A RAM copy of every slot
+ *          is kept so a lookup does not touch flash, only a change is
+ *          written through.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include <string.h>
+#include "src/gatt_cache.h"
+
+// Include logging specifically for this .c file
+#define INCLUDE_LOG_DEBUG 1
+#include "src/log.h"
+
+typedef struct {
+  uint8_t              version;   // GATT_CACHE_VERSION, 0 for an empty slot
+  uint8_t              reserved;
+  uint8_t              addr[6];
+  uint32_t             last_used; // use counter, the lowest slot is replaced
+  gatt_cache_handles_t handles;
+} gatt_cache_slot_t;
+
+static gatt_cache_slot_t slots[GATT_CACHE_SLOTS];
+static uint32_t use_count = 0;
+
+/**
+ * @brief   Slot of a peer
+ * @return  index, or -1 if the peer is not cached
+ */
+static int find_slot(const bd_addr *peer){
+  for(int i = 0; i < GATT_CACHE_SLOTS; i++){
+    if((slots[i].version == GATT_CACHE_VERSION) &&
+       (memcmp(slots[i].addr, peer->addr, sizeof(slots[i].addr)) == 0))
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief   Writes a slot through to the persistent store
+ * @return  none
+ */
+static void save_slot(int i){
+  sl_status_t sc = sl_bt_nvm_save(GATT_CACHE_NVM_KEY + i, sizeof(slots[i]), (const uint8_t*) &slots[i]);
+
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_nvm_save() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+}
+
+/**
+ * @brief   Loads the cache from the persistent store, call once the stack
+ *          has booted
+ * @return  none
+ */
+void gatt_cache_init(void){
+  size_t len;
+
+  use_count = 0;
+  for(int i = 0; i < GATT_CACHE_SLOTS; i++){
+    sl_status_t sc = sl_bt_nvm_load(GATT_CACHE_NVM_KEY + i, sizeof(slots[i]), &len, (uint8_t*) &slots[i]);
+
+    // Missing keys and the layout of an older build both read as empty
+    if((sc != SL_STATUS_OK) || (len != sizeof(slots[i])) ||
+       (slots[i].version != GATT_CACHE_VERSION)){
+      memset(&slots[i], 0, sizeof(slots[i]));
+      continue;
+    }
+    if(slots[i].last_used > use_count)
+      use_count = slots[i].last_used;
+  }
+}
+
+/**
+ * @brief   Looks up the handles cached for a peer
+ * @param   handles   -   filled on a hit
+ * @return  true on a hit
+ */
+bool gatt_cache_lookup(const bd_addr *peer, gatt_cache_handles_t *handles){
+  int i = find_slot(peer);
+
+  if(i < 0)
+    return false;
+
+  // Only the RAM copy is aged, a reboot replaying the flash order is fine
+  slots[i].last_used = ++use_count;
+  *handles = slots[i].handles;
+  return true;
+}
+
+/**
+ * @brief   Saves the handles discovered on a peer
+ * @return  none
+ */
+void gatt_cache_store(const bd_addr *peer, const gatt_cache_handles_t *handles){
+  int i = find_slot(peer);
+
+  if(i < 0){
+    // An empty slot, otherwise the least recently used one
+    i = 0;
+    for(int j = 0; j < GATT_CACHE_SLOTS; j++){
+      if(slots[j].version != GATT_CACHE_VERSION){
+        i = j;
+        break;
+      }
+      if(slots[j].last_used < slots[i].last_used)
+        i = j;
+    }
+  }
+  else if(memcmp(&slots[i].handles, handles, sizeof(*handles)) == 0){
+    // Unchanged, spare the flash
+    return;
+  }
+
+  slots[i].version = GATT_CACHE_VERSION;
+  slots[i].reserved = 0;
+  memcpy(slots[i].addr, peer->addr, sizeof(slots[i].addr));
+  slots[i].last_used = ++use_count;
+  slots[i].handles = *handles;
+  save_slot(i);
+}
+
+/**
+ * @brief   Forgets a peer, after Service Changed or a handle the server
+ *          rejected
+ * @return  none
+ */
+void gatt_cache_invalidate(const bd_addr *peer){
+  int i = find_slot(peer);
+
+  if(i < 0)
+    return;
+
+  memset(&slots[i], 0, sizeof(slots[i]));
+
+  sl_status_t sc = sl_bt_nvm_erase(GATT_CACHE_NVM_KEY + i);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_nvm_erase() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+}
@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    gatt_cache.h
+ * @brief   Persistent cache of the GATT handles the client discovered on a
+ *          server, keyed by the server's address.
+ *
+ *          With a cache hit the discovery state machine skips the six
+ *          service and characteristic discoveries on reconnect and goes
+ *          straight to enabling the indications. Each peer takes one
+ *          persistent store key (sl_bt_nvm_save()), the least recently used
+ *          peer is replaced when all slots are taken.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef SRC_GATT_CACHE_H_
+#define SRC_GATT_CACHE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sl_bt_api.h"
+
+// Peers remembered
+#define GATT_CACHE_SLOTS      (4)
+
+// First persistent store key, user keys are 0x4000 to 0x407F
+#define GATT_CACHE_NVM_KEY    (0x4000)
+
+// Bump when the layout of gatt_cache_handles_t changes
+#define GATT_CACHE_VERSION    (2)
+
+typedef struct {
+  uint32_t serviceHandleHTM;
+  uint32_t serviceHandleButton;
+  uint16_t characteristicHandleHTM;
+  uint16_t characteristicHandleButton;
+  uint16_t characteristicHandleServiceChanged;  // 0 if the server has none
+} gatt_cache_handles_t;
+
+/**
+ * @brief   Loads the cache from the persistent store, call once the stack
+ *          has booted
+ * @return  none
+ */
+void gatt_cache_init(void);
+
+/**
+ * @brief   Looks up the handles cached for a peer
+ * @param   handles   -   filled on a hit
+ * @return  true on a hit
+ */
+bool gatt_cache_lookup(const bd_addr *peer, gatt_cache_handles_t *handles);
+
+/**
+ * @brief   Saves the handles discovered on a peer
+ * @return  none
+ */
+void gatt_cache_store(const bd_addr *peer, const gatt_cache_handles_t *handles);
+
+/**
+ * @brief   Forgets a peer, after Service Changed or a handle the server
+ *          rejected
+ * @return  none
+ */
+void gatt_cache_invalidate(const bd_addr *peer);
+
+#endif /* SRC_GATT_CACHE_H_ */
@@ -17,6 +17,7 @@
  */
 
 #include "sl_i2cspm.h"
+#include "sl_power_manager.h"
 #include "em_device.h"
 #include "src/gpio.h"
 #include "src/timers.h"
@@ -32,6 +33,33 @@ I2C_TransferSeq_TypeDef transferSequence; // this one can be local
 uint8_t cmd_data; // make this global for IRQs in A4
 uint8_t read_data[2]  = {0,0}; // make this global for IRQs in A4
 
+// EM1 requirement of the IRQ transfer on the bus, I2C0 stops in EM2
+static volatile bool em1_held = false;
+
+/**
+ * @brief   Keeps the HF clocks up for an IRQ transfer, the core may sleep in
+ *          EM1 while it runs and goes back to EM2 in I2C_Transfer_Ended()
+ * @return  none
+ */
+static void I2C_Transfer_Started(void){
+  if(!em1_held){
+      em1_held = true;
+      sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM1);
+  }
+}
+
+/**
+ * @brief   Ends the EM1 requirement of an IRQ transfer, called by the I2C0 IRQ
+ *          once the transfer is done or failed, and when it fails to start
+ * @return  none
+ */
+void I2C_Transfer_Ended(void){
+  if(em1_held){
+      em1_held = false;
+      sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM1);
+  }
+}
+
 /**
  * @brief   Initialize the I2C peripheral to work with the Si7021 sensor
  * @return  none
@@ -93,10 +121,12 @@ void I2C_Write_Data_itr(uint8_t device_addr, uint8_t data){
   transferSequence.buf[0].len = sizeof(cmd_data);
 
   // starting I2C Transfer by enabling IRQ and calling the I2C_TransferInit function
+  I2C_Transfer_Started();
   NVIC_EnableIRQ(I2C0_IRQn);
   transferStatus = I2C_TransferInit(I2C0, &transferSequence);
 
   if(transferStatus < 0 ){
+      I2C_Transfer_Ended();
       LOG_ERROR("I2C_TransferInit() Write error = %d", transferStatus);
   }
 }
@@ -114,14 +144,44 @@ void I2C_Read_Data_irq(uint8_t device_addr){
     transferSequence.buf[0].len = sizeof(read_data);
 
     // starting I2C Transfer by enabling IRQ and calling the I2C_TransferInit function
+    I2C_Transfer_Started();
     NVIC_EnableIRQ(I2C0_IRQn);
     transferStatus = I2C_TransferInit(I2C0, &transferSequence);
 
     if(transferStatus < 0 ){
+        I2C_Transfer_Ended();
         LOG_ERROR("I2C_TransferInit() Read error = %d", transferStatus);
     }
 }
 
+/**
+ * @brief   Sends a command byte and reads the 2 byte answer in one repeated
+ *          start transfer. Function makes use of IRQs.
+ * @param   device_addr I2C device address
+ * @param   cmd         Command byte sent before the read
+ * @return  none
+ */
+void I2C_Write_Read_Data_irq(uint8_t device_addr, uint8_t cmd){
+    cmd_data = cmd;
+
+    transferSequence.addr = device_addr << 1; // shift device address left
+    transferSequence.flags = I2C_FLAG_WRITE_READ;
+    transferSequence.buf[0].data = &cmd_data;
+    transferSequence.buf[0].len = sizeof(cmd_data);
+    transferSequence.buf[1].data = read_data;
+    transferSequence.buf[1].len = sizeof(read_data);
+
+    // starting I2C Transfer by enabling IRQ and calling the I2C_TransferInit function
+    I2C_Transfer_Started();
+    NVIC_EnableIRQ(I2C0_IRQn);
+    transferStatus = I2C_TransferInit(I2C0, &transferSequence);
+
+    if(transferStatus < 0 ){
+        I2C_Transfer_Ended();
+        LOG_ERROR("I2C_TransferInit() Write-read error = %d", transferStatus);
+    }
+}
+
 /**
  * @brief   Returns the data received from the I2C device with endian-ness corrected
  * @return  Data received from the addressed device, with endian-ness corrected
@@ -213,43 +273,6 @@ uint8_t I2C_Read_Data_1(uint8_t device_addr){
 }
 
 
-/**
- * @brief   Gets temperature data from the onboard Si7021 temperature sensor
- * @return  Temperatue in Celsius
- */
-uint32_t I2C_Si7021_Get_Temp(){
-  // Send Measure Temperature command
-  uint16_t read_data; // make this global for IRQs in A4
-  uint32_t temperature_reading = 0;
-
-  // Turning on the SI7021 sensor and waiting till it is ready for conversion
-  // as per the recommended waiting period given in the data sheet
-  si7021TurnOn();
-  timerWaitUs_polled(SI7021_POR_TIME_US);
-
-  // Sending a temperature conversion request to the sensor
-//  I2C_Write_Data(SI7021_DEVICE_ADDR, SI7021_CMD_MEASURE_TEMP_NO_HOLD);
-  I2C_Write_Data_itr(SI7021_DEVICE_ADDR, SI7021_CMD_MEASURE_TEMP_NO_HOLD);
-
-  // Waiting for the conversion to complete (waiting time given in datasheet)
-  timerWaitUs_polled(SI7021_14B_CONVERSION_TIME_US);
-
-//  read_data = I2C_Read_Data(SI7021_DEVICE_ADDR);
-
-//  read_data = I2C_Read_Data_irq(SI7021_DEVICE_ADDR);
-  I2C_Read_Data_irq(SI7021_DEVICE_ADDR);
-  read_data = I2C_Get_Data();
-
-  // Turning off the sensor to conserve energy
-  si7021TurnOff();
-
-  // Converting the data received from the sensor into temperature in Celsius
-  // using the formula given in the SI7021 sensor application note AN607
-  temperature_reading = ((read_data*175.72)/65536) - 46.85;
-
-  return (temperature_reading);
-}
-
 void BME688_Get_Chip_Id(){
   I2C_Write_Data(0x77, 0xD0);
   uint8_t read_data;
@@ -276,3 +299,54 @@ void BMI270_Get_Chip_Id(){
   read_data = I2C_Read_Data_1(0x68);
   LOG_INFO("BMI 270 Chip ID: 0x%02x \r\n", (uint8_t) read_data);
 }
+
+/**
+ * @brief   Reads len registers of a device from reg on, in one repeated
+ *          start transfer. Polled, the core waits on the bus throughout.
+ * @param   device_addr I2C device address to read from
+ * @return  0 on success, otherwise the I2C_TransferReturn_TypeDef error
+ */
+int I2C_Burst_Read(uint8_t device_addr, uint8_t reg, uint8_t *data, uint16_t len){
+  I2C_TransferReturn_TypeDef transferStatus;
+  I2C_TransferSeq_TypeDef transferSequence;
+
+  transferSequence.addr = device_addr << 1;
+  transferSequence.flags = I2C_FLAG_WRITE_READ;
+  transferSequence.buf[0].data = &reg;
+  transferSequence.buf[0].len = 1;
+  transferSequence.buf[1].data = data;
+  transferSequence.buf[1].len = len;
+
+  transferStatus = I2CSPM_Transfer(I2C0, &transferSequence);
+
+  if (transferStatus != i2cTransferDone) {
+      LOG_ERROR("I2CSPM_Transfer: I2C burst read of 0x%02x:0x%02x failed\r\n", device_addr, reg);
+      return (int) transferStatus;
+  }
+  return 0;
+}
+
+/**
+ * @brief   Writes len registers of a device from reg on, in one transfer
+ * @param   device_addr I2C device address to write to
+ * @return  0 on success, otherwise the I2C_TransferReturn_TypeDef error
+ */
+int I2C_Burst_Write(uint8_t device_addr, uint8_t reg, const uint8_t *data, uint16_t len){
+  I2C_TransferReturn_TypeDef transferStatus;
+  I2C_TransferSeq_TypeDef transferSequence;
+
+  transferSequence.addr = device_addr << 1;
+  transferSequence.flags = I2C_FLAG_WRITE_WRITE;
+  transferSequence.buf[0].data = &reg;
+  transferSequence.buf[0].len = 1;
+  transferSequence.buf[1].data = (uint8_t*) data;
+  transferSequence.buf[1].len = len;
+
+  transferStatus = I2CSPM_Transfer(I2C0, &transferSequence);
+
+  if (transferStatus != i2cTransferDone) {
+      LOG_ERROR("I2CSPM_Transfer: I2C burst write of 0x%02x:0x%02x failed\r\n", device_addr, reg);
+      return (int) transferStatus;
+  }
+  return 0;
+}
@@ -31,12 +31,6 @@
  */
 void I2C_Init_Si7021();
 
-/**
- * @brief   Gets temperature data from the onboard Si7021 temperature sensor
- * @return  Temperatue in Celsius
- */
-uint32_t I2C_Si7021_Get_Temp();
-
 /**
  * @brief   Sends the given data over the I2C bus to the addressed device.
  *          Function makes use of IRQs.
@@ -54,6 +48,22 @@ void I2C_Write_Data_itr(uint8_t device_addr, uint8_t data);
  */
 void I2C_Read_Data_irq(uint8_t device_addr);
 
+/**
+ * @brief   Sends a command byte and reads the 2 byte answer in one repeated
+ *          start transfer. Function makes use of IRQs.
+ * @param   device_addr I2C device address
+ * @param   cmd         Command byte sent before the read
+ * @return  none
+ */
+void I2C_Write_Read_Data_irq(uint8_t device_addr, uint8_t cmd);
+
+/**
+ * @brief   Ends the EM1 requirement the IRQ transfer functions above take, for
+ *          the I2C0 IRQ once the transfer is done or failed
+ * @return  none
+ */
+void I2C_Transfer_Ended(void);
+
 /**
  * @brief   Returns the data received from the I2C device with endian-ness corrected
  * @return  Data received from the addressed device, with endian-ness corrected
@@ -66,4 +76,19 @@ void I2C_Init_BMI270();
 
 void BME688_Get_Chip_Id();
 
+/**
+ * @brief   Reads len registers of a device from reg on, in one repeated
+ *          start transfer. Polled, the core waits on the bus throughout.
+ * @param   device_addr I2C device address to read from
+ * @return  0 on success, otherwise the I2C_TransferReturn_TypeDef error
+ */
+int I2C_Burst_Read(uint8_t device_addr, uint8_t reg, uint8_t *data, uint16_t len);
+
+/**
+ * @brief   Writes len registers of a device from reg on, in one transfer
+ * @param   device_addr I2C device address to write to
+ * @return  0 on success, otherwise the I2C_TransferReturn_TypeDef error
+ */
+int I2C_Burst_Write(uint8_t device_addr, uint8_t reg, const uint8_t *data, uint16_t len);
+
 #endif /* SRC_I2C_H_ */
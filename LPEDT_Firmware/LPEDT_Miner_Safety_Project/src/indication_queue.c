@@ -0,0 +1,167 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    indication_queue.c
+ * @brief   Implementation of the pending GATT indication queue
+ *
+ *          wr, claim and rd are free running byte counts, the ring index is
+ *          the count masked with INDICATION_QUEUE_BYTES - 1:
+ *
+ *            rd <= claim <= wr
+ *            [rd, claim)   record the consumer is copying out
+ *            [claim, wr)   pending records, the producer may coalesce here
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include <stddef.h>
+#include "indication_queue.h"
+
+#if (INDICATION_QUEUE_BYTES & (INDICATION_QUEUE_BYTES - 1)) != 0
+#error "INDICATION_QUEUE_BYTES must be a power of two"
+#endif
+
+#define RING_MASK (INDICATION_QUEUE_BYTES - 1)
+
+/**
+ * @brief   Copies len bytes into the ring at pos, wrapping at the end
+ * @return  none
+ */
+static void ring_put(indication_queue_t *q, uint32_t pos, const uint8_t *src, uint32_t len){
+  for(uint32_t i = 0; i < len; i++){
+    q->ring[(pos + i) & RING_MASK] = src[i];
+  }
+}
+
+/**
+ * @brief   Copies len bytes out of the ring from pos, wrapping at the end
+ * @return  none
+ */
+static void ring_get(const indication_queue_t *q, uint32_t pos, uint8_t *dst, uint32_t len){
+  for(uint32_t i = 0; i < len; i++){
+    dst[i] = q->ring[(pos + i) & RING_MASK];
+  }
+}
+
+/**
+ * @brief   Empties the queue. Neither side may be using it.
+ * @return  none
+ */
+void indication_queue_reset(indication_queue_t *q){
+  q->wr = 0;
+  q->claim = 0;
+  q->rd = 0;
+  q->written = 0;
+  q->read = 0;
+  q->coalesced = 0;
+}
+
+/**
+ * @brief   Queues an indication, or updates the pending one for charHandle.
+ *          Producer side.
+ * @param   len   -   1 to 255 data bytes
+ * @return  false if the record does not fit
+ */
+bool indication_queue_write(indication_queue_t *q, uint16_t charHandle,
+                            const uint8_t *data, uint8_t len){
+  uint8_t header[INDICATION_QUEUE_HEADER];
+  uint32_t wr = q->wr;
+  uint32_t pos = __atomic_load_n(&q->claim, __ATOMIC_ACQUIRE);
+
+  if(len == 0)
+    return false;
+
+  // A pending record for the same handle gets the new value. The consumer
+  // cannot run until this returns, so the records from claim on stay put.
+  while(pos != wr){
+    ring_get(q, pos, header, INDICATION_QUEUE_HEADER);
+
+    uint16_t handle = (uint16_t)(header[0] | (header[1] << 8));
+    if(handle == charHandle && header[2] == len){
+      ring_put(q, pos + INDICATION_QUEUE_HEADER, data, len);
+      q->coalesced++;
+      return true;
+    }
+    pos += INDICATION_QUEUE_HEADER + header[2];
+  }
+
+  uint32_t rd = __atomic_load_n(&q->rd, __ATOMIC_ACQUIRE);
+  if(INDICATION_QUEUE_BYTES - (wr - rd) < (uint32_t)(INDICATION_QUEUE_HEADER + len))
+    return false;
+
+  header[0] = (uint8_t)charHandle;
+  header[1] = (uint8_t)(charHandle >> 8);
+  header[2] = len;
+  ring_put(q, wr, header, INDICATION_QUEUE_HEADER);
+  ring_put(q, wr + INDICATION_QUEUE_HEADER, data, len);
+
+  // Count first, so the depth never reads below the records visible
+  __atomic_store_n(&q->written, q->written + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&q->wr, wr + INDICATION_QUEUE_HEADER + len, __ATOMIC_RELEASE);
+  return true;
+}
+
+/**
+ * @brief   Takes the oldest pending indication off the queue. Consumer side.
+ * @param   data  -   room for max_len bytes
+ * @param   len   -   number of bytes copied to data
+ * @return  false if the queue is empty or the record is longer than max_len,
+ *          in which case it stays queued
+ */
+bool indication_queue_read(indication_queue_t *q, uint16_t *charHandle,
+                           uint8_t *data, uint8_t *len, uint8_t max_len){
+  uint8_t header[INDICATION_QUEUE_HEADER];
+  uint32_t pos = q->claim;
+
+  if(pos == __atomic_load_n(&q->wr, __ATOMIC_ACQUIRE))
+    return false;
+
+  ring_get(q, pos, header, INDICATION_QUEUE_HEADER);
+  if(header[2] > max_len)
+    return false;
+
+  uint32_t end = pos + INDICATION_QUEUE_HEADER + header[2];
+
+  // Take the record away from the producer before copying the data, a
+  // coalesce up to here lands in this read, one after it in a new record.
+  // The producer only runs by preempting this core, so keeping the compiler
+  // from moving the copy above the store is enough.
+  __atomic_store_n(&q->claim, end, __ATOMIC_RELEASE);
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+  ring_get(q, pos + INDICATION_QUEUE_HEADER, data, header[2]);
+  *charHandle = (uint16_t)(header[0] | (header[1] << 8));
+  *len = header[2];
+
+  __atomic_store_n(&q->read, q->read + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&q->rd, end, __ATOMIC_RELEASE);
+  return true;
+}
+
+/**
+ * @brief   Number of pending indications, either side
+ * @return  depth
+ */
+uint32_t indication_queue_depth(const indication_queue_t *q){
+  uint32_t read = __atomic_load_n(&q->read, __ATOMIC_ACQUIRE);
+  return __atomic_load_n(&q->written, __ATOMIC_ACQUIRE) - read;
+}
+
+/**
+ * @brief   Free bytes in the ring, either side. A record takes
+ *          INDICATION_QUEUE_HEADER bytes plus its data.
+ * @return  free bytes
+ */
+uint32_t indication_queue_free(const indication_queue_t *q){
+  uint32_t rd = __atomic_load_n(&q->rd, __ATOMIC_ACQUIRE);
+  return INDICATION_QUEUE_BYTES - (__atomic_load_n(&q->wr, __ATOMIC_ACQUIRE) - rd);
+}
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    indication_queue.h
+ * @brief   Single producer / single consumer queue of pending GATT
+ *          indications.
+ *
+ *          Records are byte packed in a ring as handle (2 bytes, little
+ *          endian), length (1 byte) and data, so a 1 byte button state takes
+ *          4 bytes instead of a full slot. A write for a handle that already
+ *          has a pending record of the same length overwrites that record's
+ *          data (newest value wins) instead of queueing a stale reading
+ *          behind it. The depth is kept as two counters, so reading it is
+ *          O(1).
+ *
+ *          Lock free: the producer may be an IRQ handler and the consumer the
+ *          main loop. The consumer must not preempt the producer, i.e. it
+ *          must run at the same or a lower priority. The queue has no SDK
+ *          dependencies and is also built on the host by the gateway
+ *          indq_bench tool.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef SRC_INDICATION_QUEUE_H_
+#define SRC_INDICATION_QUEUE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Ring size in bytes, must be a power of two
+#define INDICATION_QUEUE_BYTES   (128)
+
+// Bytes of a record before its data
+#define INDICATION_QUEUE_HEADER  (3)
+
+typedef struct {
+  uint8_t           ring[INDICATION_QUEUE_BYTES];
+  volatile uint32_t wr;         // end of the last record, producer only
+  volatile uint32_t claim;      // start of the next record to read, consumer only
+  volatile uint32_t rd;         // end of the last record read, frees space, consumer only
+  volatile uint32_t written;    // records appended, producer only
+  volatile uint32_t read;       // records taken out, consumer only
+  volatile uint32_t coalesced;  // writes merged into a pending record, producer only
+} indication_queue_t;
+
+/**
+ * @brief   Empties the queue. Neither side may be using it.
+ * @return  none
+ */
+void indication_queue_reset(indication_queue_t *q);
+
+/**
+ * @brief   Queues an indication, or updates the pending one for charHandle.
+ *          Producer side.
+ * @param   len   -   1 to 255 data bytes
+ * @return  false if the record does not fit
+ */
+bool indication_queue_write(indication_queue_t *q, uint16_t charHandle,
+                            const uint8_t *data, uint8_t len);
+
+/**
+ * @brief   Takes the oldest pending indication off the queue. Consumer side.
+ * @param   data  -   room for max_len bytes
+ * @param   len   -   number of bytes copied to data
+ * @return  false if the queue is empty or the record is longer than max_len,
+ *          in which case it stays queued
+ */
+bool indication_queue_read(indication_queue_t *q, uint16_t *charHandle,
+                           uint8_t *data, uint8_t *len, uint8_t max_len);
+
+/**
+ * @brief   Number of pending indications, either side
+ * @return  depth
+ */
+uint32_t indication_queue_depth(const indication_queue_t *q);
+
+/**
+ * @brief   Free bytes in the ring, either side. A record takes
+ *          INDICATION_QUEUE_HEADER bytes plus its data.
+ * @return  free bytes
+ */
+uint32_t indication_queue_free(const indication_queue_t *q);
+
+#endif /* SRC_INDICATION_QUEUE_H_ */
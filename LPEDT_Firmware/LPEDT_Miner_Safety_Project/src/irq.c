@@ -21,9 +21,11 @@
 
 #include "em_letimer.h"
 #include "gpio.h"
+#include "i2c.h"
 #include "scheduler.h"
 #include "sl_i2cspm.h"
 #include "timers.h"
+#include "src/clock.h"
 
 #define LETIMER0_COMP1_FLAG 0x2
 #define LETIMER0_UF_FLAG 0x4
@@ -62,9 +64,10 @@ void LETIMER0_IRQHandler(void){
       rollover_count += 1;
   }
 
-//  Case where COMP1 is true
-  if(flags & (1<<LETIMER0_COMP1_FLAG_BIT_POS)){
-      schedulerSetEventLETIMER0Comp1();
+//  Case where COMP1 is true, or a new period that may hold the next deadline.
+//  The timer multiplexer sets the events of the expired timers.
+  if(flags & ((1<<LETIMER0_COMP1_FLAG_BIT_POS) | (1<<LETIMER0_UF_FLAG_BIT_POS))){
+      timerMuxService();
   }
 }
 
@@ -81,11 +84,11 @@ void I2C0_IRQHandler(void){
 
   // I2C transfer is executed until the transfer is done
   IRQtransferStatus = I2C_Transfer(I2C0);
-  if (IRQtransferStatus == i2cTransferDone) {
-      schedulerSetEventI2CTransferDone();
-  }
-  if (IRQtransferStatus < 0) {
-//      LOG_ERROR("%d\r\n", IRQtransferStatus);
+
+  // Report the end of the transfer, errors included, with its status
+  if (IRQtransferStatus == i2cTransferDone || IRQtransferStatus < 0) {
+      I2C_Transfer_Ended();
+      schedulerSetEventI2CTransferDone(IRQtransferStatus);
   }
 }
 
@@ -128,20 +131,10 @@ void GPIO_ODD_IRQHandler(void)
 
 /**
  * @brief   Function to calculate the amount of time passed since the system
- *          was powered on
+ *          was powered on. The low 32 bits of clockNowMs(), so intervals
+ *          taken as a difference stay right across the wrap.
  * @return  Time since system was powered on in milliseconds
  */
 uint32_t letimerMilliseconds(){
-  // Calculate how long each tick is based on the clock frequency
-  // in micro-seconds
-  uint32_t LETIMER_Tick_Time_ms = 1000/CMU_ClockFreqGet(cmuClock_LETIMER0);
-
-  // Get the current number of ticks passed after LETIMER counter reload
-  uint32_t ctr = LETIMER_CompareGet(LETIMER0,0)-LETIMER_CounterGet(LETIMER0);
-
-  uint32_t rollover_time_ms = rollover_count*LETIMER_PERIOD_MS;
-  uint32_t curr_time_ms = LETIMER_Tick_Time_ms*ctr;
-  uint32_t return_time_ms = curr_time_ms + rollover_time_ms;
-
-  return (return_time_ms);
+  return (uint32_t) clockNowMs();
 }
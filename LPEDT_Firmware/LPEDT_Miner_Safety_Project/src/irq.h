@@ -27,7 +27,8 @@ void LETIMER0_IRQHandler(void);
 
 /**
  * @brief   Function to calculate the amount of time passed since the system
- *          was powered on
+ *          was powered on. The low 32 bits of clockNowMs(), so intervals
+ *          taken as a difference stay right across the wrap.
  * @return  Time since system was powered on in milliseconds
  */
 uint32_t letimerMilliseconds();
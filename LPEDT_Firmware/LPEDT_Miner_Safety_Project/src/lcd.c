@@ -91,6 +91,16 @@ struct display_data {
 	// GLIB_Context required for use with GLIB_ functions
 	GLIB_Context_t           glibContext;
 
+	// true once displayInit() has run, displayFlush() does nothing before
+	bool                     initialized;
+
+	// text currently shown on each row, and the rows whose text changed
+	// since the last displayFlush()
+	char                     rowText[DISPLAY_NUMBER_OF_ROWS][DISPLAY_ROW_LEN+1];
+	uint32_t                 dirtyRows;
+
+	struct display_stats     stats;
+
 };
 
 
@@ -122,9 +132,8 @@ static struct display_data         *displayGetData() {
  *    Example:
  *       displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp=%d", temp);
  *
- *    The implementation always erases a row first before drawing the
- *    string passed in. This is done so that all pixels from the previously
- *    displayed text will be erased.
+ *    The text is only recorded here, displayFlush() draws the rows that
+ *    changed. Text equal to what the row already shows is a no-op.
  *    To erase a row, pass in a format string of either "" or " ".
  *
  *    Row indexes >= DISPLAY_NUMBER_OF_ROWS will throw a LOG_ERROR() msg and
@@ -140,11 +149,9 @@ void displayPrintf(enum display_row row, const char *format, ...)
                           // of handling variable number of arguments passed to
                           // a function.
 
-   EMSTATUS               status;
    struct display_data    *display = displayGetData();
    size_t                 strLen;
    char                   strToDisplay[DISPLAY_ROW_LEN+1]; // +1 for null terminator
-   char                   strToErase[DISPLAY_ROW_LEN+1];   // +1 for null terminator
 
    // Range check the row number
    if (row >= DISPLAY_NUMBER_OF_ROWS) {
@@ -189,6 +196,36 @@ void displayPrintf(enum display_row row, const char *format, ...)
    } // else
 
 
+   display->stats.printfs++;
+
+   // Same text as on the screen, nothing to send to the LCD
+   if (strcmp(display->rowText[row], strToDisplay) == 0) {
+       display->stats.unchanged++;
+       return;
+   }
+
+   strcpy(display->rowText[row], strToDisplay);
+   display->dirtyRows |= (1u << row);
+
+} // displayPrintf()
+
+
+
+
+/**
+ * Draws the rows whose text changed since the last call and sends them to
+ * the LCD in one DMD_updateDisplay(). Call once per pass of the event loop.
+ */
+void displayFlush()
+{
+   EMSTATUS               status;
+   struct display_data    *display = displayGetData();
+   char                   strToErase[DISPLAY_ROW_LEN+1];   // +1 for null terminator
+
+   if (!display->initialized || (display->dirtyRows == 0)) {
+       return;
+   }
+
    // We always erase the whole line first, then draw the new string. This way
    // we don't leave any pixels set from the previous characters.
    for (int i=0; i<DISPLAY_ROW_LEN; i++) {
@@ -196,39 +233,59 @@ void displayPrintf(enum display_row row, const char *format, ...)
    }
    strToErase[DISPLAY_ROW_LEN] = 0; // null
 
-   // Erase the row
-   status = GLIB_drawStringOnLine(&display->glibContext,
-                                   &strToErase[0],
-                                   row,
-                                   GLIB_ALIGN_CENTER,
-                                   0,        // x offset
-                                   0,        // y offset
-                                   true);    // opaque
-   if (status != GLIB_OK) {
-       LOG_ERROR("Erase GLIB_drawStringOnLine() returned non-zero error code=0x%04x", (unsigned int) status);
-   }
-
-
-   // Draw the new string on the memory lcd display
-   status = GLIB_drawStringOnLine(&display->glibContext,
-                                  &strToDisplay[0],
-                                  row,
-                                  GLIB_ALIGN_CENTER,
-                                  0,        // x offset
-                                  0,        // y offset
-                                  true);    // opaque
-   if (status != GLIB_OK) {
-       LOG_ERROR("Draw GLIB_drawStringOnLine() returned non-zero error code=0x%04x", (unsigned int) status);
+   for (int row=0; row<DISPLAY_NUMBER_OF_ROWS; row++) {
+       if ((display->dirtyRows & (1u << row)) == 0) {
+           continue;
+       }
+
+       // Erase the row
+       status = GLIB_drawStringOnLine(&display->glibContext,
+                                       &strToErase[0],
+                                       row,
+                                       GLIB_ALIGN_CENTER,
+                                       0,        // x offset
+                                       0,        // y offset
+                                       true);    // opaque
+       if (status != GLIB_OK) {
+           LOG_ERROR("Erase GLIB_drawStringOnLine() returned non-zero error code=0x%04x", (unsigned int) status);
+       }
+
+       // Draw the new string on the memory lcd display
+       status = GLIB_drawStringOnLine(&display->glibContext,
+                                      &display->rowText[row][0],
+                                      row,
+                                      GLIB_ALIGN_CENTER,
+                                      0,        // x offset
+                                      0,        // y offset
+                                      true);    // opaque
+       if (status != GLIB_OK) {
+           LOG_ERROR("Draw GLIB_drawStringOnLine() returned non-zero error code=0x%04x", (unsigned int) status);
+       }
+
+       display->stats.rows_drawn++;
    }
+   display->dirtyRows = 0;
 
-
-   // Update the data the LCD is displaying
+   // Update the data the LCD is displaying, the DMD driver only sends the
+   // pixel lines that were drawn
    status = DMD_updateDisplay();
    if (status != DMD_OK) {
        LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
    }
+   display->stats.updates++;
 
-} // displayPrintf()
+} // displayFlush()
+
+
+
+
+/**
+ * Copies the display counters since displayInit().
+ */
+void displayGetStats(struct display_stats *stats)
+{
+   *stats = displayGetData()->stats;
+} // displayGetStats()
 
 
 
@@ -299,6 +356,7 @@ void displayInit()
     if (status != DMD_OK) {
         LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
     }
+    display->initialized = true;
 
 
 	  // The BT stack implements timers that we can setup and then have the stack pass back
@@ -37,6 +37,8 @@
 #ifndef SRC_LCD_H_
 #define SRC_LCD_H_
 
+#include <stdint.h>
+
 
 
 /**
@@ -63,6 +65,15 @@ enum display_row {
 // The number of characters per row
 #define DISPLAY_ROW_LEN      20
 
+/**
+ * Display counters since displayInit()
+ */
+struct display_stats {
+	uint32_t printfs;       // displayPrintf() calls
+	uint32_t unchanged;     // calls that left the row text as it was
+	uint32_t rows_drawn;    // rows redrawn by displayFlush()
+	uint32_t updates;       // DMD_updateDisplay() calls, i.e. SPI refreshes
+};
 
 
 // function prototypes
@@ -70,6 +81,8 @@ enum display_row {
 void displayInit();
 void displayUpdate();
 void displayPrintf(enum display_row row, const char *format, ...);
+void displayFlush();
+void displayGetStats(struct display_stats *stats);
 
 
 
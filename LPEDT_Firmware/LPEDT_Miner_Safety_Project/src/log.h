@@ -28,6 +28,7 @@
 #include <inttypes.h>
 
 #include "app_log.h"   // for LOG_INFO() / printf() / app_log() output the VCOM port
+#include "tlog.h"      // tokenized app_log(), see config/tlog_config.h
 #include "sl_status.h" // for sl_status_print()
 
 
@@ -51,8 +52,10 @@
 // File by file logging control
 #if INCLUDE_LOG_DEBUG
 
+// level is a literal and goes into the format string, with tokenized logging
+// only the timestamp, the __func__ address and the arguments are recorded
 #define LOG_DO(message,level, ...) \
-  app_log( "%5"PRIu32":%s:%s: " message "\n", loggerGetTimestamp(), level, __func__, ##__VA_ARGS__ )
+  TLOG( "%5"PRIu32":" level ":%s: " message "\n", loggerGetTimestamp(), __func__, ##__VA_ARGS__ )
 uint32_t loggerGetTimestamp (void);
 void     printSLErrorString (sl_status_t status);
 
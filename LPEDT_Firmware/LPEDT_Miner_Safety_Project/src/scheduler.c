@@ -21,7 +21,12 @@
 #include "src/scheduler.h"
 #include "src/gpio.h"
 #include "src/timers.h"
+#include "src/irq.h"
+#include "src/fsm.h"
+#include "src/telemetry.h"
+#include "src/gatt_cache.h"
 #include "i2c.h"
+#include "Si7021.h"
 #include "lcd.h"
 #include "ble.h"
 #include "ble_device_type.h"
@@ -34,13 +39,9 @@
 #define LETIMERCOMP1_BIT_POS 1
 #define I2C_TRANSFER_COMPLETE_BIT_POS 2
 
-#define SI7021_POR_TIME_US 80000
-#define SI7021_14B_CONVERSION_TIME_US 10800
-
 #define I2CTransferDone  0    /* Transfer completed successfully. Taken from em_i2c library*/
-uint32_t SchedulerEvents = 0;
 
-#define NUM_STATES 5
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
 // enum declarations used for temperature state machines
 typedef enum uint32_t {
@@ -48,7 +49,8 @@ typedef enum uint32_t {
   waitForSi7021POR,
   waitForI2CWriteTransfer,
   waitForSi7021Conversion,
-  waitForI2CReadTransfer
+  waitForI2CReadTransfer,
+  waitForI2CTempTransfer    // SI7021_SINGLE_CONVERSION, temperature of the RH conversion
 } State_t;
 
 typedef enum uint16_t{
@@ -58,13 +60,23 @@ typedef enum uint16_t{
   State_4,
   State_5,
   State_6,
-  State_7
+  State_7,
+  State_8,    // cached handles, enabling HTM indications
+  State_9,    // cached handles, enabling button indications
+  State_10,   // button indications enabled, discovering the GATT service
+  State_11,   // discovering the Service Changed characteristic
+  State_12,   // enabling Service Changed indications
+  State_13    // cached handles, enabling Service Changed indications
 } Discovery_States_t;
 
 uint8_t htm_temperature_buffer[5];
 uint32_t htm_temperature_flt;
 uint8_t flags = 0x00;
 
+#if BUILD_INCLUDES_BLE_SERVER == 1
+static uint16_t si7021_rh_code = 0;
+#endif
+
 #if BUILD_INCLUDES_BLE_CLIENT == 1
 
 // Health Thermometer service UUID defined by Bluetooth SIG
@@ -90,31 +102,210 @@ static const uint8_t button_char[] =  { 0x89, 0x62, 0x13, 0x2d, 0x2a, 0x65, // 6
                                         0x02, 0x00, 0x00, 0x00              // 00000002
                                       };
 
+// Generic Attribute service and its Service Changed characteristic, defined
+// by Bluetooth SIG
+static const uint8_t gatt_service[2] = { 0x01, 0x18 };
+static const uint8_t service_changed_char[2] = { 0x05, 0x2a };
+
+// Discovery events that are not BT stack message ids. Stack event ids all end
+// in 0xa0, so these cannot collide.
+#define DISC_EVENT_OPENED_CACHED    (0x01)  // connected to a server in the GATT cache
+#define DISC_EVENT_CACHE_STALE      (0x02)  // the server rejected a cached handle
+#define DISC_EVENT_SERVICE_CHANGED  (0x03)  // indication on the Service Changed handle
+
+// Server of the current connection and its cached handles
+static bd_addr disc_peer;
+static gatt_cache_handles_t disc_cached;
+
 #endif
 
 
+/*
+ * Event queue, one ring of SCHEDULER_QUEUE_SIZE slots per priority level.
+ *
+ * Producers are IRQ handlers of any priority and the main loop, the consumer
+ * is the main loop only. A producer claims a slot by moving tail with a
+ * compare and swap (LDREX/STREX, so an IRQ that preempts a producer takes the
+ * next slot instead of blocking) and publishes it by writing the slot
+ * sequence number. The consumer only reads slots whose sequence says they
+ * are published, so interrupts are never masked.
+ */
+typedef struct {
+  volatile uint32_t seq;
+  Scheduler_Event_t evt;
+} Event_Slot_t;
+
+typedef struct {
+  volatile uint32_t head;   // next slot to read, consumer only
+  volatile uint32_t tail;   // next slot to claim
+  Event_Slot_t slots[SCHEDULER_QUEUE_SIZE];
+} Event_Queue_t;
+
+#if (SCHEDULER_QUEUE_SIZE & (SCHEDULER_QUEUE_SIZE - 1)) != 0
+#error "SCHEDULER_QUEUE_SIZE must be a power of two"
+#endif
+
+// Slot sequence numbers count in laps of the ring, so the zeroed queue is
+// empty: a slot is free for pos at EVENT_LAP(pos), published at
+// EVENT_LAP(pos) + 1 and free again for the next lap at EVENT_LAP(pos) + SIZE
+#define EVENT_LAP(pos) ((pos) & ~(uint32_t)(SCHEDULER_QUEUE_SIZE - 1))
+
+static Event_Queue_t event_queues[EVENT_PRIORITY_COUNT];
+static Scheduler_Stats_t event_stats;
+
+// Default priority of each event, I2C first so a transfer is never held up
+static volatile uint8_t event_priority[EVENT_COUNT] = {
+  [EVENT_LETIMER_UF]            = EVENT_PRIORITY_LOW,
+  [EVENT_LETIMER_COMP1]         = EVENT_PRIORITY_NORMAL,
+  [EVENT_I2C_TRANSFER_COMPLETE] = EVENT_PRIORITY_HIGH,
+  [EVENT_NONE]                  = EVENT_PRIORITY_LOW,
+  [EVENT_PB0]                   = EVENT_PRIORITY_NORMAL,
+  [EVENT_PB1]                   = EVENT_PRIORITY_NORMAL,
+};
+
 /**
- * @brief   Scheduler to set the <>
+ * @brief   Raises the high water mark of a priority level to used if lower
  * @return  none
  */
-void schedulerSetEventPB1(){
-  // Enter critical state to modify global variable and exit ASAP
+static void event_stats_high_water(uint32_t priority, uint32_t used){
+  uint32_t hwm = __atomic_load_n(&event_stats.high_water[priority], __ATOMIC_RELAXED);
+  while((used > hwm) &&
+        !__atomic_compare_exchange_n(&event_stats.high_water[priority], &hwm, used,
+                                     true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+  }
+}
+
+/**
+ * @brief   Queues an event. Lock free, can be called from any IRQ handler or
+ *          from the main loop.
+ * @param   id    -   EVENT_xxx
+ * @param   value -   data for the event, stored in data.value
+ * @return  false if the queue for the priority of the event is full
+ */
+bool schedulerPostEvent(uint32_t id, uint32_t value){
+  if(id >= EVENT_COUNT || id == EVENT_NONE)
+    return false;
+
+  uint32_t priority = event_priority[id];
+  Event_Queue_t *q = &event_queues[priority];
+  Event_Slot_t *slot;
+  uint32_t pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+
+  // Claim a slot
+  for(;;){
+    slot = &q->slots[pos & (SCHEDULER_QUEUE_SIZE - 1)];
+    int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - EVENT_LAP(pos));
+
+    if(diff == 0){
+      if(__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, true,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    }
+    else if(diff < 0){
+      // The consumer has not freed this slot yet, queue is full
+      __atomic_fetch_add(&event_stats.dropped, 1, __ATOMIC_RELAXED);
+      return false;
+    }
+    else{
+      // Another producer took this position
+      pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    }
+    // A failed compare and swap has reloaded pos
+  }
+
+  slot->evt.id = id;
+  slot->evt.timestamp = letimerMilliseconds();
+  slot->evt.data.value = value;
+
+  // Publish
+  __atomic_store_n(&slot->seq, EVENT_LAP(pos) + 1, __ATOMIC_RELEASE);
+
+  __atomic_fetch_add(&event_stats.posted, 1, __ATOMIC_RELAXED);
+  event_stats_high_water(priority, pos + 1 - q->head);
+  return true;
+}
+
+/**
+ * @brief   Changes the priority level an event is queued at. Events already
+ *          queued keep their old priority.
+ * @return  none
+ */
+void schedulerSetEventPriority(uint32_t id, Event_Priority_t priority){
+  if(id < EVENT_COUNT && priority < EVENT_PRIORITY_COUNT)
+    event_priority[id] = priority;
+}
+
+/**
+ * @brief   Takes the next event off the queue, highest priority first and in
+ *          the order they were set within a priority. Main loop only.
+ * @param   evt -   filled with the event
+ * @return  false if no event is pending
+ */
+bool schedulerGetEvent(Scheduler_Event_t *evt){
+  for(uint32_t p = 0; p < EVENT_PRIORITY_COUNT; p++){
+    Event_Queue_t *q = &event_queues[p];
+    uint32_t pos = q->head;
+    Event_Slot_t *slot = &q->slots[pos & (SCHEDULER_QUEUE_SIZE - 1)];
+
+    // Not published yet, either empty or the producer was preempted while
+    // filling it in. Its event is picked up on a later call.
+    if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != EVENT_LAP(pos) + 1)
+      continue;
+
+    *evt = slot->evt;
+
+    // Hand the slot back to the producers for position pos + SIZE
+    __atomic_store_n(&slot->seq, EVENT_LAP(pos) + SCHEDULER_QUEUE_SIZE, __ATOMIC_RELEASE);
+    q->head = pos + 1;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief   Hands every pending event to handler, highest priority first. An
+ *          event set while draining is handled in the same call.
+ * @return  number of events handled
+ */
+uint32_t schedulerDrainEvents(Scheduler_Handler_t handler){
+  Scheduler_Event_t evt;
+  uint32_t count = 0;
+
+  while(schedulerGetEvent(&evt)){
+    if(handler != NULL)
+      handler(&evt);
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief   Copies the queue counters, see Scheduler_Stats_t
+ * @return  none
+ */
+void schedulerGetStats(Scheduler_Stats_t *stats){
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
-  sl_bt_external_signal(1<<PB1_BIT_POS);
+  *stats = event_stats;
   CORE_EXIT_CRITICAL();
 }
 
 /**
- * @brief   Scheduler to set the <>
+ * @brief   Scheduler to set the PB1 event
+ * @return  none
+ */
+void schedulerSetEventPB1(){
+  schedulerPostEvent(EVENT_PB1, 0);
+  sl_bt_external_signal(1<<PB1_BIT_POS);
+}
+
+/**
+ * @brief   Scheduler to set the PB0 event
  * @return  none
  */
 void schedulerSetEventPB0(){
-  // Enter critical state to modify global variable and exit ASAP
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  schedulerPostEvent(EVENT_PB0, 0);
   sl_bt_external_signal(1<<PB0_BIT_POS);
-  CORE_EXIT_CRITICAL();
 }
 
 
@@ -123,12 +314,8 @@ void schedulerSetEventPB0(){
  * @return  none
  */
 void schedulerSetEventLETIMER0Comp1(){
-  // Enter critical state to modify global variable and exit ASAP
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
-  SchedulerEvents |= (1<<LETIMERCOMP1_BIT_POS);
+  schedulerPostEvent(EVENT_LETIMER_COMP1, 0);
   sl_bt_external_signal(1<<LETIMERCOMP1_BIT_POS);
-  CORE_EXIT_CRITICAL();
 }
 
 /**
@@ -136,73 +323,248 @@ void schedulerSetEventLETIMER0Comp1(){
  * @return  none
  */
 void schedulerSetEventLETIMER0UF(){
-  // Enter critical state to modify global variable and exit ASAP
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
-  SchedulerEvents |= (1<<LETIMERUF_BIT_POS);
+  schedulerPostEvent(EVENT_LETIMER_UF, 0);
   sl_bt_external_signal(1<<LETIMERUF_BIT_POS);
-  CORE_EXIT_CRITICAL();
 }
 
 /**
- * @brief   Scheduler to set the event where I2C transfer is done
+ * @brief   Scheduler to set the event of an expired timerStartUs() timer. The
+ *          event id is also the external signal bit for the BT state machines.
+ * @param   id  -   EVENT_xxx the timer was started with
  * @return  none
  */
-void schedulerSetEventI2CTransferDone(){
-  // Enter critical state to modify global variable and exit ASAP
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
-  SchedulerEvents |= (1<<I2C_TRANSFER_COMPLETE_BIT_POS);
-  sl_bt_external_signal(1<<I2C_TRANSFER_COMPLETE_BIT_POS);
-  CORE_EXIT_CRITICAL();
+void schedulerSetEventTimerExpired(uint32_t id){
+  schedulerPostEvent(id, 0);
+  sl_bt_external_signal(1<<id);
+}
+
+/**
+ * @brief   Scheduler to set the event where I2C transfer has ended
+ * @param   status -  result of the transfer, i2cTransferDone or an error
+ * @return  none
+ */
+void schedulerSetEventI2CTransferDone(int32_t status){
+  schedulerPostEvent(EVENT_I2C_TRANSFER_COMPLETE, (uint32_t)status);
+
+  // The BT state machines only move on a completed transfer
+  if(status == I2CTransferDone)
+    sl_bt_external_signal(1<<I2C_TRANSFER_COMPLETE_BIT_POS);
 }
 
 
 /**
  * @brief   Checks if any event are present to handle and returns them. In case
  *          of multiple events, the most important event shall be handled first.
- * @return  Returns the latest event to handle
+ * @return  Returns the latest event to handle, EVENT_NONE if there is none
  */
 uint32_t getNextEvent(){
+  Scheduler_Event_t evt;
 
-  // Set the default event to be returned as EVENT_NONE
-  uint32_t ReturnEvent = EVENT_NONE;
-
-  /* Determine the event to return based on priority level.
-   *
-   * Priority level:
-   *    EVENT_I2C_TRANSFER_COMPLETE
-   *    EVENT_LETIMER_COMP1
-   *    EVENT_LETIMER_UF
-   */
-
-  if(SchedulerEvents & (1<<I2C_TRANSFER_COMPLETE_BIT_POS))
-    ReturnEvent = EVENT_I2C_TRANSFER_COMPLETE;
-  else if(SchedulerEvents & (1<<LETIMERCOMP1_BIT_POS))
-    ReturnEvent = EVENT_LETIMER_COMP1;
-  else if (SchedulerEvents & (1<<LETIMERUF_BIT_POS))
-    ReturnEvent = EVENT_LETIMER_UF;
-
-  // Enter critical state to modify global variable and exit ASAP
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
-  switch(ReturnEvent){
-    case EVENT_LETIMER_COMP1:
-                        SchedulerEvents &= ~(1<<LETIMERCOMP1_BIT_POS);
-                        break;
-    case EVENT_LETIMER_UF:
-                        SchedulerEvents &= ~(1<<LETIMERUF_BIT_POS);
-                        break;
-    case EVENT_I2C_TRANSFER_COMPLETE:
-                        SchedulerEvents &= ~(1<<I2C_TRANSFER_COMPLETE_BIT_POS);
-                        break;
-  }
-  CORE_EXIT_CRITICAL();
+  if(!schedulerGetEvent(&evt))
+    return EVENT_NONE;
 
-  return ReturnEvent;
+  return evt.id;
 }
 
 #if BUILD_INCLUDES_BLE_SERVER == 1
+/*
+ * Temperature state machine, reads the Si7021 over I2C using IRQs and sends
+ * the temperature via BT. Its events are the external signal bit positions.
+ */
+
+/**
+ * @brief   Powers on the Si7021 and waits for its POR, the COMP1 event comes
+ *          at once if the part is still powered from the last sample
+ * @return  none
+ */
+static void temp_power_on(fsm_t *fsm, void *arg){
+  uint32_t por_us = Si7021_Power_On();
+
+  (void) fsm;
+  (void) arg;
+  if(por_us != 0)
+    timerWaitUs_irq(por_us);
+  else
+    schedulerSetEventTimerExpired(EVENT_LETIMER_COMP1);
+}
+
+/**
+ * @brief   Sets the resolution if the part lost it and starts the I2C write
+ *          requesting a measurement
+ * @return  none
+ */
+static void temp_request(fsm_t *fsm, void *arg){
+  (void) fsm;
+  (void) arg;
+  if(!Si7021_Configure()){
+      LOG_ERROR("Si7021_Configure() failed, measuring at the current resolution\r\n");
+  }
+#if SI7021_SINGLE_CONVERSION == 1
+  I2C_Write_Data_itr(SI7021_DEVICE_ADDR, SI7021_CMD_MEASURE_RH_NO_HOLD);
+#else
+  I2C_Write_Data_itr(SI7021_DEVICE_ADDR, SI7021_CMD_MEASURE_TEMP_NO_HOLD);
+#endif
+}
+
+/**
+ * @brief   Disables the I2C IRQ and waits for the Si7021 conversion
+ * @return  none
+ */
+static void temp_wait_conversion(fsm_t *fsm, void *arg){
+  (void) fsm;
+  (void) arg;
+  NVIC_DisableIRQ(I2C0_IRQn);
+  timerWaitUs_irq(Si7021_Conversion_Time_Us());
+}
+
+/**
+ * @brief   Starts the I2C read of the measurement
+ * @return  none
+ */
+static void temp_read(fsm_t *fsm, void *arg){
+  (void) fsm;
+  (void) arg;
+  I2C_Read_Data_irq(SI7021_DEVICE_ADDR);
+}
+
+#if SI7021_SINGLE_CONVERSION == 1
+/**
+ * @brief   Keeps the RH code and reads back the temperature the RH
+ *          conversion measured, no second conversion needed
+ * @return  none
+ */
+static void temp_read_from_rh(fsm_t *fsm, void *arg){
+  (void) fsm;
+  (void) arg;
+  NVIC_DisableIRQ(I2C0_IRQn);
+  si7021_rh_code = I2C_Get_Data();
+  I2C_Write_Read_Data_irq(SI7021_DEVICE_ADDR, SI7021_CMD_READ_TEMP_FROM_RH);
+}
+#endif
+
+/**
+ * @brief   Disables the I2C IRQ, ends the Si7021 sample and sends the
+ *          temperature over BT
+ * @return  none
+ */
+static void temp_send(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+  uint32_t temperature_reading = 0;
+  uint16_t Si7021_data = 0;
+  sl_status_t sc; // status code
+
+  (void) arg;
+  NVIC_DisableIRQ(I2C0_IRQn);
+  Si7021_Power_Off(LETIMER_PERIOD_MS);
+  uint8_t *p = &htm_temperature_buffer[0];
+  Si7021_data = I2C_Get_Data();
+
+  // Converting the data received from the sensor into temperature in Celsius
+  // using the formula given in the SI7021 sensor application note AN607
+  temperature_reading = ((Si7021_data*175.72)/65536) - 46.85;
+
+#if SI7021_SINGLE_CONVERSION == 1
+  int32_t rh = Si7021_RH_Centi_Percent(si7021_rh_code);
+#endif
+
+  // To send via BT, do the following steps:
+  // - update GATT data base with sl_bt_gatt_server_write_attribute_value()
+  // - Convert the temp data into float, insert into the bit
+  //   stream and write into the GATT DB
+  UINT8_TO_BITSTREAM(p, flags);
+  htm_temperature_flt = INT32_TO_FLOAT(temperature_reading*1000, -3);
+  UINT32_TO_BITSTREAM(p, htm_temperature_flt);
+
+  sc = sl_bt_gatt_server_write_attribute_value(
+        gattdb_temperature_measurement, // handle from gatt_db.h
+        0, // offset
+        5, // length
+        &htm_temperature_buffer[0] // in IEEE-11073 format
+       );
+
+  // A client that enabled the telemetry stream gets the reading batched with
+  // the others instead of as an indication of its own
+  if((bleDataPtr->connection_open == true) && telemetry_is_enabled()){
+      telemetry_add_sample(TELEMETRY_TEMPERATURE,
+                           (int16_t) Si7021_Temp_Centi_C(Si7021_data));
+      displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp=%d", temperature_reading);
+#if SI7021_SINGLE_CONVERSION == 1
+      telemetry_add_sample(TELEMETRY_HUMIDITY, (int16_t) rh);
+      displayPrintf(DISPLAY_ROW_8, "RH=%d%%", (int) (rh / 100));
+#endif
+      return;
+  }
+
+  //-----------------------------------------------------------------------
+  // call sl_bt_gatt_server_send_indication() ONLY if the following
+  // conditions are met :
+  //  - Connection is open
+  //  - Client has enabled indications for the HTM indications
+  //  - There is no indication currently in-flight
+  //
+  // If all above conditions are met, then update the temperature value on
+  // the LCD display on the row 'DISPLAY_ROW_TEMPVALUE'.
+  // Else, clear the text on the same row
+  //-----------------------------------------------------------------------
+  if  ((bleDataPtr->connection_open == true) &&
+       (bleDataPtr->ok_to_send_htm_indications == true)){
+
+      if(!((bleDataPtr->indication_in_flight == false)||
+          (get_queue_depth() > 0))){
+          // Server Sending the Indication.
+        sc = sl_bt_gatt_server_send_indication(
+              bleDataPtr->connectionHandle,
+              gattdb_temperature_measurement, // handle from gatt_db.h
+              5,
+              &htm_temperature_buffer[0] // in IEEE-11073 format
+             );
+
+        if (sc != SL_STATUS_OK) {
+            LOG_ERROR("sl_bt_gatt_server_send_indication() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+        }
+        bleDataPtr->indication_in_flight = true;
+
+      } // if
+      else{
+          write_queue(gattdb_temperature_measurement, 5, &htm_temperature_buffer[0]);
+      }
+        displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp=%d", temperature_reading);
+#if SI7021_SINGLE_CONVERSION == 1
+        displayPrintf(DISPLAY_ROW_8, "RH=%d%%", (int) (rh / 100));
+#endif
+  }// if
+  else{
+      displayPrintf(DISPLAY_ROW_TEMPVALUE, "");
+#if SI7021_SINGLE_CONVERSION == 1
+      displayPrintf(DISPLAY_ROW_8, "");
+#endif
+  }
+}
+
+static const fsm_transition_t temperature_table[] = {
+  // state                    event                           action                next state
+  { stateIdle,                LETIMERUF_BIT_POS,              temp_power_on,        waitForSi7021POR },
+  { waitForSi7021POR,         LETIMERCOMP1_BIT_POS,           temp_request,         waitForI2CWriteTransfer },
+  { waitForI2CWriteTransfer,  I2C_TRANSFER_COMPLETE_BIT_POS,  temp_wait_conversion, waitForSi7021Conversion },
+  { waitForSi7021Conversion,  LETIMERCOMP1_BIT_POS,           temp_read,            waitForI2CReadTransfer },
+#if SI7021_SINGLE_CONVERSION == 1
+  { waitForI2CReadTransfer,   I2C_TRANSFER_COMPLETE_BIT_POS,  temp_read_from_rh,    waitForI2CTempTransfer },
+  { waitForI2CTempTransfer,   I2C_TRANSFER_COMPLETE_BIT_POS,  temp_send,            stateIdle },
+#else
+  { waitForI2CReadTransfer,   I2C_TRANSFER_COMPLETE_BIT_POS,  temp_send,            stateIdle },
+#endif
+};
+
+static const fsm_def_t temperature_fsm_def = {
+  .name = "temp",
+  .table = temperature_table,
+  .count = ARRAY_SIZE(temperature_table),
+  .initial = stateIdle
+};
+
+static fsm_t temperature_fsm;
+static fsm_transition_stats_t temperature_fsm_stats[ARRAY_SIZE(temperature_table)];
+
 /**
  * @brief   State machine to get the temperature from Si7021 chip over I2C using
  *          IRQs and send it via BT
@@ -211,308 +573,394 @@ uint32_t getNextEvent(){
  * @return  none
  */
 void temperature_state_machine_bt(sl_bt_msg_t *evt){
-  State_t currentState;
-  static State_t nextState = stateIdle;
-  uint32_t temperature_reading = 0;
-  uint16_t Si7021_data = 0;
-  sl_status_t sc; // status code
-
-  currentState = nextState;
   ble_data_struct_t *bleDataPtr = get_ble_data_ptr();
 
   // Check the following conditioins and proceed if all are true:
   //  - we have recieved some external event from the bluetooth stack
   //  - the bluetooth connection is open
-  //  - indications are turned on by the client
+  //  - indications or the telemetry stream are turned on by the client
   if((SL_BT_MSG_ID(evt->header) == sl_bt_evt_system_external_signal_id) &&
      (bleDataPtr->connection_open == true) &&
-     (bleDataPtr->ok_to_send_htm_indications == true)){
-    switch (currentState) {
-      case stateIdle:
-              nextState = stateIdle; // default
-              /*
-               * if event is LETIMERUF, then power on the Si7021, set delay for
-               * Si7021 POR and go to next state
-               */
-                if ((evt->data.evt_system_external_signal.extsignals & (1<<LETIMERUF_BIT_POS))){
-                    si7021TurnOn();
-                    timerWaitUs_irq(SI7021_POR_TIME_US);
-                    nextState = waitForSi7021POR;
-                }
-              break;
-      case waitForSi7021POR:
-              nextState = waitForSi7021POR; // default
-              /*
-               * if timer event is complete (denoted by the LETIMER_COMP1 event),
-               * then start I2C write operation to request
-               * temperature data from the Si7021 chip and go to next state.
-               */
-                if ((evt->data.evt_system_external_signal.extsignals & (1<<LETIMERCOMP1_BIT_POS))){
-                    I2C_Write_Data_itr(SI7021_DEVICE_ADDR, SI7021_CMD_MEASURE_TEMP_NO_HOLD);
-                    nextState = waitForI2CWriteTransfer;
-                }
-              break;
-      case waitForI2CWriteTransfer:
-              nextState = waitForI2CWriteTransfer; // default
-              /*
-               * if i2c transfer is done, disable I2C IRQ, setup conversion
-               * timer required by the Si7021 chip and go to next state.
-               */
-                if ((evt->data.evt_system_external_signal.extsignals & (1<<I2C_TRANSFER_COMPLETE_BIT_POS))){
-                    NVIC_DisableIRQ(I2C0_IRQn);
-                    timerWaitUs_irq(SI7021_14B_CONVERSION_TIME_US);
-                    nextState = waitForSi7021Conversion;
-                }
-              break;
-      case waitForSi7021Conversion:
-              nextState = waitForSi7021Conversion; // default
-              /*
-              * if timer event is complete (denoted by the LETIMER_COMP1 event),
-              * start I2C read operation to read the requested temperature data
-              * from the Si7021 chip and go to next state.
-              */
-                if ((evt->data.evt_system_external_signal.extsignals & (1<<LETIMERCOMP1_BIT_POS))){
-                    I2C_Read_Data_irq(SI7021_DEVICE_ADDR);
-                    nextState = waitForI2CReadTransfer;
-                }
-              break;
-      case waitForI2CReadTransfer:
-              /*
-               * if i2c transfer is done, disable I2C IRQ, retrieve data from
-               * I2C read operation and send tempurature data over bluetooth,
-               * and go to next state.
-               */
-              nextState = waitForI2CReadTransfer; // default
-                  if ((evt->data.evt_system_external_signal.extsignals & (1<<I2C_TRANSFER_COMPLETE_BIT_POS))){
-                    NVIC_DisableIRQ(I2C0_IRQn);
-                    si7021TurnOff();
-                    uint8_t *p = &htm_temperature_buffer[0];
-                    Si7021_data = I2C_Get_Data();
-
-                    // Converting the data received from the sensor into temperature in Celsius
-                    // using the formula given in the SI7021 sensor application note AN607
-                    temperature_reading = ((Si7021_data*175.72)/65536) - 46.85;
-
-                    // To send via BT, do the following steps:
-                    // - update GATT data base with sl_bt_gatt_server_write_attribute_value()
-                    // - Convert the temp data into float, insert into the bit
-                    //   stream and write into the GATT DB
-                    UINT8_TO_BITSTREAM(p, flags);
-                    htm_temperature_flt = INT32_TO_FLOAT(temperature_reading*1000, -3);
-                    UINT32_TO_BITSTREAM(p, htm_temperature_flt);
-
-                    sc = sl_bt_gatt_server_write_attribute_value(
-                          gattdb_temperature_measurement, // handle from gatt_db.h
-                          0, // offset
-                          5, // length
-                          &htm_temperature_buffer[0] // in IEEE-11073 format
-                         );
-
-                    //-----------------------------------------------------------------------
-                    // call sl_bt_gatt_server_send_indication() ONLY if the following
-                    // conditions are met :
-                    //  - Connection is open
-                    //  - Client has enabled indications for the HTM indications
-                    //  - There is no indication currently in-flight
-                    //
-                    // If all above conditions are met, then update the temperature value on
-                    // the LCD display on the row 'DISPLAY_ROW_TEMPVALUE'.
-                    // Else, clear the text on the same row
-                    //-----------------------------------------------------------------------
-                    if  ((bleDataPtr->connection_open == true) &&
-                         (bleDataPtr->ok_to_send_htm_indications == true)){
-
-                        if(!((bleDataPtr->indication_in_flight == false)||
-                            (get_queue_depth() > 0))){
-                            // Server Sending the Indication.
-                          sc = sl_bt_gatt_server_send_indication(
-                                bleDataPtr->connectionHandle,
-                                gattdb_temperature_measurement, // handle from gatt_db.h
-                                5,
-                                &htm_temperature_buffer[0] // in IEEE-11073 format
-                               );
-
-                          if (sc != SL_STATUS_OK) {
-                              LOG_ERROR("sl_bt_gatt_server_send_indication() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-                          }
-                          bleDataPtr->indication_in_flight = true;
-
-                        } // if
-                        else{
-                            write_queue(gattdb_temperature_measurement, 5, &htm_temperature_buffer[0]);
-                        }
-                          displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp=%d", temperature_reading);
-                    }// if
-                    else{
-                        displayPrintf(DISPLAY_ROW_TEMPVALUE, "");
-                    }
-                    nextState = stateIdle;
-                }// if
-              break;
-    default:
-              break;
-    } // switch
-  }// end if
+     ((bleDataPtr->ok_to_send_htm_indications == true) || telemetry_is_enabled())){
+    uint32_t signals = evt->data.evt_system_external_signal.extsignals;
+
+    // At most one transition per signal, taken on the first bit the current
+    // state is waiting for
+    for(uint32_t bit = 0; bit < 32; bit++){
+      if((signals & (1u<<bit)) && fsm_dispatch(&temperature_fsm, bit, evt))
+        break;
+    }
+  }
 
-  // If the connection has been closed or indication is not given, then we clear
-  // the LCD text on the row 'DISPLAY_ROW_TEMPVALUE'.
+  // If the connection has been closed or neither indication nor the stream
+  // is enabled, then we clear the LCD text on the row 'DISPLAY_ROW_TEMPVALUE'.
   if((bleDataPtr->connection_open == false) ||
-     (bleDataPtr->ok_to_send_htm_indications == false)){
+     ((bleDataPtr->ok_to_send_htm_indications == false) && !telemetry_is_enabled())){
     displayPrintf(DISPLAY_ROW_TEMPVALUE, "");
+#if SI7021_SINGLE_CONVERSION == 1
+    displayPrintf(DISPLAY_ROW_8, "");
+#endif
   }
 } // state_machine()
 #endif
 
 #if BUILD_INCLUDES_BLE_CLIENT == 1
+/*
+ * Discovery state machine, finds the HTM and button services and
+ * characteristics of the server and enables their indications, then does the
+ * same for Service Changed so a changed server invalidates the GATT cache.
+ * Its events are BT stack message ids.
+ */
+
+/**
+ * @brief   Discovers the HTM service
+ * @return  none
+ */
+static void disc_find_htm_service(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+  sl_status_t sc; // status code
+
+  (void) arg;
+  sc = sl_bt_gatt_discover_primary_services_by_uuid(bleDataPtr->connectionHandle,
+                                                    sizeof(thermo_service),
+                                                    (const uint8_t*)&thermo_service[0]);
+
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_gatt_discover_primary_services_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+}
+
+/**
+ * @brief   Saves the HTM service handle and discovers the HTM characteristic
+ * @return  none
+ */
+static void disc_find_htm_char(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+  sl_status_t sc; // status code
+
+  (void) arg;
+  bleDataPtr->serviceHandleHTM = bleDataPtr->serviceHandle;
+  sc = sl_bt_gatt_discover_characteristics_by_uuid(bleDataPtr->connectionHandle,
+                                                   bleDataPtr->serviceHandleHTM,
+                                                   sizeof(thermo_char),
+                                                   (const uint8_t*) &thermo_char[0]);
+
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_gatt_discover_characteristics_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+}
+
+/**
+ * @brief   Saves the HTM characteristic handle and enables its indications
+ * @return  none
+ */
+static void disc_enable_htm(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+  sl_status_t sc; // status code
+
+  (void) arg;
+  bleDataPtr->characteristicHandleHTM = bleDataPtr->characteristicHandle;
+  sc = sl_bt_gatt_set_characteristic_notification(bleDataPtr->connectionHandle,
+                                                  bleDataPtr->characteristicHandleHTM,
+                                                  sl_bt_gatt_indication);
+
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_gatt_set_characteristic_notification() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+}
+
+/**
+ * @brief   Updates the LCD and discovers the button service
+ * @return  none
+ */
+static void disc_find_button_service(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+  sl_status_t sc; // status code
+
+  (void) arg;
+  displayPrintf(DISPLAY_ROW_CONNECTION, "Handling Indications");
+  sc = sl_bt_gatt_discover_primary_services_by_uuid(bleDataPtr->connectionHandle,
+                                                    sizeof(button_service),
+                                                    (const uint8_t*)&button_service[0]);
+
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_gatt_discover_primary_services_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+}
+
+/**
+ * @brief   Saves the button service handle and discovers the button
+ *          characteristic
+ * @return  none
+ */
+static void disc_find_button_char(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+  sl_status_t sc; // status code
+
+  (void) arg;
+  bleDataPtr->serviceHandleButton = bleDataPtr->serviceHandle;
+  sc = sl_bt_gatt_discover_characteristics_by_uuid(bleDataPtr->connectionHandle,
+                                                   bleDataPtr->serviceHandleButton,
+                                                   sizeof(button_char),
+                                                   (const uint8_t*) &button_char[0]);
+
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_gatt_discover_characteristics_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+}
+
+/**
+ * @brief   Saves the button characteristic handle and enables its indications
+ * @return  none
+ */
+static void disc_enable_button(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+  sl_status_t sc; // status code
+
+  (void) arg;
+  bleDataPtr->characteristicHandleButton = bleDataPtr->characteristicHandle;
+  sc = sl_bt_gatt_set_characteristic_notification(bleDataPtr->connectionHandle,
+                                                  bleDataPtr->characteristicHandleButton,
+                                                  sl_bt_gatt_indication);
+
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_gatt_set_characteristic_notification() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+  bleDataPtr->isIndicationOnButton = true;
+}
+
+/**
+ * @brief   Discovers the Generic Attribute service
+ * @return  none
+ */
+static void disc_find_gatt_service(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+  sl_status_t sc; // status code
+
+  (void) arg;
+  bleDataPtr->serviceHandle = 0;
+  sc = sl_bt_gatt_discover_primary_services_by_uuid(bleDataPtr->connectionHandle,
+                                                    sizeof(gatt_service),
+                                                    (const uint8_t*)&gatt_service[0]);
+
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_gatt_discover_primary_services_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+}
+
+/**
+ * @brief   Enables the Service Changed indications, the handle may be 0 if the
+ *          server has none
+ * @return  none
+ */
+static void disc_enable_service_changed_handle(fsm_t *fsm){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+  sl_status_t sc; // status code
+
+  if(bleDataPtr->characteristicHandleServiceChanged == 0){
+      LOG_WARN("Server has no Service Changed characteristic\r\n");
+      return;
+  }
+
+  sc = sl_bt_gatt_set_characteristic_notification(bleDataPtr->connectionHandle,
+                                                  bleDataPtr->characteristicHandleServiceChanged,
+                                                  sl_bt_gatt_indication);
+
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_gatt_set_characteristic_notification() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+}
+
+/**
+ * @brief   Saves the Service Changed handle, enables its indications and
+ *          stores every handle in the cache
+ * @return  none
+ */
+static void disc_enable_service_changed(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+
+  (void) arg;
+  bleDataPtr->characteristicHandleServiceChanged = bleDataPtr->characteristicHandle;
+  disc_enable_service_changed_handle(fsm);
+
+  // Every handle is known now, skip the discovery on the next connection
+  gatt_cache_handles_t handles = {
+    .serviceHandleHTM = bleDataPtr->serviceHandleHTM,
+    .serviceHandleButton = bleDataPtr->serviceHandleButton,
+    .characteristicHandleHTM = bleDataPtr->characteristicHandleHTM,
+    .characteristicHandleButton = bleDataPtr->characteristicHandleButton,
+    .characteristicHandleServiceChanged = bleDataPtr->characteristicHandleServiceChanged
+  };
+  gatt_cache_store(&disc_peer, &handles);
+}
+
+/**
+ * @brief   Discovers the Service Changed characteristic in the Generic
+ *          Attribute service
+ * @return  none
+ */
+static void disc_find_service_changed(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+  sl_status_t sc; // status code
+
+  bleDataPtr->characteristicHandle = 0;
+
+  // No Generic Attribute service, nothing to discover. Cache the other
+  // handles without Service Changed, no procedure is started so the state
+  // machine stays put until the connection closes.
+  if(bleDataPtr->serviceHandle == 0){
+      disc_enable_service_changed(fsm, arg);
+      return;
+  }
+
+  sc = sl_bt_gatt_discover_characteristics_by_uuid(bleDataPtr->connectionHandle,
+                                                   bleDataPtr->serviceHandle,
+                                                   sizeof(service_changed_char),
+                                                   (const uint8_t*) &service_changed_char[0]);
+
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_gatt_discover_characteristics_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+}
+
+/**
+ * @brief   Takes the handles from the cache and enables the HTM indications
+ * @return  none
+ */
+static void disc_enable_cached_htm(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+
+  bleDataPtr->serviceHandleHTM = disc_cached.serviceHandleHTM;
+  bleDataPtr->serviceHandleButton = disc_cached.serviceHandleButton;
+  bleDataPtr->characteristicHandleServiceChanged = disc_cached.characteristicHandleServiceChanged;
+  bleDataPtr->characteristicHandle = disc_cached.characteristicHandleHTM;
+  disc_enable_htm(fsm, arg);
+}
 
+/**
+ * @brief   Updates the LCD and enables the button indications on the cached
+ *          handle
+ * @return  none
+ */
+static void disc_enable_cached_button(fsm_t *fsm, void *arg){
+  ble_data_struct_t *bleDataPtr = fsm->ctx;
+
+  displayPrintf(DISPLAY_ROW_CONNECTION, "Handling Indications");
+  bleDataPtr->characteristicHandle = disc_cached.characteristicHandleButton;
+  disc_enable_button(fsm, arg);
+}
+
+/**
+ * @brief   Enables the Service Changed indications on the cached handle. The
+ *          client configuration is not kept for an unbonded client, so it is
+ *          written on every connection.
+ * @return  none
+ */
+static void disc_enable_cached_service_changed(fsm_t *fsm, void *arg){
+  (void) arg;
+  disc_enable_service_changed_handle(fsm);
+}
+
+/**
+ * @brief   Drops the cached handles and discovers the server from the start
+ * @return  none
+ */
+static void disc_rediscover(fsm_t *fsm, void *arg){
+  LOG_INFO("GATT handle cache stale, discovering\r\n");
+  gatt_cache_invalidate(&disc_peer);
+  disc_find_htm_service(fsm, arg);
+}
+
+static const fsm_transition_t discovery_table[] = {
+  // state          event                                   action                      next state
+  { State_1,        sl_bt_evt_connection_opened_id,         disc_find_htm_service,      State_2 },
+  { State_2,        sl_bt_evt_gatt_procedure_completed_id,  disc_find_htm_char,         State_3 },
+  { State_3,        sl_bt_evt_gatt_procedure_completed_id,  disc_enable_htm,            State_4 },
+  { State_4,        sl_bt_evt_gatt_procedure_completed_id,  disc_find_button_service,   State_5 },
+  { State_5,        sl_bt_evt_gatt_procedure_completed_id,  disc_find_button_char,      State_6 },
+  { State_6,        sl_bt_evt_gatt_procedure_completed_id,  disc_enable_button,         State_10 },
+  { State_10,       sl_bt_evt_gatt_procedure_completed_id,  disc_find_gatt_service,     State_11 },
+  { State_11,       sl_bt_evt_gatt_procedure_completed_id,  disc_find_service_changed,  State_12 },
+  { State_12,       sl_bt_evt_gatt_procedure_completed_id,  disc_enable_service_changed, State_7 },
+  // known server, the handles come from the cache
+  { State_1,        DISC_EVENT_OPENED_CACHED,               disc_enable_cached_htm,     State_8 },
+  { State_8,        DISC_EVENT_CACHE_STALE,                 disc_rediscover,            State_2 },
+  { State_8,        sl_bt_evt_gatt_procedure_completed_id,  disc_enable_cached_button,  State_9 },
+  { State_9,        DISC_EVENT_CACHE_STALE,                 disc_rediscover,            State_2 },
+  { State_9,        sl_bt_evt_gatt_procedure_completed_id,  disc_enable_cached_service_changed, State_13 },
+  { State_13,       DISC_EVENT_CACHE_STALE,                 disc_rediscover,            State_2 },
+  { State_13,       sl_bt_evt_gatt_procedure_completed_id,  NULL,                       State_7 },
+  { State_7,        DISC_EVENT_SERVICE_CHANGED,             disc_rediscover,            State_2 },
+  // if the connection is closed, start discovery from the beginning
+  { FSM_ANY_STATE,  sl_bt_evt_connection_closed_id,         NULL,                       State_1 },
+};
+
+static const fsm_def_t discovery_fsm_def = {
+  .name = "discovery",
+  .table = discovery_table,
+  .count = ARRAY_SIZE(discovery_table),
+  .initial = State_1
+};
+
+static fsm_t discovery_fsm;
+static fsm_transition_stats_t discovery_fsm_stats[ARRAY_SIZE(discovery_table)];
+
+/**
+ * @brief   Discovery state machine, finds the handles of the server or takes
+ *          them from the GATT cache
+ * @param   evt -   BT stack event
+ * @return  none
+ */
 void Discovery_State_Machine(sl_bt_msg_t *evt){
+  ble_data_struct_t *bleDataPtr = get_ble_data_ptr();
+  uint32_t event = SL_BT_MSG_ID(evt->header);
+
+  // Turn the stack events that mean something else for the cache into
+  // events of their own
+  switch(event){
+    case sl_bt_evt_connection_opened_id:
+      disc_peer = evt->data.evt_connection_opened.address;
+      bleDataPtr->characteristicHandleServiceChanged = 0;
+      if(gatt_cache_lookup(&disc_peer, &disc_cached))
+        event = DISC_EVENT_OPENED_CACHED;
+      break;
+
+    case sl_bt_evt_gatt_procedure_completed_id:
+      // A cached handle that no longer exists on the server
+      if(((discovery_fsm.state == State_8) || (discovery_fsm.state == State_9) ||
+          (discovery_fsm.state == State_13)) &&
+         ((evt->data.evt_gatt_procedure_completed.result == SL_STATUS_BT_ATT_INVALID_HANDLE) ||
+          (evt->data.evt_gatt_procedure_completed.result == SL_STATUS_BT_ATT_ATT_NOT_FOUND)))
+        event = DISC_EVENT_CACHE_STALE;
+      break;
+
+    case sl_bt_evt_gatt_characteristic_value_id:
+      // Only an indication on the discovered Service Changed handle
+      if((evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_handle_value_indication) &&
+         (bleDataPtr->characteristicHandleServiceChanged != 0) &&
+         (evt->data.evt_gatt_characteristic_value.characteristic == bleDataPtr->characteristicHandleServiceChanged)){
+        gatt_cache_invalidate(&disc_peer);
+        event = DISC_EVENT_SERVICE_CHANGED;
+      }
+      break;
 
-    Discovery_States_t currentState;
-    static Discovery_States_t nextState = State_1;
-
-    sl_status_t sc; // status code
-
-    currentState = nextState;
-    ble_data_struct_t *bleDataPtr = get_ble_data_ptr();
-    switch (currentState) {
-        case State_1:
-                nextState = State_1; // default
-                /*
-                 * if event is sl_bt_evt_connection_opened_id,
-                 *  - call API sl_bt_gatt_discover_primary_services_by_uuid()
-                 *    for HTM service
-                 */
-                  if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_connection_opened_id) {
-                    sc = sl_bt_gatt_discover_primary_services_by_uuid(bleDataPtr->connectionHandle,
-                                                                      sizeof(thermo_service),
-                                                                      (const uint8_t*)&thermo_service[0]);
-
-                    if (sc != SL_STATUS_OK) {
-                        LOG_ERROR("sl_bt_gatt_discover_primary_services_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-                    }
-
-                    nextState = State_2;
-                  }
-                break;
-        case State_2:
-                nextState = State_2; // default
-                /*
-                 * if event is sl_bt_evt_gatt_procedure_completed_id,
-                 *  - Save the returned service handle for HTM
-                 *  - call API sl_bt_gatt_discover_characteristics_by_uuid()
-                 *    for HTM characteristics
-                 */
-                  if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
-                      bleDataPtr->serviceHandleHTM = bleDataPtr->serviceHandle;
-                      sc = sl_bt_gatt_discover_characteristics_by_uuid(bleDataPtr->connectionHandle,
-                                                                       bleDataPtr->serviceHandleHTM,
-                                                                        sizeof(thermo_char),
-                                                                        (const uint8_t*) &thermo_char[0]);
-
-                      if (sc != SL_STATUS_OK) {
-                          LOG_ERROR("sl_bt_gatt_discover_characteristics_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-                      }
-                      nextState = State_3;
-                  }
-                break;
-        case State_3:
-                nextState = State_3; // default
-                 /*
-                  * if event is sl_bt_evt_gatt_procedure_completed_id,
-                  *  - Save the returned characteristic handle for HTM
-                  *  - call API sl_bt_gatt_set_characteristic_notification()
-                  *    for HTM characteristics
-                  */
-                   if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
-
-                       bleDataPtr->characteristicHandleHTM = bleDataPtr->characteristicHandle;
-                       sc = sl_bt_gatt_set_characteristic_notification(bleDataPtr->connectionHandle,
-                                                                        bleDataPtr->characteristicHandleHTM,
-                                                                        sl_bt_gatt_indication);
-
-                       if (sc != SL_STATUS_OK) {
-                           LOG_ERROR("sl_bt_gatt_set_characteristic_notification() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-                       }
-                       nextState = State_4;
-                   }
-                break;
-        case State_4:
-                nextState = State_4; // default
-                /*
-                 * if event is sl_bt_evt_gatt_procedure_completed_id,
-                 *  - update the LCD row DISPLAY_ROW_CONNECTION
-                 *  - call API sl_bt_gatt_discover_primary_services_by_uuid()
-                 *    for button service
-                 */
-                  if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
-                      displayPrintf(DISPLAY_ROW_CONNECTION, "Handling Indications");
-                      sc = sl_bt_gatt_discover_primary_services_by_uuid(bleDataPtr->connectionHandle,
-                                                                        sizeof(button_service),
-                                                                        (const uint8_t*)&button_service[0]);
-
-                      if (sc != SL_STATUS_OK) {
-                          LOG_ERROR("sl_bt_gatt_discover_primary_services_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-                      }
-                      nextState = State_5;
-                  }
-                break;
-        case State_5:
-                nextState = State_5; // default
-                /*
-                 * if event is sl_bt_evt_connection_opened_id,
-                 *  - Save the returned service handle for Button service
-                 *  - call API sl_bt_gatt_discover_characteristics_by_uuid()
-                 *    for Button characteristics
-                 */
-                  if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
-                    bleDataPtr->serviceHandleButton = bleDataPtr->serviceHandle;
-                    sc = sl_bt_gatt_discover_characteristics_by_uuid(bleDataPtr->connectionHandle,
-                                                                     bleDataPtr->serviceHandleButton,
-                                                                     sizeof(button_char),
-                                                                     (const uint8_t*) &button_char[0]);
-
-                    if (sc != SL_STATUS_OK) {
-                        LOG_ERROR("sl_bt_gatt_discover_characteristics_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-                    }
-
-                    nextState = State_6;
-                  }
-                break;
-        case State_6:
-                nextState = State_6; // default
-                /*
-                 * if event is sl_bt_evt_gatt_procedure_completed_id,
-                  *  - Save the returned characteristic handle for Button
-                  *    characteristics
-                  *  - call API sl_bt_gatt_set_characteristic_notification()
-                  *    for HTM characteristics
-                  *  - Save the status indication state for the button
-                  *    characteristics
-                 */
-                  if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
-                     bleDataPtr->characteristicHandleButton = bleDataPtr->characteristicHandle;
-                     sc = sl_bt_gatt_set_characteristic_notification(bleDataPtr->connectionHandle,
-                                                                      bleDataPtr->characteristicHandleButton,
-                                                                      sl_bt_gatt_indication);
-
-                     if (sc != SL_STATUS_OK) {
-                         LOG_ERROR("sl_bt_gatt_set_characteristic_notification() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-                     }
-                     bleDataPtr->isIndicationOnButton = true;
-                     nextState = State_7;
-                  }
-                  break;
-        case State_7:
-                nextState = State_7; // default
-                /*
-                 * if the connection is closed, the start discovery from the beginning
-                 */
-
-                if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_connection_closed_id) {
-                    nextState = State_1;
-                }
-                break;
+    default:
+      break;
+  }
 
-    }
+  fsm_dispatch(&discovery_fsm, event, evt);
 }
 #endif
+
+/**
+ * @brief   Puts the state machines in their initial state
+ * @return  none
+ */
+void schedulerStateMachinesInit(){
+#if BUILD_INCLUDES_BLE_SERVER == 1
+  fsm_init(&temperature_fsm, &temperature_fsm_def, get_ble_data_ptr(), temperature_fsm_stats);
+#endif
+#if BUILD_INCLUDES_BLE_CLIENT == 1
+  fsm_init(&discovery_fsm, &discovery_fsm_def, get_ble_data_ptr(), discovery_fsm_stats);
+#endif
+}
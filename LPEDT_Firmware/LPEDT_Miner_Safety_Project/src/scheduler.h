@@ -23,12 +23,50 @@
 #define EVENT_LETIMER_COMP1 1
 #define EVENT_I2C_TRANSFER_COMPLETE 2
 #define EVENT_NONE 3
+#define EVENT_PB0 4
+#define EVENT_PB1 5
+#define EVENT_COUNT 6
 
 #define PB0_BIT_POS 4
 #define PB1_BIT_POS 5
 
+// Slots per priority level, must be a power of two
+#define SCHEDULER_QUEUE_SIZE 16
+
+// Most events expected to wait at once with the queue drained every pass,
+// app.c warns above it
+#define SCHEDULER_QUEUE_HWM_MAX 4
+
+#include <stdbool.h>
+#include <stdint.h>
 #include "ble.h"
 
+// Priority levels of the event queue, EVENT_PRIORITY_HIGH is handled first
+typedef enum {
+  EVENT_PRIORITY_HIGH,
+  EVENT_PRIORITY_NORMAL,
+  EVENT_PRIORITY_LOW,
+  EVENT_PRIORITY_COUNT
+} Event_Priority_t;
+
+// An event and the data its producer attached to it
+typedef struct {
+  uint32_t id;          // EVENT_xxx
+  uint32_t timestamp;   // letimerMilliseconds() when the event was set
+  union {
+    int32_t  i2c_status;  // EVENT_I2C_TRANSFER_COMPLETE, I2C_TransferReturn_TypeDef
+    uint32_t value;
+  } data;
+} Scheduler_Event_t;
+
+typedef struct {
+  uint32_t posted;                            // events queued
+  uint32_t dropped;                           // events lost, queue was full
+  uint32_t high_water[EVENT_PRIORITY_COUNT];  // most events waiting at once
+} Scheduler_Stats_t;
+
+typedef void (*Scheduler_Handler_t)(const Scheduler_Event_t *evt);
+
 /**
  * @brief   Scheduler to set the <>
  * @return  none
@@ -53,20 +91,73 @@ void schedulerSetEventLETIMER0Comp1();
  */
 void schedulerSetEventLETIMER0UF();
 
+/**
+ * @brief   Scheduler to set the event of an expired timerStartUs() timer. The
+ *          event id is also the external signal bit for the BT state machines.
+ * @param   id  -   EVENT_xxx the timer was started with
+ * @return  none
+ */
+void schedulerSetEventTimerExpired(uint32_t id);
+
+
+/**
+ * @brief   Scheduler to set the event where I2C transfer has ended
+ * @param   status -  result of the transfer, i2cTransferDone or an error
+ * @return  none
+ */
+void schedulerSetEventI2CTransferDone(int32_t status);
+
+/**
+ * @brief   Queues an event. Lock free, can be called from any IRQ handler or
+ *          from the main loop.
+ * @param   id    -   EVENT_xxx
+ * @param   value -   data for the event, stored in data.value
+ * @return  false if the queue for the priority of the event is full
+ */
+bool schedulerPostEvent(uint32_t id, uint32_t value);
+
+/**
+ * @brief   Changes the priority level an event is queued at. Events already
+ *          queued keep their old priority.
+ * @return  none
+ */
+void schedulerSetEventPriority(uint32_t id, Event_Priority_t priority);
+
+/**
+ * @brief   Takes the next event off the queue, highest priority first and in
+ *          the order they were set within a priority. Main loop only.
+ * @param   evt -   filled with the event
+ * @return  false if no event is pending
+ */
+bool schedulerGetEvent(Scheduler_Event_t *evt);
+
+/**
+ * @brief   Hands every pending event to handler, highest priority first. An
+ *          event set while draining is handled in the same call.
+ * @return  number of events handled
+ */
+uint32_t schedulerDrainEvents(Scheduler_Handler_t handler);
 
 /**
- * @brief   Scheduler to set the event where I2C transfer is done
+ * @brief   Copies the queue counters, see Scheduler_Stats_t
  * @return  none
  */
-void schedulerSetEventI2CTransferDone();
+void schedulerGetStats(Scheduler_Stats_t *stats);
 
 /**
  * @brief   Checks if any event are present to handle and returns them. In case
  *          of multiple events, the most important event shall be handled first.
- * @return  Returns the latest event to handle
+ * @return  Returns the latest event to handle, EVENT_NONE if there is none
  */
 uint32_t getNextEvent();
 
+/**
+ * @brief   Puts the state machines in their initial state, call once from
+ *          app_init() after the LETIMER is running
+ * @return  none
+ */
+void schedulerStateMachinesInit();
+
 #if BUILD_INCLUDES_BLE_SERVER == 1
 /**
  * @brief   State machine to get the temperature from Si7021 chip over I2C using
@@ -0,0 +1,204 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    telemetry.c
+ * @brief   Implementation of the batched telemetry stream
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "gatt_db.h"
+#include "src/ble.h"
+#include "src/irq.h"
+#include "src/telemetry.h"
+
+// Include logging specifically for this .c file
+#define INCLUDE_LOG_DEBUG 1
+#include "src/log.h"
+
+// Largest notification, ATT MTU minus the 3 byte ATT header
+#define TELEMETRY_MAX_PAYLOAD  (TELEMETRY_ATT_MTU - 3)
+
+// ATT MTU before the exchange
+#define ATT_DEFAULT_MTU        (23)
+
+typedef struct {
+  uint32_t timestamp;
+  int16_t  value;
+  uint8_t  type;
+} telemetry_sample_t;
+
+static telemetry_sample_t samples[TELEMETRY_BUFFER_SAMPLES];
+static uint32_t head = 0;     // oldest sample
+static uint32_t count = 0;
+static uint16_t att_mtu = ATT_DEFAULT_MTU;
+static bool enabled = false;
+static telemetry_stats_t stats;
+
+/**
+ * @brief   Samples that fit in one notification at the current MTU
+ * @return  number of samples
+ */
+static uint32_t frame_capacity(){
+  uint32_t payload = att_mtu - 3;
+
+  if(payload > TELEMETRY_MAX_PAYLOAD)
+    payload = TELEMETRY_MAX_PAYLOAD;
+  return (payload - TELEMETRY_FRAME_HEADER) / TELEMETRY_SAMPLE_BYTES;
+}
+
+/**
+ * @brief   Packs up to frame_capacity() of the oldest samples into one
+ *          notification. The samples are only removed if the stack took it.
+ * @return  true if a notification was sent
+ */
+static bool send_frame(){
+  ble_data_struct_t *bleDataPtr = get_ble_data_ptr();
+  uint8_t frame[TELEMETRY_MAX_PAYLOAD];
+  uint32_t base = samples[head].timestamp;
+  uint32_t n = 0, capacity = frame_capacity();
+  uint8_t *p = &frame[TELEMETRY_FRAME_HEADER];
+
+  while(n < count && n < capacity){
+    const telemetry_sample_t *s = &samples[(head + n) % TELEMETRY_BUFFER_SAMPLES];
+    uint32_t offset = s->timestamp - base;
+
+    // The offset is 16 bits, a later sample starts the next frame
+    if(offset > UINT16_MAX)
+      break;
+
+    *p++ = (uint8_t)offset;
+    *p++ = (uint8_t)(offset >> 8);
+    *p++ = s->type;
+    *p++ = (uint8_t)s->value;
+    *p++ = (uint8_t)((uint16_t)s->value >> 8);
+    n++;
+  }
+
+  frame[0] = TELEMETRY_FRAME_VERSION;
+  frame[1] = (uint8_t)n;
+  frame[2] = (uint8_t)base;
+  frame[3] = (uint8_t)(base >> 8);
+  frame[4] = (uint8_t)(base >> 16);
+  frame[5] = (uint8_t)(base >> 24);
+
+  sl_status_t sc = sl_bt_gatt_server_send_notification(bleDataPtr->connectionHandle,
+                                                       gattdb_telemetry_stream,
+                                                       (size_t)(p - frame),
+                                                       frame);
+  if(sc != SL_STATUS_OK){
+    // Out of stack buffers, the link is busy. Retried on the next poll.
+    if(sc != SL_STATUS_NO_MORE_RESOURCE)
+      LOG_ERROR("sl_bt_gatt_server_send_notification() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+    return false;
+  }
+
+  head = (head + n) % TELEMETRY_BUFFER_SAMPLES;
+  count -= n;
+  stats.frames++;
+  stats.samples += n;
+  return true;
+}
+
+/**
+ * @brief   Sends frames while there are enough samples to fill one, and the
+ *          remainder if flush_all is set
+ * @return  none
+ */
+static void send_frames(bool flush_all){
+  if(!enabled || !get_ble_data_ptr()->connection_open)
+    return;
+
+  // Several notifications go out in the same connection event
+  while(count > 0 && (flush_all || count >= frame_capacity())){
+    if(!send_frame())
+      break;
+  }
+}
+
+/**
+ * @brief   Clears the buffer and the stream state, call when a connection
+ *          opens or closes
+ * @return  none
+ */
+void telemetry_reset(void){
+  head = 0;
+  count = 0;
+  att_mtu = ATT_DEFAULT_MTU;
+  enabled = false;
+}
+
+/**
+ * @brief   Records the ATT MTU from sl_bt_evt_gatt_mtu_exchanged
+ * @return  none
+ */
+void telemetry_set_mtu(uint16_t mtu){
+  att_mtu = (mtu < ATT_DEFAULT_MTU) ? ATT_DEFAULT_MTU : mtu;
+  LOG_INFO("ATT MTU %u, %u samples per notification\r\n",
+           (unsigned int) att_mtu, (unsigned int) frame_capacity());
+}
+
+/**
+ * @brief   Records whether the client enabled notifications on the stream
+ * @return  none
+ */
+void telemetry_set_enabled(bool on){
+  enabled = on;
+}
+
+/**
+ * @brief   true if samples should go to the stream instead of HTM indications
+ */
+bool telemetry_is_enabled(void){
+  return enabled;
+}
+
+/**
+ * @brief   Buffers a sample timestamped now and sends the frames that are full
+ * @param   type  -   TELEMETRY_xxx
+ * @return  none
+ */
+void telemetry_add_sample(uint8_t type, int16_t value){
+  if(count == TELEMETRY_BUFFER_SAMPLES){
+    head = (head + 1) % TELEMETRY_BUFFER_SAMPLES;
+    count--;
+    stats.dropped++;
+  }
+
+  telemetry_sample_t *s = &samples[(head + count) % TELEMETRY_BUFFER_SAMPLES];
+  s->timestamp = letimerMilliseconds();
+  s->type = type;
+  s->value = value;
+  count++;
+
+  send_frames(false);
+}
+
+/**
+ * @brief   Sends full frames and a partly filled one that has waited
+ *          TELEMETRY_MAX_LATENCY_MS, call periodically (SOFT_TIMER_1)
+ * @return  none
+ */
+void telemetry_poll(void){
+  if(count == 0)
+    return;
+
+  send_frames(letimerMilliseconds() - samples[head].timestamp >= TELEMETRY_MAX_LATENCY_MS);
+}
+
+/**
+ * @brief   Counters since boot
+ * @return  none
+ */
+void telemetry_get_stats(telemetry_stats_t *out){
+  *out = stats;
+}
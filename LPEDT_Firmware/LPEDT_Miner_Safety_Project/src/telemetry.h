@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    telemetry.h
+ * @brief   Batched sensor samples over the LPEDT Telemetry Stream
+ *          characteristic (gattdb_telemetry_stream).
+ *
+ *          Samples are buffered and sent as notifications that carry as many
+ *          timestamped samples as the negotiated ATT MTU allows (47 at an MTU
+ *          of 247), instead of one 5 byte HTM indication per reading that
+ *          has to be confirmed before the next one goes out. Clients that do
+ *          not enable the stream keep getting the HTM indications.
+ *
+ *          Frame, little endian:
+ *            version (1), sample count (1), base timestamp ms (4)
+ *            per sample: offset from base ms (2), type (1), value (2, signed)
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef SRC_TELEMETRY_H_
+#define SRC_TELEMETRY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ATT MTU the server offers, the largest the stack supports
+#define TELEMETRY_ATT_MTU          (247)
+
+#define TELEMETRY_FRAME_VERSION    (1)
+#define TELEMETRY_FRAME_HEADER     (6)
+#define TELEMETRY_SAMPLE_BYTES     (5)
+
+// A partly filled frame is sent once its oldest sample is this old
+#define TELEMETRY_MAX_LATENCY_MS   (1000)
+
+// Samples held while the link is busy, the oldest are dropped beyond this
+#define TELEMETRY_BUFFER_SAMPLES   (128)
+
+// Sample types
+#define TELEMETRY_TEMPERATURE      (1)   // 0.01 degC
+#define TELEMETRY_HUMIDITY         (2)   // 0.01 %RH
+
+typedef struct {
+  uint32_t frames;    // notifications sent
+  uint32_t samples;   // samples sent
+  uint32_t dropped;   // samples lost to a full buffer
+} telemetry_stats_t;
+
+/**
+ * @brief   Clears the buffer and the stream state, call when a connection
+ *          opens or closes
+ * @return  none
+ */
+void telemetry_reset(void);
+
+/**
+ * @brief   Records the ATT MTU from sl_bt_evt_gatt_mtu_exchanged
+ * @return  none
+ */
+void telemetry_set_mtu(uint16_t mtu);
+
+/**
+ * @brief   Records whether the client enabled notifications on the stream
+ * @return  none
+ */
+void telemetry_set_enabled(bool enabled);
+
+/**
+ * @brief   true if samples should go to the stream instead of HTM indications
+ */
+bool telemetry_is_enabled(void);
+
+/**
+ * @brief   Buffers a sample timestamped now and sends the frames that are full
+ * @param   type  -   TELEMETRY_xxx
+ * @return  none
+ */
+void telemetry_add_sample(uint8_t type, int16_t value);
+
+/**
+ * @brief   Sends full frames and a partly filled one that has waited
+ *          TELEMETRY_MAX_LATENCY_MS, call periodically (SOFT_TIMER_1)
+ * @return  none
+ */
+void telemetry_poll(void);
+
+/**
+ * @brief   Counters since boot
+ * @return  none
+ */
+void telemetry_get_stats(telemetry_stats_t *stats);
+
+#endif /* SRC_TELEMETRY_H_ */
@@ -19,10 +19,13 @@
 #include <stdbool.h>
 
 #include "em_device.h"
+#include "em_core.h"
 #include "oscillators.h"
 #include "em_letimer.h"
 #include "timers.h"
 #include "em_cmu.h"
+#include "sl_power_manager.h"
+#include "scheduler.h"
 
 // Include logging specifically for this .c file
 #define INCLUDE_LOG_DEBUG 1
@@ -45,6 +48,28 @@
 
 uint32_t LETIMER0_Comp0_Load_Val = 0, LETIMER0_Comp1_Load_Val = 0;
 
+// irq.c, counts the LETIMER0 underflows
+extern uint32_t rollover_count;
+
+/*
+ * Timer multiplexer. Active timers are kept in a list sorted by deadline,
+ * deadlines are in free running ticks and compared as a signed difference
+ * so the wrap of the tick count at 2^32 is handled. COMP1 is only armed for
+ * a deadline inside the current LETIMER0 period, a later one is armed by the
+ * UF IRQ of the period it falls in.
+ */
+typedef struct {
+  uint32_t deadline;    // tick count
+  uint32_t event_id;
+  int8_t   next;        // next slot in deadline order, -1 at the end
+  bool     active;
+  volatile uint8_t gen; // bumped each time the timer stops
+} Timer_Slot_t;
+
+static Timer_Slot_t timer_slots[TIMER_MUX_SLOTS];
+static int8_t timer_head = -1;        // nearest deadline, -1 if none
+static uint32_t letimer_freq_hz = 0;  // LETIMER0 clock, set by LETIMER0_Enable()
+
 
 /**
  * @brief   Sets the comp1 value in the LETIMER0 module
@@ -110,11 +135,13 @@ void LETIMER0_Enable(uint32_t nrg_mode){
 
   LETIMER_CompareSet(LETIMER0, 0, LETIMER0_Comp0_Load_Val);
 //  LETIMER0_Set_Comp1(LETIMER0_Comp1_Load_Val);
+  letimer_freq_hz = CMU_ClockFreqGet(cmuClock_LETIMER0);
 
   // Setup Interrupts
   LETIMER_IntClear (LETIMER0, 0xFFFFFFFF); // punch them all down
-  // Set UF and COMP1 in LETIMER0_IEN, so that the timer will generate IRQs to the NVIC.
-  temp = LETIMER_IEN_UF | LETIMER_IEN_COMP1;
+  // Set UF in LETIMER0_IEN, so that the timer will generate IRQs to the NVIC.
+  // COMP1 is enabled by the timer multiplexer while a deadline is armed.
+  temp = LETIMER_IEN_UF;
   LETIMER_IntEnable (LETIMER0, temp); // Make sure you have defined the ISR routine LETIMER0_IRQHandler()
   NVIC_ClearPendingIRQ (LETIMER0_IRQn);
   NVIC_EnableIRQ(LETIMER0_IRQn);
@@ -124,18 +151,15 @@ void LETIMER0_Enable(uint32_t nrg_mode){
 }
 
 /**
- * @brief   Provides a blocking delay of atleast us_wait micro-seconds based on
- *          the LETIMER0 ticks
+ * @brief   Range checks a blocking delay the way the blocking waits have
+ *          always done it
  * @param   us_wait   Time to provide delay for in microseconds
- * @return  none
+ * @return  us_wait clamped to between 1 tick and 1 LETIMER0 period
  */
-void timerWaitUs_polled(uint32_t us_wait){
-  uint32_t LETIMER_TICK_1 = 0, LETIMER_TICK_2 = 0;
-
+static uint32_t clampWaitUs(uint32_t us_wait){
   // Calculate how long each tick is based on the clock frequency
   // in micro-seconds
-  uint32_t LETIMER_Freq = CMU_ClockFreqGet(cmuClock_LETIMER0);
-  uint32_t LETIMER_Tick_Time_us = 1000000/LETIMER_Freq;
+  uint32_t LETIMER_Tick_Time_us = 1000000/CMU_ClockFreqGet(cmuClock_LETIMER0);
 
   // Range checking the input. If requested time is less than what this function
   // can provide, then we provide a minimum time delay given supported by 1 tick
@@ -152,6 +176,24 @@ void timerWaitUs_polled(uint32_t us_wait){
       LOG_ERROR("Requested delay is more than the supported range. Replacing with delay of %dus", us_wait);
   }
 
+  return us_wait;
+}
+
+/**
+ * @brief   Provides a blocking delay of atleast us_wait micro-seconds based on
+ *          the LETIMER0 ticks
+ * @param   us_wait   Time to provide delay for in microseconds
+ * @return  none
+ */
+void timerWaitUs_polled(uint32_t us_wait){
+  uint32_t LETIMER_TICK_1 = 0, LETIMER_TICK_2 = 0;
+
+  // Calculate how long each tick is based on the clock frequency
+  // in micro-seconds
+  uint32_t LETIMER_Tick_Time_us = 1000000/CMU_ClockFreqGet(cmuClock_LETIMER0);
+
+  us_wait = clampWaitUs(us_wait);
+
   // Calculating the number of ticks required to achieve the desired time
   uint32_t LETIMER_Tick_Count = us_wait/LETIMER_Tick_Time_us;
 
@@ -175,61 +217,229 @@ void timerWaitUs_polled(uint32_t us_wait){
   }
 }
 
+/**
+ * @brief   Provides a blocking delay of atleast us_wait micro-seconds, with
+ *          the core asleep until a LETIMER0 COMP1 deadline ends it. The range
+ *          is clamped like timerWaitUs_polled(). The core goes as deep as the
+ *          power manager requirements allow, add an EM1 requirement around
+ *          the call if a peripheral needs the HF clocks meanwhile.
+ * @param   us_wait   Time to provide delay for in microseconds
+ * @return  none
+ */
+void timerWaitUs_sleep(uint32_t us_wait){
+  int32_t handle = timerStartUs(clampWaitUs(us_wait), EVENT_NONE);
+
+  // No free timer, still honour the delay
+  if(handle < 0){
+      timerWaitUs_polled(us_wait);
+      return;
+  }
+
+  uint8_t gen = timer_slots[handle].gen;
+
+  // Interrupts stay masked from the check to the sleep, so an expiry in
+  // between leaves its IRQ pending and the sleep returns at once. It is
+  // serviced when the mask is lifted.
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  while(timer_slots[handle].gen == gen){
+      sl_power_manager_sleep();
+      CORE_EXIT_CRITICAL();
+      CORE_ENTER_CRITICAL();
+  }
+  CORE_EXIT_CRITICAL();
+}
+
 /**
  * @brief   Provides a non-blocking delay of atleast us_wait micro-seconds based on
- *          the LETIMER0 ticks
+ *          the LETIMER0 ticks, EVENT_LETIMER_COMP1 is set when it is over
  * @param   us_wait   Time to provide delay for in microseconds
  * @return  none
  */
 void timerWaitUs_irq(uint32_t us_wait){
-  uint32_t LETIMER_Curr_Tick = 0, LETIMER_Comp1_New_Load_Val = 0;
+  if(timerStartUs(us_wait, EVENT_LETIMER_COMP1) < 0){
+      LOG_ERROR("timerStartUs() no free timer for a %dus delay", us_wait);
+  }
+}
 
-  // Calculate how long each tick is based on the clock frequency
-  // in micro-seconds
-  uint32_t LETIMER_Tick_Time_us = 1000000/CMU_ClockFreqGet(cmuClock_LETIMER0);
+/**
+ * @brief   Tick count and LETIMER0 counter read together
+ * @param   cnt   -   LETIMER0 counter the tick count was taken from
+ * @return  free running tick count
+ */
+static uint32_t ticks_snapshot(uint32_t *cnt){
+  uint32_t period = LETIMER0_Comp0_Load_Val + 1;
+  uint32_t rollovers;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  rollovers = rollover_count;
+  *cnt = LETIMER_CounterGet(LETIMER0);
+
+  // The counter reloaded but the UF IRQ has not counted it yet, read the
+  // counter again so it is from after the reload
+  if(LETIMER_IntGet(LETIMER0) & LETIMER_IF_UF){
+    rollovers++;
+    *cnt = LETIMER_CounterGet(LETIMER0);
+  }
+  CORE_EXIT_CRITICAL();
 
-  // Range checking the input. If requested time is less than what this function
-  // can provide, then we provide a minimum time delay given supported by 1 tick
-  // If the requested time is more that the max time supported by the current
-  // LETIMER0 configuration, then we provide maximum time supported by this
-  // LETIMER0 configuration.
-  if (us_wait < LETIMER_Tick_Time_us){
-      us_wait = LETIMER_Tick_Time_us;
-      LOG_ERROR("Requested delay is below the supported range. Replacing with delay of %dus", us_wait);
+  // Counts down from COMP0 to 0, one period is COMP0 + 1 ticks
+  return rollovers * period + (LETIMER0_Comp0_Load_Val - *cnt);
+}
+
+/**
+ * @brief   Free running LETIMER0 tick count, wraps at 2^32
+ * @return  ticks since LETIMER0_Enable()
+ */
+uint32_t timerTicksNow(void){
+  uint32_t cnt;
+  return ticks_snapshot(&cnt);
+}
+
+/**
+ * @brief   Points COMP1 at the nearest deadline if it is in the current
+ *          period, called with interrupts masked
+ * @return  none
+ */
+static void timer_arm(){
+  uint32_t cnt;
+
+  if(timer_head < 0){
+    LETIMER_IntDisable(LETIMER0, LETIMER_IEN_COMP1);
+    return;
   }
 
-  if( us_wait > (LETIMER_Tick_Time_us * LETIMER0_Comp0_Load_Val)){
-      us_wait = LETIMER_Tick_Time_us  * LETIMER0_Comp0_Load_Val;
-      LOG_ERROR("Requested delay is more than the supported range. Replacing with delay of %dus", us_wait);
+  uint32_t now = ticks_snapshot(&cnt);
+  int32_t lead = (int32_t)(timer_slots[timer_head].deadline - now);
+
+  if(lead < TIMER_MUX_MIN_LEAD_TICKS)
+    lead = TIMER_MUX_MIN_LEAD_TICKS;
+
+  // Further than the counter has left to count, the UF IRQ arms it
+  if((uint32_t)lead > cnt){
+    LETIMER_IntDisable(LETIMER0, LETIMER_IEN_COMP1);
+    return;
   }
 
-  // Calculating the number of ticks required to achieve the desired time
-  uint32_t LETIMER_Req_Tick_Count = us_wait/LETIMER_Tick_Time_us;
+  LETIMER_IntClear(LETIMER0, LETIMER_IF_COMP1);
+  LETIMER0_Set_Comp1(cnt - (uint32_t)lead);
+  LETIMER_IntEnable(LETIMER0, LETIMER_IEN_COMP1);
 
-  // If the requested time is not completely divisible by the time taken for a
-  // single LETIMER0 tick, then we count one tick extra so that we can meet the
-  // given minimum requirement
-  if((us_wait % LETIMER_Tick_Time_us) != 0)
-    LETIMER_Req_Tick_Count++;
-
-  // Get the current tick count
-  LETIMER_Curr_Tick = LETIMER_CounterGet(LETIMER0);
-
-  /*
-   * Calculate the Comp1 load value and load it to LETIMER0. If the required
-   * tick count is less than the current tick count, then we calculate the
-   * comp1 load value by wrapping it to the top of the counter when the LETIMER
-   * module restarts
-   */
-  if(LETIMER_Req_Tick_Count < LETIMER_Curr_Tick)
-    LETIMER_Comp1_New_Load_Val = LETIMER_Curr_Tick - LETIMER_Req_Tick_Count;
-  else
-    LETIMER_Comp1_New_Load_Val = LETIMER0_Comp0_Load_Val - (LETIMER_Req_Tick_Count - LETIMER_Curr_Tick);
-
-//  LETIMER_IntClear(LETIMER0, 0xFFFFFFFF);
-  LETIMER0_Set_Comp1(LETIMER_Comp1_New_Load_Val);
-//  LETIMER_IntEnable(LETIMER0, LETIMER_IEN_COMP1);
-//  LETIMER_TypeDef *letimer;
-//  letimer = LETIMER0;
-//  letimer->IEN |= LETIMER_IEN_COMP1;
+  // The compare register write takes a few ticks to reach the LF clock
+  // domain, if the counter got there first the match is lost
+  if((int32_t)(timerTicksNow() - (now + (uint32_t)lead)) >= 0)
+    LETIMER_IntSet(LETIMER0, LETIMER_IF_COMP1);
+}
+
+/**
+ * @brief   Starts a one shot timer. Any number up to TIMER_MUX_SLOTS run at
+ *          the same time, the nearest deadline drives LETIMER0 COMP1, so the
+ *          core can sleep in EM2/EM3 while they run. On expiry event_id is
+ *          set with schedulerSetEventTimerExpired().
+ * @param   us_wait   -   delay in microseconds, at least one tick
+ * @param   event_id  -   EVENT_xxx to set when the delay is over, EVENT_NONE
+ *                        for none
+ * @return  handle for timerCancel(), -1 if all slots are in use
+ */
+int32_t timerStartUs(uint32_t us_wait, uint32_t event_id){
+  // Round up, the delay is a minimum
+  uint64_t ticks = ((uint64_t)us_wait * letimer_freq_hz + 999999) / 1000000;
+  int32_t handle = -1;
+
+  if(ticks == 0)
+    ticks = 1;
+
+  // Deadlines are compared as signed differences
+  if(ticks > INT32_MAX){
+    ticks = INT32_MAX;
+    LOG_ERROR("Requested delay is more than the supported range. Replacing with delay of %d ticks", (int) ticks);
+  }
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  for(int32_t i = 0; i < TIMER_MUX_SLOTS; i++){
+    if(!timer_slots[i].active){
+      handle = i;
+      break;
+    }
+  }
+
+  if(handle >= 0){
+    Timer_Slot_t *t = &timer_slots[handle];
+    int8_t *link = &timer_head;
+
+    t->deadline = timerTicksNow() + (uint32_t)ticks;
+    t->event_id = event_id;
+    t->active = true;
+
+    // Insert after the deadlines that are not later, so equal deadlines
+    // expire in the order they were started
+    while((*link >= 0) && ((int32_t)(timer_slots[*link].deadline - t->deadline) <= 0))
+      link = &timer_slots[*link].next;
+    t->next = *link;
+    *link = (int8_t)handle;
+
+    if(timer_head == handle)
+      timer_arm();
+  }
+
+  CORE_EXIT_CRITICAL();
+  return handle;
+}
+
+/**
+ * @brief   Stops a timer started by timerStartUs(), its event is not set.
+ *          Does nothing if the timer already expired.
+ * @return  none
+ */
+void timerCancel(int32_t handle){
+  if((handle < 0) || (handle >= TIMER_MUX_SLOTS))
+    return;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  for(int8_t *link = &timer_head; *link >= 0; link = &timer_slots[*link].next){
+    if(*link == handle){
+      bool was_head = (link == &timer_head);
+
+      *link = timer_slots[handle].next;
+      timer_slots[handle].active = false;
+      timer_slots[handle].gen++;
+      if(was_head)
+        timer_arm();
+      break;
+    }
+  }
+
+  CORE_EXIT_CRITICAL();
+}
+
+/**
+ * @brief   Sets the events of the expired timers and moves COMP1 to the next
+ *          deadline. Called from the LETIMER0 IRQ on COMP1 and UF.
+ * @return  none
+ */
+void timerMuxService(void){
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  uint32_t now = timerTicksNow();
+
+  while((timer_head >= 0) && ((int32_t)(now - timer_slots[timer_head].deadline) >= 0)){
+    Timer_Slot_t *t = &timer_slots[timer_head];
+
+    timer_head = t->next;
+    t->active = false;
+    t->gen++;
+
+    // EVENT_NONE only wakes a timerWaitUs_sleep()
+    if(t->event_id != EVENT_NONE)
+      schedulerSetEventTimerExpired(t->event_id);
+  }
+  timer_arm();
+
+  CORE_EXIT_CRITICAL();
 }
@@ -20,9 +20,19 @@
 #ifndef SRC_TIMERS_H_
 #define SRC_TIMERS_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #define LETIMER_PERIOD_MS (3000)
 #define LETIMER_ON_TIME_MS (175)
 
+// One shot timers that can run at the same time
+#define TIMER_MUX_SLOTS (8)
+
+// COMP1 is never set closer than this to the counter, a nearer deadline
+// fires this many ticks late instead of being missed
+#define TIMER_MUX_MIN_LEAD_TICKS (2)
+
 void LETIMER0_Set_Comp1(uint32_t load_value);
 
 /**
@@ -43,6 +53,18 @@ void LETIMER0_Enable(uint32_t nrg_mode);
 void timerWaitUs_polled(uint32_t us_wait);
 
 
+/**
+ * @brief   Provides a blocking delay of atleast us_wait micro-seconds, with
+ *          the core asleep until a LETIMER0 COMP1 deadline ends it. The range
+ *          is clamped like timerWaitUs_polled(). The core goes as deep as the
+ *          power manager requirements allow, add an EM1 requirement around
+ *          the call if a peripheral needs the HF clocks meanwhile.
+ * @param   us_wait   Time to provide delay for in microseconds
+ * @return  none
+ */
+void timerWaitUs_sleep(uint32_t us_wait);
+
+
 /**
  * @brief   Provides a non-blocking delay of atleast us_wait micro-seconds based on
  *          the LETIMER0 ticks
@@ -51,4 +73,36 @@ void timerWaitUs_polled(uint32_t us_wait);
  */
 void timerWaitUs_irq(uint32_t us_wait);
 
+/**
+ * @brief   Free running LETIMER0 tick count, wraps at 2^32
+ * @return  ticks since LETIMER0_Enable()
+ */
+uint32_t timerTicksNow(void);
+
+/**
+ * @brief   Starts a one shot timer. Any number up to TIMER_MUX_SLOTS run at
+ *          the same time, the nearest deadline drives LETIMER0 COMP1, so the
+ *          core can sleep in EM2/EM3 while they run. On expiry event_id is
+ *          set with schedulerSetEventTimerExpired().
+ * @param   us_wait   -   delay in microseconds, at least one tick
+ * @param   event_id  -   EVENT_xxx to set when the delay is over, EVENT_NONE
+ *                        for none
+ * @return  handle for timerCancel(), -1 if all slots are in use
+ */
+int32_t timerStartUs(uint32_t us_wait, uint32_t event_id);
+
+/**
+ * @brief   Stops a timer started by timerStartUs(), its event is not set.
+ *          Does nothing if the timer already expired.
+ * @return  none
+ */
+void timerCancel(int32_t handle);
+
+/**
+ * @brief   Sets the events of the expired timers and moves COMP1 to the next
+ *          deadline. Called from the LETIMER0 IRQ on COMP1 and UF.
+ * @return  none
+ */
+void timerMuxService(void);
+
 #endif /* SRC_TIMERS_H_ */
@@ -16,14 +16,23 @@
 
 #define RSSI_THREASHOLD -70
 
+// Execution time probes (profiler.h), dumped over VCOM every
+// PROFILER_DUMP_PERIOD_MS
+#define PROFILER_ENABLE          0
+#define PROFILER_DUMP_PERIOD_MS  60000
+
+// Energy accounting (energy.h) report period over the mesh
+#define ENERGY_REPORT_PERIOD_MS  300000
+
 // The following parameters should not be changed
 
 #define RSSI_DATA_LENGTH            1
+#define SENSOR_STATUS_LENGTH        1   // get_rssi, Sensors_Degraded() mask
 #define EMERGENCY_STATE_DATA_LENGTH 1
 
 #define TEMP_MAX 50
 #define HUM_MAX 75
-#define GAS_MAX 10
+#define GAS_MAX 40         // gas_baseline.h index, % under the clean air resistance
 #define PRESSURE_MAX 1700
 
 #define ACC_Z_MIN -3500
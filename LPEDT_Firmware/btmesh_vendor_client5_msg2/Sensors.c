@@ -5,8 +5,9 @@
  *      Author: vishn
  */
 
-#include "app_log.h"
+#include "tlog.h"
 #include "sl_status.h"
+#include "Sensors.h"
 
 
 #include "sl_sensor_rht.h"
@@ -16,11 +17,91 @@
 #include "sl_i2cspm_sensor_config.h"
 #include "sl_pwm_instances.h"
 #include "sl_simple_led_instances.h"
+#include "energy.h"
+#include "sensor_health.h"
+#include "sensor_bus.h"
+#include "timer_service.h"
+
+// The slcp links sensor_rht_mock, sl_sensor_rht_get() makes up a reading
+// without touching the bus. 1 once the real Si7021 driver is linked
+#define SI7021_ON_BUS  (0)
+
+// sl_sensor_rht_get(): measure RH command and 3 byte read, read temperature
+// command and 2 byte read, each transfer with its address byte
+#define SI7021_RHT_I2C_BYTES  (11)
+
+// Result of the chunked BMI270 init, it stops at the first error
+static sl_status_t imu_init_sc = SL_STATUS_OK;
+
+// The BMI270 holds its configuration, otherwise it reads as if valid but
+// unconfigured. Cleared on any failed access, the upload is then redone
+static bool imu_ready = false;
+static bool imu_uploading = false;
+
+// Per device backoff, a dead sensor is only tried again when due
+static sensor_health_t health;
+static uint8_t degraded_logged = 0;
+
+static uint32_t now_ms(void)
+{
+  return (uint32_t)timer_service_now_ms();
+}
+
+static uint8_t degraded_mask(void)
+{
+  uint8_t mask = sensor_health_degraded(&health);
+
+  if (!imu_ready)
+    mask |= (uint8_t)(1u << SENSOR_DEV_BMI270);
+  return mask;
+}
+
+static void log_degraded(void)
+{
+  uint8_t mask = degraded_mask();
+  if (mask != degraded_logged) {
+    app_log_warning("Sensors degraded: 0x%02X, bus timeouts %lu\n\r", mask,
+                    (unsigned long)sensor_bus_timeouts());
+    degraded_logged = mask;
+  }
+}
+
+static void health_result(sensor_dev_t dev, sl_status_t sc)
+{
+  sensor_health_result(&health, dev, sc == SL_STATUS_OK, now_ms());
+  log_degraded();
+}
+
+// One step of the BMI270 upload again, a chunk per call
+static sl_status_t imu_reinit_step(bool *done)
+{
+  sl_status_t sc;
+
+  *done = false;
+  if (!imu_uploading) {
+    sc = sl_bmi270_init_start(SL_I2CSPM_SENSOR_PERIPHERAL, BMI270_ADDR);
+    imu_uploading = (sc == SL_STATUS_OK);
+    return sc;
+  }
+
+  sc = sl_bmi270_init_step(SL_I2CSPM_SENSOR_PERIPHERAL, BMI270_ADDR, done);
+  if (sc != SL_STATUS_OK || *done)
+    imu_uploading = false;
+  return sc;
+}
 
 void Sensors_Init(){
+  Sensors_Init_Start();
+  while (!Sensors_Init_Step())
+    ;
+}
+
+void Sensors_Init_Start(){
   // Init temperature sensor.
     sl_status_t sc;
 
+    sensor_health_init(&health);
+
 //    sc = sl_sensor_rht_init();
     sl_sensor_rht_init();
 
@@ -34,18 +115,37 @@ void Sensors_Init(){
       app_log_warning("Gas sensor initialized.\n\r");
       app_log_nl();
     }
+    // Logged with the IMU result at the end of the init
+    sensor_health_result(&health, SENSOR_DEV_BME688, sc == SL_STATUS_OK, now_ms());
 
+    // The IMU configuration upload is left to Sensors_Init_Step()
+    imu_init_sc = sl_bmi270_init_start(SL_I2CSPM_SENSOR_PERIPHERAL, BMI270_ADDR);
+}
+
+bool Sensors_Init_Step(){
+    bool done = false;
+
+    if (imu_init_sc == SL_STATUS_OK) {
+      imu_init_sc = sl_bmi270_init_step(SL_I2CSPM_SENSOR_PERIPHERAL, BMI270_ADDR, &done);
+      if (imu_init_sc == SL_STATUS_OK && !done)
+        return false;
+    }
+
+    // Done, or failed; a helmet without its IMU still reports the rest
     int16_t acc_gyr_data[6] = {0, 0, 0, 0, 0, 0};
-    sc = sl_bmi270_init(SL_I2CSPM_SENSOR_PERIPHERAL, BMI270_ADDR, acc_gyr_data);
-    if (sc == SL_STATUS_OK) {
+    if (imu_init_sc == SL_STATUS_OK) {
+      imu_init_sc = sl_bmi270_read_acc_gyr(SL_I2CSPM_SENSOR_PERIPHERAL, BMI270_ADDR, acc_gyr_data);
       app_log_warning("IMU sensor initialized.\n\r");
       app_log_nl();
     }
+    imu_ready = (imu_init_sc == SL_STATUS_OK);
+    health_result(SENSOR_DEV_BMI270, imu_init_sc);
 
     app_log_info("Accel: X=%d, Y=%d, Z=%d\n\r", acc_gyr_data[0], acc_gyr_data[1], acc_gyr_data[2]);
     app_log_info("Gyro: X=%d, Y=%d, Z=%d\n\r", acc_gyr_data[3], acc_gyr_data[4], acc_gyr_data[5]);
 
     app_log_warning("Initialization Complete....\n\r");
+    return true;
 }
 
 void Get_Temp(int *data){
@@ -56,15 +156,27 @@ void Get_Temp(int *data){
   float tmp_c = 0.0;
   // float tmp_f = 0.0;
 
+#if SI7021_ON_BUS
+  // The real driver goes through I2CSPM_Transfer(), only the backoff bounds it
+  if (!sensor_health_due(&health, SENSOR_DEV_SI7021, now_ms()))
+    return;
+#endif
+
   // Measure temperature; units are % and milli-Celsius.
   sc = sl_sensor_rht_get(&humidity, &temperature);
+#if SI7021_ON_BUS
+  energy_i2c(ENERGY_I2C_SI7021, SI7021_RHT_I2C_BYTES);
+  health_result(SENSOR_DEV_SI7021, sc);
+#endif
 
   if (SL_STATUS_NOT_INITIALIZED == sc) {
     app_log_info("Relative Humidity and Temperature sensor is not initialized.");
     app_log_nl();
+    return;
   }
   else if (sc != SL_STATUS_OK) {
     app_log_warning("Invalid RHT reading: %lu %ld\n\r", humidity, temperature);
+    return;
   }
 
   tmp_c = (float)temperature / 1000;
@@ -78,7 +190,12 @@ void Get_Humidity(int *data){
 
   sl_status_t sc;
   double humidity_percent = 0.0;
+
+  if (!sensor_health_due(&health, SENSOR_DEV_BME688, now_ms()))
+    return;
+
   sc = sl_bme688_read_humidity(SL_I2CSPM_SENSOR_PERIPHERAL, BME688_ADDR, &humidity_percent);
+  health_result(SENSOR_DEV_BME688, sc);
   if (sc != SL_STATUS_OK) {
       app_log_warning("Failed to read humidity data\n\r");
   } else {
@@ -97,7 +214,29 @@ void Get_IMU_data(int *a_x, int *a_y, int *a_z, int *g_x, int *g_y, int *g_z){
 
   sl_status_t sc;
   int16_t acc_gyr_data[6] = {0, 0, 0, 0, 0, 0};
+
+  if (!sensor_health_due(&health, SENSOR_DEV_BMI270, now_ms()))
+    return;
+
+  // Upload the configuration again first, a chunk per tick (~13 s). The
+  // IMU stays degraded and its last values are kept until it is done
+  if (!imu_ready) {
+    bool done;
+    sc = imu_reinit_step(&done);
+    if (sc != SL_STATUS_OK) {
+      health_result(SENSOR_DEV_BMI270, sc);
+      return;
+    }
+    if (!done)
+      return;
+    imu_ready = true;
+    app_log_warning("IMU sensor re-initialized.\n\r");
+  }
+
   sc = sl_bmi270_read_acc_gyr(SL_I2CSPM_SENSOR_PERIPHERAL, BMI270_ADDR, acc_gyr_data);
+  if (sc != SL_STATUS_OK)
+    imu_ready = false;
+  health_result(SENSOR_DEV_BMI270, sc);
 
   if (sc != SL_STATUS_OK) {
       app_log_warning("Failed to read IMU data\n\r");
@@ -119,12 +258,21 @@ void Get_IMU_data(int *a_x, int *a_y, int *a_z, int *g_x, int *g_y, int *g_z){
 void Get_Gas(int *data){
   sl_status_t sc;
   double gas_readout = 0.0;
+
+  if (!sensor_health_due(&health, SENSOR_DEV_BME688, now_ms())) {
+    *data = 0;  // no reading, as on a failed one
+    return;
+  }
+
   sc = sl_bme688_read_gas_resistance(SL_I2CSPM_SENSOR_PERIPHERAL, BME688_ADDR, &gas_readout);
+  health_result(SENSOR_DEV_BME688, sc);
   if (sc == SL_STATUS_OK) {
       app_log_info("Gas Readout: %.2lf\n\r", gas_readout);
+      *data = gas_readout;
   } else {
+      // 0 ohms, gas_baseline_update() skips it
       app_log_warning("Failed to read gas readout data\n\r");
-      *data = gas_readout;
+      *data = 0;
   }
 }
 
@@ -134,7 +282,11 @@ void Get_Pressure(int *data){
   double press_comp;
   float tmp_c = 0.0;
 
+  if (!sensor_health_due(&health, SENSOR_DEV_BME688, now_ms()))
+    return;
+
   sc = sl_bme688_compute_pressure(SL_I2CSPM_SENSOR_PERIPHERAL, BME688_ADDR, press_raw, tmp_c, &press_comp);
+  health_result(SENSOR_DEV_BME688, sc);
   if (sc == SL_STATUS_OK) {
       app_log_info("Pressure: %.6f hPa\n\r", press_comp/100.0);
       *data = (press_comp/100.0);
@@ -143,12 +295,21 @@ void Get_Pressure(int *data){
   }
 }
 
+uint8_t Sensors_Degraded(){
+  return degraded_mask();
+}
+
 void Emergency_State(){
+  // Both stay on for good, see the loop below
+  energy_output(ENERGY_OUT_LED, true);
+  energy_output(ENERGY_OUT_BUZZER, true);
+
   while(1){
       sl_led_turn_on(SL_SIMPLE_LED_INSTANCE(0));
       app_log_info("LED on.\n\r");
       sl_pwm_set_duty_cycle(&sl_pwm_buzzer_msg, 50);
       sl_pwm_start(&sl_pwm_buzzer_msg);
       app_log_info("Buzzer on.\n\r");
+      TLOG_DRAIN(); // the main loop does not run anymore
   }
 }
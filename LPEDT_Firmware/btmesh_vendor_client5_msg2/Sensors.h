@@ -8,10 +8,21 @@
 #ifndef SENSORS_H_
 #define SENSORS_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
+// Blocking init of every sensor
 void Sensors_Init();
 
+// The same init in steps: Sensors_Init_Start() brings up the Si7021 and the
+// BME688 and starts the BMI270, then every Sensors_Init_Step() call uploads
+// one chunk of its 8 KB configuration (about 23 ms of I2C each), so the main
+// loop, and the mesh stack with it, runs in between. Returns true once all
+// sensors are ready.
+void Sensors_Init_Start();
+
+bool Sensors_Init_Step();
+
 void Get_Temp(int *data);
 
 void Get_Humidity(int *data);
@@ -22,6 +33,13 @@ void Get_Gas(int *data);
 
 void Get_Pressure(int *data);
 
+// Every Get_*() skips a failing sensor until its backoff ends and keeps the
+// last value (Get_Gas() gives 0). Bit n set if sensor_dev_t n has failed
+// SENSOR_HEALTH_DEGRADED_AFTER times in a row, see sensor_health.h. The
+// BMI270 is also degraded while its configuration is not loaded; after a
+// failed access it is uploaded again, a chunk per Get_IMU_data() call.
+uint8_t Sensors_Degraded();
+
 void Emergency_State();
 
 #endif /* SENSORS_H_ */
@@ -40,13 +40,14 @@
 
 #include "em_common.h"
 #include "app_assert.h"
-#include "app_log.h"
+#include "tlog.h"
 #include "sl_status.h"
 #include "app.h"
 
 #include "sl_btmesh_api.h"
 #include "sl_bt_api.h"
-#include "sl_simple_timer.h"
+#include "sl_power_manager.h"
+#include "timer_service.h"
 
 #include "em_cmu.h"
 #include "em_gpio.h"
@@ -55,6 +56,10 @@
 #include "my_model_def.h"
 #include "Custom_Defines.h"
 #include "Sensors.h"
+#include "profiler.h"
+#include "energy.h"
+#include "timesync.h"
+#include "gas_baseline.h"
 
 //#include "app_button_press.h"
 //#include "sl_simple_button.h"
@@ -82,8 +87,17 @@
 #define IVI                                         0
 #define DEFAULT_TTL                                 5
 // #define ELEMENT_ID
+
+// User NVM key holding the version of the local configuration the node
+// completed, bump PROV_CONFIG_VERSION when the configuration changes
+#define PROV_NVM_KEY                                0x4000
+#define PROV_CONFIG_VERSION                         1
 #endif // #ifdef PROV_LOCALLY
 
+// Network transmit state, every PDU goes out NETTX_COUNT + 1 times
+#define NETTX_COUNT                                 2
+#define NETTX_INTERVAL                              4   // (n + 1) * 10 ms
+
 #define EX_B0_PRESS                                 ((1) << 5)
 #define EX_B0_LONG_PRESS                            ((1) << 6)
 #define EX_B1_PRESS                                 ((1) << 7)
@@ -119,6 +133,11 @@ static uint32_t periodic_timer_ms = 0;
 static uint8_t update_interval = 0;
 static uint8_t emergency_status = 0;
 static unit_t unit = celsius;
+static gas_baseline_t gas_baseline;
+
+// Sampling starts once both are set, see start_sampling()
+static bool sensors_ready = false;
+static bool mesh_ready = false;
 
 static uint8_t period_idx = 0;
 // DOS: The Client can send an "update interval" message to the Server, and the Server
@@ -175,7 +194,9 @@ my_model_t my_model = { // DOS: declare storage for saving important model value
   .opcodes_data[12] = get_emergency,
   .opcodes_data[13] = get_emergency_status,
   .opcodes_data[14] = set_emergency,
-  .opcodes_data[15] = set_emergency_status
+  .opcodes_data[15] = set_emergency_status,
+  .opcodes_data[16] = energy_status,
+  .opcodes_data[17] = time_ref
 };
 
 
@@ -209,31 +230,24 @@ uint8_t          myAddressType;
 
 
 static void factory_reset(void);
+void Publish_Energy_Report();
 static void delay_reset_ms(uint32_t ms);
 static void parse_period(uint8_t interval);
+static void start_sampling(void);
+#ifdef PROV_LOCALLY
+static void self_provision(void);
+static bool self_config_done(void);
+static void self_configure(void);
+#endif
 
 
-// DOS:
-// global
-uint32_t logging_timestamp = 0; // in ms
-
-/**************************************************************************//**
- * Logging timer callback
- *****************************************************************************/
-static void logging_timer_cb(sl_simple_timer_t *handle, void *data)
-{
-  (void)handle;
-  (void)data;
-
-  logging_timestamp += 500; // increment the timestamp
-}
-
 // DOS:
 /**************************************************************************//**
- * Public function to retrieve the timestamp
+ * Public function to retrieve the timestamp, ms since boot from the
+ * sleeptimer tick count
  *****************************************************************************/
 uint32_t get_logger_timestamp() {
-  return logging_timestamp;
+  return (uint32_t)timer_service_now_ms();
 }
 
 // Low power state definitions
@@ -301,11 +315,16 @@ uint32_t get_logger_timestamp() {
 
 bool app_is_ok_to_sleep(void)
 {
-  return APP_IS_OK_TO_SLEEP;
+  // An expired timer_service timer still has to run from the main loop, and
+  // so do the remaining sensor init steps
+  return APP_IS_OK_TO_SLEEP && !timer_service_pending() && sensors_ready;
 } // app_is_ok_to_sleep()
 
 sl_power_manager_on_isr_exit_t app_sleep_on_isr_exit(void)
 {
+  if (timer_service_pending() || !sensors_ready) {
+    return SL_POWER_MANAGER_WAKEUP;
+  }
   return APP_SLEEP_ON_ISR_EXIT;
 } // app_sleep_on_isr_exit()
 
@@ -316,10 +335,15 @@ sl_power_manager_on_isr_exit_t app_sleep_on_isr_exit(void)
  *****************************************************************************/
 SL_WEAK void app_init(void)
 {
+  PROF_INIT();
+  energy_init();
+  timesync_init();
+  gas_baseline_init(&gas_baseline);
   app_log("=================\r\n");
   app_log("Client/LPN\r\n");
   app_log("Sensors_Init\r\n");
-  Sensors_Init();
+  // Finished from app_process_action() while the mesh stack comes up
+  Sensors_Init_Start();
 //  app_button_press_enable();
 
   // DOS: For LCD
@@ -345,15 +369,6 @@ SL_WEAK void app_init(void)
       default:break;
     }
 
-  // DOS:
-  // Run a periodic timer for logging timestamp
-  static sl_simple_timer_t logging_timer;
-  sl_simple_timer_start(&logging_timer,
-                        500,   // every 500 ms
-                        logging_timer_cb, // a callback that increments a timestamp for logging
-                        NULL,  // pointer to callback data
-                        true); // is periodic
-
 }
 
 /**************************************************************************//**
@@ -366,6 +381,18 @@ SL_WEAK void app_process_action(void)
   // This is called infinitely.                                              //
   // Do not call blocking functions from here!                               //
   /////////////////////////////////////////////////////////////////////////////
+
+  // Timers due since the last pass, the expiry interrupt only flags them
+  timer_service_step();
+
+  // One chunk of the sensor init per pass until it is done
+  if (!sensors_ready && Sensors_Init_Step()) {
+    sensors_ready = true;
+    start_sampling();
+  }
+
+  // Idle, nothing else runs until the next event. Send the deferred logs.
+  TLOG_DRAIN();
 }
 
 void Emergency_Mode(){
@@ -526,7 +553,7 @@ void sl_bt_on_event(struct sl_bt_msg *evt)
 
 } // sl_bt_on_event()
 
-static sl_simple_timer_t MSG_call_timer;
+static timer_service_timer_t MSG_call_timer;
 
 static int temp = 0;
 static int humidity = 0;
@@ -538,32 +565,66 @@ static int gyro_x = 0;
 static int gyro_y = 0;
 static int gyro_z = 0;
 
-static int gas_1 = 0;
+static int gas_1 = 0;       // ohms
 static int pressure = 0;
 
-void MSG_Callback(sl_simple_timer_t *handle, void *data)
+// Gas index and its alarm, see gas_baseline_alarm()
+static uint8_t gas_index = 0;
+static bool gas_alarm = false;
+
+void MSG_Callback(timer_service_timer_t *handle, void *data)
 {
   (void)handle;
   (void)data;
   uint8_t opcode = 0, length = 0, Tx_data = 0;
+  uint8_t stamp[TIMESYNC_STAMP_LEN];
   sl_status_t sc;
 
+  // The alarm is stamped with the time the sensors were read
+  timesync_stamp(timer_service_now_ms(), stamp);
+
+  // Dump before the probe so the dump itself isn't measured
+  PROF_DUMP_EVERY(PROFILER_DUMP_PERIOD_MS / CLIENT_SLEEP_TIME_MS);
+  PROF_SCOPE(PROF_MSG_CALLBACK);
+
+  PROF_BEGIN(PROF_SENSOR_TEMP);
   Get_Temp(&temp);
+  PROF_END(PROF_SENSOR_TEMP);
+
+  PROF_BEGIN(PROF_SENSOR_HUMIDITY);
   Get_Humidity(&humidity);
+  PROF_END(PROF_SENSOR_HUMIDITY);
+
+  PROF_BEGIN(PROF_SENSOR_IMU);
   Get_IMU_data(&acc_x, &acc_y, &acc_z, &gyro_x, &gyro_y, &gyro_z);
+  PROF_END(PROF_SENSOR_IMU);
+
+  PROF_BEGIN(PROF_SENSOR_GAS);
   Get_Gas(&gas_1);
+  gas_index = gas_baseline_update(&gas_baseline, gas_1 > 0 ? (uint32_t)gas_1 : 0, humidity);
+  gas_alarm = gas_baseline_alarm(&gas_baseline, GAS_MAX);
+  PROF_END(PROF_SENSOR_GAS);
+
+  PROF_BEGIN(PROF_SENSOR_PRESSURE);
   Get_Pressure(&pressure);
+  PROF_END(PROF_SENSOR_PRESSURE);
 
+  PROF_BEGIN(PROF_LOG);
   app_log("Client Data log: \r\n");
   app_log("Temp: %d\tHumidity: %d\r\n", temp, humidity);
   app_log("imu_acc (x, y, z): %d, %d, %d\r\n", acc_x, acc_y, acc_z);
   app_log("imu_gyro (x, y, z): %d, %d, %d\r\n", gyro_x, gyro_y, gyro_z);
-  app_log("Gas: %d\r\n", gas_1);
+  app_log("Gas: %d ohm, index %d, baseline %lu ohm\r\n", gas_1, gas_index,
+          (unsigned long)gas_baseline_ohms(&gas_baseline));
   app_log("Press: %d\r\n", pressure);
+  PROF_END(PROF_LOG);
 
 
-  // Get RSSI val from server
+  // Get RSSI val from server, the request carries the degraded sensors
+  PROF_BEGIN(PROF_PUBLISH);
   opcode = get_rssi;
+  length = SENSOR_STATUS_LENGTH;
+  Tx_data = Sensors_Degraded();
   sc = sl_btmesh_vendor_model_set_publication(my_model.elem_index,
                                               my_model.vendor_id,
                                               my_model.model_id,
@@ -587,14 +648,17 @@ void MSG_Callback(sl_simple_timer_t *handle, void *data)
     }
     else {
       app_log("Publish done.\r\n");
+      energy_radio_tx(NETTX_COUNT + 1);
     }
   } // else
+  PROF_END(PROF_PUBLISH);
 
   if((temp      > TEMP_MAX) ||
      (humidity  > HUM_MAX) ||
-     (gas_1     > GAS_MAX) ||
+     (gas_alarm) ||
      (pressure  > PRESSURE_MAX)){
       app_log("Setting Emergency State\r\n");
+      PROF_BEGIN(PROF_PUBLISH);
       opcode = set_emergency;
 
       sc = sl_btmesh_vendor_model_set_publication(my_model.elem_index,
@@ -602,8 +666,8 @@ void MSG_Callback(sl_simple_timer_t *handle, void *data)
                                                   my_model.model_id,
                                                   opcode,
                                                   1, // DOS: the final payload "chunk"
-                                                  length,
-                                                  &Tx_data);
+                                                  TIMESYNC_STAMP_LEN,
+                                                  stamp);
       if(sc != SL_STATUS_OK) {
           app_log("Set publication error: 0x%04X\r\n", sc);
         }
@@ -619,12 +683,35 @@ void MSG_Callback(sl_simple_timer_t *handle, void *data)
           }
           else {
             app_log("Publish done.\r\n");
+            energy_radio_tx(NETTX_COUNT + 1);
           }
         } // else
+      PROF_END(PROF_PUBLISH);
+  }
+
+  static uint32_t energy_ticks = 0;
+  if (++energy_ticks >= ENERGY_REPORT_PERIOD_MS / CLIENT_SLEEP_TIME_MS) {
+    energy_ticks = 0;
+    Publish_Energy_Report();
   }
 
 }
 
+// Sampling starts when the mesh is up and the sensors are ready, whichever
+// comes last, with the first sample right away instead of a period later
+static void start_sampling(void)
+{
+  if (!mesh_ready || !sensors_ready)
+    return;
+
+  timer_service_start(&MSG_call_timer,
+                      CLIENT_SLEEP_TIME_MS,
+                      MSG_Callback, // sample, log and publish, see above
+                      NULL,  // pointer to callback data
+                      true); // is periodic
+  MSG_Callback(&MSG_call_timer, NULL);
+}
+
 
 void Check_emg_state(){
 
@@ -654,11 +741,45 @@ void Check_emg_state(){
       }
       else {
         app_log("Publish done.\r\n");
+        energy_radio_tx(NETTX_COUNT + 1);
       }
     } // else
 
 }
 
+void Publish_Energy_Report(){
+
+  uint8_t report[ENERGY_REPORT_LEN];
+  sl_status_t sc;
+
+  energy_report(report);
+
+  sc = sl_btmesh_vendor_model_set_publication(my_model.elem_index,
+                                              my_model.vendor_id,
+                                              my_model.model_id,
+                                              energy_status,
+                                              1, // DOS: the final payload "chunk"
+                                              ENERGY_REPORT_LEN,
+                                              report);
+
+  if(sc != SL_STATUS_OK) {
+    app_log("Set publication error: 0x%04X\r\n", sc);
+  }
+  else {
+    sc = sl_btmesh_vendor_model_publish(my_model.elem_index,
+                                        my_model.vendor_id,
+                                        my_model.model_id);
+    if (sc != SL_STATUS_OK) {
+      app_log("Publish error = 0x%04X\r\n", sc);
+    }
+    else {
+      app_log("Energy report published.\r\n");
+      energy_radio_tx((NETTX_COUNT + 1) * ENERGY_REPORT_SEGMENTS);
+    }
+  } // else
+
+}
+
 /**************************************************************************//**
  * Bluetooth Mesh stack event handler.
  * This overrides the dummy weak implementation.
@@ -679,11 +800,6 @@ void sl_btmesh_on_event(sl_btmesh_msg_t *evt)
     case sl_btmesh_evt_node_initialized_id:
       app_log("Node initialized ...\r\n");
 
-      sl_simple_timer_start(&MSG_call_timer,
-                            CLIENT_SLEEP_TIME_MS,   // every 2000 ms
-                            MSG_Callback, // a callback that increments a timestamp for logging
-                            NULL,  // pointer to callback data
-                            true); // is periodic
       // DOS: Init the vendor model
       sc = sl_btmesh_vendor_model_init(my_model.elem_index,
                                        my_model.vendor_id,
@@ -701,21 +817,11 @@ void sl_btmesh_on_event(sl_btmesh_msg_t *evt)
           app_log("Node unprovisioned\r\n");
 
 #ifdef PROV_LOCALLY
-          // Derive the unicast address from the LSB 2 bytes from the BD_ADDR
-          bd_addr address;
-          sc = sl_bt_system_get_identity_address(&address, 0);
-          uni_addr = ((address.addr[1] << 8) | address.addr[0]) & 0x7FFF;
-          app_log("Unicast Address = 0x%04X\r\n", uni_addr);
-          app_log("Provisioning itself.\r\n");
-          // DOS: The device must be reset after this command has been issued,
-          //      see delay_reset_ms() below.
-          sc = sl_btmesh_node_set_provisioning_data(enc_key, // DOS: device key
-                                                    enc_key, // DOS: network key
-                                                    NET_KEY_IDX,
-                                                    IVI,
-                                                    uni_addr,
-                                                    0); // key refresh = false
-          app_assert_status_f(sc, "Failed to provision itself\r\n");
+          // sl_btmesh_node_set_provisioning_data() only takes effect after
+          // a reset, a new node boots twice. Later boots are provisioned.
+          app_log("Provisioning itself, reset.\r\n");
+          sl_bt_nvm_erase(PROV_NVM_KEY);
+          self_provision();
           delay_reset_ms(100);
           break;
 
@@ -727,67 +833,16 @@ void sl_btmesh_on_event(sl_btmesh_msg_t *evt)
       }
 
 #ifdef PROV_LOCALLY
-      // Set the publication and subscription
-      uint16_t appkey_index;
-      uint16_t pub_address;
-      uint8_t ttl;
-      uint8_t period;
-      uint8_t retrans;
-      uint8_t credentials;
-      sc = sl_btmesh_test_get_local_model_pub(my_model.elem_index,
-                                              my_model.vendor_id,
-                                              my_model.model_id,
-                                              &appkey_index,
-                                              &pub_address,
-                                              &ttl,
-                                              &period,
-                                              &retrans,
-                                              &credentials);
-      if (!sc && pub_address == CUSTOM_CTRL_GRP_ADDR) {
+      // Set the publication and subscription, once
+      if (self_config_done()) {
         app_log("Configuration done already.\r\n");
       } else {
-        app_log("Pub setting result = 0x%04X, pub setting address = 0x%04X\r\n", sc, pub_address);
-        app_log("Add local app key ...\r\n");
-        sc = sl_btmesh_test_add_local_key(1,
-                                          enc_key, // DOS: app key
-                                          APP_KEY_IDX,
-                                          NET_KEY_IDX);
-        app_assert_status_f(sc, "Failed to add local app key\r\n");
-
-        app_log("Bind local app key ...\r\n");
-        sc = sl_btmesh_test_bind_local_model_app(my_model.elem_index,
-                                                 APP_KEY_IDX,
-                                                 my_model.vendor_id,
-                                                 my_model.model_id);
-        app_assert_status_f(sc, "Failed to bind local app key\r\n");
-
-        app_log("Set local model pub ...\r\n");
-        sc = sl_btmesh_test_set_local_model_pub(my_model.elem_index,
-                                                APP_KEY_IDX,
-                                                my_model.vendor_id,
-                                                my_model.model_id,
-                                                CUSTOM_CTRL_GRP_ADDR,
-                                                DEFAULT_TTL,
-                                                0, 0, 0);
-        app_assert_status_f(sc, "Failed to set local model pub\r\n");
-
-        app_log("Add local model sub ...\r\n");
-        sc = sl_btmesh_test_add_local_model_sub(my_model.elem_index,
-                                                my_model.vendor_id,
-                                                my_model.model_id,
-                                                CUSTOM_STATUS_GRP_ADDR);
-        app_assert_status_f(sc, "Failed to add local model sub\r\n");
-
-        app_log("Set relay ...\r\n");
-        sc = sl_btmesh_test_set_relay(1, 0, 0);
-        app_assert_status_f(sc, "Failed to set relay\r\n");
-
-        app_log("Set Network tx state.\r\n");
-        sc = sl_btmesh_test_set_nettx(2, 4);
-        app_assert_status_f(sc, "Failed to set network tx state\r\n");
+        self_configure();
       }
 #endif // #ifdef PROV_LOCALLY
 
+      mesh_ready = true;
+      start_sampling();
 
       // Init node as low power node and setting max LPN timeout as 1 second VK
 
@@ -843,6 +898,8 @@ void sl_btmesh_on_event(sl_btmesh_msg_t *evt)
     // -------------------------------
     // Handle vendor model message reception event
     case sl_btmesh_evt_vendor_model_receive_id: {
+      PROF_SCOPE(PROF_MESH_RX);
+      energy_radio_rx(1);
 
 //      int32_t temperature = 0;
 
@@ -889,18 +946,20 @@ void sl_btmesh_on_event(sl_btmesh_msg_t *evt)
 
           if(a < RSSI_THREASHOLD){
 
-              uint8_t opcode = 0, length = 0, Tx_data = 0;
+              uint8_t opcode = 0;
+              uint8_t stamp[TIMESYNC_STAMP_LEN];
               sl_status_t sc;
               app_log("Setting Emergency State\r\n");
               opcode = set_emergency;
+              timesync_stamp(timer_service_now_ms(), stamp);
 
               sc = sl_btmesh_vendor_model_set_publication(my_model.elem_index,
                                                           my_model.vendor_id,
                                                           my_model.model_id,
                                                           opcode,
                                                           1, // DOS: the final payload "chunk"
-                                                          length,
-                                                          &Tx_data);
+                                                          TIMESYNC_STAMP_LEN,
+                                                          stamp);
               if(sc != SL_STATUS_OK) {
                   app_log("Set publication error: 0x%04X\r\n", sc);
                 }
@@ -916,6 +975,7 @@ void sl_btmesh_on_event(sl_btmesh_msg_t *evt)
                   }
                   else {
                     app_log("Publish done.\r\n");
+                    energy_radio_tx(NETTX_COUNT + 1);
                   }
                 } // else
           }
@@ -938,6 +998,35 @@ void sl_btmesh_on_event(sl_btmesh_msg_t *evt)
           Emergency_Mode();
           break;
 
+        case time_ref:
+          timesync_reference(timer_service_now_ms(), rx_evt->payload.data, rx_evt->payload.len);
+          app_log("Network time offset %ld ms, error %u ms\r\n",
+                  (long)((int32_t)(timesync_network_ms(timer_service_now_ms()) - (uint32_t)timer_service_now_ms())),
+                  timesync_error_ms());
+
+          // Pass the round on to the helmets in radio range
+          uint8_t ref[TIMESYNC_REF_LEN];
+          if (timesync_forward(timer_service_now_ms(), rx_evt->payload.data, rx_evt->payload.len, ref)) {
+            sl_status_t sc = sl_btmesh_vendor_model_send(CUSTOM_STATUS_GRP_ADDR,
+                                                         0,
+                                                         0,
+                                                         my_model.elem_index,
+                                                         my_model.vendor_id,
+                                                         my_model.model_id,
+                                                         1, // nonrelayed, one hop
+                                                         time_ref,
+                                                         1,
+                                                         TIMESYNC_REF_LEN,
+                                                         ref);
+            if (sc != SL_STATUS_OK) {
+              app_log("Time ref send error = 0x%04X\r\n", sc);
+            }
+            else {
+              energy_radio_tx(NETTX_COUNT + 1);
+            }
+          }
+          break;
+
 //        case temperature_status:
 //          // DOS: There was a formatting bug in this code when units are set to Fahrenheit.
 //          //      and the value was negative and less than abs(1).
@@ -1001,11 +1090,11 @@ void sl_btmesh_on_event(sl_btmesh_msg_t *evt)
 
       app_log("  ***Friendship Established\r\n"); // DOS
 
-      sl_simple_timer_start(&MSG_call_timer,
-                            CLIENT_SLEEP_TIME_MS,   // every 2000 ms
-                            MSG_Callback, // a callback that increments a timestamp for logging
-                            NULL,  // pointer to callback data
-                            true); // is periodic
+      timer_service_start(&MSG_call_timer,
+                          CLIENT_SLEEP_TIME_MS,   // every 2000 ms
+                          MSG_Callback, // a callback that increments a timestamp for logging
+                          NULL,  // pointer to callback data
+                          true); // is periodic
 
       app_log("Setting sleep to EM2 vendor model\r\n");
       sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM2); // Setting sleep to EM2
@@ -1020,7 +1109,7 @@ void sl_btmesh_on_event(sl_btmesh_msg_t *evt)
 
       app_log("  ***Friendship terminated\r\n");
 
-      sl_simple_timer_stop(&MSG_call_timer);
+      timer_service_stop(&MSG_call_timer);
 
       app_log("Setting sleep to EM2 vendor model\r\n");
       sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM2); // Setting sleep to EM2
@@ -1104,29 +1193,148 @@ static void factory_reset(void)
 //  sl_btmesh_LCD_write(reset_status, LCD_ROW_2);
 
   sl_btmesh_node_reset();
+#ifdef PROV_LOCALLY
+  sl_bt_nvm_erase(PROV_NVM_KEY);
+#endif
 
   delay_reset_ms(100);
 }
 
+#ifdef PROV_LOCALLY
+// Provision with the unicast address from the LSB 2 bytes of the BD_ADDR
+static void self_provision(void)
+{
+  sl_status_t sc;
+  bd_addr address;
+
+  sc = sl_bt_system_get_identity_address(&address, 0);
+  app_assert_status_f(sc, "Failed to get identity address\r\n");
+  uni_addr = ((address.addr[1] << 8) | address.addr[0]) & 0x7FFF;
+  app_log("Unicast Address = 0x%04X\r\n", uni_addr);
+
+  sc = sl_btmesh_node_set_provisioning_data(enc_key, // DOS: device key
+                                            enc_key, // DOS: network key
+                                            NET_KEY_IDX,
+                                            IVI,
+                                            uni_addr,
+                                            0); // key refresh = false
+  if (sc == SL_STATUS_OK) {
+      app_log("Provisioned itself.\r\n");
+      energy_flash_write(1);
+  } else {
+      // Already provisioned
+      app_log("Provisioning data kept, 0x%04X\r\n", (unsigned int)sc);
+  }
+}
+
+static bool self_config_done(void)
+{
+  uint8_t version = 0;
+  size_t len = 0;
+
+  return sl_bt_nvm_load(PROV_NVM_KEY, sizeof(version), &len, &version) == SL_STATUS_OK &&
+         len == sizeof(version) && version == PROV_CONFIG_VERSION;
+}
+
+// Local app key, binding, publication, subscription, relay and network tx
+// state, then the PROV_NVM_KEY record so later boots skip all of it
+static void self_configure(void)
+{
+  sl_status_t sc;
+
+  // A node set up before the record existed already has its publication
+  uint16_t appkey_index;
+  uint16_t pub_address;
+  uint8_t ttl;
+  uint8_t period;
+  uint8_t retrans;
+  uint8_t credentials;
+  sc = sl_btmesh_test_get_local_model_pub(my_model.elem_index,
+                                          my_model.vendor_id,
+                                          my_model.model_id,
+                                          &appkey_index,
+                                          &pub_address,
+                                          &ttl,
+                                          &period,
+                                          &retrans,
+                                          &credentials);
+  if (!sc && pub_address == CUSTOM_CTRL_GRP_ADDR) {
+    app_log("Publication set already.\r\n");
+  } else {
+    app_log("Add local app key ...\r\n");
+    sc = sl_btmesh_test_add_local_key(1,
+                                      enc_key, // DOS: app key
+                                      APP_KEY_IDX,
+                                      NET_KEY_IDX);
+    if (sc != SL_STATUS_BT_MESH_ALREADY_EXISTS) {
+      app_assert_status_f(sc, "Failed to add local app key\r\n");
+    }
+
+    app_log("Bind local app key ...\r\n");
+    sc = sl_btmesh_test_bind_local_model_app(my_model.elem_index,
+                                             APP_KEY_IDX,
+                                             my_model.vendor_id,
+                                             my_model.model_id);
+    app_assert_status_f(sc, "Failed to bind local app key\r\n");
+
+    app_log("Set local model pub ...\r\n");
+    sc = sl_btmesh_test_set_local_model_pub(my_model.elem_index,
+                                            APP_KEY_IDX,
+                                            my_model.vendor_id,
+                                            my_model.model_id,
+                                            CUSTOM_CTRL_GRP_ADDR,
+                                            DEFAULT_TTL,
+                                            0, 0, 0);
+    app_assert_status_f(sc, "Failed to set local model pub\r\n");
+
+    app_log("Add local model sub ...\r\n");
+    sc = sl_btmesh_test_add_local_model_sub(my_model.elem_index,
+                                            my_model.vendor_id,
+                                            my_model.model_id,
+                                            CUSTOM_STATUS_GRP_ADDR);
+    if (sc != SL_STATUS_BT_MESH_ALREADY_EXISTS) {
+      app_assert_status_f(sc, "Failed to add local model sub\r\n");
+    }
+
+    app_log("Set relay ...\r\n");
+    sc = sl_btmesh_test_set_relay(1, 0, 0);
+    app_assert_status_f(sc, "Failed to set relay\r\n");
+
+    app_log("Set Network tx state.\r\n");
+    sc = sl_btmesh_test_set_nettx(NETTX_COUNT, NETTX_INTERVAL);
+    app_assert_status_f(sc, "Failed to set network tx state\r\n");
+
+    // key, binding, publication, subscription, relay and nettx are
+    // each stored in NVM
+    energy_flash_write(6);
+  }
+
+  uint8_t version = PROV_CONFIG_VERSION;
+  sc = sl_bt_nvm_save(PROV_NVM_KEY, sizeof(version), &version);
+  app_assert_status_f(sc, "Failed to save the configuration record\r\n");
+  energy_flash_write(1);
+}
+#endif // #ifdef PROV_LOCALLY
+
 // DOS: Simple timer callback
-static void app_reset_timer_cb(sl_simple_timer_t *handle, void *data)
+static void app_reset_timer_cb(timer_service_timer_t *handle, void *data)
 {
   (void)handle;
   (void)data;
   sl_bt_system_reset(0);
 }
 
-static sl_simple_timer_t app_reset_timer;
+static timer_service_timer_t app_reset_timer;
 static void delay_reset_ms(uint32_t ms)
 {
   if(ms < 10) {
       ms = 10;
   }
-  sl_simple_timer_start(&app_reset_timer,
-                         ms,
-                         app_reset_timer_cb, // DOS: function to call when time is expired
-                         NULL,               // pointer to callback data
-                         false);             // not periodic, i.e. a one-shot
+  timer_service_start(&app_reset_timer,
+                       ms,
+                       app_reset_timer_cb, // DOS: function to call when time is expired
+                       NULL,               // pointer to callback data
+                       false);             // not periodic, i.e. a one-shot
 }
 
 
@@ -2,6 +2,9 @@
 #include <string.h>
 #include "sl_sleeptimer.h"
 #include <math.h>
+#include "profiler.h"
+#include "energy.h"
+#include "sensor_bus.h"
 
 // BME688 register addresses
 #define BME688_REG_CHIP_ID      0xD0
@@ -42,11 +45,26 @@
 #define GAS_R_LSB_REG 0x2D
 #define GAS_RANGE_REG 0x2D
 
+// Transfer deadline before the per byte allowance, see sensor_bus.h
+#define BME688_I2C_TIMEOUT_BASE_US 500
+
+// The calibration reads stop at the first failed transfer, a missing sensor
+// costs one NACK instead of one per register
+#define READ_OR_RETURN(i2cspm, addr, reg, data) \
+    do { \
+        sl_status_t rd_status = sl_bme688_read_register(i2cspm, addr, reg, data, 1); \
+        if (rd_status != SL_STATUS_OK) { \
+            return rd_status; \
+        } \
+    } while (0)
+
 /**************************************************************************//**
  * @brief Reads a register from the BME688 sensor.
  *****************************************************************************/
 sl_status_t sl_bme688_read_register(sl_i2cspm_t *i2cspm, uint8_t addr, uint8_t reg, uint8_t *data, size_t len)
 {
+    PROF_SCOPE(PROF_I2C);
+
     I2C_TransferSeq_TypeDef seq;
     seq.addr = addr << 1;
     seq.flags = I2C_FLAG_WRITE_READ;
@@ -57,10 +75,9 @@ sl_status_t sl_bme688_read_register(sl_i2cspm_t *i2cspm, uint8_t addr, uint8_t r
     seq.buf[1].data = data;
     seq.buf[1].len = len;
 
-    if (I2CSPM_Transfer(i2cspm, &seq) != i2cTransferDone) {
-        return SL_STATUS_TRANSMIT;
-    }
-    return SL_STATUS_OK;
+    energy_i2c(ENERGY_I2C_BME688, 3 + len); // address byte(s), register, data
+
+    return sensor_bus_transfer(i2cspm, &seq, SENSOR_BUS_TIMEOUT_US(BME688_I2C_TIMEOUT_BASE_US, 3 + len));
 }
 
 /**************************************************************************//**
@@ -79,10 +96,9 @@ sl_status_t sl_bme688_write_register(sl_i2cspm_t *i2cspm, uint8_t addr, uint8_t
     seq.buf[0].data = buf;
     seq.buf[0].len = len + 1;
 
-    if (I2CSPM_Transfer(i2cspm, &seq) != i2cTransferDone) {
-        return SL_STATUS_TRANSMIT;
-    }
-    return SL_STATUS_OK;
+    energy_i2c(ENERGY_I2C_BME688, 2 + len); // address byte(s), register, data
+
+    return sensor_bus_transfer(i2cspm, &seq, SENSOR_BUS_TIMEOUT_US(BME688_I2C_TIMEOUT_BASE_US, 2 + len));
 }
 
 /**************************************************************************//**
@@ -148,29 +164,29 @@ sl_status_t sl_bme688_read_calibration_params(sl_i2cspm_t *i2cspm, uint8_t addr,
     uint8_t data[2];
 
     // Read par_h1
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_H1_LSB_REG, &data[0], 1);
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_H1_MSB_REG, &data[1], 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_H1_LSB_REG, &data[0]);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_H1_MSB_REG, &data[1]);
     *par_h1 = (((int16_t)data[1]) << 4) | (((int16_t)data[0]) & 0x000F);
 
     // Read par_h2
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_H2_LSB_REG, &data[0], 1);
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_H2_MSB_REG, &data[1], 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_H2_LSB_REG, &data[0]);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_H2_MSB_REG, &data[1]);
     *par_h2 = (((int16_t)data[1]) << 4) | (int16_t)((data[0] >> 4));
 
     // Read par_h3
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_H3_REG, (uint8_t *)par_h3, 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_H3_REG, (uint8_t *)par_h3);
 
     // Read par_h4
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_H4_REG, (uint8_t *)par_h4, 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_H4_REG, (uint8_t *)par_h4);
 
     // Read par_h5
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_H5_REG, (uint8_t *)par_h5, 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_H5_REG, (uint8_t *)par_h5);
 
     // Read par_h6
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_H6_REG, par_h6, 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_H6_REG, par_h6);
 
     // Read par_h7
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_H7_REG, par_h7, 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_H7_REG, par_h7);
 
     return SL_STATUS_OK;
 }
@@ -240,37 +256,37 @@ static sl_status_t read_pressure_calibration_params(sl_i2cspm_t *i2cspm, uint8_t
     uint8_t data[2];
 
     // Read par_p1
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P1_LSB_REG, &data[0], 1);
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P1_MSB_REG, &data[1], 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P1_LSB_REG, &data[0]);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P1_MSB_REG, &data[1]);
     *par_p1 = (uint16_t)((data[1] << 8) | data[0]);
 
     // Read par_p2
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P2_LSB_REG, &data[0], 1);
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P2_MSB_REG, &data[1], 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P2_LSB_REG, &data[0]);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P2_MSB_REG, &data[1]);
     *par_p2 = (int16_t)((data[1] << 8) | data[0]);
 
     // Read other parameters
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P3_REG, (uint8_t *)par_p3, 1);
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P4_LSB_REG, &data[0], 1);
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P4_MSB_REG, &data[1], 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P3_REG, (uint8_t *)par_p3);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P4_LSB_REG, &data[0]);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P4_MSB_REG, &data[1]);
     *par_p4 = (int16_t)((data[1] << 8) | data[0]);
 
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P5_LSB_REG, &data[0], 1);
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P5_MSB_REG, &data[1], 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P5_LSB_REG, &data[0]);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P5_MSB_REG, &data[1]);
     *par_p5 = (int16_t)((data[1] << 8) | data[0]);
 
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P6_REG, (uint8_t *)par_p6, 1);
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P7_REG, (uint8_t *)par_p7, 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P6_REG, (uint8_t *)par_p6);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P7_REG, (uint8_t *)par_p7);
 
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P8_LSB_REG, &data[0], 1);
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P8_MSB_REG, &data[1], 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P8_LSB_REG, &data[0]);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P8_MSB_REG, &data[1]);
     *par_p8 = (int16_t)((data[1] << 8) | data[0]);
 
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P9_LSB_REG, &data[0], 1);
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P9_MSB_REG, &data[1], 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P9_LSB_REG, &data[0]);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P9_MSB_REG, &data[1]);
     *par_p9 = (int16_t)((data[1] << 8) | data[0]);
 
-    sl_bme688_read_register(i2cspm, addr, BME688_PAR_P10_REG, (uint8_t *)par_p10, 1);
+    READ_OR_RETURN(i2cspm, addr, BME688_PAR_P10_REG, (uint8_t *)par_p10);
 
     return SL_STATUS_OK;
 }
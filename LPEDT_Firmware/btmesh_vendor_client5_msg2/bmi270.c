@@ -5,6 +5,9 @@
 #include "sl_i2cspm.h"
 #include "sl_sleeptimer.h"
 #include <string.h>
+#include "profiler.h"
+#include "energy.h"
+#include "sensor_bus.h"
 
 /** BMI270 Commands */
 #define READ_CHIP_ID 0x00
@@ -21,20 +24,45 @@
 #define INIT_ADDR_0_REG_ADDR 0x5B
 #define INIT_ADDR_1_REG_ADDR 0x5C
 #define CONFIG_FILE_SIZE     8192
-#define CHUNK_SIZE           2048
+#define CHUNK_SIZE           256     // ~23 ms of I2C at 100 kbit/s
 #define INTERNAL_STATUS_REG_ADDR 0x21
 
 #define CHIP_ID_EXPECTED 0x24
 
+// Transfer deadline before the per byte allowance, see sensor_bus.h
+#define BMI270_I2C_TIMEOUT_BASE_US 500
+
 int cnt = 0;
 
 sl_status_t sl_bmi270_read_register(sl_i2cspm_t *i2cspm, uint8_t addr, uint8_t reg, uint8_t *data, size_t len);
 sl_status_t sl_bmi270_write_register(sl_i2cspm_t *i2cspm, uint8_t addr, uint8_t reg, const uint8_t *data, size_t len);
-sl_status_t sl_bmi270_write_init_register (sl_i2cspm_t *i2cspm, uint8_t addr, uint8_t *data, size_t len);
 /***************************************************************************//**
  *    Initializes the BMI270 sensor
  ******************************************************************************/
 sl_status_t sl_bmi270_init(sl_i2cspm_t *i2cspm, uint8_t addr, int16_t *acc_gyr_data)
+{
+    sl_status_t status;
+    bool done = false;
+
+    status = sl_bmi270_init_start(i2cspm, addr);
+    while (status == SL_STATUS_OK && !done) {
+        status = sl_bmi270_init_step(i2cspm, addr, &done);
+    }
+    if (status != SL_STATUS_OK) {
+        return status;
+    }
+
+    return sl_bmi270_read_acc_gyr(i2cspm, addr, acc_gyr_data);
+}
+
+// Bytes of the configuration file uploaded so far, CONFIG_FILE_SIZE once the
+// upload is complete
+static size_t config_loaded = CONFIG_FILE_SIZE;
+
+/***************************************************************************//**
+ *    Prepares the BMI270 for the configuration upload
+ ******************************************************************************/
+sl_status_t sl_bmi270_init_start(sl_i2cspm_t *i2cspm, uint8_t addr)
 {
 //    uint8_t chip_id;
     sl_status_t status;
@@ -52,6 +80,8 @@ sl_status_t sl_bmi270_init(sl_i2cspm_t *i2cspm, uint8_t addr, int16_t *acc_gyr_d
 //        return SL_STATUS_INITIALIZATION; // Incorrect chip ID
 //    }
 
+    config_loaded = CONFIG_FILE_SIZE;
+
     // Disable adv_power_save bit
     uint8_t config_data[] = {0x00};
     status = sl_bmi270_write_register(i2cspm, addr, PWR_CONF_REG_ADDR, config_data, 1);
@@ -68,19 +98,43 @@ sl_status_t sl_bmi270_init(sl_i2cspm_t *i2cspm, uint8_t addr, int16_t *acc_gyr_d
         return status;
     }
 
-    // Burst Write config to INIT_DATA
-//    status = sl_bmi270_load_config(i2cspm, addr, bmi270_config_file);
-//    if (status != SL_STATUS_OK) {
-//        return status;
-//    }
+    config_loaded = 0;
+    return SL_STATUS_OK;
+}
 
-    status = sl_bmi270_write_init_register(i2cspm, addr, bmi270_config_file, 8193); // register added to conf file
-    if (status != SL_STATUS_OK) {
-        return status;
+/***************************************************************************//**
+ *    Uploads the next chunk of the configuration, or finishes the init
+ ******************************************************************************/
+sl_status_t sl_bmi270_init_step(sl_i2cspm_t *i2cspm, uint8_t addr, bool *done)
+{
+    sl_status_t status;
+
+    *done = false;
+
+    if (config_loaded < CONFIG_FILE_SIZE) {
+        // INIT_ADDR is the offset in 16 bit words, bits 3:0 then 11:4
+        uint8_t init_addr[2];
+        init_addr[0] = (uint8_t)((config_loaded / 2) & 0x0F);
+        init_addr[1] = (uint8_t)((config_loaded / 2) >> 4);
+        status = sl_bmi270_write_register(i2cspm, addr, INIT_ADDR_0_REG_ADDR, init_addr, 2);
+        if (status != SL_STATUS_OK) {
+            return status;
+        }
+
+        // Burst write the chunk to INIT_DATA, the file starts with the
+        // register address
+        status = sl_bmi270_write_register(i2cspm, addr, INIT_DATA_REG_ADDR,
+                                          &bmi270_config_file[1 + config_loaded], CHUNK_SIZE);
+        if (status != SL_STATUS_OK) {
+            return status;
+        }
+
+        config_loaded += CHUNK_SIZE;
+        return SL_STATUS_OK;
     }
 
     // Complete Config Load
-    config_data[0] = 0x01;
+    uint8_t config_data[] = {0x01};
     status = sl_bmi270_write_register(i2cspm, addr, INIT_CTRL_REG_ADDR, config_data, 1);
     if (status != SL_STATUS_OK) {
         return status;
@@ -88,6 +142,9 @@ sl_status_t sl_bmi270_init(sl_i2cspm_t *i2cspm, uint8_t addr, int16_t *acc_gyr_d
 
     uint8_t internal_status;
     status = sl_bmi270_read_register(i2cspm, addr, INTERNAL_STATUS_REG_ADDR, &internal_status, 1);
+    if (status != SL_STATUS_OK) {
+        return status;
+    }
     if (internal_status != 0x01) {
         return SL_STATUS_FAIL; // Configuration incomplete
     }
@@ -120,17 +177,7 @@ sl_status_t sl_bmi270_init(sl_i2cspm_t *i2cspm, uint8_t addr, int16_t *acc_gyr_d
         return status;
     }
 
-    uint8_t acc_data[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    sl_bmi270_read_register(i2cspm, addr, BST_READ_REG_ADDR, acc_data, 12);
-
-    acc_gyr_data[0] = (int16_t)(acc_data[1] << 8) | (int16_t)(acc_data[0]);
-    acc_gyr_data[1] = (int16_t)(acc_data[3] << 8) | (int16_t)(acc_data[2]);
-    acc_gyr_data[2] = (int16_t)(acc_data[5] << 8) | (int16_t)(acc_data[4]);
-
-    acc_gyr_data[3] = (int16_t)(acc_data[7] << 8) | (int16_t)(acc_data[6]);
-    acc_gyr_data[4] = (int16_t)(acc_data[9] << 8) | (int16_t)(acc_data[8]);
-    acc_gyr_data[5] = (int16_t)(acc_data[11] << 8) | (int16_t)(acc_data[10]);
-
+    *done = true;
     return SL_STATUS_OK;
 }
 
@@ -157,7 +204,10 @@ sl_status_t sl_bmi270_read_acc_gyr(sl_i2cspm_t *i2cspm, uint8_t addr,
                                  int16_t *acc_gyr_data)
 {
   uint8_t acc_data[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-  sl_bmi270_read_register(i2cspm, addr, BST_READ_REG_ADDR, acc_data, 12);
+  sl_status_t status = sl_bmi270_read_register(i2cspm, addr, BST_READ_REG_ADDR, acc_data, 12);
+  if (status != SL_STATUS_OK) {
+    return status;
+  }
 
   acc_gyr_data[0] = (int16_t)(acc_data[1] << 8) | (int16_t)(acc_data[0]);
   acc_gyr_data[1] = (int16_t)(acc_data[3] << 8) | (int16_t)(acc_data[2]);
@@ -176,6 +226,8 @@ sl_status_t sl_bmi270_read_acc_gyr(sl_i2cspm_t *i2cspm, uint8_t addr,
 sl_status_t sl_bmi270_read_register(sl_i2cspm_t *i2cspm, uint8_t addr, uint8_t reg,
                                     uint8_t *data, size_t len)
 {
+    PROF_SCOPE(PROF_I2C);
+
     I2C_TransferSeq_TypeDef seq;
     seq.addr = addr << 1;
     seq.flags = I2C_FLAG_WRITE_READ;
@@ -186,10 +238,9 @@ sl_status_t sl_bmi270_read_register(sl_i2cspm_t *i2cspm, uint8_t addr, uint8_t r
     seq.buf[1].data = data;
     seq.buf[1].len = len;
 
-    if (I2CSPM_Transfer(i2cspm, &seq) != i2cTransferDone) {
-        return SL_STATUS_TRANSMIT;
-    }
-    return SL_STATUS_OK;
+    energy_i2c(ENERGY_I2C_BMI270, 3 + len); // address byte(s), register, data
+
+    return sensor_bus_transfer(i2cspm, &seq, SENSOR_BUS_TIMEOUT_US(BMI270_I2C_TIMEOUT_BASE_US, 3 + len));
 }
 
 /***************************************************************************//**
@@ -209,27 +260,7 @@ sl_status_t sl_bmi270_write_register(sl_i2cspm_t *i2cspm, uint8_t addr, uint8_t
     seq.buf[0].data = buf;
     seq.buf[0].len = len + 1;
 
-    if (I2CSPM_Transfer(i2cspm, &seq) != i2cTransferDone) {
-        return SL_STATUS_TRANSMIT;
-    }
-    return SL_STATUS_OK;
-}
-
-/***************************************************************************//**
- *   Helper function to write to a register of BMI270
- ******************************************************************************/
-sl_status_t sl_bmi270_write_init_register(sl_i2cspm_t *i2cspm, uint8_t addr,
-                                     uint8_t *data, size_t len)
-{
-    I2C_TransferSeq_TypeDef seq;
-    seq.addr = addr << 1;
-    seq.flags = I2C_FLAG_WRITE;
-
-    seq.buf[0].data = data;
-    seq.buf[0].len = len;
+    energy_i2c(ENERGY_I2C_BMI270, 2 + len); // address byte(s), register, data
 
-    if (I2CSPM_Transfer(i2cspm, &seq) != i2cTransferDone) {
-        return SL_STATUS_TRANSMIT;
-    }
-    return SL_STATUS_OK;
+    return sensor_bus_transfer(i2cspm, &seq, SENSOR_BUS_TIMEOUT_US(BMI270_I2C_TIMEOUT_BASE_US, 2 + len));
 }
@@ -41,6 +41,36 @@ extern "C" {
  *****************************************************************************/
 sl_status_t sl_bmi270_init(sl_i2cspm_t *i2cspm, uint8_t addr, int16_t *acc_gyr_data);
 
+/**************************************************************************//**
+ * @brief
+ *   Start a chunked initialization of the bmi270. The 8 KB configuration
+ *   file is then uploaded a chunk per sl_bmi270_init_step() call, so the
+ *   caller can run other work between the chunks.
+ * @param[in] i2cspm
+ *   The I2C peripheral to use.
+ * @param[in] addr
+ *   The I2C address of the sensor.
+ * @retval SL_STATUS_OK Success
+ * @retval SL_STATUS_TRANSMIT I2C transmission error
+ *****************************************************************************/
+sl_status_t sl_bmi270_init_start(sl_i2cspm_t *i2cspm, uint8_t addr);
+
+/**************************************************************************//**
+ * @brief
+ *   Upload the next configuration chunk, or after the last one complete the
+ *   load and configure the accelerometer and gyroscope.
+ * @param[in] i2cspm
+ *   The I2C peripheral to use.
+ * @param[in] addr
+ *   The I2C address of the sensor.
+ * @param[out] done
+ *   Set once the sensor is initialized.
+ * @retval SL_STATUS_OK Success
+ * @retval SL_STATUS_TRANSMIT I2C transmission error
+ * @retval SL_STATUS_FAIL The sensor did not accept the configuration
+ *****************************************************************************/
+sl_status_t sl_bmi270_init_step(sl_i2cspm_t *i2cspm, uint8_t addr, bool *done);
+
 /**************************************************************************//**
  * @brief
  *   Check whether an bmi270 is present on the I2C bus or not.
@@ -69,6 +99,7 @@ bool sl_bmi270_present(sl_i2cspm_t *i2cspm, uint8_t addr, uint8_t *device_id);
  *   The position in .
  * @retval SL_STATUS_OK Success
  * @retval SL_STATUS_TRANSMIT I2C transmission error
+ * @retval SL_STATUS_TIMEOUT The bus hung, it has been recovered
  *****************************************************************************/
 sl_status_t sl_bmi270_read_acc_gyr(sl_i2cspm_t *i2cspm, uint8_t addr,
                                  int16_t *acc_gyr_data);
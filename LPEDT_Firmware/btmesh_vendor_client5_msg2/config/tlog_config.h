@@ -0,0 +1,17 @@
+/*
+ * tlog_config.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#ifndef TLOG_CONFIG_H_
+#define TLOG_CONFIG_H_
+
+// Tokenized logging (../common/tlog.h). 1 (the default) keeps log calls
+// to a record copy and sends binary frames to VCOM from the idle loop, read
+// them with LPEDT_Gateway/tools/tlog_decode. 0 is a debug setting for
+// plain app_log text, formatted and sent on every call
+#define TLOG_ENABLE              1
+
+#endif /* TLOG_CONFIG_H_ */
@@ -0,0 +1,179 @@
+/*
+ * energy.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#include "energy.h"
+
+#include <string.h>
+#include "tlog.h"
+#include "sl_power_manager.h"
+#include "sl_sleeptimer.h"
+
+#define ENERGY_EM_EVENT_MASK  (SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM0 \
+                               | SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM1 \
+                               | SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM2 \
+                               | SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM3)
+
+#define ENERGY_NC_PER_UNIT    ((uint64_t)ENERGY_REPORT_UNIT_NAH * 3600)
+
+static const char *const energy_names[ENERGY_NUM_SUBSYSTEMS] = {
+  "EM0", "EM1", "EM2", "EM3", "radio tx", "radio rx", "i2c", "led", "buzzer", "flash"
+};
+
+static energy_counters_t counters;
+static uint64_t reported_units[ENERGY_NUM_SUBSYSTEMS];
+
+static sl_power_manager_em_t em_current = SL_POWER_MANAGER_EM0;
+static uint32_t em_since;
+static bool     out_on[ENERGY_OUT_NUM];
+static uint32_t out_since[ENERGY_OUT_NUM];
+
+static void energy_em_transition(sl_power_manager_em_t from, sl_power_manager_em_t to);
+
+static sl_power_manager_em_transition_event_handle_t em_event_handle;
+static sl_power_manager_em_transition_event_info_t em_event_info = {
+  .event_mask = ENERGY_EM_EVENT_MASK,
+  .on_event = energy_em_transition,
+};
+
+/*
+ * Called from sl_power_manager_sleep() in the main loop, not from an ISR, so
+ * no locking against the rest of this file is needed.
+ */
+static void energy_em_transition(sl_power_manager_em_t from, sl_power_manager_em_t to)
+{
+  uint32_t now = sl_sleeptimer_get_tick_count();
+
+  if (from <= SL_POWER_MANAGER_EM3) {
+    counters.em_ticks[from] += (uint32_t)(now - em_since);
+  }
+  em_since = now;
+  em_current = to;
+}
+
+// Fold the running intervals into the counters
+static void energy_sync(void)
+{
+  uint32_t now = sl_sleeptimer_get_tick_count();
+
+  if (em_current <= SL_POWER_MANAGER_EM3) {
+    counters.em_ticks[em_current] += (uint32_t)(now - em_since);
+  }
+  em_since = now;
+
+  for (int i = 0; i < ENERGY_OUT_NUM; i++) {
+    if (out_on[i]) {
+      counters.out_ticks[i] += (uint32_t)(now - out_since[i]);
+      out_since[i] = now;
+    }
+  }
+}
+
+static uint64_t ticks_to_nc(uint64_t ticks, uint32_t ua)
+{
+  return ticks * ua * 1000 / sl_sleeptimer_get_timer_frequency();
+}
+
+// Charge in nC (nA.s) per subsystem since boot
+static void energy_charge(uint64_t *nc)
+{
+  for (int em = 0; em < 4; em++) {
+    static const uint32_t em_ua[4] = { ENERGY_EM0_UA, ENERGY_EM1_UA, ENERGY_EM2_UA, ENERGY_EM3_UA };
+    nc[ENERGY_EM0 + em] = ticks_to_nc(counters.em_ticks[em], em_ua[em]);
+  }
+
+  nc[ENERGY_RADIO_TX] = (uint64_t)counters.radio_tx_events * ENERGY_RADIO_TX_NC;
+  nc[ENERGY_RADIO_RX] = (uint64_t)counters.radio_rx_events * ENERGY_RADIO_RX_NC;
+  nc[ENERGY_I2C]      = (uint64_t)counters.i2c_bytes[ENERGY_I2C_SI7021] * ENERGY_SI7021_NC_PER_BYTE
+                      + (uint64_t)counters.i2c_bytes[ENERGY_I2C_BME688] * ENERGY_BME688_NC_PER_BYTE
+                      + (uint64_t)counters.i2c_bytes[ENERGY_I2C_BMI270] * ENERGY_BMI270_NC_PER_BYTE;
+  nc[ENERGY_LED]      = ticks_to_nc(counters.out_ticks[ENERGY_OUT_LED], ENERGY_LED_UA);
+  nc[ENERGY_BUZZER]   = ticks_to_nc(counters.out_ticks[ENERGY_OUT_BUZZER], ENERGY_BUZZER_UA);
+  nc[ENERGY_FLASH]    = (uint64_t)counters.flash_writes * ENERGY_FLASH_NC_PER_WRITE;
+}
+
+void energy_init(void)
+{
+  memset(&counters, 0, sizeof(counters));
+  memset(reported_units, 0, sizeof(reported_units));
+  memset(out_on, 0, sizeof(out_on));
+
+  em_current = SL_POWER_MANAGER_EM0;
+  em_since = sl_sleeptimer_get_tick_count();
+
+  sl_power_manager_subscribe_em_transition_event(&em_event_handle, &em_event_info);
+}
+
+void energy_radio_tx(uint32_t events)
+{
+  counters.radio_tx_events += events;
+}
+
+void energy_radio_rx(uint32_t events)
+{
+  counters.radio_rx_events += events;
+}
+
+void energy_i2c(energy_i2c_dev_t dev, uint32_t bytes)
+{
+  counters.i2c_bytes[dev] += bytes;
+}
+
+void energy_output(energy_output_t out, bool on)
+{
+  uint32_t now = sl_sleeptimer_get_tick_count();
+
+  if (on && !out_on[out]) {
+    out_since[out] = now;
+  }
+  else if (!on && out_on[out]) {
+    counters.out_ticks[out] += (uint32_t)(now - out_since[out]);
+  }
+  out_on[out] = on;
+}
+
+void energy_flash_write(uint32_t writes)
+{
+  counters.flash_writes += writes;
+}
+
+const energy_counters_t *energy_counters(void)
+{
+  energy_sync();
+  return &counters;
+}
+
+void energy_report(uint8_t *buf)
+{
+  uint64_t nc[ENERGY_NUM_SUBSYSTEMS];
+
+  energy_sync();
+  energy_charge(nc);
+
+  app_log("Energy, 0.1 uAh total / last period\r\n");
+  for (int i = 0; i < ENERGY_NUM_SUBSYSTEMS; i++) {
+    // Differences of the running totals, so truncation does not accumulate
+    uint64_t units = nc[i] / ENERGY_NC_PER_UNIT;
+    uint64_t delta = units - reported_units[i];
+    reported_units[i] = units;
+
+    if (delta > UINT16_MAX) {
+      delta = UINT16_MAX;
+    }
+    buf[2 * i]     = (uint8_t)delta;
+    buf[2 * i + 1] = (uint8_t)(delta >> 8);
+
+    app_log("  %-9s %8lu %6u\r\n", energy_names[i], (unsigned long)units, (unsigned)delta);
+  }
+
+  app_log("  tx %lu rx %lu, i2c bytes si7021 %lu bme688 %lu bmi270 %lu, nvm writes %lu\r\n",
+          (unsigned long)counters.radio_tx_events,
+          (unsigned long)counters.radio_rx_events,
+          (unsigned long)counters.i2c_bytes[ENERGY_I2C_SI7021],
+          (unsigned long)counters.i2c_bytes[ENERGY_I2C_BME688],
+          (unsigned long)counters.i2c_bytes[ENERGY_I2C_BMI270],
+          (unsigned long)counters.flash_writes);
+}
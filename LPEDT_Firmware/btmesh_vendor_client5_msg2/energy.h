@@ -0,0 +1,103 @@
+/*
+ * energy.h
+ *
+ *  Energy accounting. Counts time in each energy mode (power manager
+ *  transition events), radio TX/RX events, I2C bytes per device, LED/buzzer
+ *  on-time and flash (NVM) writes, and converts them with a simple
+ *  charge model into µAh per subsystem. The helmet publishes the per period
+ *  figures with the energy_status vendor opcode.
+ *
+ *  The model constants are datasheet typical values for the EFR32BG13 and
+ *  the sensors at 3.0 V, they are meant to rank subsystems against each
+ *  other, not to replace a measurement with the energy profiler.
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#ifndef ENERGY_H_
+#define ENERGY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+  ENERGY_EM0 = 0,
+  ENERGY_EM1,
+  ENERGY_EM2,
+  ENERGY_EM3,
+  ENERGY_RADIO_TX,
+  ENERGY_RADIO_RX,
+  ENERGY_I2C,
+  ENERGY_LED,
+  ENERGY_BUZZER,
+  ENERGY_FLASH,
+  ENERGY_NUM_SUBSYSTEMS
+} energy_subsystem_t;
+
+typedef enum {
+  ENERGY_I2C_SI7021 = 0,
+  ENERGY_I2C_BME688,
+  ENERGY_I2C_BMI270,
+  ENERGY_I2C_NUM_DEVICES
+} energy_i2c_dev_t;
+
+typedef enum {
+  ENERGY_OUT_LED = 0,
+  ENERGY_OUT_BUZZER,
+  ENERGY_OUT_NUM
+} energy_output_t;
+
+// Raw counters, since boot
+typedef struct {
+  uint64_t em_ticks[4];                         // sleeptimer ticks in EM0..EM3
+  uint32_t radio_tx_events;                     // advertising events sent
+  uint32_t radio_rx_events;                     // messages received
+  uint32_t i2c_bytes[ENERGY_I2C_NUM_DEVICES];
+  uint64_t out_ticks[ENERGY_OUT_NUM];           // LED/buzzer on-time
+  uint32_t flash_writes;                        // NVM object writes
+} energy_counters_t;
+
+// ---------------------------------------------------------------------------
+// Charge model
+// ---------------------------------------------------------------------------
+#define ENERGY_EM0_UA              (3300)   // 87 uA/MHz at 38.4 MHz
+#define ENERGY_EM1_UA              (1350)   // 35 uA/MHz at 38.4 MHz
+#define ENERGY_EM2_UA              (3)      // RTCC, 32 kB RAM retained
+#define ENERGY_EM3_UA              (2)
+#define ENERGY_RADIO_TX_NC         (10200)  // 8.5 mA, 3 channels x 0.4 ms
+#define ENERGY_RADIO_RX_NC         (4000)   // 9.9 mA, one PDU on air
+#define ENERGY_SI7021_NC_PER_BYTE  (250)    // conversion current folded in
+#define ENERGY_BME688_NC_PER_BYTE  (120)
+#define ENERGY_BMI270_NC_PER_BYTE  (60)
+#define ENERGY_LED_UA              (2000)
+#define ENERGY_BUZZER_UA           (10000)  // 50 % PWM duty
+#define ENERGY_FLASH_NC_PER_WRITE  (12000)  // NVM3 object write incl. erase share
+
+// energy_status payload, one uint16_t per subsystem in 0.1 uAh units for the
+// report period, little endian
+#define ENERGY_REPORT_UNIT_NAH     (100)
+#define ENERGY_REPORT_LEN          (ENERGY_NUM_SUBSYSTEMS * 2)
+
+// Segments of the energy_status access PDU, 3 byte opcode and 4 byte
+// TransMIC, 12 bytes per segment
+#define ENERGY_REPORT_SEGMENTS     ((ENERGY_REPORT_LEN + 3 + 4 + 11) / 12)
+
+void energy_init(void);
+
+void energy_radio_tx(uint32_t events);
+void energy_radio_rx(uint32_t events);
+void energy_i2c(energy_i2c_dev_t dev, uint32_t bytes);
+void energy_output(energy_output_t out, bool on);
+void energy_flash_write(uint32_t writes);
+
+const energy_counters_t *energy_counters(void);
+
+/*
+ * Build the energy_status payload for the period since the previous call
+ * and log the per subsystem figures over VCOM. buf must hold
+ * ENERGY_REPORT_LEN bytes.
+ */
+void energy_report(uint8_t *buf);
+
+#endif /* ENERGY_H_ */
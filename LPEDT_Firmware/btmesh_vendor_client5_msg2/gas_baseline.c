@@ -0,0 +1,117 @@
+/*
+ * gas_baseline.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#include "gas_baseline.h"
+
+#include <string.h>
+
+// Compensation divisor bounds, per mille, keep a bad humidity reading from
+// scaling the resistance more than 2x either way
+#define GAS_HUM_DIV_MIN   (500)
+#define GAS_HUM_DIV_MAX   (1500)
+
+void gas_baseline_init(gas_baseline_t *gb)
+{
+  memset(gb, 0, sizeof(*gb));
+}
+
+// Resistance at GAS_HUM_REF_PCT, ohms << GAS_BASELINE_FRAC
+static uint32_t compensate(uint32_t ohms, int32_t humidity_pct)
+{
+  int32_t div = 1000 - GAS_HUM_COMP_PERMILLE * (humidity_pct - GAS_HUM_REF_PCT);
+  if (div < GAS_HUM_DIV_MIN)
+    div = GAS_HUM_DIV_MIN;
+  if (div > GAS_HUM_DIV_MAX)
+    div = GAS_HUM_DIV_MAX;
+
+  uint64_t q = (((uint64_t)ohms << GAS_BASELINE_FRAC) * 1000) / (uint32_t)div;
+  if (q > ((uint64_t)GAS_BASELINE_OHMS_MAX << GAS_BASELINE_FRAC))
+    q = (uint64_t)GAS_BASELINE_OHMS_MAX << GAS_BASELINE_FRAC;
+  return (uint32_t)q;
+}
+
+// value moved towards target by 1 / 2^shift, at least one step
+static uint32_t approach(uint32_t value, uint32_t target, uint8_t shift)
+{
+  if (target > value) {
+    uint32_t step = (target - value) >> shift;
+    return value + (step ? step : 1);
+  }
+  if (target < value) {
+    uint32_t step = (value - target) >> shift;
+    return value - (step ? step : 1);
+  }
+  return value;
+}
+
+uint8_t gas_baseline_update(gas_baseline_t *gb, uint32_t ohms, int32_t humidity_pct)
+{
+  if (ohms == 0) {
+    if (gb->rejected < UINT16_MAX)
+      gb->rejected++;
+    return gb->index;
+  }
+  if (ohms > GAS_BASELINE_OHMS_MAX)
+    ohms = GAS_BASELINE_OHMS_MAX;
+
+  uint32_t r = compensate(ohms, humidity_pct);
+
+  if (gb->readings == 0) {
+    gb->filtered = r;
+    gb->baseline = r;
+  }
+  else {
+    gb->filtered = approach(gb->filtered, r, GAS_BASELINE_FILTER_SHIFT);
+  }
+  if (gb->readings < UINT16_MAX)
+    gb->readings++;
+
+  if (gb->readings <= GAS_BASELINE_WARMUP) {
+    // Settling, both ways at the filter's pace
+    gb->baseline = approach(gb->baseline, gb->filtered, GAS_BASELINE_FILTER_SHIFT);
+  }
+  else if (gb->filtered > gb->baseline) {
+    gb->baseline = approach(gb->baseline, gb->filtered, GAS_BASELINE_UP_SHIFT);
+  }
+  else if (gb->index < GAS_BASELINE_HOLD_INDEX || gb->held >= GAS_BASELINE_HOLD_MAX) {
+    gb->baseline = approach(gb->baseline, gb->filtered, GAS_BASELINE_DOWN_SHIFT);
+  }
+
+  uint32_t ratio = gb->baseline ? (uint32_t)(((uint64_t)gb->filtered * 100) / gb->baseline) : 100;
+  gb->ratio_pct = (uint8_t)(ratio > 255 ? 255 : ratio);
+
+  if (gb->readings <= GAS_BASELINE_WARMUP || ratio >= 100)
+    gb->index = 0;
+  else
+    gb->index = (uint8_t)(100 - ratio);
+
+  if (gb->index < GAS_BASELINE_HOLD_INDEX)
+    gb->held = 0;
+  else if (gb->held < UINT16_MAX)
+    gb->held++;
+
+  return gb->index;
+}
+
+bool gas_baseline_alarm(gas_baseline_t *gb, uint8_t threshold)
+{
+  if (!gb->alarm && gb->index > threshold)
+    gb->alarm = true;
+  else if (gb->alarm && (int)gb->index <= (int)threshold - GAS_ALARM_HYST)
+    gb->alarm = false;
+  return gb->alarm;
+}
+
+bool gas_baseline_ready(const gas_baseline_t *gb)
+{
+  return gb->readings > GAS_BASELINE_WARMUP;
+}
+
+uint32_t gas_baseline_ohms(const gas_baseline_t *gb)
+{
+  return gb->baseline >> GAS_BASELINE_FRAC;
+}
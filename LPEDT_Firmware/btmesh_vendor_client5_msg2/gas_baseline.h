@@ -0,0 +1,85 @@
+/*
+ * gas_baseline.h
+ *
+ *  Clean air baseline of the BME688 gas resistance and an index derived
+ *  from it, so the gas alarm does not depend on the sensor, its burn-in
+ *  or the humidity.
+ *
+ *  Every reading is first humidity compensated: the resistance of the
+ *  metal oxide drops as the humidity rises, by about
+ *  GAS_HUM_COMP_PERMILLE per %RH, and is scaled back to what it would be
+ *  at GAS_HUM_REF_PCT. A short EWMA smooths it. The baseline is an EWMA
+ *  of the smoothed value that follows cleaner air (a higher resistance)
+ *  quickly and dirtier air very slowly, and not at all while the index
+ *  is at or over GAS_BASELINE_HOLD_INDEX, so neither the burn-in climb nor
+ *  a slow sensor drift looks like gas, while a leak is not learned as the
+ *  new clean air. The hold ends after GAS_BASELINE_HOLD_MAX readings, a
+ *  drift that got past the hold index is then still followed down and
+ *  cannot keep the alarm up for good.
+ *
+ *    ratio  smoothed resistance against the baseline, percent
+ *    index  100 - ratio, 0 (clean air) to 100
+ *    alarm  set when the index goes over a threshold (GAS_MAX), cleared
+ *           when it is back at GAS_ALARM_HYST under it
+ *
+ *  Integer only, the state is the gas_baseline_t. The index is 0 for the
+ *  first GAS_BASELINE_WARMUP readings while the baseline settles. Nothing
+ *  here touches hardware, the gateway gas_replay tool runs it on the host.
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#ifndef GAS_BASELINE_H_
+#define GAS_BASELINE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GAS_BASELINE_FRAC         (8)         // baseline and filter are ohms << 8
+#define GAS_BASELINE_OHMS_MAX     (16000000)  // readings are clamped to this
+#define GAS_BASELINE_WARMUP       (16)        // readings before the index is given
+#define GAS_BASELINE_FILTER_SHIFT (1)         // reading EWMA, 1/2
+#define GAS_BASELINE_UP_SHIFT     (5)         // towards cleaner air, 1/32
+#define GAS_BASELINE_DOWN_SHIFT   (14)        // towards dirtier air, 1/16384
+#define GAS_BASELINE_HOLD_INDEX   (15)        // no downward adaptation from here
+#define GAS_BASELINE_HOLD_MAX     (9000)      // for this many readings, 1 h at 400 ms
+#define GAS_ALARM_HYST            (10)
+
+#define GAS_HUM_REF_PCT           (40)
+#define GAS_HUM_COMP_PERMILLE     (15)
+
+typedef struct {
+  uint32_t baseline;    // clean air resistance, ohms << GAS_BASELINE_FRAC
+  uint32_t filtered;    // compensated, smoothed reading, same unit
+  uint16_t readings;    // saturates
+  uint16_t rejected;    // failed readings (0 ohms), saturates
+  uint16_t held;        // readings in a row at the hold index, saturates
+  uint8_t  ratio_pct;   // saturates at 255
+  uint8_t  index;
+  bool     alarm;
+} gas_baseline_t;
+
+void gas_baseline_init(gas_baseline_t *gb);
+
+/**
+ * @brief   Fold in one reading
+ * @param   ohms          gas resistance, 0 for a failed reading, which is
+ *                        counted and skipped
+ * @param   humidity_pct  relative humidity of the same measurement
+ * @return  the index after it
+ */
+uint8_t gas_baseline_update(gas_baseline_t *gb, uint32_t ohms, int32_t humidity_pct);
+
+/**
+ * @brief   Alarm on the index after gas_baseline_update(), with hysteresis
+ * @param   threshold  set over it, cleared at threshold - GAS_ALARM_HYST
+ */
+bool gas_baseline_alarm(gas_baseline_t *gb, uint8_t threshold);
+
+bool gas_baseline_ready(const gas_baseline_t *gb);
+
+// Clean air resistance in ohms
+uint32_t gas_baseline_ohms(const gas_baseline_t *gb);
+
+#endif /* GAS_BASELINE_H_ */
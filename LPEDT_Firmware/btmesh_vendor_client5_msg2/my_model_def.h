@@ -50,7 +50,7 @@
 #define UPDATE_INTERVAL_LENGTH          1
 #define UNIT_DATA_LENGTH                1
 
-#define NUMBER_OF_OPCODES               16
+#define NUMBER_OF_OPCODES               18
 
 #define ACK_REQ                         (0x1)
 #define STATUS_UPDATE_REQ               (0x2)
@@ -73,7 +73,9 @@ typedef enum { // DOS: these are the commands exchanged between mesh nodes.
   get_emergency,
   get_emergency_status,
   set_emergency,
-  set_emergency_status
+  set_emergency_status,
+  energy_status,          // per subsystem charge for the last period, see energy.h
+  time_ref                // gateway reference time, see timesync.h
 } my_msg_t;
 
 typedef enum {
@@ -0,0 +1,130 @@
+/*
+ * profiler.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#if !defined(__arm__)
+#define _POSIX_C_SOURCE 199309L // clock_gettime() with -std=c99
+#endif
+
+#include "profiler.h"
+
+#if PROFILER_ENABLE
+
+#include <stdio.h>
+#include <string.h>
+#include "tlog.h"
+
+#if !defined(__arm__)
+#include <time.h>
+#endif
+
+static prof_stats_t prof_stats[PROF_NUM_PROBES];
+
+static const char *const prof_names[PROF_NUM_PROBES] = {
+  "msg_callback",
+  "temp",
+  "humidity",
+  "imu",
+  "gas",
+  "pressure",
+  "i2c_read",
+  "log",
+  "publish",
+  "mesh_rx",
+};
+
+#if !defined(__arm__)
+uint32_t profiler_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+#endif
+
+static uint32_t profiler_ticks_per_us(void)
+{
+#if defined(__arm__)
+  return SystemCoreClock / 1000000;
+#else
+  return 1000;
+#endif
+}
+
+void profiler_init(void)
+{
+#if defined(__arm__)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  profiler_reset();
+}
+
+void profiler_reset(void)
+{
+  memset(prof_stats, 0, sizeof(prof_stats));
+  for (int i = 0; i < PROF_NUM_PROBES; i++) {
+    prof_stats[i].min = UINT32_MAX;
+  }
+}
+
+void profiler_record(prof_probe_t id, uint32_t ticks)
+{
+  prof_stats_t *s = &prof_stats[id];
+
+  s->count++;
+  s->sum += ticks;
+  if (ticks < s->min) s->min = ticks;
+  if (ticks > s->max) s->max = ticks;
+
+  // log2 bin, 32 - clz is the bit length of ticks
+  int bin = (ticks ? 32 - __builtin_clz(ticks) : 0) - PROF_HIST_SHIFT;
+  if (bin < 0) bin = 0;
+  if (bin >= PROF_HIST_BINS) bin = PROF_HIST_BINS - 1;
+  s->hist[bin]++;
+}
+
+void profiler_scope_end(prof_scope_t *scope)
+{
+  profiler_record(scope->id, profiler_now() - scope->start);
+}
+
+const prof_stats_t *profiler_stats(prof_probe_t id)
+{
+  return &prof_stats[id];
+}
+
+void profiler_dump(void)
+{
+  uint32_t tpu = profiler_ticks_per_us();
+
+  app_log("Profile (us), histogram bins are log2 from 2^%d ticks\r\n", PROF_HIST_SHIFT);
+  app_log("%-13s %8s %8s %8s %8s\r\n", "probe", "count", "min", "mean", "max");
+
+  for (int i = 0; i < PROF_NUM_PROBES; i++) {
+    const prof_stats_t *s = &prof_stats[i];
+    if (s->count == 0) {
+      continue;
+    }
+
+    char hist[PROF_HIST_BINS * 6 + 1];
+    int pos = 0;
+    for (int b = 0; b < PROF_HIST_BINS && pos < (int)sizeof(hist); b++) {
+      pos += snprintf(&hist[pos], sizeof(hist) - pos, " %lu", (unsigned long)s->hist[b]);
+    }
+
+    app_log("%-13s %8lu %8lu %8lu %8lu  |%s\r\n",
+            prof_names[i],
+            (unsigned long)s->count,
+            (unsigned long)(s->min / tpu),
+            (unsigned long)(s->sum / s->count / tpu),
+            (unsigned long)(s->max / tpu),
+            hist);
+  }
+}
+
+#endif // PROFILER_ENABLE
@@ -0,0 +1,111 @@
+/*
+ * profiler.h
+ *
+ *  Lightweight execution time probes. On target the Cortex-M4 DWT cycle
+ *  counter is used, on host (mesh simulator) a monotonic clock in ns. Each
+ *  probe keeps count/min/max/sum and a log2 histogram in RAM, profiler_dump()
+ *  prints them over VCOM.
+ *
+ *  There is no mesh opcode for the dump. my_msg_t has room for more (vendor
+ *  opcodes are 6 bit), but the server's opcode table and handler would have
+ *  to change in step, so VCOM is the only readout for now.
+ *
+ *  Everything compiles to nothing unless PROFILER_ENABLE is set in
+ *  Custom_Defines.h.
+ *
+ *  Usage:
+ *    PROF_DUMP_EVERY(n);               // dump every n-th call
+ *    PROF_SCOPE(PROF_MSG_CALLBACK);    // until the end of the enclosing block
+ *
+ *    PROF_BEGIN(PROF_LOG);             // explicit begin/end pair in the
+ *    ...                               // same block
+ *    PROF_END(PROF_LOG);
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdint.h>
+#include "Custom_Defines.h"
+
+typedef enum {
+  PROF_MSG_CALLBACK = 0,  // whole sample-and-publish tick
+  PROF_SENSOR_TEMP,       // Get_Temp()
+  PROF_SENSOR_HUMIDITY,   // Get_Humidity()
+  PROF_SENSOR_IMU,        // Get_IMU_data()
+  PROF_SENSOR_GAS,        // Get_Gas()
+  PROF_SENSOR_PRESSURE,   // Get_Pressure()
+  PROF_I2C,               // single BME688/BMI270 register read, sensor time
+                          // minus this is the compensation math
+  PROF_LOG,               // data log app_log() block
+  PROF_PUBLISH,           // set_publication + publish
+  PROF_MESH_RX,           // vendor model receive handler
+  PROF_NUM_PROBES
+} prof_probe_t;
+
+// Histogram bin b counts durations in [2^(b+SHIFT-1), 2^(b+SHIFT)) ticks,
+// first and last bins are open ended. 2^6..2^21 cycles is 1.7 us..55 ms at
+// 38.4 MHz.
+#define PROF_HIST_BINS   16
+#define PROF_HIST_SHIFT  6
+
+typedef struct {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t hist[PROF_HIST_BINS];
+} prof_stats_t;
+
+#if PROFILER_ENABLE
+
+#if defined(__arm__)
+#include "em_device.h"
+// CYCCNT does not count in EM2 and below, probes must not span a sleep
+static inline uint32_t profiler_now(void) { return DWT->CYCCNT; }
+#else
+uint32_t profiler_now(void);
+#endif
+
+typedef struct {
+  prof_probe_t id;
+  uint32_t     start;
+} prof_scope_t;
+
+void profiler_init(void);
+void profiler_reset(void);
+void profiler_record(prof_probe_t id, uint32_t ticks);
+void profiler_scope_end(prof_scope_t *scope);
+const prof_stats_t *profiler_stats(prof_probe_t id);
+void profiler_dump(void);
+
+#define PROF_INIT()     profiler_init()
+#define PROF_DUMP()     profiler_dump()
+#define PROF_BEGIN(id)  uint32_t prof_start_##id = profiler_now()
+#define PROF_END(id)    profiler_record((id), profiler_now() - prof_start_##id)
+#define PROF_SCOPE(id)  prof_scope_t prof_scope_##id __attribute__((cleanup(profiler_scope_end))) = \
+                          { (id), profiler_now() }
+#define PROF_DUMP_EVERY(n) \
+  do { \
+    static uint32_t prof_calls; \
+    if (++prof_calls >= (n)) { \
+      prof_calls = 0; \
+      profiler_dump(); \
+    } \
+  } while (0)
+
+#else
+
+#define PROF_INIT()     do { } while (0)
+#define PROF_DUMP()     do { } while (0)
+#define PROF_BEGIN(id)  do { } while (0)
+#define PROF_END(id)    do { } while (0)
+#define PROF_SCOPE(id)  do { } while (0)
+#define PROF_DUMP_EVERY(n) do { } while (0)
+
+#endif // PROFILER_ENABLE
+
+#endif /* PROFILER_H_ */
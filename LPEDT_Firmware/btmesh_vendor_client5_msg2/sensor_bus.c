@@ -0,0 +1,93 @@
+/*
+ * sensor_bus.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#include "sensor_bus.h"
+
+#include "em_gpio.h"
+#include "em_i2c.h"
+#include "sl_sleeptimer.h"
+#include "sl_i2cspm_sensor_config.h"
+#include "tlog.h"
+
+// Clocks needed to free a slave stopped anywhere in a byte and its ACK
+#define SENSOR_BUS_RECOVERY_CLOCKS  (9)
+
+static uint32_t timeouts = 0;
+
+static uint32_t us_to_ticks(uint32_t us)
+{
+  uint64_t hz = sl_sleeptimer_get_timer_frequency();
+  // Rounded up, plus one for the partial tick we start in
+  return (uint32_t)(((uint64_t)us * hz + 999999) / 1000000) + 1;
+}
+
+// Waits for the tick count to advance by 2. That is 1 to 2 ticks of the
+// 32768 Hz sleeptimer, 30.5 to 61 us, so SCL runs at 8 to 16 kHz
+static void half_clock(void)
+{
+  uint32_t start = sl_sleeptimer_get_tick_count();
+  while (sl_sleeptimer_get_tick_count() - start < 2)
+    ;
+}
+
+sl_status_t sensor_bus_transfer(sl_i2cspm_t *i2cspm, I2C_TransferSeq_TypeDef *seq, uint32_t timeout_us)
+{
+  uint32_t start = sl_sleeptimer_get_tick_count();
+  uint32_t ticks = us_to_ticks(timeout_us);
+
+  I2C_TransferReturn_TypeDef ret = I2C_TransferInit(i2cspm, seq);
+  while (ret == i2cTransferInProgress) {
+    if (sl_sleeptimer_get_tick_count() - start >= ticks) {
+      timeouts++;
+      app_log_warning("Sensor bus timeout, addr 0x%02X, recovering\n\r", (unsigned int)(seq->addr >> 1));
+      sensor_bus_recover(i2cspm);
+      return SL_STATUS_TIMEOUT;
+    }
+    ret = I2C_Transfer(i2cspm);
+  }
+
+  return (ret == i2cTransferDone) ? SL_STATUS_OK : SL_STATUS_TRANSMIT;
+}
+
+void sensor_bus_recover(sl_i2cspm_t *i2cspm)
+{
+  // Abandon the transfer and take the pins from the peripheral
+  i2cspm->CMD = I2C_CMD_ABORT;
+  i2cspm->ROUTEPEN &= ~(I2C_ROUTEPEN_SDAPEN | I2C_ROUTEPEN_SCLPEN);
+
+  GPIO_PinModeSet(SL_I2CSPM_SENSOR_SDA_PORT, SL_I2CSPM_SENSOR_SDA_PIN, gpioModeWiredAndPullUp, 1);
+  GPIO_PinModeSet(SL_I2CSPM_SENSOR_SCL_PORT, SL_I2CSPM_SENSOR_SCL_PIN, gpioModeWiredAndPullUp, 1);
+  half_clock();
+
+  for (int i = 0; i < SENSOR_BUS_RECOVERY_CLOCKS; i++) {
+    if (GPIO_PinInGet(SL_I2CSPM_SENSOR_SDA_PORT, SL_I2CSPM_SENSOR_SDA_PIN))
+      break;
+    GPIO_PinOutClear(SL_I2CSPM_SENSOR_SCL_PORT, SL_I2CSPM_SENSOR_SCL_PIN);
+    half_clock();
+    GPIO_PinOutSet(SL_I2CSPM_SENSOR_SCL_PORT, SL_I2CSPM_SENSOR_SCL_PIN);
+    half_clock();
+  }
+
+  // STOP, SDA rising while SCL is high
+  GPIO_PinOutClear(SL_I2CSPM_SENSOR_SCL_PORT, SL_I2CSPM_SENSOR_SCL_PIN);
+  half_clock();
+  GPIO_PinOutClear(SL_I2CSPM_SENSOR_SDA_PORT, SL_I2CSPM_SENSOR_SDA_PIN);
+  half_clock();
+  GPIO_PinOutSet(SL_I2CSPM_SENSOR_SCL_PORT, SL_I2CSPM_SENSOR_SCL_PIN);
+  half_clock();
+  GPIO_PinOutSet(SL_I2CSPM_SENSOR_SDA_PORT, SL_I2CSPM_SENSOR_SDA_PIN);
+  half_clock();
+
+  // Back to the peripheral, the STOP let it see the bus idle again
+  i2cspm->ROUTEPEN |= I2C_ROUTEPEN_SDAPEN | I2C_ROUTEPEN_SCLPEN;
+  i2cspm->CMD = I2C_CMD_ABORT | I2C_CMD_CLEARTX | I2C_CMD_CLEARPC;
+}
+
+uint32_t sensor_bus_timeouts(void)
+{
+  return timeouts;
+}
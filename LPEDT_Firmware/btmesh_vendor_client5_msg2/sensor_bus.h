@@ -0,0 +1,44 @@
+/*
+ * sensor_bus.h
+ *
+ *  Bounded I2C transfers on the sensor bus. I2CSPM_Transfer() polls for a
+ *  fixed loop count and leaves a timed out transfer in progress, so a hung
+ *  bus costs its whole timeout on every access until something resets it.
+ *  sensor_bus_transfer() polls against a deadline given by the caller, and
+ *  on a timeout aborts the transfer and recovers the bus: it takes SCL
+ *  from the peripheral and clocks it until the slave holding SDA lets go,
+ *  then sends a STOP.
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#ifndef SENSOR_BUS_H_
+#define SENSOR_BUS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sl_status.h"
+#include "sl_i2cspm.h"
+
+// A byte on the wire at 100 kbit/s is 90 us, deadlines allow twice that
+#define SENSOR_BUS_US_PER_BYTE    (180)
+
+// Deadline for a transfer of len bytes, address and register bytes included
+#define SENSOR_BUS_TIMEOUT_US(base_us, len)  ((base_us) + (uint32_t)(len) * SENSOR_BUS_US_PER_BYTE)
+
+/**
+ * @brief   Polled transfer that gives up after timeout_us
+ * @return  SL_STATUS_OK, SL_STATUS_TRANSMIT on a NACK or bus error, or
+ *          SL_STATUS_TIMEOUT after which the bus has been recovered
+ */
+sl_status_t sensor_bus_transfer(sl_i2cspm_t *i2cspm, I2C_TransferSeq_TypeDef *seq, uint32_t timeout_us);
+
+// Clock SCL until SDA is released (at most 9 clocks) and send a STOP
+void sensor_bus_recover(sl_i2cspm_t *i2cspm);
+
+// Timeouts since boot, each followed by a recovery
+uint32_t sensor_bus_timeouts(void);
+
+#endif /* SENSOR_BUS_H_ */
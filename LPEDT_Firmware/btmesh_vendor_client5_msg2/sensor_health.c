@@ -0,0 +1,61 @@
+/*
+ * sensor_health.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#include "sensor_health.h"
+
+#include <string.h>
+
+void sensor_health_init(sensor_health_t *sh)
+{
+  memset(sh, 0, sizeof(*sh));
+}
+
+bool sensor_health_due(sensor_health_t *sh, sensor_dev_t dev, uint32_t now_ms)
+{
+  sensor_health_dev_t *d = &sh->dev[dev];
+
+  if (d->backoff_ms == 0 || (int32_t)(now_ms + SENSOR_HEALTH_SLACK_MS - d->retry_at_ms) >= 0)
+    return true;
+
+  if (d->skipped < UINT16_MAX)
+    d->skipped++;
+  return false;
+}
+
+void sensor_health_result(sensor_health_t *sh, sensor_dev_t dev, bool ok, uint32_t now_ms)
+{
+  sensor_health_dev_t *d = &sh->dev[dev];
+
+  if (ok) {
+    d->failures = 0;
+    d->backoff_ms = 0;
+    return;
+  }
+
+  if (d->failures < UINT16_MAX)
+    d->failures++;
+  d->total_failures++;
+
+  if (d->backoff_ms == 0)
+    d->backoff_ms = SENSOR_HEALTH_BACKOFF_MIN_MS;
+  else if (d->backoff_ms < SENSOR_HEALTH_BACKOFF_MAX_MS / 2)
+    d->backoff_ms *= 2;
+  else
+    d->backoff_ms = SENSOR_HEALTH_BACKOFF_MAX_MS;
+  d->retry_at_ms = now_ms + d->backoff_ms;
+}
+
+uint8_t sensor_health_degraded(const sensor_health_t *sh)
+{
+  uint8_t mask = 0;
+
+  for (int i = 0; i < SENSOR_DEV_COUNT; i++) {
+    if (sh->dev[i].failures >= SENSOR_HEALTH_DEGRADED_AFTER)
+      mask |= (uint8_t)(1u << i);
+  }
+  return mask;
+}
@@ -0,0 +1,68 @@
+/*
+ * sensor_health.h
+ *
+ *  Per device health of the helmet sensors, so a missing or failing sensor
+ *  is not accessed on every tick.
+ *
+ *  Every access reports its result. A failure puts the device in backoff:
+ *  it is skipped until SENSOR_HEALTH_BACKOFF_MIN_MS later, then tried
+ *  once, and every further failed try doubles the wait up to
+ *  SENSOR_HEALTH_BACKOFF_MAX_MS. The first success clears it. The minimum
+ *  is one sampling period, so a single glitch only drops the rest of that
+ *  tick for the device, while the other devices are read as usual.
+ *
+ *  A device is degraded after SENSOR_HEALTH_DEGRADED_AFTER failures in a
+ *  row, the helmet reports the degraded mask with its telemetry.
+ *
+ *  So a dead sensor costs at most one access every 64 s once its backoff
+ *  has grown from 400 ms, and shows as degraded from its 3rd failure in a
+ *  row until its next success.
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#ifndef SENSOR_HEALTH_H_
+#define SENSOR_HEALTH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SENSOR_HEALTH_BACKOFF_MIN_MS  (400)     // CLIENT_SLEEP_TIME_MS
+#define SENSOR_HEALTH_BACKOFF_MAX_MS  (64000)
+#define SENSOR_HEALTH_DEGRADED_AFTER  (3)
+#define SENSOR_HEALTH_SLACK_MS        (50)      // a retry is due this early, the
+                                                // reads of a tick are not all at its start
+
+// Bit numbers of the degraded mask
+typedef enum {
+  SENSOR_DEV_SI7021 = 0,  // temperature, not tracked while mocked (Sensors.c)
+  SENSOR_DEV_BME688,      // humidity, gas, pressure
+  SENSOR_DEV_BMI270,      // IMU
+  SENSOR_DEV_COUNT
+} sensor_dev_t;
+
+typedef struct {
+  uint32_t retry_at_ms;   // next try while failing
+  uint32_t backoff_ms;    // 0 while healthy
+  uint16_t failures;      // in a row, saturates
+  uint16_t skipped;       // accesses skipped in backoff, saturates
+  uint32_t total_failures;
+} sensor_health_dev_t;
+
+typedef struct {
+  sensor_health_dev_t dev[SENSOR_DEV_COUNT];
+} sensor_health_t;
+
+void sensor_health_init(sensor_health_t *sh);
+
+// Whether the device is to be accessed now, counts a skip if not
+bool sensor_health_due(sensor_health_t *sh, sensor_dev_t dev, uint32_t now_ms);
+
+// Result of an access made at now_ms
+void sensor_health_result(sensor_health_t *sh, sensor_dev_t dev, bool ok, uint32_t now_ms);
+
+// 1 << sensor_dev_t for every degraded device
+uint8_t sensor_health_degraded(const sensor_health_t *sh);
+
+#endif /* SENSOR_HEALTH_H_ */
@@ -0,0 +1,171 @@
+/*
+ * timer_service.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#include "timer_service.h"
+
+#include <stddef.h>
+#include "sl_sleeptimer.h"
+
+// The sleeptimer takes a 32 bit timeout, longer waits are done in steps
+#define TIMER_SERVICE_MAX_ARM  (0x7FFFFFFFu)
+
+static sl_sleeptimer_timer_handle_t hw_timer;
+static timer_service_timer_t *timer_head;   // running timers, earliest first
+static volatile bool expired;
+
+static uint64_t ms_to_ticks(uint32_t ms)
+{
+  // Round up, a timer never fires early
+  uint64_t hz = sl_sleeptimer_get_timer_frequency();
+  return ((uint64_t)ms * hz + 999) / 1000;
+}
+
+/*
+ * Interrupt context, the callbacks run from timer_service_step()
+ */
+static void hw_timer_callback(sl_sleeptimer_timer_handle_t *handle, void *data)
+{
+  (void)handle;
+  (void)data;
+  expired = true;
+}
+
+static void timer_insert(timer_service_timer_t *timer)
+{
+  timer_service_timer_t **p = &timer_head;
+
+  // Behind timers with the same deadline, so they fire in start order
+  while (*p != NULL && (*p)->deadline <= timer->deadline) {
+    p = &(*p)->next;
+  }
+  timer->next = *p;
+  *p = timer;
+}
+
+static void timer_remove(timer_service_timer_t *timer)
+{
+  for (timer_service_timer_t **p = &timer_head; *p != NULL; p = &(*p)->next) {
+    if (*p == timer) {
+      *p = timer->next;
+      timer->next = NULL;
+      return;
+    }
+  }
+}
+
+// Program the one hardware compare for the earliest deadline
+static void timer_arm(void)
+{
+  (void)sl_sleeptimer_stop_timer(&hw_timer);
+
+  if (timer_head == NULL) {
+    return;
+  }
+
+  uint64_t now = sl_sleeptimer_get_tick_count64();
+  if (timer_head->deadline <= now) {
+    expired = true;
+    return;
+  }
+
+  uint64_t ticks = timer_head->deadline - now;
+  if (ticks > TIMER_SERVICE_MAX_ARM) {
+    ticks = TIMER_SERVICE_MAX_ARM;
+  }
+  (void)sl_sleeptimer_start_timer(&hw_timer, (uint32_t)ticks, hw_timer_callback, NULL, 0, 0);
+}
+
+sl_status_t timer_service_start(timer_service_timer_t *timer,
+                                uint32_t timeout_ms,
+                                timer_service_callback_t callback,
+                                void *callback_data,
+                                bool is_periodic)
+{
+  if (timer == NULL) {
+    return SL_STATUS_NULL_POINTER;
+  }
+  if (timeout_ms == 0 && is_periodic) {
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+
+  timer_remove(timer);
+
+  timer->callback = callback;
+  timer->callback_data = callback_data;
+  timer->period = is_periodic ? (uint32_t)ms_to_ticks(timeout_ms) : 0;
+  timer->deadline = sl_sleeptimer_get_tick_count64() + ms_to_ticks(timeout_ms);
+  timer->running = true;
+  timer_insert(timer);
+
+  if (timer_head == timer) {
+    timer_arm();
+  }
+  return SL_STATUS_OK;
+}
+
+sl_status_t timer_service_stop(timer_service_timer_t *timer)
+{
+  if (timer == NULL) {
+    return SL_STATUS_NULL_POINTER;
+  }
+  if (!timer->running) {
+    return SL_STATUS_OK;
+  }
+
+  bool was_head = (timer_head == timer);
+  timer_remove(timer);
+  timer->running = false;
+
+  // Leaving the compare for the stopped timer would be a wasted wakeup
+  if (was_head) {
+    timer_arm();
+  }
+  return SL_STATUS_OK;
+}
+
+void timer_service_step(void)
+{
+  if (!expired) {
+    return;
+  }
+  expired = false;
+
+  uint64_t now = sl_sleeptimer_get_tick_count64();
+
+  // A callback may start or stop timers, the head is reread every time
+  while (timer_head != NULL && timer_head->deadline <= now) {
+    timer_service_timer_t *timer = timer_head;
+    timer_head = timer->next;
+    timer->next = NULL;
+
+    if (timer->period) {
+      // Periods missed while busy are skipped, not run back to back
+      uint64_t late = now - timer->deadline;
+      timer->deadline += (late / timer->period + 1) * timer->period;
+      timer_insert(timer);
+    }
+    else {
+      timer->running = false;
+    }
+
+    if (timer->callback != NULL) {
+      timer->callback(timer, timer->callback_data);
+    }
+  }
+
+  timer_arm();
+}
+
+bool timer_service_pending(void)
+{
+  return expired;
+}
+
+uint64_t timer_service_now_ms(void)
+{
+  return sl_sleeptimer_get_tick_count64() * 1000 / sl_sleeptimer_get_timer_frequency();
+}
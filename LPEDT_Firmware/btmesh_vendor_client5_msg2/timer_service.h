@@ -0,0 +1,61 @@
+/*
+ * timer_service.h
+ *
+ *  Tickless software timers on a single sleeptimer. The running timers are
+ *  kept in a list ordered by deadline and only the earliest one is armed in
+ *  hardware, so the node wakes from EM2 only when some timer is actually
+ *  due, and timers due at the same tick share one wakeup. Deadlines are
+ *  absolute 64 bit sleeptimer ticks, periodic timers advance by whole
+ *  periods from their previous deadline and do not drift with the callback
+ *  latency.
+ *
+ *  The expiry interrupt only flags the service, callbacks run from
+ *  timer_service_step() in the main loop (app_process_action()), like
+ *  sl_simple_timer callbacks.
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#ifndef TIMER_SERVICE_H_
+#define TIMER_SERVICE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sl_status.h"
+
+typedef struct timer_service_timer timer_service_timer_t;
+
+typedef void (*timer_service_callback_t)(timer_service_timer_t *timer, void *data);
+
+struct timer_service_timer {
+  timer_service_callback_t callback;
+  void                    *callback_data;
+  uint64_t                 deadline;   // sleeptimer ticks
+  uint32_t                 period;     // ticks, 0 for a one-shot
+  bool                     running;
+  timer_service_timer_t   *next;
+};
+
+/*
+ * Start (or restart) a timer, timeout_ms from now. Must be called from the
+ * main loop, not from an interrupt.
+ */
+sl_status_t timer_service_start(timer_service_timer_t *timer,
+                                uint32_t timeout_ms,
+                                timer_service_callback_t callback,
+                                void *callback_data,
+                                bool is_periodic);
+
+sl_status_t timer_service_stop(timer_service_timer_t *timer);
+
+// Run the callbacks of the timers that are due and rearm the hardware
+void timer_service_step(void);
+
+// True between an expiry interrupt and the next timer_service_step()
+bool timer_service_pending(void);
+
+// Time since boot from the sleeptimer tick count
+uint64_t timer_service_now_ms(void);
+
+#endif /* TIMER_SERVICE_H_ */
@@ -0,0 +1,272 @@
+/*
+ * timesync.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#include "timesync.h"
+
+#include <string.h>
+
+// Offsets are ms << TIMESYNC_OFFSET_FRAC, the drift is ms per ms <<
+// TIMESYNC_DRIFT_FRAC, steps of 0.06 ppm
+#define TIMESYNC_OFFSET_FRAC  (16)
+#define TIMESYNC_DRIFT_FRAC   (24)
+#define TIMESYNC_OFFSET_ONE   ((int64_t)1 << TIMESYNC_OFFSET_FRAC)
+#define TIMESYNC_DRIFT_ONE    ((int64_t)1 << TIMESYNC_DRIFT_FRAC)
+
+// Crystals are +-40 ppm, a slope past this is delay, not drift
+#define TIMESYNC_DRIFT_MAX    (TIMESYNC_DRIFT_ONE / 20000)   // 50 ppm
+
+// How fast what is known about the offset ages, past any drift error the
+// clamp leaves: true drift and estimate are both within TIMESYNC_DRIFT_MAX
+#define TIMESYNC_AGING        (2 * TIMESYNC_DRIFT_MAX)       // 100 ppm
+
+typedef struct {
+  int64_t local_ms;
+  int64_t offset_ms;    // network - local, least delayed of the window
+} timesync_point_t;
+
+static timesync_point_t points[TIMESYNC_POINTS];
+static uint8_t  point_count;
+static uint8_t  point_next;
+
+// Window being collected
+static int64_t  window_best;
+static int64_t  window_local;
+static uint8_t  window_count;
+
+// Current estimate, offset at base_ms plus drift from there
+static bool     synced;
+static int64_t  base_ms;
+static int64_t  base_offset;
+static int64_t  drift;
+static uint8_t  error_ms = TIMESYNC_UNSYNCED;
+
+// Newest round passed on
+static bool     forwarded;
+static uint8_t  forward_round;
+
+void timesync_init(void)
+{
+  memset(points, 0, sizeof(points));
+  point_count = 0;
+  point_next = 0;
+  window_count = 0;
+  synced = false;
+  base_ms = 0;
+  base_offset = 0;
+  drift = 0;
+  error_ms = TIMESYNC_UNSYNCED;
+  forwarded = false;
+  forward_round = 0;
+}
+
+void timesync_put_u32(uint8_t *out, uint32_t value)
+{
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+  out[2] = (uint8_t)(value >> 16);
+  out[3] = (uint8_t)(value >> 24);
+}
+
+uint32_t timesync_get_u32(const uint8_t *in)
+{
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+// v / 2^shift rounded half away from zero, for either sign
+static int64_t round_shift(int64_t v, uint8_t shift)
+{
+  int64_t half = (int64_t)1 << (shift - 1);
+  return v >= 0 ? (v + half) >> shift : -((half - v) >> shift);
+}
+
+// Network minus local time at local_ms, ms << TIMESYNC_OFFSET_FRAC
+static int64_t estimate_offset(int64_t local_ms)
+{
+  return base_offset + round_shift(drift * (local_ms - base_ms), TIMESYNC_DRIFT_FRAC - TIMESYNC_OFFSET_FRAC);
+}
+
+static int64_t estimate_offset_ms(int64_t local_ms)
+{
+  return round_shift(estimate_offset(local_ms), TIMESYNC_OFFSET_FRAC);
+}
+
+// Aging of what is known at base_ms by local_ms, ms << TIMESYNC_OFFSET_FRAC
+static int64_t aging(int64_t local_ms, int64_t since_ms)
+{
+  int64_t age = local_ms > since_ms ? local_ms - since_ms : 0;
+  return round_shift(TIMESYNC_AGING * age, TIMESYNC_DRIFT_FRAC - TIMESYNC_OFFSET_FRAC);
+}
+
+// Index of the least delayed point among count of them, oldest first from
+// the first'th oldest
+static uint8_t best_point(uint8_t first, uint8_t count)
+{
+  uint8_t oldest = (uint8_t)((point_next + TIMESYNC_POINTS - point_count) % TIMESYNC_POINTS);
+  uint8_t best = (uint8_t)((oldest + first) % TIMESYNC_POINTS);
+
+  for (uint8_t i = 1; i < count; i++) {
+    uint8_t p = (uint8_t)((oldest + first + i) % TIMESYNC_POINTS);
+    if (points[p].offset_ms > points[best].offset_ms) {
+      best = p;
+    }
+  }
+  return best;
+}
+
+/*
+ * Every point is the least delayed reference of its window, and still
+ * late by whatever that one was held up. The drift is the slope between
+ * the least delayed point of the older half and of the newer half, once
+ * they are TIMESYNC_DRIFT_SPAN_MS apart: a few ms of delay over a shorter
+ * span would be more slope than any crystal has.
+ *
+ * The offset is the least delayed point carried to the newest with that
+ * drift, less its aging. The aging outgrows any drift error, so an old
+ * point only wins by being that much less delayed, and the pick is never
+ * early: late references cannot make it early, neither can the drift.
+ */
+static void update(void)
+{
+  const timesync_point_t *newest = &points[(point_next + TIMESYNC_POINTS - 1) % TIMESYNC_POINTS];
+  uint8_t half = point_count / 2;
+
+  if (half > 0) {
+    const timesync_point_t *older = &points[best_point(0, half)];
+    const timesync_point_t *newer = &points[best_point(half, (uint8_t)(point_count - half))];
+    int64_t span = newer->local_ms - older->local_ms;
+
+    if (span >= TIMESYNC_DRIFT_SPAN_MS) {
+      drift = (newer->offset_ms - older->offset_ms) * TIMESYNC_DRIFT_ONE / span;
+      if (drift > TIMESYNC_DRIFT_MAX) {
+        drift = TIMESYNC_DRIFT_MAX;
+      }
+      if (drift < -TIMESYNC_DRIFT_MAX) {
+        drift = -TIMESYNC_DRIFT_MAX;
+      }
+    }
+  }
+
+  int64_t top = INT64_MIN, bottom = INT64_MAX;
+  for (uint8_t i = 0; i < point_count; i++) {
+    int64_t r = points[i].offset_ms * TIMESYNC_OFFSET_ONE +
+                round_shift(drift * (newest->local_ms - points[i].local_ms), TIMESYNC_DRIFT_FRAC - TIMESYNC_OFFSET_FRAC) -
+                aging(newest->local_ms, points[i].local_ms);
+    if (r > top) {
+      top = r;
+    }
+    if (r < bottom) {
+      bottom = r;
+    }
+  }
+  base_ms = newest->local_ms;
+  base_offset = top;
+
+  int64_t spread = round_shift(top - bottom, TIMESYNC_OFFSET_FRAC);
+  error_ms = spread >= TIMESYNC_UNSYNCED - 1 ? (uint8_t)(TIMESYNC_UNSYNCED - 1) : (uint8_t)spread;
+}
+
+void timesync_reference(uint64_t local_ms, const uint8_t *payload, uint8_t len)
+{
+  if (len < TIMESYNC_REF_LEN) {
+    return;
+  }
+
+  uint32_t ref = timesync_get_u32(payload);
+  int64_t  local = (int64_t)local_ms;
+  int64_t  offset;
+
+  if (synced) {
+    // Unwrap the 32 bit reference against the estimate
+    int64_t predicted = local + estimate_offset_ms(local);
+    int64_t network = predicted + (int32_t)(ref - (uint32_t)predicted);
+    offset = network - local;
+
+    if (network - predicted > TIMESYNC_RESET_MS || predicted - network > TIMESYNC_RESET_MS) {
+      timesync_init();
+      offset = (int64_t)ref - local;
+    }
+  }
+  else {
+    offset = (int64_t)ref - local;
+  }
+
+  // No reference is ever early, one above the estimate was held up less
+  // than any behind it and the estimate moves up onto it at once. Until
+  // the first window is in that is all there is, a coarse estimate.
+  if (!synced || offset * TIMESYNC_OFFSET_ONE > estimate_offset(local)) {
+    base_ms = local;
+    base_offset = offset * TIMESYNC_OFFSET_ONE;
+    if (!synced) {
+      synced = true;
+      error_ms = TIMESYNC_UNSYNCED - 1;
+    }
+  }
+
+  if (window_count == 0 || offset > window_best) {
+    window_best = offset;
+    window_local = local;
+  }
+  if (++window_count < TIMESYNC_WINDOW) {
+    return;
+  }
+  window_count = 0;
+
+  points[point_next].local_ms = window_local;
+  points[point_next].offset_ms = window_best;
+  point_next = (point_next + 1) % TIMESYNC_POINTS;
+  if (point_count < TIMESYNC_POINTS) {
+    point_count++;
+  }
+  update();
+}
+
+// The estimate is aged like the points, a reference passed on is never
+// early either
+bool timesync_forward(uint64_t local_ms, const uint8_t *payload, uint8_t len, uint8_t *out)
+{
+  if (!synced || len < TIMESYNC_REF_LEN) {
+    return false;
+  }
+
+  uint8_t round = payload[4];
+  if (forwarded && (int8_t)(round - forward_round) <= 0) {
+    return false;
+  }
+  forwarded = true;
+  forward_round = round;
+
+  int64_t local = (int64_t)local_ms;
+  int64_t offset = round_shift(estimate_offset(local) - aging(local, base_ms), TIMESYNC_OFFSET_FRAC);
+  timesync_put_u32(out, (uint32_t)(local + offset));
+  out[4] = round;
+  return true;
+}
+
+bool timesync_synced(void)
+{
+  return synced;
+}
+
+uint32_t timesync_network_ms(uint64_t local_ms)
+{
+  if (!synced) {
+    return (uint32_t)local_ms;
+  }
+
+  return (uint32_t)((int64_t)local_ms + estimate_offset_ms((int64_t)local_ms));
+}
+
+uint8_t timesync_error_ms(void)
+{
+  return synced ? error_ms : TIMESYNC_UNSYNCED;
+}
+
+void timesync_stamp(uint64_t local_ms, uint8_t *out)
+{
+  timesync_put_u32(out, timesync_network_ms(local_ms));
+  out[4] = timesync_error_ms();
+}
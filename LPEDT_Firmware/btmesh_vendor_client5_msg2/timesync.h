@@ -0,0 +1,83 @@
+/*
+ * timesync.h
+ *
+ *  Network time from the reference the gateway publishes (time_ref), so
+ *  the gateway can order events of different helmets. The helmet keeps no
+ *  clock of its own, it keeps an estimate of offset and drift of its local
+ *  clock against the gateway and maps local times to network time.
+ *
+ *  A reference is stamped when it is handed to the stack, the advertising
+ *  delays, relay hops and queueing on the way only ever make it look
+ *  older. So each window of TIMESYNC_WINDOW references keeps the least
+ *  delayed one, and the offset is the least delayed of the last
+ *  TIMESYNC_POINTS of those, TIMESYNC_WINDOW * TIMESYNC_POINTS references,
+ *  each aged by how old it is. The drift comes from least delayed points
+ *  far apart. The first reference alone is enough for a coarse offset.
+ *
+ *  The gateway numbers its references (round) and sends them nonrelayed.
+ *  A helmet passes each round on once, nonrelayed and stamped with its own
+ *  network time, so a reference crosses the mesh one radio hop at a time
+ *  instead of riding relays that a busy mesh loses most of. The estimate
+ *  it stamps is aged too, so it is late if anything, like any other
+ *  delayed reference, and never pulls the helmets that hear it early.
+ *
+ *  Network time is gateway milliseconds, carried as 32 bits that wrap
+ *  every 49.7 days. Integer only, no double on the single precision FPU.
+ *  Nothing here touches hardware, the caller passes its local time
+ *  (timer_service_now_ms()).
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#ifndef TIMESYNC_H_
+#define TIMESYNC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TIMESYNC_WINDOW      (4)     // references per envelope point
+#define TIMESYNC_POINTS      (16)    // envelope points the offset is taken from
+
+// Shortest span the drift is taken over, 0 until there is one
+#define TIMESYNC_DRIFT_SPAN_MS (60000)
+
+// A reference this far off the estimate means the gateway restarted its
+// clock, the filter starts over
+#define TIMESYNC_RESET_MS    (5000)
+
+// time_ref payload: network time, uint32 LE, then the gateway's round
+#define TIMESYNC_REF_LEN     (5)
+
+// Timestamp carried by sample and alarm frames: network time, uint32 LE,
+// then the error bound in ms, TIMESYNC_UNSYNCED if there is no estimate
+#define TIMESYNC_STAMP_LEN   (5)
+#define TIMESYNC_UNSYNCED    (0xFF)
+
+void timesync_init(void);
+
+// A time_ref was received at local time local_ms
+void timesync_reference(uint64_t local_ms, const uint8_t *payload, uint8_t len);
+
+// After timesync_reference(): true if the round of payload was not passed
+// on yet, out is then the reference to send nonrelayed, TIMESYNC_REF_LEN
+// bytes stamped at local time local_ms
+bool timesync_forward(uint64_t local_ms, const uint8_t *payload, uint8_t len, uint8_t *out);
+
+bool timesync_synced(void);
+
+// Network time at local time local_ms, local_ms itself while unsynced
+uint32_t timesync_network_ms(uint64_t local_ms);
+
+// Spread of the envelope points under the least delayed one, capped below
+// TIMESYNC_UNSYNCED. The cap until the first window is in.
+uint8_t timesync_error_ms(void);
+
+// Stamp for local time local_ms, TIMESYNC_STAMP_LEN bytes
+void timesync_stamp(uint64_t local_ms, uint8_t *out);
+
+// Gateway side helpers for the frame formats
+void     timesync_put_u32(uint8_t *out, uint32_t value);
+uint32_t timesync_get_u32(const uint8_t *in);
+
+#endif /* TIMESYNC_H_ */
@@ -0,0 +1,177 @@
+/*
+ * tlog.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#include "tlog.h"
+
+#if TLOG_ENABLE && defined(__arm__)
+
+#include <stdbool.h>
+#include <string.h>
+#include "em_core.h"
+#include "sl_iostream.h"
+
+// __builtin_classify_type() results used for the argument encoding
+#define TLOG_CLASS_POINTER  5
+#define TLOG_CLASS_REAL     8
+
+// Code and constant data are below this, the decoder reads flash strings
+// from the .axf
+#define TLOG_RAM_BASE       0x20000000UL
+
+// Worst case bytes of one argument, a copied RAM string
+#define TLOG_ARG_MAX        (1 + TLOG_STR_MAX)
+
+// Ring of records, each stored as its length byte followed by the payload
+static uint8_t  tlog_buf[TLOG_BUF_SIZE];
+static uint32_t tlog_head;    // write index, free running
+static uint32_t tlog_tail;    // read index, free running
+static uint32_t tlog_drops;   // records lost to a full ring, not yet reported
+static uint32_t tlog_drops_total;
+
+static uint32_t tlog_put_varint(uint8_t *out, uint64_t v)
+{
+  uint32_t n = 0;
+
+  do {
+    out[n] = (uint8_t)(v & 0x7F);
+    v >>= 7;
+    if (v) {
+      out[n] |= 0x80;
+    }
+    n++;
+  } while (v);
+
+  return n;
+}
+
+static uint32_t tlog_put_string(uint8_t *out, const char *s)
+{
+  if (s == NULL) {
+    s = "(null)";
+  }
+
+  if ((uintptr_t)s < TLOG_RAM_BASE) {
+    uint32_t addr = (uint32_t)(uintptr_t)s;
+    out[0] = 0;
+    memcpy(&out[1], &addr, sizeof(addr));
+    return 1 + sizeof(addr);
+  }
+
+  uint32_t len = 0;
+  while (len < TLOG_STR_MAX && s[len] != '\0') {
+    len++;
+  }
+  out[0] = (uint8_t)(len + 1);
+  memcpy(&out[1], s, len);
+  return 1 + len;
+}
+
+static uint32_t tlog_put_arg(uint8_t *out, const tlog_arg_t *arg)
+{
+  if (arg->cls == TLOG_CLASS_REAL) {
+    float f = (arg->size == sizeof(float)) ? *(const float *)arg->p
+                                           : (float)*(const double *)arg->p;
+    memcpy(out, &f, sizeof(f));
+    return sizeof(f);
+  }
+
+  if (arg->cls == TLOG_CLASS_POINTER) {
+    return tlog_put_string(out, *(const char *const *)arg->p);
+  }
+
+  uint64_t v = (arg->size == sizeof(uint64_t)) ? *(const uint64_t *)arg->p
+                                               : *(const uint32_t *)arg->p;
+  return tlog_put_varint(out, v);
+}
+
+void tlog_write(uint32_t token, uint32_t nargs, const tlog_arg_t *args)
+{
+  uint8_t rec[1 + TLOG_RECORD_MAX];
+  uint32_t len = tlog_put_varint(&rec[1], token);
+
+  // Arguments that do not fit are left out, the decoder marks them
+  for (uint32_t i = 0; i < nargs && len + TLOG_ARG_MAX <= TLOG_RECORD_MAX; i++) {
+    len += tlog_put_arg(&rec[1 + len], &args[i]);
+  }
+  rec[0] = (uint8_t)len;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_ATOMIC();
+  if (TLOG_BUF_SIZE - (tlog_head - tlog_tail) < 1 + len) {
+    tlog_drops++;
+    tlog_drops_total++;
+  }
+  else {
+    for (uint32_t i = 0; i < 1 + len; i++) {
+      tlog_buf[(tlog_head + i) % TLOG_BUF_SIZE] = rec[i];
+    }
+    tlog_head += 1 + len;
+  }
+  CORE_EXIT_ATOMIC();
+}
+
+static void tlog_send_frame(uint8_t sync, const uint8_t *payload, uint32_t len)
+{
+  uint8_t frame[2 + TLOG_RECORD_MAX + 1];
+  uint8_t sum = 0;
+
+  frame[0] = sync;
+  frame[1] = (uint8_t)len;
+  for (uint32_t i = 0; i < len; i++) {
+    frame[2 + i] = payload[i];
+    sum += payload[i];
+  }
+  frame[2 + len] = sum;
+
+  sl_iostream_write(SL_IOSTREAM_STDOUT, frame, 3 + len);
+}
+
+void tlog_drain(void)
+{
+  uint32_t sent = 0;
+
+  while (sent < TLOG_DRAIN_MAX) {
+    uint8_t rec[TLOG_RECORD_MAX];
+    uint32_t len = 0;
+    uint32_t drops;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_ATOMIC();
+    bool empty = (tlog_head == tlog_tail);
+    // The lost records were newer than anything still queued
+    drops = empty ? tlog_drops : 0;
+    tlog_drops -= drops;
+    if (!empty) {
+      len = tlog_buf[tlog_tail % TLOG_BUF_SIZE];
+      for (uint32_t i = 0; i < len; i++) {
+        rec[i] = tlog_buf[(tlog_tail + 1 + i) % TLOG_BUF_SIZE];
+      }
+      tlog_tail += 1 + len;
+    }
+    CORE_EXIT_ATOMIC();
+
+    if (drops) {
+      uint8_t payload[5];
+      uint32_t n = tlog_put_varint(payload, drops);
+      tlog_send_frame(TLOG_SYNC_DROPPED, payload, n);
+      sent += 3 + n;
+    }
+
+    if (empty) {
+      break;
+    }
+    tlog_send_frame(TLOG_SYNC_RECORD, rec, len);
+    sent += 3 + len;
+  }
+}
+
+uint32_t tlog_dropped(void)
+{
+  return tlog_drops_total;
+}
+
+#endif // TLOG_ENABLE && defined(__arm__)
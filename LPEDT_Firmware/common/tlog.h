@@ -0,0 +1,143 @@
+/*
+ * tlog.h
+ *
+ *  Tokenized, deferred logging. A log call stores the ID of its format
+ *  string and the raw argument values in a RAM ring, tlog_drain() sends the
+ *  records to VCOM as binary frames from the idle main loop. The format
+ *  strings are placed in the non allocated .tlog_fmt section, they stay in
+ *  the .axf for the host decoder (LPEDT_Gateway/tools/tlog_decode.cpp) but
+ *  are not programmed into flash. The token is the offset of the string in
+ *  that section.
+ *
+ *  One copy shared by the firmware projects, each sets TLOG_ENABLE in its
+ *  config/tlog_config.h. Include this header instead of app_log.h. With
+ *  TLOG_ENABLE set app_log() and app_log_<level>() go through the ring
+ *  (and on the miner board LOG_ERROR()/LOG_WARN()/LOG_INFO() of log.h),
+ *  otherwise (and always in the host build of the mesh simulator) they are
+ *  the plain app_log text macros.
+ *
+ *  TLOG_ENABLE is 1 by default, so VCOM carries binary frames and a serial
+ *  terminal shows garbage. The normal way to read it is
+ *    stty -F /dev/ttyACM0 115200 raw
+ *    tlog_decode --elf <project>.axf --in /dev/ttyACM0
+ *  with the .axf of the build that is running (LPEDT_Gateway/tools). Set
+ *  TLOG_ENABLE 0 for plain text when a decoder is not at hand, at the cost
+ *  of formatting and UART work at EM0 in every log call.
+ *
+ *  Arguments are encoded from their C type after the usual promotions:
+ *    integer, enum, bool  unsigned LEB128 varint of the 32 (or 64) bit value
+ *    float, double        IEEE single, 4 bytes little endian
+ *    pointer              a %s string, varint 0 and the 4 byte address when
+ *                         it points into flash, varint n+1 and n bytes (at
+ *                         most TLOG_STR_MAX) copied when it points into RAM
+ *  so %p is not supported. The decoder walks the format string to know how
+ *  to read each argument.
+ *
+ *  Frame on the wire, sync bytes are outside ASCII so plain text from
+ *  app_assert() or the stack passes through the decoder untouched:
+ *    0xA5 len payload[len] sum   payload = varint token, arguments
+ *    0xA6 len payload[len] sum   payload = varint number of dropped records
+ *  sum is the 8 bit sum of the payload bytes.
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vishn
+ */
+
+#ifndef TLOG_H_
+#define TLOG_H_
+
+#include <stdint.h>
+#include "app_log.h"
+#include "tlog_config.h"
+
+#ifndef TLOG_ENABLE
+#define TLOG_ENABLE        0
+#endif
+
+#define TLOG_SYNC_RECORD   0xA5
+#define TLOG_SYNC_DROPPED  0xA6
+
+#if TLOG_ENABLE && defined(__arm__)
+
+#define TLOG_BUF_SIZE      1024  // RAM ring, bytes
+#define TLOG_RECORD_MAX    96    // encoded record, without framing
+#define TLOG_STR_MAX       32    // RAM string argument, longer ones are cut
+#define TLOG_DRAIN_MAX     512   // bytes written to VCOM per tlog_drain()
+
+typedef struct {
+  const void *p;     // copy of the promoted argument
+  uint8_t     cls;   // __builtin_classify_type()
+  uint8_t     size;
+} tlog_arg_t;
+
+void tlog_write(uint32_t token, uint32_t nargs, const tlog_arg_t *args);
+void tlog_drain(void);
+uint32_t tlog_dropped(void);
+
+// '@' comments out the flags gcc appends, so the section is not allocated.
+// That is ARM GAS syntax, other assemblers ('#' on x86) reject the line,
+// one reason for the __arm__ check above
+#define TLOG_FMT_ATTR  __attribute__((section(".tlog_fmt,\"\",%progbits @"), used))
+
+#define TLOG_ARG(x)    { &(const __typeof__((x) + 0)){ (x) }, \
+                         __builtin_classify_type((x) + 0), sizeof((x) + 0) }
+
+// Number of arguments after the format, TLOG_NARGS(fmt, ##__VA_ARGS__)
+#define TLOG_NARGS(...) TLOG_NARGS_(__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define TLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, n, ...) n
+
+#define TLOG_CAT(a, b)  TLOG_CAT_(a, b)
+#define TLOG_CAT_(a, b) a##b
+
+#define TLOG_ARGS(n, ...)    TLOG_CAT(TLOG_ARGS_, n)(__VA_ARGS__)
+#define TLOG_ARGS_0()
+#define TLOG_ARGS_1(a)       , TLOG_ARG(a)
+#define TLOG_ARGS_2(a, ...)  , TLOG_ARG(a) TLOG_ARGS_1(__VA_ARGS__)
+#define TLOG_ARGS_3(a, ...)  , TLOG_ARG(a) TLOG_ARGS_2(__VA_ARGS__)
+#define TLOG_ARGS_4(a, ...)  , TLOG_ARG(a) TLOG_ARGS_3(__VA_ARGS__)
+#define TLOG_ARGS_5(a, ...)  , TLOG_ARG(a) TLOG_ARGS_4(__VA_ARGS__)
+#define TLOG_ARGS_6(a, ...)  , TLOG_ARG(a) TLOG_ARGS_5(__VA_ARGS__)
+#define TLOG_ARGS_7(a, ...)  , TLOG_ARG(a) TLOG_ARGS_6(__VA_ARGS__)
+#define TLOG_ARGS_8(a, ...)  , TLOG_ARG(a) TLOG_ARGS_7(__VA_ARGS__)
+#define TLOG_ARGS_9(a, ...)  , TLOG_ARG(a) TLOG_ARGS_8(__VA_ARGS__)
+#define TLOG_ARGS_10(a, ...) , TLOG_ARG(a) TLOG_ARGS_9(__VA_ARGS__)
+#define TLOG_ARGS_11(a, ...) , TLOG_ARG(a) TLOG_ARGS_10(__VA_ARGS__)
+#define TLOG_ARGS_12(a, ...) , TLOG_ARG(a) TLOG_ARGS_11(__VA_ARGS__)
+
+// The leading dummy element keeps the initializer valid without arguments
+#define TLOG(fmt, ...) \
+  do { \
+    static const char tlog_fmt_[] TLOG_FMT_ATTR = fmt; \
+    tlog_write((uint32_t)(uintptr_t)tlog_fmt_, TLOG_NARGS(fmt, ##__VA_ARGS__), \
+               (const tlog_arg_t[]){ { 0, 0, 0 } \
+                 TLOG_ARGS(TLOG_NARGS(fmt, ##__VA_ARGS__), ##__VA_ARGS__) } + 1); \
+  } while (0)
+
+#define TLOG_DRAIN()   tlog_drain()
+
+#undef app_log
+#undef app_log_append
+#undef app_log_nl
+#undef app_log_debug
+#undef app_log_info
+#undef app_log_warning
+#undef app_log_error
+#undef app_log_critical
+
+#define app_log(fmt, ...)          TLOG(fmt, ##__VA_ARGS__)
+#define app_log_append(fmt, ...)   TLOG(fmt, ##__VA_ARGS__)
+#define app_log_nl()               TLOG(APP_LOG_NEW_LINE)
+#define app_log_debug(fmt, ...)    TLOG(APP_LOG_LEVEL_DEBUG_PREFIX APP_LOG_SEPARATOR fmt, ##__VA_ARGS__)
+#define app_log_info(fmt, ...)     TLOG(APP_LOG_LEVEL_INFO_PREFIX APP_LOG_SEPARATOR fmt, ##__VA_ARGS__)
+#define app_log_warning(fmt, ...)  TLOG(APP_LOG_LEVEL_WARNING_PREFIX APP_LOG_SEPARATOR fmt, ##__VA_ARGS__)
+#define app_log_error(fmt, ...)    TLOG(APP_LOG_LEVEL_ERROR_PREFIX APP_LOG_SEPARATOR fmt, ##__VA_ARGS__)
+#define app_log_critical(fmt, ...) TLOG(APP_LOG_LEVEL_CRITICAL_PREFIX APP_LOG_SEPARATOR fmt, ##__VA_ARGS__)
+
+#else
+
+#define TLOG(fmt, ...)  app_log(fmt, ##__VA_ARGS__)
+#define TLOG_DRAIN()    do { } while (0)
+
+#endif // TLOG_ENABLE && defined(__arm__)
+
+#endif /* TLOG_H_ */
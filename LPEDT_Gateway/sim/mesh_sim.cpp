@@ -0,0 +1,1675 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    mesh_sim.cpp
+ * @brief   Discrete-event mesh simulator core
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "mesh_sim.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <filesystem>
+#include <thread>
+
+#include "sl_status.h"
+#include "my_model_def.h"
+#include "Custom_Defines.h"
+#include "sl_btmesh_config.h"
+#include "sl_btmesh_lpn_config.h"
+extern "C" {
+#include "sl_sleeptimer.h"
+#include "timesync.h"
+}
+
+namespace lpedt {
+
+// Group addresses and TTL the application configures, must match app.c
+#define SIM_STATUS_GRP_ADDR       (0xC001)
+#define SIM_CTRL_GRP_ADDR         (0xC002)
+#define SIM_DEFAULT_TTL           (5)
+
+// Unicast addresses handed out, helmets derive theirs from the identity
+// address (see PROV_LOCALLY in app.c)
+#define SIM_HELMET_BASE_ADDR      (0x0100)
+#define SIM_ANCHOR_BASE_ADDR      (0x0800)
+
+#define SIM_BOOT_TIME_MS          (30)    // reset to sl_bt_evt_system_boot
+#define SIM_MESH_INIT_MS          (20)    // sl_btmesh_node_init() to node_initialized
+
+// sl_bt_nvm_save() user keys and value size
+#define SIM_NVM_KEY_FIRST         (0x4000)
+#define SIM_NVM_KEY_LAST          (0x407F)
+#define SIM_NVM_VALUE_MAX         (56)
+
+// Advertising bearer
+#define SIM_ADV_CHANNELS          (3)
+#define SIM_ADV_CHANNEL_SWITCH_US (150)
+#define SIM_ADV_DELAY_MAX_US      (10000) // random advDelay added to every transmission
+#define SIM_LL_OVERHEAD_BYTES     (1 + 4 + 2 + 6 + 3) // preamble, access address, header, AdvA, CRC
+#define SIM_AD_HEADER_BYTES       (2)
+#define SIM_NET_HEADER_BYTES      (9)     // IVI/NID, CTL/TTL, SEQ, SRC, DST
+#define SIM_NET_MIC_BYTES         (4)
+#define SIM_TRANS_MIC_BYTES       (4)
+#define SIM_VENDOR_OPCODE_BYTES   (3)
+#define SIM_UNSEG_ACCESS_MAX      (11)
+#define SIM_SEG_ACCESS_BYTES      (12)
+#define SIM_SEG_HEADER_BYTES      (4)
+
+// Gas resistance, the injected alarm is well past GAS_MAX on gas_baseline.h's index
+#define SIM_CLEAN_GAS_OHM         (50000)
+#define SIM_EMERGENCY_GAS_OHM     (SIM_CLEAN_GAS_OHM / 10)
+
+static mesh_sim *g_sim = nullptr;
+
+mesh_sim_config_t::mesh_sim_config_t()
+  : poll_ms(LPN_POLL_TIMEOUT),
+    receive_delay_ms(LPN_RECEIVE_DELAY),
+    friend_find_ms(LPN_FRIEND_FIND_TIMEOUT),
+    friend_queue(SL_BTMESH_CONFIG_FRIEND_MAX_SINGLE_CACHE),
+    max_friendships(SL_BTMESH_CONFIG_MAX_FRIENDSHIPS),
+    app_txq(SL_BTMESH_CONFIG_APP_TXQ_SIZE),
+    net_cache(SL_BTMESH_CONFIG_NET_CACHE_SIZE)
+{
+}
+
+mesh_sim::mesh_sim(const mesh_sim_config_t &config)
+  : config_(config),
+    rng_(config.seed),
+    shadow_(0.0f, config.shadowing_db)
+{
+}
+
+mesh_sim::~mesh_sim()
+{
+  for (node_t &n : nodes_)
+    unload_app(n);
+
+  if (!tmp_dir_.empty()) {
+    std::error_code ec;
+    std::filesystem::remove_all(tmp_dir_, ec);
+  }
+
+  if (g_sim == this)
+    g_sim = nullptr;
+}
+
+/*
+ * Setup
+ */
+bool mesh_sim::setup(std::string &error)
+{
+  g_sim = this;
+
+  uint32_t total = config_.helmets + config_.anchors;
+  if (config_.helmets == 0 || config_.anchors == 0) {
+    error = "need at least one helmet and one anchor";
+    return false;
+  }
+  if (config_.helmets > SIM_ANCHOR_BASE_ADDR - SIM_HELMET_BASE_ADDR) {
+    error = "too many helmets for the address plan";
+    return false;
+  }
+
+  std::uniform_real_distribution<float> uni(0.0f, 1.0f);
+  nodes_.resize(total);
+
+  // Anchors either along a tunnel drift or on a square grid, helmets
+  // scattered uniformly over the covered area
+  float extent_x, extent_y;
+  uint32_t side = (uint32_t)std::ceil(std::sqrt((double)config_.anchors));
+  if (config_.grid) {
+    extent_x = extent_y = side * config_.anchor_spacing_m;
+  }
+  else {
+    extent_x = config_.anchors * config_.anchor_spacing_m;
+    extent_y = config_.tunnel_width_m;
+  }
+
+  for (uint32_t i = 0; i < total; i++) {
+    node_t &n = nodes_[i];
+    n.index = (uint16_t)i;
+    n.helmet = i < config_.helmets;
+    n.cache.assign(config_.net_cache, 0);
+
+    if (n.helmet) {
+      n.x_m = uni(rng_) * extent_x;
+      n.y_m = uni(rng_) * extent_y;
+      n.provisioned = config_.provisioned;
+      n.address = config_.provisioned ? identity_address_of(n) : 0;
+      continue;
+    }
+
+    uint32_t j = i - config_.helmets;
+    if (config_.grid) {
+      n.x_m = ((j % side) + 0.5f) * config_.anchor_spacing_m;
+      n.y_m = ((j / side) + 0.5f) * config_.anchor_spacing_m;
+    }
+    else {
+      n.x_m = (j + 0.5f) * config_.anchor_spacing_m;
+      n.y_m = config_.tunnel_width_m / 2.0f;
+    }
+
+    // Anchors are infrastructure, configured and running from the start with
+    // the server side of the group setup in app.c
+    n.provisioned = true;
+    n.address = (uint16_t)(SIM_ANCHOR_BASE_ADDR + j);
+    n.app_key = true;
+    n.app_bound = true;
+    n.pub_address = SIM_STATUS_GRP_ADDR;
+    n.pub_ttl = SIM_DEFAULT_TTL;
+    n.subs.push_back(SIM_CTRL_GRP_ADDR);
+    n.relay = true;
+    n.nettx_count = 2;
+    n.nettx_interval = 4;
+    n.state = node_state_t::running;
+    n.mesh_ready = true;
+    n.model_ready = true;
+  }
+
+  // Links, anything that can be heard some of the time
+  float floor_dbm = config_.sensitivity_dbm - 3.0f * config_.shadowing_db;
+  for (uint32_t a = 0; a < total; a++) {
+    for (uint32_t b = a + 1; b < total; b++) {
+      float d = std::hypot(nodes_[a].x_m - nodes_[b].x_m, nodes_[a].y_m - nodes_[b].y_m);
+      if (d < 1.0f)
+        d = 1.0f;
+      float rssi = config_.rssi_1m_dbm - 10.0f * config_.path_loss_exp * std::log10(d);
+      if (rssi < floor_dbm)
+        continue;
+      nodes_[a].links.push_back({ (uint16_t)b, rssi });
+      nodes_[b].links.push_back({ (uint16_t)a, rssi });
+    }
+  }
+
+  // One private copy of the application module per helmet, dlopen() of the
+  // same path would hand back the same instance
+  char tmpl[] = "/tmp/mesh_sim_XXXXXX";
+  if (mkdtemp(tmpl) == nullptr) {
+    error = "mkdtemp failed";
+    return false;
+  }
+  tmp_dir_ = tmpl;
+
+  for (uint32_t i = 0; i < config_.helmets; i++) {
+    node_t &n = nodes_[i];
+    n.app.path = tmp_dir_ + "/app_" + std::to_string(i) + ".so";
+
+    std::error_code ec;
+    std::filesystem::copy_file(config_.app_module, n.app.path, ec);
+    if (ec) {
+      error = config_.app_module + ": " + ec.message();
+      return false;
+    }
+    if (!load_app(n, error))
+      return false;
+
+    uint64_t boot_ms = config_.boot_stagger_ms ? (rng_() % config_.boot_stagger_ms) : 0;
+    schedule(boot_ms * 1000, event_type_t::boot, n.index);
+  }
+
+  // Crystal error of every helmet, then of every anchor but the gateway,
+  // drawn from its own generator so the deployment and traffic of a seed
+  // stay the same whatever clock_ppm is
+  std::mt19937_64 clock_rng(config_.seed ^ 0x5eedc10cull);
+  std::uniform_real_distribution<double> ppm(-config_.clock_ppm, config_.clock_ppm);
+  for (uint32_t i = 0; i < config_.helmets; i++)
+    nodes_[i].clock_rate = 1.0 + ppm(clock_rng) * 1e-6;
+  for (uint32_t i = config_.helmets + 1; i < total; i++)
+    nodes_[i].clock_rate = 1.0 + ppm(clock_rng) * 1e-6;
+
+  // The first anchor is the gateway, the others pass its time on with the
+  // helmet's timesync.c, they only hear it on the helmets' group
+  if (config_.time_ref_ms) {
+    for (uint32_t i = config_.helmets + 1; i < total; i++) {
+      node_t &n = nodes_[i];
+      n.app.path = tmp_dir_ + "/anchor_" + std::to_string(i) + ".so";
+
+      std::error_code ec;
+      std::filesystem::copy_file(config_.app_module, n.app.path, ec);
+      if (ec) {
+        error = config_.app_module + ": " + ec.message();
+        return false;
+      }
+      if (!load_app(n, error))
+        return false;
+      if (n.app.timesync_init)
+        n.app.timesync_init();
+      n.subs.push_back(SIM_STATUS_GRP_ADDR);
+    }
+
+    schedule((uint64_t)config_.time_ref_ms * 1000, event_type_t::time_ref, (uint16_t)config_.helmets);
+    schedule((uint64_t)config_.sync_probe_ms * 1000, event_type_t::sync_probe, (uint16_t)config_.helmets);
+  }
+
+  if (config_.alarm_helmet >= 0 && (uint32_t)config_.alarm_helmet < config_.helmets)
+    schedule((uint64_t)config_.alarm_at_ms * 1000, event_type_t::alarm, (uint16_t)config_.alarm_helmet);
+
+  if (!config_.capture_path.empty()) {
+    capture_header_t header;
+    header.flags = CAPTURE_FROM_SIM;
+    if (!capture_.open(config_.capture_path, header, error))
+      return false;
+  }
+
+  if (config_.replay) {
+    if (config_.replay_helmets.size() != config_.helmets) {
+      error = "replay needs one captured address per helmet";
+      return false;
+    }
+    for (uint32_t i = 0; i < config_.helmets; i++)
+      replay_node_[config_.replay_helmets[i]] = (uint16_t)i;
+    replay_alarm_us_.assign(config_.helmets, -1);
+    replay_wall_start_ = std::chrono::steady_clock::now();
+    if (!config_.replay->empty())
+      schedule((uint64_t)config_.replay_offset_ms * 1000 + config_.replay->front().t_us, event_type_t::replay, 0, 0);
+  }
+
+  return true;
+}
+
+bool mesh_sim::load_app(node_t &n, std::string &error)
+{
+  n.app.lib = dlopen(n.app.path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (n.app.lib == nullptr) {
+    error = dlerror();
+    return false;
+  }
+
+  n.app.app_init           = (void (*)(void))dlsym(n.app.lib, "app_init");
+  n.app.app_process_action = (void (*)(void))dlsym(n.app.lib, "app_process_action");
+  n.app.on_bt_event        = (sim_event_handler_t)dlsym(n.app.lib, "sl_bt_on_event");
+  n.app.on_mesh_event      = (sim_event_handler_t)dlsym(n.app.lib, "sl_btmesh_on_event");
+
+  if (!n.app.app_init || !n.app.app_process_action || !n.app.on_bt_event || !n.app.on_mesh_event) {
+    error = n.app.path + ": missing app_init/app_process_action/sl_bt_on_event/sl_btmesh_on_event";
+    return false;
+  }
+
+  n.app.timesync_init      = (void (*)(void))dlsym(n.app.lib, "timesync_init");
+  n.app.timesync_reference = (void (*)(uint64_t, const uint8_t *, uint8_t))dlsym(n.app.lib, "timesync_reference");
+  n.app.timesync_forward   = (bool (*)(uint64_t, const uint8_t *, uint8_t, uint8_t *))dlsym(n.app.lib, "timesync_forward");
+  n.app.timesync_synced    = (bool (*)(void))dlsym(n.app.lib, "timesync_synced");
+  n.app.timesync_network_ms = (uint32_t (*)(uint64_t))dlsym(n.app.lib, "timesync_network_ms");
+
+  return true;
+}
+
+void mesh_sim::unload_app(node_t &n)
+{
+  if (n.app.lib != nullptr) {
+    dlclose(n.app.lib);
+    n.app.lib = nullptr;
+  }
+}
+
+uint16_t mesh_sim::identity_address_of(const node_t &n) const
+{
+  return (uint16_t)(SIM_HELMET_BASE_ADDR + n.index);
+}
+
+/*
+ * Event loop
+ */
+void mesh_sim::schedule(uint64_t time_us, event_type_t type, uint16_t node, uint32_t arg, void *timer)
+{
+  event_t ev;
+  ev.time_us = time_us;
+  ev.order = order_++;
+  ev.type = type;
+  ev.node = node;
+  ev.incarnation = nodes_[node].incarnation;
+  ev.arg = arg;
+  ev.timer = timer;
+  events_.push(ev);
+}
+
+void mesh_sim::run()
+{
+  uint64_t end_us = (uint64_t)config_.duration_ms * 1000;
+
+  while (!events_.empty() && !aborted_) {
+    event_t ev = events_.top();
+    if (ev.time_us > end_us)
+      break;
+    events_.pop();
+
+    now_us_ = ev.time_us;
+    events_processed_++;
+    dispatch(ev);
+  }
+
+  now_us_ = end_us;
+  capture_.close();
+}
+
+void mesh_sim::enter(uint16_t node)
+{
+  current_ = node;
+}
+
+void mesh_sim::dispatch(const event_t &ev)
+{
+  node_t &n = nodes_[ev.node];
+  bool current = (ev.incarnation == n.incarnation);
+  bool running = current && n.state == node_state_t::running;
+
+  switch (ev.type) {
+    case event_type_t::boot:
+      if (current)
+        on_boot(n);
+      break;
+
+    case event_type_t::mesh_initialized:
+      if (running)
+        on_mesh_initialized(n);
+      break;
+
+    case event_type_t::timer:
+    case event_type_t::sleeptimer:
+      if (running) {
+        enter(n.index);
+        bool fired = (ev.type == event_type_t::timer) ? sim_dispatch_timer(ev.timer, ev.arg)
+                                                      : sim_dispatch_sleeptimer(ev.timer, ev.arg);
+        if (fired)
+          n.stats.timer_wakeups++;
+        n.app.app_process_action();
+      }
+      break;
+
+    case event_type_t::tx_service:
+      n.service_pending = false;
+      radio_kick(n);
+      break;
+
+    case event_type_t::tx_end:
+      on_tx_end(n, ev.arg);
+      break;
+
+    case event_type_t::rx_end:
+      on_rx_end(n, ev.arg);
+      break;
+
+    case event_type_t::reload:
+      on_reload(n);
+      break;
+
+    case event_type_t::friend_establish:
+      if (running)
+        on_friend_establish(n);
+      break;
+
+    case event_type_t::friend_poll:
+      if (running)
+        on_friend_poll(n);
+      break;
+
+    case event_type_t::friend_deliver:
+      if (running) {
+        on_friend_deliver(n, ev.arg);
+      }
+      else {
+        rx_free_.push_back(ev.arg);
+      }
+      break;
+
+    case event_type_t::alarm:
+      on_alarm(n);
+      break;
+
+    case event_type_t::time_ref:
+      on_time_ref(n);
+      break;
+
+    case event_type_t::sync_probe:
+      on_sync_probe();
+      break;
+
+    case event_type_t::replay:
+      on_replay(ev.arg);
+      break;
+
+    case event_type_t::sensors_ready:
+      // The main loop polls the init steps, it isn't asleep meanwhile
+      if (running) {
+        enter(n.index);
+        n.app.app_process_action();
+      }
+      break;
+  }
+}
+
+/*
+ * Node life cycle
+ */
+void mesh_sim::on_boot(node_t &n)
+{
+  n.state = node_state_t::running;
+  if (n.boot_us == 0 && n.stats.resets == 0)
+    n.boot_us = now_us_;
+
+  enter(n.index);
+  n.app.app_init();
+  sim_dispatch_boot(n.app.on_bt_event);
+  n.app.app_process_action();
+}
+
+void mesh_sim::on_mesh_initialized(node_t &n)
+{
+  n.mesh_ready = true;
+
+  enter(n.index);
+  sim_dispatch_node_initialized(n.app.on_mesh_event, n.provisioned, n.address, 0);
+  n.app.app_process_action();
+
+  if (config_.lpn && n.provisioned && n.state == node_state_t::running && !n.friend_established)
+    schedule(now_us_ + (uint64_t)config_.friend_find_ms * 1000, event_type_t::friend_establish, n.index);
+}
+
+void mesh_sim::on_reload(node_t &n)
+{
+  unload_app(n);
+
+  if (n.prov_pending) {
+    n.provisioned = true;
+    n.address = n.prov_pending_address;
+    n.prov_pending = false;
+  }
+
+  n.state = node_state_t::off;
+  n.incarnation++;
+  n.mesh_ready = false;
+  n.model_ready = false;
+  n.pub_set = false;
+  n.sensors_ready_us = 0;
+  std::fill(n.cache.begin(), n.cache.end(), 0);
+  n.app_q.clear();
+  n.relay_q.clear();
+  n.sync_q.clear();
+
+  if (n.friend_of >= 0) {
+    std::vector<uint16_t> &lpns = nodes_[n.friend_of].lpns;
+    lpns.erase(std::remove(lpns.begin(), lpns.end(), n.index), lpns.end());
+    n.friend_of = -1;
+  }
+  n.friend_established = false;
+  n.friend_queue.clear();
+
+  std::string error;
+  if (!load_app(n, error)) {
+    fprintf(stderr, "mesh_sim: reload of helmet %u failed: %s\n", n.index, error.c_str());
+    aborted_ = true;
+    return;
+  }
+
+  schedule(now_us_ + SIM_BOOT_TIME_MS * 1000, event_type_t::boot, n.index);
+}
+
+void mesh_sim::on_alarm(node_t &n)
+{
+  n.gas_alarm = true;
+  alarm_injected_ = true;
+  alarm_injected_us_ = now_us_;
+}
+
+/*
+ * Time sync. The gateway stamps its reference when it hands it to the
+ * stack, the probe compares what every helmet would stamp now with the
+ * gateway time.
+ */
+void mesh_sim::on_time_ref(node_t &gateway)
+{
+  uint8_t payload[TIMESYNC_REF_LEN];
+
+  timesync_put_u32(payload, (uint32_t)(now_us_ / 1000));
+  payload[4] = time_ref_round_++;
+  if (node_send(gateway, SIM_STATUS_GRP_ADDR, 0, time_ref, sizeof(payload), payload) == SL_STATUS_OK)
+    refs_sent_++;
+
+  schedule(now_us_ + (uint64_t)config_.time_ref_ms * 1000, event_type_t::time_ref, gateway.index);
+}
+
+void mesh_sim::on_sync_probe()
+{
+  uint32_t gateway_ms = (uint32_t)(now_us_ / 1000);
+
+  for (uint32_t i = 0; i < config_.helmets; i++) {
+    node_t &n = nodes_[i];
+    if (n.state != node_state_t::running || !n.app.timesync_synced || !n.app.timesync_synced())
+      continue;
+
+    // timer_service_now_ms() of the helmet
+    uint64_t local_ms = local_us(n) * SIM_SLEEPTIMER_HZ / 1000000 * 1000 / SIM_SLEEPTIMER_HZ;
+    int32_t error = (int32_t)(n.app.timesync_network_ms(local_ms) - gateway_ms);
+    sync_samples_.push_back({ now_us_, (double)error });
+  }
+
+  schedule(now_us_ + (uint64_t)config_.sync_probe_ms * 1000, event_type_t::sync_probe, (uint16_t)config_.helmets);
+}
+
+/*
+ * Replay. A record goes to the helmets it would have reached had they heard
+ * what the gateway heard, captured helmet addresses are mapped to the
+ * simulated ones.
+ */
+void mesh_sim::on_replay(uint32_t index)
+{
+  const std::vector<capture_record_t> &records = *config_.replay;
+  const capture_record_t &rec = records[index];
+  uint64_t offset_us = (uint64_t)config_.replay_offset_ms * 1000;
+
+  if (config_.replay_speed > 0.0) {
+    auto due = replay_wall_start_ + std::chrono::microseconds((int64_t)(rec.t_us / config_.replay_speed));
+    std::this_thread::sleep_until(due);
+  }
+
+  pdu_t pdu{};
+  auto src = replay_node_.find(rec.src);
+  auto dst = replay_node_.find(rec.dst);
+  pdu.src = src != replay_node_.end() ? identity_address_of(nodes_[src->second]) : rec.src;
+  pdu.dst = dst != replay_node_.end() ? identity_address_of(nodes_[dst->second]) : rec.dst;
+  pdu.hops = (rec.flags & CAPTURE_NONRELAYED) ? 0 : 1;
+  pdu.opcode = rec.opcode;
+  pdu.len = rec.len <= SIM_MAX_PAYLOAD ? rec.len : SIM_MAX_PAYLOAD;
+  memcpy(pdu.payload, rec.payload, pdu.len);
+  pdu.origin_us = now_us_;
+  int8_t rssi = rec.rssi == CAPTURE_RSSI_UNKNOWN ? config_.anchor_rssi : rec.rssi;
+
+  for (uint32_t i = 0; i < config_.helmets; i++) {
+    node_t &n = nodes_[i];
+    if (n.state != node_state_t::running || pdu.src == n.address)
+      continue;
+    if (pdu.dst == n.address || subscribed(n, pdu.dst)) {
+      deliver(n, pdu, rssi);
+      replay_delivered_++;
+    }
+  }
+
+  if (index + 1 < records.size())
+    schedule(offset_us + records[index + 1].t_us, event_type_t::replay, 0, index + 1);
+}
+
+void mesh_sim::halt(node_t &n)
+{
+  n.state = node_state_t::halted;
+  n.app_q.clear();
+  n.relay_q.clear();
+  n.sync_q.clear();
+}
+
+/*
+ * Stub layer entry points, current node
+ */
+uint64_t mesh_sim::local_us(const node_t &n) const
+{
+  if (!n.helmet)
+    return (uint64_t)(now_us_ * n.clock_rate);
+  return (uint64_t)((now_us_ - n.boot_us) * n.clock_rate);
+}
+
+uint64_t mesh_sim::local_now_us() const
+{
+  return local_us(nodes_[current_]);
+}
+
+uint16_t mesh_sim::identity_address() const
+{
+  return identity_address_of(nodes_[current_]);
+}
+
+void mesh_sim::node_init()
+{
+  schedule(now_us_ + SIM_MESH_INIT_MS * 1000, event_type_t::mesh_initialized, (uint16_t)current_);
+}
+
+uint16_t mesh_sim::set_provisioning_data(uint16_t address)
+{
+  node_t &n = nodes_[current_];
+  if (n.provisioned)
+    return SL_STATUS_INVALID_STATE;
+
+  // Like the GSDK, the data is stored and only used after the next reset
+  n.prov_pending = true;
+  n.prov_pending_address = address;
+  return SL_STATUS_OK;
+}
+
+void mesh_sim::node_reset()
+{
+  node_t &n = nodes_[current_];
+  n.provisioned = false;
+  n.address = 0;
+  n.prov_pending = false;
+  n.app_key = false;
+  n.app_bound = false;
+  n.pub_address = 0;
+  n.pub_ttl = 0;
+  n.subs.clear();
+  n.relay = false;
+  n.relay_count = n.relay_interval = 0;
+  n.nettx_count = n.nettx_interval = 0;
+  n.seq = 0;
+}
+
+void mesh_sim::system_reset()
+{
+  node_t &n = nodes_[current_];
+  if (n.state == node_state_t::resetting)
+    return;
+
+  // The module can't be unloaded while its code is on the stack
+  n.state = node_state_t::resetting;
+  n.stats.resets++;
+  schedule(now_us_, event_type_t::reload, n.index);
+}
+
+uint16_t mesh_sim::get_local_model_pub(uint16_t *pub_address, uint8_t *ttl) const
+{
+  const node_t &n = nodes_[current_];
+  *pub_address = n.pub_address;
+  *ttl = n.pub_ttl;
+  return n.pub_address ? SL_STATUS_OK : SL_STATUS_BT_MESH_DOES_NOT_EXIST;
+}
+
+uint16_t mesh_sim::nvm_save(uint16_t key, size_t len, const uint8_t *value)
+{
+  if (key < SIM_NVM_KEY_FIRST || key > SIM_NVM_KEY_LAST)
+    return SL_STATUS_INVALID_KEY;
+  if (len > SIM_NVM_VALUE_MAX)
+    return SL_STATUS_COMMAND_TOO_LONG;
+
+  nodes_[current_].nvm[key].assign(value, value + len);
+  return SL_STATUS_OK;
+}
+
+uint16_t mesh_sim::nvm_load(uint16_t key, size_t max_len, size_t *len, uint8_t *value) const
+{
+  const node_t &n = nodes_[current_];
+  auto it = n.nvm.find(key);
+  if (it == n.nvm.end())
+    return SL_STATUS_BT_PS_KEY_NOT_FOUND;
+  if (it->second.size() > max_len)
+    return SL_STATUS_WOULD_OVERFLOW;
+
+  std::copy(it->second.begin(), it->second.end(), value);
+  *len = it->second.size();
+  return SL_STATUS_OK;
+}
+
+uint16_t mesh_sim::nvm_erase(uint16_t key)
+{
+  return nodes_[current_].nvm.erase(key) ? SL_STATUS_OK : SL_STATUS_BT_PS_KEY_NOT_FOUND;
+}
+
+uint16_t mesh_sim::add_local_key()
+{
+  node_t &n = nodes_[current_];
+  if (!n.provisioned)
+    return SL_STATUS_BT_MESH_NOT_INITIALIZED;
+  if (n.app_key)
+    return SL_STATUS_BT_MESH_ALREADY_EXISTS;
+
+  n.app_key = true;
+  return SL_STATUS_OK;
+}
+
+uint16_t mesh_sim::bind_local_model_app()
+{
+  node_t &n = nodes_[current_];
+  if (!n.app_key)
+    return SL_STATUS_BT_MESH_DOES_NOT_EXIST;
+
+  n.app_bound = true;
+  return SL_STATUS_OK;
+}
+
+uint16_t mesh_sim::set_local_model_pub(uint16_t pub_address, uint8_t ttl)
+{
+  node_t &n = nodes_[current_];
+  if (!n.app_bound)
+    return SL_STATUS_BT_MESH_APP_KEY_NOT_BOUND;
+
+  n.pub_address = pub_address;
+  n.pub_ttl = ttl;
+  return SL_STATUS_OK;
+}
+
+uint16_t mesh_sim::add_local_model_sub(uint16_t sub_address)
+{
+  node_t &n = nodes_[current_];
+  if (subscribed(n, sub_address))
+    return SL_STATUS_OK;
+  if (n.subs.size() >= SL_BTMESH_CONFIG_MAX_SUBSCRIPTIONS)
+    return SL_STATUS_BT_MESH_LIMIT_REACHED;
+
+  n.subs.push_back(sub_address);
+  return SL_STATUS_OK;
+}
+
+uint16_t mesh_sim::set_relay(uint8_t enabled, uint8_t count, uint8_t interval)
+{
+  node_t &n = nodes_[current_];
+  n.relay = enabled != 0;
+  n.relay_count = count;
+  n.relay_interval = interval;
+  return SL_STATUS_OK;
+}
+
+uint16_t mesh_sim::set_nettx(uint8_t count, uint8_t interval)
+{
+  node_t &n = nodes_[current_];
+  n.nettx_count = count;
+  n.nettx_interval = interval;
+  return SL_STATUS_OK;
+}
+
+uint16_t mesh_sim::vendor_model_init(uint16_t vendor_id, uint16_t model_id)
+{
+  node_t &n = nodes_[current_];
+  if (vendor_id != MY_VENDOR_ID || model_id != MY_MODEL_CLIENT_ID)
+    return SL_STATUS_BT_MESH_FOUNDATION_INVALID_MODEL;
+  if (n.model_ready)
+    return SL_STATUS_BT_MESH_ALREADY_INITIALIZED;
+
+  n.model_ready = true;
+  return SL_STATUS_OK;
+}
+
+uint16_t mesh_sim::set_publication(uint8_t opcode, size_t len, const uint8_t *payload)
+{
+  node_t &n = nodes_[current_];
+  if (!n.model_ready)
+    return SL_STATUS_BT_MESH_NOT_INITIALIZED;
+  if (len > SIM_MAX_PAYLOAD)
+    return SL_STATUS_INVALID_PARAMETER;
+
+  n.pub_msg.opcode = opcode;
+  n.pub_msg.len = (uint8_t)len;
+  if (len)
+    memcpy(n.pub_msg.payload, payload, len);
+  n.pub_set = true;
+  return SL_STATUS_OK;
+}
+
+uint16_t mesh_sim::publish()
+{
+  node_t &n = nodes_[current_];
+  if (!n.pub_set)
+    return SL_STATUS_INVALID_STATE;
+
+  return node_publish(n, n.pub_msg.opcode, n.pub_msg.len, n.pub_msg.payload);
+}
+
+// Nonrelayed goes out with TTL 0, for the radio neighbourhood only
+uint16_t mesh_sim::send(uint16_t dst, uint8_t nonrelayed, uint8_t opcode, size_t len, const uint8_t *payload)
+{
+  node_t &n = nodes_[current_];
+  if (!n.model_ready)
+    return SL_STATUS_BT_MESH_NOT_INITIALIZED;
+  if (len > SIM_MAX_PAYLOAD)
+    return SL_STATUS_INVALID_PARAMETER;
+
+  return node_send(n, dst, nonrelayed ? 0 : SIM_DEFAULT_TTL, opcode, len, payload);
+}
+
+// Timeouts are in helmet clock time, rounded up so a timer never expires
+// before its tick
+void mesh_sim::timer_schedule(void *timer, uint32_t generation, uint32_t timeout_ms)
+{
+  uint64_t timeout_us = (uint64_t)std::ceil(timeout_ms * 1000.0 / nodes_[current_].clock_rate) + 1;
+  schedule(now_us_ + timeout_us, event_type_t::timer, (uint16_t)current_, generation, timer);
+}
+
+void mesh_sim::sleeptimer_schedule(void *timer, uint32_t generation, uint64_t timeout_us)
+{
+  timeout_us = (uint64_t)std::ceil(timeout_us / nodes_[current_].clock_rate) + 1;
+  schedule(now_us_ + timeout_us, event_type_t::sleeptimer, (uint16_t)current_, generation, timer);
+}
+
+void mesh_sim::em_requirement(int em, bool add)
+{
+  if (em != 2)
+    return;
+
+  node_stats_t &s = nodes_[current_].stats;
+  s.em2_requirements += add ? 1 : -1;
+  s.em2_requirements_max = std::max(s.em2_requirements_max, s.em2_requirements);
+}
+
+void mesh_sim::sensor_read(sim_sensor_values_t *values) const
+{
+  const node_t &n = nodes_[current_];
+
+  values->temp = 24;
+  values->humidity = 45;
+  values->acc[0] = 12;
+  values->acc[1] = -30;
+  values->acc[2] = 1000;
+  values->gyro[0] = values->gyro[1] = values->gyro[2] = 0;
+  values->gas = n.gas_alarm ? SIM_EMERGENCY_GAS_OHM : SIM_CLEAN_GAS_OHM;
+  values->pressure = 1013;
+}
+
+void mesh_sim::sensor_init_start()
+{
+  node_t &n = nodes_[current_];
+  n.sensors_ready_us = now_us_ + (uint64_t)config_.sensor_init_ms * 1000;
+  schedule(n.sensors_ready_us, event_type_t::sensors_ready, n.index);
+}
+
+bool mesh_sim::sensor_init_done() const
+{
+  return now_us_ >= nodes_[current_].sensors_ready_us;
+}
+
+void mesh_sim::emergency_state()
+{
+  node_t &n = nodes_[current_];
+  if (!n.in_emergency) {
+    n.in_emergency = true;
+    n.emergency_us = now_us_;
+  }
+
+  if (config_.halt_on_emergency)
+    halt(n);
+}
+
+void mesh_sim::log_count()
+{
+  nodes_[current_].stats.log_calls++;
+}
+
+void mesh_sim::log_prefix() const
+{
+  printf("%10.3f h%03u: ", now_us_ / 1000.0, (unsigned)current_);
+}
+
+void mesh_sim::assert_failed(const char *file, int line, uint32_t sc)
+{
+  fprintf(stderr, "mesh_sim: helmet %d assert at %s:%d, status 0x%04x, t=%.3f ms\n",
+          current_, file, line, (unsigned)sc, now_us_ / 1000.0);
+  halt(nodes_[current_]);
+  aborted_ = true;
+}
+
+/*
+ * Network layer
+ */
+uint16_t mesh_sim::node_publish(node_t &n, uint8_t opcode, size_t len, const uint8_t *payload)
+{
+  if (n.state != node_state_t::running || !n.mesh_ready || !n.provisioned)
+    return SL_STATUS_BT_MESH_NOT_INITIALIZED;
+  if (!n.app_bound || n.pub_address == 0)
+    return SL_STATUS_BT_MESH_PUBLISH_NOT_CONFIGURED;
+
+  return node_send(n, n.pub_address, n.pub_ttl, opcode, len, payload);
+}
+
+uint16_t mesh_sim::node_send(node_t &n, uint16_t dst, uint8_t ttl, uint8_t opcode, size_t len,
+                             const uint8_t *payload)
+{
+  if (n.state != node_state_t::running || !n.mesh_ready || !n.provisioned)
+    return SL_STATUS_BT_MESH_NOT_INITIALIZED;
+  if (!n.app_bound)
+    return SL_STATUS_BT_MESH_APP_KEY_NOT_BOUND;
+
+  if (config_.replay && n.helmet) {
+    n.stats.publications++;
+    replay_published_++;
+    if (n.first_publish_us == 0)
+      n.first_publish_us = now_us_;
+    if (opcode == set_emergency && replay_alarm_us_[n.index] < 0)
+      replay_alarm_us_[n.index] = (int64_t)now_us_;
+    return SL_STATUS_OK;
+  }
+
+  pdu_t pdu;
+  pdu.src = n.address;
+  pdu.dst = dst;
+  pdu.seq = ++n.seq;
+  pdu.ttl = ttl;
+  pdu.hops = 0;
+  pdu.opcode = opcode;
+  pdu.len = (uint8_t)len;
+  if (len)
+    memcpy(pdu.payload, payload, len);
+  pdu.origin_us = now_us_;
+
+  if (!enqueue_tx(n, pdu, false)) {
+    n.stats.publish_errors++;
+    return SL_STATUS_NO_MORE_RESOURCE;
+  }
+
+  n.stats.publications++;
+  if (n.first_publish_us == 0)
+    n.first_publish_us = now_us_;
+  if (n.index == config_.helmets)
+    capture_pdu(pdu, CAPTURE_RSSI_UNKNOWN);
+  if (n.helmet && opcode == set_emergency && first_set_emergency_node_ < 0) {
+    first_set_emergency_node_ = n.index;
+    first_set_emergency_us_ = now_us_;
+  }
+
+  return SL_STATUS_OK;
+}
+
+/*
+ * The gateway keeps one slot for its own time_ref, outside the app queue
+ * the get_rssi answers fill up. A reference that is still waiting is
+ * replaced by the newer one, and a ready reference goes out before
+ * anything else: each reference queued behind others is one more held up
+ * reference for the helmets to filter out.
+ */
+bool mesh_sim::enqueue_tx(node_t &n, const pdu_t &pdu, bool relay)
+{
+  bool sync = !relay && pdu.opcode == time_ref && n.index == config_.helmets;
+  std::deque<tx_item_t> &q = sync ? n.sync_q : relay ? n.relay_q : n.app_q;
+  if (sync)
+    q.clear();
+  else if (q.size() >= (relay ? config_.relay_txq : config_.app_txq)) {
+    if (relay)
+      n.stats.relay_txq_overflow++;
+    else
+      n.stats.app_txq_overflow++;
+    return false;
+  }
+
+  tx_item_t item;
+  item.pdu = pdu;
+  item.id = next_item_id_++;
+  item.ready_us = now_us_ + adv_delay_us();
+  item.relay = relay;
+  if (relay) {
+    item.remaining = n.relay_count + 1;
+    item.interval_us = (n.relay_interval + 1) * 10000;
+  }
+  else {
+    item.remaining = n.nettx_count + 1;
+    item.interval_us = (n.nettx_interval + 1) * 10000;
+  }
+  q.push_back(item);
+
+  n.stats.txq_high_water = std::max(n.stats.txq_high_water, (uint32_t)(n.app_q.size() + n.relay_q.size()));
+
+  radio_kick(n);
+  return true;
+}
+
+void mesh_sim::radio_kick(node_t &n)
+{
+  if (n.tx_active || n.state != node_state_t::running)
+    return;
+
+  tx_item_t *next = nullptr;
+  if (!n.sync_q.empty() && n.sync_q.front().ready_us <= now_us_) {
+    next = &n.sync_q.front();
+  }
+  else {
+    for (auto *q : { &n.sync_q, &n.app_q, &n.relay_q }) {
+      for (tx_item_t &item : *q) {
+        if (next == nullptr || item.ready_us < next->ready_us)
+          next = &item;
+      }
+    }
+  }
+  if (next == nullptr)
+    return;
+
+  if (next->ready_us > now_us_) {
+    if (!n.service_pending || n.service_at_us > next->ready_us) {
+      n.service_pending = true;
+      n.service_at_us = next->ready_us;
+      schedule(next->ready_us, event_type_t::tx_service, n.index);
+    }
+    return;
+  }
+
+  uint32_t duration = pdu_event_us(next->pdu.len);
+
+  n.tx_active = true;
+  n.stats.tx_events++;
+  n.stats.tx_airtime_us += pdu_airtime_us(next->pdu.len);
+  if (next->pdu.opcode == time_ref)
+    sync_airtime_us_ += pdu_airtime_us(next->pdu.len);
+  if (next->relay)
+    n.stats.relayed++;
+
+  // Half duplex, our own transmission kills whatever we were receiving
+  if (n.rx_end_us > now_us_)
+    rx_pool_[n.rx_current].corrupted = true;
+
+  next->ready_us = now_us_ + next->interval_us;
+
+  for (const link_t &link : n.links)
+    receive_start(nodes_[link.to], next->pdu, link.mean_rssi, duration);
+
+  schedule(now_us_ + duration, event_type_t::tx_end, n.index, next->id);
+}
+
+void mesh_sim::on_tx_end(node_t &n, uint32_t item_id)
+{
+  n.tx_active = false;
+
+  for (auto *q : { &n.sync_q, &n.app_q, &n.relay_q }) {
+    for (auto it = q->begin(); it != q->end(); ++it) {
+      if (it->id != item_id)
+        continue;
+      if (--it->remaining == 0)
+        q->erase(it);
+      else
+        it->ready_us = std::max(it->ready_us, now_us_) + adv_delay_us();
+      radio_kick(n);
+      return;
+    }
+  }
+
+  radio_kick(n);
+}
+
+void mesh_sim::receive_start(node_t &r, const pdu_t &pdu, float mean_rssi, uint64_t duration_us)
+{
+  if (!scanning(r))
+    return;
+
+  float rssi = mean_rssi + shadow_(rng_);
+  if (rssi < config_.sensitivity_dbm) {
+    r.stats.rx_weak++;
+    return;
+  }
+  if (r.tx_active) {
+    r.stats.rx_half_duplex++;
+    return;
+  }
+
+  uint32_t id = alloc_rx();
+  reception_t &rx = rx_pool_[id];
+  rx.pdu = pdu;
+  rx.rssi = (int8_t)std::max(-128.0f, std::min(127.0f, std::round(rssi)));
+  rx.corrupted = false;
+
+  // Overlapping receptions destroy each other, no capture effect
+  if (r.rx_end_us > now_us_) {
+    rx_pool_[r.rx_current].corrupted = true;
+    rx.corrupted = true;
+  }
+  if (now_us_ + duration_us > r.rx_end_us) {
+    r.rx_end_us = now_us_ + duration_us;
+    r.rx_current = id;
+  }
+
+  schedule(now_us_ + duration_us, event_type_t::rx_end, r.index, id);
+}
+
+void mesh_sim::on_rx_end(node_t &r, uint32_t rx_id)
+{
+  reception_t rx = rx_pool_[rx_id];
+  rx_free_.push_back(rx_id);
+
+  if (rx.corrupted) {
+    r.stats.rx_collision++;
+    return;
+  }
+  if (scanning(r))
+    network_receive(r, rx.pdu, rx.rssi, false);
+}
+
+void mesh_sim::network_receive(node_t &r, const pdu_t &pdu, int8_t rssi, bool from_friend)
+{
+  if (pdu.src == r.address)
+    return;
+
+  uint64_t key = ((uint64_t)pdu.src << 32) | pdu.seq;
+  if (std::find(r.cache.begin(), r.cache.end(), key) != r.cache.end()) {
+    r.stats.rx_duplicate++;
+    return;
+  }
+  r.cache[r.cache_next] = key;
+  r.cache_next = (r.cache_next + 1) % r.cache.size();
+  r.stats.rx_ok++;
+
+  // The gateway's NCP, everything it decodes is captured
+  if (r.index == config_.helmets)
+    capture_pdu(pdu, rssi);
+
+  // Friend side, keep what the LPNs we serve are interested in
+  for (uint16_t l : r.lpns) {
+    node_t &lpn = nodes_[l];
+    if (pdu.src == lpn.address || (pdu.dst != lpn.address && !subscribed(lpn, pdu.dst)))
+      continue;
+    if (lpn.friend_queue.size() >= config_.friend_queue) {
+      lpn.friend_queue.pop_front(); // the oldest entry is discarded
+      r.stats.friend_queue_overflow++;
+    }
+    lpn.friend_queue.push_back(pdu);
+    r.stats.friend_queue_high_water = std::max(r.stats.friend_queue_high_water,
+                                               (uint32_t)lpn.friend_queue.size());
+  }
+
+  // The stack queues the relay before the application sees the message
+  if (!from_friend && r.relay && pdu.ttl >= 2 && pdu.dst != r.address &&
+      !(config_.lpn && r.friend_established)) {
+    pdu_t relayed = pdu;
+    relayed.ttl--;
+    relayed.hops++;
+    enqueue_tx(r, relayed, true);
+  }
+
+  if (pdu.dst == r.address || subscribed(r, pdu.dst))
+    deliver(r, pdu, rssi);
+}
+
+void mesh_sim::capture_pdu(const pdu_t &pdu, int8_t rssi)
+{
+  if (!capture_.is_open())
+    return;
+
+  capture_record_t rec;
+  rec.t_us = now_us_;
+  rec.src = pdu.src;
+  rec.dst = pdu.dst;
+  rec.opcode = pdu.opcode;
+  rec.rssi = rssi;
+  rec.flags = (uint8_t)((pdu.hops == 0 ? CAPTURE_NONRELAYED : 0) |
+                        (pdu.dst == SIM_STATUS_GRP_ADDR ? CAPTURE_CLIENT_MODEL : 0));
+  rec.len = pdu.len;
+  memcpy(rec.payload, pdu.payload, pdu.len);
+  capture_.write(rec);
+}
+
+void mesh_sim::deliver(node_t &r, const pdu_t &pdu, int8_t rssi)
+{
+  if (!r.helmet) {
+    anchor_receive(r, pdu, rssi);
+    return;
+  }
+  if (!r.model_ready || !r.app_bound)
+    return;
+
+  sim_vendor_msg_t msg;
+  msg.source_address = pdu.src;
+  msg.destination_address = pdu.dst;
+  msg.opcode = pdu.opcode;
+  msg.nonrelayed = pdu.hops == 0;
+  msg.len = pdu.len;
+  memcpy(msg.payload, pdu.payload, pdu.len);
+
+  enter(r.index);
+  sim_dispatch_vendor_receive(r.app.on_mesh_event, MY_VENDOR_ID, MY_MODEL_CLIENT_ID, &msg);
+  r.app.app_process_action();
+
+  if (pdu.opcode == time_ref && r.first_sync_us == 0 && r.app.timesync_synced && r.app.timesync_synced())
+    r.first_sync_us = now_us_;
+}
+
+void mesh_sim::anchor_receive(node_t &a, const pdu_t &pdu, int8_t rssi)
+{
+  uint8_t value;
+
+  switch (pdu.opcode) {
+    case get_rssi:
+      value = (uint8_t)(config_.anchor_rssi_fixed ? config_.anchor_rssi : rssi);
+      node_publish(a, get_rssi_status, 1, &value);
+      break;
+
+    case get_emergency:
+      node_publish(a, get_emergency_status, 1, &a.emergency);
+      break;
+
+    case time_ref:
+      if (a.app.timesync_reference && a.app.timesync_forward) {
+        uint64_t local_ms = local_us(a) / 1000;
+        uint8_t ref[TIMESYNC_REF_LEN];
+
+        a.app.timesync_reference(local_ms, pdu.payload, pdu.len);
+        if (a.app.timesync_forward(local_ms, pdu.payload, pdu.len, ref))
+          node_send(a, SIM_STATUS_GRP_ADDR, 0, time_ref, sizeof(ref), ref);
+      }
+      break;
+
+    case set_emergency:
+      // Stamped with the network time the sensors were read at
+      if (pdu.len >= TIMESYNC_STAMP_LEN && pdu.payload[4] != TIMESYNC_UNSYNCED)
+        alarm_stamp_errors_.push_back((double)(int32_t)(timesync_get_u32(pdu.payload) - (uint32_t)(pdu.origin_us / 1000)));
+      if (!a.emergency) {
+        a.emergency = 1;
+        if (first_anchor_emergency_us_ == 0)
+          first_anchor_emergency_us_ = now_us_;
+      }
+      node_publish(a, set_emergency_status, 1, &a.emergency);
+      break;
+
+    default:
+      break;
+  }
+}
+
+bool mesh_sim::scanning(const node_t &n) const
+{
+  return n.state == node_state_t::running && n.mesh_ready && n.provisioned &&
+         !(config_.lpn && n.friend_established);
+}
+
+bool mesh_sim::subscribed(const node_t &n, uint16_t dst) const
+{
+  return std::find(n.subs.begin(), n.subs.end(), dst) != n.subs.end();
+}
+
+/*
+ * Friendship. Friend traffic is accounted for in airtime but not run
+ * through the collision model.
+ */
+void mesh_sim::on_friend_establish(node_t &lpn)
+{
+  if (lpn.friend_established)
+    return;
+
+  const link_t *best = nullptr;
+  for (const link_t &link : lpn.links) {
+    const node_t &f = nodes_[link.to];
+    if (f.helmet || f.state != node_state_t::running || f.lpns.size() >= config_.max_friendships)
+      continue;
+    if (best == nullptr || link.mean_rssi > best->mean_rssi)
+      best = &link;
+  }
+
+  enter(lpn.index);
+  if (best == nullptr) {
+    lpn.stats.friend_failures++;
+    sim_dispatch_friendship_failed(lpn.app.on_mesh_event, (uint16_t)SL_STATUS_BT_MESH_NO_FRIEND_OFFER);
+    lpn.app.app_process_action();
+    schedule(now_us_ + (uint64_t)config_.friend_find_ms * 1000, event_type_t::friend_establish, lpn.index);
+    return;
+  }
+
+  node_t &f = nodes_[best->to];
+  f.lpns.push_back(lpn.index);
+  lpn.friend_of = f.index;
+  lpn.friend_established = true;
+  if (lpn.friend_established_us == 0)
+    lpn.friend_established_us = now_us_;
+
+  sim_dispatch_friendship_established(lpn.app.on_mesh_event, f.address);
+  lpn.app.app_process_action();
+
+  schedule(now_us_ + (uint64_t)config_.poll_ms * 1000, event_type_t::friend_poll, lpn.index);
+}
+
+void mesh_sim::on_friend_poll(node_t &lpn)
+{
+  if (!lpn.friend_established)
+    return;
+
+  node_t &f = nodes_[lpn.friend_of];
+  lpn.stats.tx_events++;
+  lpn.stats.tx_airtime_us += pdu_airtime_us(0);
+
+  if (lpn.friend_queue.empty()) {
+    f.stats.tx_events++;
+    f.stats.tx_airtime_us += pdu_airtime_us(0); // Friend Update
+    schedule(now_us_ + (uint64_t)config_.poll_ms * 1000, event_type_t::friend_poll, lpn.index);
+    return;
+  }
+
+  uint32_t id = alloc_rx();
+  reception_t &rx = rx_pool_[id];
+  rx.pdu = lpn.friend_queue.front();
+  rx.corrupted = false;
+  rx.rssi = 0;
+  for (const link_t &link : lpn.links) {
+    if (link.to == f.index)
+      rx.rssi = (int8_t)std::round(link.mean_rssi);
+  }
+  lpn.friend_queue.pop_front();
+
+  f.stats.tx_events++;
+  f.stats.tx_airtime_us += pdu_airtime_us(rx.pdu.len);
+
+  schedule(now_us_ + (uint64_t)config_.receive_delay_ms * 1000 + pdu_event_us(rx.pdu.len),
+           event_type_t::friend_deliver, lpn.index, id);
+}
+
+void mesh_sim::on_friend_deliver(node_t &lpn, uint32_t rx_id)
+{
+  reception_t rx = rx_pool_[rx_id];
+  rx_free_.push_back(rx_id);
+
+  network_receive(lpn, rx.pdu, rx.rssi, true);
+  if (lpn.state != node_state_t::running)
+    return;
+
+  // More data pending, poll again right away
+  uint64_t next = lpn.friend_queue.empty() ? (uint64_t)config_.poll_ms * 1000 : 0;
+  schedule(now_us_ + next, event_type_t::friend_poll, lpn.index);
+}
+
+/*
+ * Helpers
+ */
+uint32_t mesh_sim::alloc_rx()
+{
+  if (!rx_free_.empty()) {
+    uint32_t id = rx_free_.back();
+    rx_free_.pop_back();
+    return id;
+  }
+  rx_pool_.emplace_back();
+  return (uint32_t)(rx_pool_.size() - 1);
+}
+
+// Over the air size of one (segment of a) network PDU carrying a vendor
+// message of len bytes, plus the number of segments needed
+static void pdu_layout(uint8_t len, uint32_t *ll_bytes, uint32_t *segments)
+{
+  uint32_t access = SIM_VENDOR_OPCODE_BYTES + len;
+  uint32_t transport;
+
+  if (access <= SIM_UNSEG_ACCESS_MAX) {
+    *segments = 1;
+    transport = 1 + access + SIM_TRANS_MIC_BYTES;
+  }
+  else {
+    *segments = (access + SIM_TRANS_MIC_BYTES + SIM_SEG_ACCESS_BYTES - 1) / SIM_SEG_ACCESS_BYTES;
+    transport = SIM_SEG_HEADER_BYTES + SIM_SEG_ACCESS_BYTES;
+  }
+
+  uint32_t network = SIM_NET_HEADER_BYTES + transport + SIM_NET_MIC_BYTES;
+  *ll_bytes = SIM_LL_OVERHEAD_BYTES + SIM_AD_HEADER_BYTES + network;
+}
+
+uint32_t mesh_sim::pdu_airtime_us(uint8_t len) const
+{
+  uint32_t ll_bytes, segments;
+  pdu_layout(len, &ll_bytes, &segments);
+  return segments * SIM_ADV_CHANNELS * ll_bytes * 8; // 1 Mbit/s
+}
+
+uint32_t mesh_sim::pdu_event_us(uint8_t len) const
+{
+  uint32_t ll_bytes, segments;
+  pdu_layout(len, &ll_bytes, &segments);
+  return segments * (SIM_ADV_CHANNELS * ll_bytes * 8 + (SIM_ADV_CHANNELS - 1) * SIM_ADV_CHANNEL_SWITCH_US);
+}
+
+uint32_t mesh_sim::adv_delay_us()
+{
+  return (uint32_t)(rng_() % SIM_ADV_DELAY_MAX_US);
+}
+
+/*
+ * Report
+ */
+static double percentile(std::vector<double> &v, double p)
+{
+  if (v.empty())
+    return 0.0;
+  std::sort(v.begin(), v.end());
+  size_t idx = (size_t)std::min((double)(v.size() - 1), std::floor(p * (v.size() - 1) + 0.5));
+  return v[idx];
+}
+
+mesh_sim_sync_t mesh_sim::sync_summary() const
+{
+  mesh_sim_sync_t r;
+  double duration_s = config_.duration_ms / 1000.0;
+  std::vector<double> first_sync, abs_error, alarm;
+
+  r.refs_sent = refs_sent_;
+  r.airtime_ms_per_s = sync_airtime_us_ / 1e3 / duration_s;
+
+  for (uint32_t i = 0; i < config_.helmets; i++) {
+    const node_t &n = nodes_[i];
+    if (n.first_sync_us == 0)
+      continue;
+    r.helmets_synced++;
+    first_sync.push_back((n.first_sync_us - n.boot_us) / 1000.0);
+  }
+  r.first_sync_median_ms = percentile(first_sync, 0.5);
+
+  // Steady state, the second half of the run
+  uint64_t from_us = (uint64_t)config_.duration_ms * 500;
+  double sum = 0.0;
+  for (const sync_sample_t &s : sync_samples_) {
+    if (s.time_us < from_us)
+      continue;
+    sum += s.error_ms;
+    abs_error.push_back(std::fabs(s.error_ms));
+  }
+  r.samples = abs_error.size();
+  if (r.samples) {
+    r.bias_ms = sum / r.samples;
+    r.abs_median_ms = percentile(abs_error, 0.5);
+    r.abs_p95_ms = percentile(abs_error, 0.95);
+    r.abs_max_ms = percentile(abs_error, 1.0);
+  }
+
+  for (double e : alarm_stamp_errors_)
+    alarm.push_back(std::fabs(e));
+  r.alarm_stamps = (uint32_t)alarm.size();
+  r.alarm_abs_max_ms = percentile(alarm, 1.0);
+
+  return r;
+}
+
+mesh_sim_replay_t mesh_sim::replay_summary() const
+{
+  mesh_sim_replay_t r;
+  int64_t offset_us = (int64_t)config_.replay_offset_ms * 1000;
+
+  r.records = config_.replay ? config_.replay->size() : 0;
+  r.delivered = replay_delivered_;
+  r.published = replay_published_;
+  for (uint32_t i = 0; i < config_.helmets && config_.replay; i++) {
+    const node_t &n = nodes_[i];
+    int64_t alarm = replay_alarm_us_[i];
+    r.first_alarm_ms.push_back(alarm < 0 ? -1 : (alarm - offset_us) / 1000);
+    r.emergency_ms.push_back(n.in_emergency ? ((int64_t)n.emergency_us - offset_us) / 1000 : -1);
+  }
+  return r;
+}
+
+void mesh_sim::report(FILE *out) const
+{
+  double duration_s = config_.duration_ms / 1000.0;
+  node_stats_t h{}, a{};
+  std::vector<double> boot_to_publish, latency;
+  uint32_t reached = 0, em2_overflow = 0, lpn_with_friend = 0;
+  int32_t  em2_max = 0;
+  uint64_t helmet_logs = 0;
+  uint64_t helmet_wakeups = 0;
+  double   busiest_node = 0.0, busiest_area = 0.0;
+
+  for (const node_t &n : nodes_) {
+    node_stats_t &t = n.helmet ? h : a;
+    t.tx_events += n.stats.tx_events;
+    t.tx_airtime_us += n.stats.tx_airtime_us;
+    t.publications += n.stats.publications;
+    t.publish_errors += n.stats.publish_errors;
+    t.relayed += n.stats.relayed;
+    t.rx_ok += n.stats.rx_ok;
+    t.rx_duplicate += n.stats.rx_duplicate;
+    t.rx_collision += n.stats.rx_collision;
+    t.rx_half_duplex += n.stats.rx_half_duplex;
+    t.rx_weak += n.stats.rx_weak;
+    t.app_txq_overflow += n.stats.app_txq_overflow;
+    t.relay_txq_overflow += n.stats.relay_txq_overflow;
+    t.friend_queue_overflow += n.stats.friend_queue_overflow;
+    t.friend_failures += n.stats.friend_failures;
+    t.resets += n.stats.resets;
+    t.txq_high_water = std::max(t.txq_high_water, n.stats.txq_high_water);
+    t.friend_queue_high_water = std::max(t.friend_queue_high_water, n.stats.friend_queue_high_water);
+
+    busiest_node = std::max(busiest_node, n.stats.tx_airtime_us / (duration_s * 1e6));
+    double area = (double)n.stats.tx_airtime_us;
+    for (const link_t &link : n.links)
+      area += nodes_[link.to].stats.tx_airtime_us;
+    busiest_area = std::max(busiest_area, area / (duration_s * 1e6));
+
+    if (!n.helmet)
+      continue;
+
+    helmet_logs += n.stats.log_calls;
+    helmet_wakeups += n.stats.timer_wakeups;
+    em2_max = std::max(em2_max, n.stats.em2_requirements_max);
+    if (n.stats.em2_requirements_max > UINT8_MAX)
+      em2_overflow++;
+    if (n.friend_established)
+      lpn_with_friend++;
+    if (n.first_publish_us)
+      boot_to_publish.push_back((n.first_publish_us - n.boot_us) / 1000.0);
+    if (n.in_emergency) {
+      reached++;
+      if (first_set_emergency_node_ >= 0)
+        latency.push_back(((double)n.emergency_us - (double)first_set_emergency_us_) / 1000.0);
+    }
+  }
+
+  fprintf(out, "deployment     %u helmets, %u anchors, %s, %.0f m spacing\n", config_.helmets,
+          config_.anchors, config_.grid ? "grid" : "tunnel", config_.anchor_spacing_m);
+  fprintf(out, "mode           %s, %s, %s\n", config_.lpn ? "LPN helmets" : "relay helmets",
+          config_.provisioned ? "pre-provisioned" : "self-provisioning",
+          config_.anchor_rssi_fixed ? "fixed anchor RSSI" : "measured anchor RSSI");
+  fprintf(out, "simulated      %.1f s, %llu events\n", duration_s, (unsigned long long)events_processed_);
+  if (aborted_)
+    fprintf(out, "               ABORTED, see assert above\n");
+
+  fprintf(out, "\nboot\n");
+  fprintf(out, "  resets                   %u\n", h.resets);
+  fprintf(out, "  sensor init              %u ms\n", config_.sensor_init_ms);
+  fprintf(out, "  boot to first publish    median %.0f ms, max %.0f ms (%zu/%u helmets)\n",
+          percentile(boot_to_publish, 0.5), percentile(boot_to_publish, 1.0),
+          boot_to_publish.size(), config_.helmets);
+
+  fprintf(out, "\ntraffic                    helmets      anchors\n");
+  fprintf(out, "  publications         %11llu  %11llu\n", (unsigned long long)h.publications, (unsigned long long)a.publications);
+  fprintf(out, "  transmissions        %11llu  %11llu\n", (unsigned long long)h.tx_events, (unsigned long long)a.tx_events);
+  fprintf(out, "  relay transmissions  %11llu  %11llu\n", (unsigned long long)h.relayed, (unsigned long long)a.relayed);
+  fprintf(out, "  received             %11llu  %11llu\n", (unsigned long long)h.rx_ok, (unsigned long long)a.rx_ok);
+  fprintf(out, "  duplicates (cache)   %11llu  %11llu\n", (unsigned long long)h.rx_duplicate, (unsigned long long)a.rx_duplicate);
+  fprintf(out, "  lost, collision      %11llu  %11llu\n", (unsigned long long)h.rx_collision, (unsigned long long)a.rx_collision);
+  fprintf(out, "  lost, half duplex    %11llu  %11llu\n", (unsigned long long)h.rx_half_duplex, (unsigned long long)a.rx_half_duplex);
+  fprintf(out, "  lost, below sens.    %11llu  %11llu\n", (unsigned long long)h.rx_weak, (unsigned long long)a.rx_weak);
+
+  fprintf(out, "\nairtime\n");
+  fprintf(out, "  total on air             %.1f s (%.1f ms/s)\n",
+          (h.tx_airtime_us + a.tx_airtime_us) / 1e6, (h.tx_airtime_us + a.tx_airtime_us) / 1e3 / duration_s);
+  fprintf(out, "  busiest node             %.1f %% duty cycle\n", busiest_node * 100.0);
+  fprintf(out, "  busiest neighbourhood    %.1f %% of the channel\n", busiest_area * 100.0);
+
+  fprintf(out, "\nqueues                     helmets      anchors\n");
+  fprintf(out, "  app txq overflow     %11llu  %11llu  (size %u, publish errors)\n",
+          (unsigned long long)h.app_txq_overflow, (unsigned long long)a.app_txq_overflow, config_.app_txq);
+  fprintf(out, "  relay txq overflow   %11llu  %11llu  (size %u)\n",
+          (unsigned long long)h.relay_txq_overflow, (unsigned long long)a.relay_txq_overflow, config_.relay_txq);
+  fprintf(out, "  txq high water       %11u  %11u\n", h.txq_high_water, a.txq_high_water);
+  if (config_.lpn) {
+    fprintf(out, "  friend queue overflow %10llu  %11llu  (size %u)\n",
+            (unsigned long long)h.friend_queue_overflow, (unsigned long long)a.friend_queue_overflow, config_.friend_queue);
+    fprintf(out, "  friendships              %u/%u helmets, %u failed attempts\n",
+            lpn_with_friend, config_.helmets, h.friend_failures);
+  }
+
+  fprintf(out, "\nalarm\n");
+  if (alarm_injected_)
+    fprintf(out, "  injected                 helmet %d gas at %.0f ms\n", config_.alarm_helmet, alarm_injected_us_ / 1000.0);
+  if (first_set_emergency_node_ >= 0) {
+    fprintf(out, "  first set_emergency      helmet %d at %.0f ms%s\n", first_set_emergency_node_,
+            first_set_emergency_us_ / 1000.0,
+            (!alarm_injected_ || first_set_emergency_us_ < alarm_injected_us_) ? " (not the injected alarm)" : "");
+    if (first_anchor_emergency_us_)
+      fprintf(out, "  first anchor latched     %.1f ms later\n",
+              (first_anchor_emergency_us_ - first_set_emergency_us_) / 1000.0);
+    fprintf(out, "  helmets in emergency     %u/%u\n", reached, config_.helmets);
+    std::vector<double> l = latency;
+    if (!l.empty())
+      fprintf(out, "  propagation latency      min %.1f, median %.1f, p95 %.1f, max %.1f ms\n",
+              percentile(l, 0.0), percentile(l, 0.5), percentile(l, 0.95), percentile(l, 1.0));
+  }
+  else {
+    fprintf(out, "  no set_emergency published\n");
+  }
+
+  if (config_.time_ref_ms) {
+    mesh_sim_sync_t sync = sync_summary();
+    fprintf(out, "\ntime sync\n");
+    fprintf(out, "  references               %llu every %u ms, %.2f ms/s on air with relays\n",
+            (unsigned long long)sync.refs_sent, config_.time_ref_ms, sync.airtime_ms_per_s);
+    fprintf(out, "  helmets synced           %u/%u, median %.0f ms after boot\n",
+            sync.helmets_synced, config_.helmets, sync.first_sync_median_ms);
+    if (sync.samples)
+      fprintf(out, "  error, second half       bias %.1f, |error| median %.1f, p95 %.1f, max %.1f ms\n",
+              sync.bias_ms, sync.abs_median_ms, sync.abs_p95_ms, sync.abs_max_ms);
+    if (sync.alarm_stamps)
+      fprintf(out, "  alarm stamps             %u checked, max |error| %.1f ms\n",
+              sync.alarm_stamps, sync.alarm_abs_max_ms);
+  }
+
+  fprintf(out, "\nhelmet firmware\n");
+  fprintf(out, "  app_log calls            %.0f per helmet per second\n", helmet_logs / (duration_s * config_.helmets));
+  fprintf(out, "  timer wakeups            %.2f per helmet per second\n", helmet_wakeups / (duration_s * config_.helmets));
+  fprintf(out, "  EM2 requirements held    max %d%s\n", em2_max,
+          em2_overflow ? " (over UINT8_MAX, sl_power_manager would assert)" : "");
+  if (em2_overflow)
+    fprintf(out, "                           on %u helmets\n", em2_overflow);
+}
+
+} // namespace lpedt
+
+/*
+ * sim_api.h, core side
+ */
+using lpedt::g_sim;
+
+extern "C" {
+
+uint64_t sim_now_us(void) { return g_sim->local_now_us(); }
+uint16_t sim_identity_address(void) { return g_sim->identity_address(); }
+void     sim_node_init(void) { g_sim->node_init(); }
+uint16_t sim_set_provisioning_data(uint16_t address, uint16_t netkey_index, uint32_t iv_index)
+{
+  (void)netkey_index;
+  (void)iv_index;
+  return g_sim->set_provisioning_data(address);
+}
+void     sim_node_reset(void) { g_sim->node_reset(); }
+void     sim_system_reset(void) { g_sim->system_reset(); }
+uint16_t sim_get_local_model_pub(uint16_t *pub_address, uint8_t *ttl) { return g_sim->get_local_model_pub(pub_address, ttl); }
+uint16_t sim_add_local_key(uint16_t key_index) { (void)key_index; return g_sim->add_local_key(); }
+uint16_t sim_bind_local_model_app(uint16_t appkey_index) { (void)appkey_index; return g_sim->bind_local_model_app(); }
+uint16_t sim_set_local_model_pub(uint16_t pub_address, uint8_t ttl) { return g_sim->set_local_model_pub(pub_address, ttl); }
+uint16_t sim_add_local_model_sub(uint16_t sub_address) { return g_sim->add_local_model_sub(sub_address); }
+uint16_t sim_set_relay(uint8_t enabled, uint8_t count, uint8_t interval) { return g_sim->set_relay(enabled, count, interval); }
+uint16_t sim_set_nettx(uint8_t count, uint8_t interval) { return g_sim->set_nettx(count, interval); }
+uint16_t sim_nvm_save(uint16_t key, size_t len, const uint8_t *value) { return g_sim->nvm_save(key, len, value); }
+uint16_t sim_nvm_load(uint16_t key, size_t max_len, size_t *len, uint8_t *value) { return g_sim->nvm_load(key, max_len, len, value); }
+uint16_t sim_nvm_erase(uint16_t key) { return g_sim->nvm_erase(key); }
+uint16_t sim_vendor_model_init(uint16_t vendor_id, uint16_t model_id) { return g_sim->vendor_model_init(vendor_id, model_id); }
+uint16_t sim_set_publication(uint8_t opcode, size_t len, const uint8_t *payload) { return g_sim->set_publication(opcode, len, payload); }
+uint16_t sim_publish(void) { return g_sim->publish(); }
+uint16_t sim_send(uint16_t dst, uint8_t nonrelayed, uint8_t opcode, size_t len, const uint8_t *payload) { return g_sim->send(dst, nonrelayed, opcode, len, payload); }
+void     sim_timer_schedule(void *timer, uint32_t generation, uint32_t timeout_ms) { g_sim->timer_schedule(timer, generation, timeout_ms); }
+void     sim_sleeptimer_schedule(void *timer, uint32_t generation, uint64_t timeout_us) { g_sim->sleeptimer_schedule(timer, generation, timeout_us); }
+void     sim_em_requirement(int em, int add) { g_sim->em_requirement(em, add != 0); }
+void     sim_sensor_init_start(void) { g_sim->sensor_init_start(); }
+int      sim_sensor_init_done(void) { return g_sim->sensor_init_done(); }
+void     sim_sensor_read(sim_sensor_values_t *values) { g_sim->sensor_read(values); }
+void     sim_emergency_state(void) { g_sim->emergency_state(); }
+int      sim_log_verbose(void) { return g_sim->log_verbose(); }
+void     sim_log_count(void) { g_sim->log_count(); }
+void     sim_log_prefix(void) { g_sim->log_prefix(); }
+void     sim_assert_failed(const char *file, int line, uint32_t sc) { g_sim->assert_failed(file, line, sc); }
+
+} // extern "C"
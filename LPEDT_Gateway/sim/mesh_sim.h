@@ -0,0 +1,463 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    mesh_sim.h
+ * @brief   Discrete-event Bluetooth mesh simulator for helmet deployments.
+ *
+ *          Every helmet runs the real client app.c. The application is built
+ *          as a loadable module and loaded once per helmet so each node has
+ *          its own copy of the file scope state. It links against the stubbed
+ *          SDK in sim_stubs.c. Anchors run a native model of the server side
+ *          of the vendor model (get_rssi, get_emergency, set_emergency).
+ *
+ *          The network layer models advertising bearer airtime, nettx and
+ *          relay retransmissions, TTL, the network message cache, bounded
+ *          application/relay transmit queues, collisions and half duplex at
+ *          the receivers, and optionally Low Power Node friend queues.
+ *
+ *          Helmet and anchor clocks run at their own crystal error. With
+ *          time_ref_ms set the first anchor acts as the gateway and sends
+ *          its time, the other anchors pass it on like the helmets do, with
+ *          the timesync.c of a private copy of the application module, and
+ *          the network time estimate of every helmet (timesync.h) is
+ *          sampled against the gateway.
+ *
+ *          capture_path makes the first anchor, the gateway, write every
+ *          vendor message it hears, and what it publishes itself, to a
+ *          mesh_capture.h file. With replay set
+ *          the helmets get the records of a capture instead of a network:
+ *          each record is handed to every helmet it is addressed to, or that
+ *          subscribes to its group, at its captured time. What the helmets
+ *          publish is counted but not transmitted.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef LPEDT_GATEWAY_MESH_SIM_H_
+#define LPEDT_GATEWAY_MESH_SIM_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <queue>
+#include <random>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh_capture.h"
+#include "sim_api.h"
+
+namespace lpedt {
+
+struct mesh_sim_config_t {
+  // Deployment
+  uint32_t helmets          = 20;
+  uint32_t anchors          = 6;
+  float    anchor_spacing_m = 40.0f;
+  float    tunnel_width_m   = 5.0f;
+  bool     grid             = false;  // false: anchors along a tunnel, true: square grid
+  uint32_t duration_ms      = 30000;
+  uint32_t boot_stagger_ms  = 1000;   // helmets power up uniformly over this window
+  bool     provisioned      = false;  // helmets boot already self-provisioned
+  uint32_t sensor_init_ms   = 760;    // Sensors_Init_Start() to ready, the BMI270
+                                      // 8 KB config upload at 100 kbit/s
+
+  // Injected alarm, the helmet's gas resistance drops, its gas index goes over GAS_MAX
+  int32_t  alarm_helmet     = 0;      // -1 disables the injected alarm
+  uint32_t alarm_at_ms      = 10000;
+
+  // Anchors answer get_rssi with a fixed value by default. With the measured
+  // RSSI every helmet further than ~10 m from an anchor sees less than -70 dBm
+  // and raises set_emergency itself, which hides the injected alarm.
+  bool     anchor_rssi_fixed = true;
+  int8_t   anchor_rssi       = -50;
+
+  // Time sync. The first anchor is the gateway, it publishes time_ref every
+  // time_ref_ms (0: never). Helmet crystals are off by a uniform +-clock_ppm.
+  uint32_t time_ref_ms      = 0;
+  float    clock_ppm        = 40.0f;
+  uint32_t sync_probe_ms    = 1000;   // network time of every helmet sampled
+
+  // Emergency_State() never returns on target, the node stops servicing the
+  // stack. Model that by halting the node, or let it keep running.
+  bool     halt_on_emergency = true;
+
+  // Low Power Node operation of the helmets
+  bool     lpn              = false;
+  uint32_t poll_ms;
+  uint32_t receive_delay_ms;
+  uint32_t friend_find_ms;
+  uint32_t friend_queue;
+  uint32_t max_friendships;
+
+  // Stack resources
+  uint32_t app_txq;
+  uint32_t relay_txq        = 8;
+  uint32_t net_cache;
+
+  // Radio
+  float    rssi_1m_dbm      = -59.0f;
+  float    path_loss_exp    = 2.7f;
+  float    shadowing_db     = 4.0f;
+  float    sensitivity_dbm  = -95.0f;
+
+  // Capture of what the gateway hears
+  std::string capture_path;
+
+  // Replay of a capture into the helmets. replay_helmets[i] is the captured
+  // address of helmet i, records start replay_offset_ms into the run, paced
+  // at replay_speed times real time (0: as fast as possible).
+  const std::vector<capture_record_t> *replay = nullptr;
+  std::vector<uint16_t> replay_helmets;
+  uint32_t    replay_offset_ms = 3000;
+  double      replay_speed  = 0.0;
+
+  uint32_t    seed          = 1;
+  bool        verbose       = false;
+  std::string app_module;
+
+  mesh_sim_config_t();
+};
+
+// Time sync results, errors in ms as estimate minus gateway time
+struct mesh_sim_sync_t {
+  uint64_t refs_sent = 0;
+  double   airtime_ms_per_s = 0.0;  // time_ref transmissions, relays included
+  uint32_t helmets_synced = 0;
+  double   first_sync_median_ms = 0.0;
+  uint64_t samples = 0;             // second half of the run
+  double   bias_ms = 0.0;
+  double   abs_median_ms = 0.0;
+  double   abs_p95_ms = 0.0;
+  double   abs_max_ms = 0.0;
+  uint32_t alarm_stamps = 0;        // set_emergency stamps checked at the gateway
+  double   alarm_abs_max_ms = 0.0;
+};
+
+// Replay results, times in ms of capture time, -1 if never
+struct mesh_sim_replay_t {
+  uint64_t records   = 0;
+  uint64_t delivered = 0;             // record deliveries to helmets
+  uint64_t published = 0;             // helmet publications, not transmitted
+  std::vector<int64_t> first_alarm_ms;      // first set_emergency per helmet
+  std::vector<int64_t> emergency_ms;        // Emergency_Mode() entry per helmet
+};
+
+class mesh_sim {
+public:
+  explicit mesh_sim(const mesh_sim_config_t &config);
+  ~mesh_sim();
+
+  /**
+   * @brief   Place the nodes, load one application instance per helmet
+   * @return  false with error set if the application module can't be loaded
+   */
+  bool setup(std::string &error);
+
+  void run();
+  void report(FILE *out) const;
+  mesh_sim_sync_t sync_summary() const;
+  mesh_sim_replay_t replay_summary() const;
+
+  // Entry points for the stub layer (sim_api.h), act on the current node
+  uint64_t now_us() const { return now_us_; }
+  uint64_t local_now_us() const;
+  uint16_t identity_address() const;
+  void     node_init();
+  uint16_t set_provisioning_data(uint16_t address);
+  void     node_reset();
+  void     system_reset();
+  uint16_t get_local_model_pub(uint16_t *pub_address, uint8_t *ttl) const;
+  uint16_t nvm_save(uint16_t key, size_t len, const uint8_t *value);
+  uint16_t nvm_load(uint16_t key, size_t max_len, size_t *len, uint8_t *value) const;
+  uint16_t nvm_erase(uint16_t key);
+  uint16_t add_local_key();
+  uint16_t bind_local_model_app();
+  uint16_t set_local_model_pub(uint16_t pub_address, uint8_t ttl);
+  uint16_t add_local_model_sub(uint16_t sub_address);
+  uint16_t set_relay(uint8_t enabled, uint8_t count, uint8_t interval);
+  uint16_t set_nettx(uint8_t count, uint8_t interval);
+  uint16_t vendor_model_init(uint16_t vendor_id, uint16_t model_id);
+  uint16_t set_publication(uint8_t opcode, size_t len, const uint8_t *payload);
+  uint16_t publish();
+  uint16_t send(uint16_t dst, uint8_t nonrelayed, uint8_t opcode, size_t len, const uint8_t *payload);
+  void     timer_schedule(void *timer, uint32_t generation, uint32_t timeout_ms);
+  void     sleeptimer_schedule(void *timer, uint32_t generation, uint64_t timeout_us);
+  void     em_requirement(int em, bool add);
+  void     sensor_init_start();
+  bool     sensor_init_done() const;
+  void     sensor_read(sim_sensor_values_t *values) const;
+  void     emergency_state();
+  bool     log_verbose() const { return config_.verbose; }
+  void     log_count();
+  void     log_prefix() const;
+  void     assert_failed(const char *file, int line, uint32_t sc);
+
+private:
+  enum class node_state_t : uint8_t { off, running, resetting, halted };
+
+  enum class event_type_t : uint8_t {
+    boot, mesh_initialized, timer, sleeptimer, tx_service, tx_end, rx_end, reload,
+    friend_establish, friend_poll, friend_deliver, alarm, time_ref, sync_probe, replay,
+    sensors_ready
+  };
+
+  struct event_t {
+    uint64_t     time_us;
+    uint64_t     order;
+    event_type_t type;
+    uint16_t     node;
+    uint32_t     incarnation;
+    uint32_t     arg;
+    void        *timer;
+
+    bool operator>(const event_t &o) const {
+      return time_us != o.time_us ? time_us > o.time_us : order > o.order;
+    }
+  };
+
+  struct pdu_t {
+    uint16_t src;
+    uint16_t dst;
+    uint32_t seq;
+    uint8_t  ttl;
+    uint8_t  hops;
+    uint8_t  opcode;
+    uint8_t  len;
+    uint8_t  payload[SIM_MAX_PAYLOAD];
+    uint64_t origin_us;   // published, for the checks of timestamps
+  };
+
+  struct tx_item_t {
+    pdu_t    pdu;
+    uint32_t id;
+    uint64_t ready_us;
+    uint32_t interval_us;
+    uint8_t  remaining;
+    bool     relay;
+  };
+
+  struct reception_t {
+    pdu_t  pdu;
+    int8_t rssi;
+    bool   corrupted;
+  };
+
+  struct link_t {
+    uint16_t to;
+    float    mean_rssi;
+  };
+
+  struct app_instance_t {
+    std::string path;
+    void *lib = nullptr;
+    void (*app_init)(void) = nullptr;
+    void (*app_process_action)(void) = nullptr;
+    sim_event_handler_t on_bt_event = nullptr;
+    sim_event_handler_t on_mesh_event = nullptr;
+
+    // timesync.h, absent from applications without it
+    void     (*timesync_init)(void) = nullptr;
+    void     (*timesync_reference)(uint64_t local_ms, const uint8_t *payload, uint8_t len) = nullptr;
+    bool     (*timesync_forward)(uint64_t local_ms, const uint8_t *payload, uint8_t len, uint8_t *out) = nullptr;
+    bool     (*timesync_synced)(void) = nullptr;
+    uint32_t (*timesync_network_ms)(uint64_t local_ms) = nullptr;
+  };
+
+  struct node_stats_t {
+    uint64_t tx_events = 0;
+    uint64_t tx_airtime_us = 0;
+    uint64_t publications = 0;
+    uint64_t publish_errors = 0;
+    uint64_t relayed = 0;
+    uint64_t rx_ok = 0;
+    uint64_t rx_duplicate = 0;
+    uint64_t rx_collision = 0;
+    uint64_t rx_half_duplex = 0;
+    uint64_t rx_weak = 0;
+    uint64_t app_txq_overflow = 0;
+    uint64_t relay_txq_overflow = 0;
+    uint64_t friend_queue_overflow = 0;
+    uint32_t friend_failures = 0;
+    uint32_t txq_high_water = 0;
+    uint32_t friend_queue_high_water = 0;
+    uint64_t log_calls = 0;
+    uint64_t timer_wakeups = 0;  // application timer expiries, each one an EM2 exit
+    uint32_t resets = 0;
+    int32_t  em2_requirements = 0;
+    int32_t  em2_requirements_max = 0;
+  };
+
+  struct node_t {
+    uint16_t index = 0;
+    bool     helmet = false;
+    float    x_m = 0.0f;
+    float    y_m = 0.0f;
+    std::vector<link_t> links;
+
+    // Survives a reset, what the stack keeps in NVM
+    bool     provisioned = false;
+    uint16_t address = 0;
+    bool     prov_pending = false;     // set_provisioning_data(), applied on reset
+    uint16_t prov_pending_address = 0;
+    bool     app_key = false;
+    bool     app_bound = false;
+    uint16_t pub_address = 0;
+    uint8_t  pub_ttl = 0;
+    std::vector<uint16_t> subs;
+    bool     relay = false;
+    uint8_t  relay_count = 0;
+    uint8_t  relay_interval = 0;
+    uint8_t  nettx_count = 0;
+    uint8_t  nettx_interval = 0;
+    uint32_t seq = 0;
+    std::map<uint16_t, std::vector<uint8_t>> nvm;  // sl_bt_nvm_* user keys
+
+    // Cleared on reset
+    node_state_t state = node_state_t::off;
+    uint32_t incarnation = 0;
+    bool     mesh_ready = false;
+    bool     model_ready = false;
+    bool     pub_set = false;
+    uint64_t sensors_ready_us = 0;   // Sensors_Init_Start() + sensor_init_ms
+    pdu_t    pub_msg{};
+    std::vector<uint64_t> cache;
+    size_t   cache_next = 0;
+    std::deque<tx_item_t> app_q;
+    std::deque<tx_item_t> relay_q;
+    std::deque<tx_item_t> sync_q;    // gateway time_ref, one slot, sent first
+    bool     tx_active = false;
+    bool     service_pending = false;
+    uint64_t service_at_us = 0;
+    uint64_t rx_end_us = 0;
+    uint32_t rx_current = 0;
+
+    // Friendship, friend_queue lives here but is owned by the friend
+    int32_t  friend_of = -1;            // LPN: index of its friend
+    std::vector<uint16_t> lpns;         // friend: the LPNs it serves
+    bool     friend_established = false;
+    uint64_t friend_established_us = 0;
+    std::deque<pdu_t> friend_queue;
+
+    // Anchor model
+    uint8_t  emergency = 0;
+
+    // Helmet sensors
+    bool     gas_alarm = false;
+
+    // Helmet clock, counts from the first boot at clock_rate. Anchors
+    // count from 0, the gateway's is network time.
+    double   clock_rate = 1.0;
+    uint64_t first_sync_us = 0;
+
+    // Timing of interest
+    uint64_t boot_us = 0;
+    uint64_t first_publish_us = 0;
+    uint64_t emergency_us = 0;
+    bool     in_emergency = false;
+
+    node_stats_t   stats;
+    app_instance_t app;
+  };
+
+  void schedule(uint64_t time_us, event_type_t type, uint16_t node, uint32_t arg = 0,
+                void *timer = nullptr);
+  void dispatch(const event_t &ev);
+  void enter(uint16_t node);
+
+  bool load_app(node_t &n, std::string &error);
+  void unload_app(node_t &n);
+
+  uint16_t identity_address_of(const node_t &n) const;
+
+  void on_boot(node_t &n);
+  void on_mesh_initialized(node_t &n);
+  void on_reload(node_t &n);
+  void on_alarm(node_t &n);
+  uint64_t local_us(const node_t &n) const;
+  void on_time_ref(node_t &gateway);
+  void on_sync_probe();
+  void on_replay(uint32_t index);
+  void capture_pdu(const pdu_t &pdu, int8_t rssi);
+  void halt(node_t &n);
+
+  uint16_t node_publish(node_t &n, uint8_t opcode, size_t len, const uint8_t *payload);
+  uint16_t node_send(node_t &n, uint16_t dst, uint8_t ttl, uint8_t opcode, size_t len, const uint8_t *payload);
+  bool     enqueue_tx(node_t &n, const pdu_t &pdu, bool relay);
+  void     radio_kick(node_t &n);
+  void     on_tx_end(node_t &n, uint32_t item_id);
+  void     receive_start(node_t &r, const pdu_t &pdu, float mean_rssi, uint64_t duration_us);
+  void     on_rx_end(node_t &r, uint32_t rx_id);
+  void     network_receive(node_t &r, const pdu_t &pdu, int8_t rssi, bool from_friend);
+  void     deliver(node_t &r, const pdu_t &pdu, int8_t rssi);
+  void     anchor_receive(node_t &a, const pdu_t &pdu, int8_t rssi);
+  bool     scanning(const node_t &n) const;
+  bool     subscribed(const node_t &n, uint16_t dst) const;
+
+  void on_friend_establish(node_t &lpn);
+  void on_friend_poll(node_t &lpn);
+  void on_friend_deliver(node_t &lpn, uint32_t rx_id);
+
+  uint32_t alloc_rx();
+  uint32_t pdu_event_us(uint8_t len) const;
+  uint32_t pdu_airtime_us(uint8_t len) const;
+  uint32_t adv_delay_us();
+
+  mesh_sim_config_t config_;
+  std::vector<node_t> nodes_;
+  std::priority_queue<event_t, std::vector<event_t>, std::greater<event_t>> events_;
+  std::vector<reception_t> rx_pool_;
+  std::vector<uint32_t> rx_free_;
+  std::mt19937_64 rng_;
+  std::normal_distribution<float> shadow_;
+  std::string tmp_dir_;
+
+  uint64_t now_us_ = 0;
+  uint64_t order_ = 0;
+  uint64_t events_processed_ = 0;
+  uint32_t next_item_id_ = 1;
+  int32_t  current_ = -1;
+  bool     aborted_ = false;
+
+  // Alarm bookkeeping
+  uint64_t alarm_injected_us_ = 0;
+  bool     alarm_injected_ = false;
+  uint64_t first_set_emergency_us_ = 0;
+  int32_t  first_set_emergency_node_ = -1;
+  uint64_t first_anchor_emergency_us_ = 0;
+
+  // Time sync bookkeeping
+  struct sync_sample_t {
+    uint64_t time_us;
+    double   error_ms;
+  };
+  uint64_t refs_sent_ = 0;
+  uint64_t sync_airtime_us_ = 0;
+  uint8_t  time_ref_round_ = 0;
+  std::vector<sync_sample_t> sync_samples_;
+  std::vector<double> alarm_stamp_errors_;
+
+  // Capture and replay
+  capture_writer capture_;
+  uint64_t replay_delivered_ = 0;
+  uint64_t replay_published_ = 0;
+  std::vector<int64_t> replay_alarm_us_;
+  std::unordered_map<uint16_t, uint16_t> replay_node_;   // captured helmet address to node
+  std::chrono::steady_clock::time_point replay_wall_start_;
+};
+
+} // namespace lpedt
+
+#endif /* LPEDT_GATEWAY_MESH_SIM_H_ */
@@ -0,0 +1,28 @@
+/*
+ * app_assert.h
+ *
+ *  Host stand-in for app_assert used by the mesh simulator. A failed assert
+ *  is reported against the node that was running and ends the simulation.
+ *
+ *      Author: vishn
+ */
+
+#ifndef SIM_SHIM_APP_ASSERT_H_
+#define SIM_SHIM_APP_ASSERT_H_
+
+#include "sl_status.h"
+#include "sim_api.h"
+
+#define app_assert(expr, ...) \
+  do { if (!(expr)) sim_assert_failed(__FILE__, __LINE__, SL_STATUS_FAIL); } while (0)
+
+#define app_assert_s(expr) \
+  do { if (!(expr)) sim_assert_failed(__FILE__, __LINE__, SL_STATUS_FAIL); } while (0)
+
+#define app_assert_status(sc) \
+  do { if ((sc) != SL_STATUS_OK) sim_assert_failed(__FILE__, __LINE__, (sc)); } while (0)
+
+#define app_assert_status_f(sc, ...) \
+  do { if ((sc) != SL_STATUS_OK) sim_assert_failed(__FILE__, __LINE__, (sc)); } while (0)
+
+#endif /* SIM_SHIM_APP_ASSERT_H_ */
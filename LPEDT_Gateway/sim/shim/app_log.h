@@ -0,0 +1,23 @@
+/*
+ * app_log.h
+ *
+ *  Host stand-in for app_log used by the mesh simulator. Log calls are
+ *  counted per node and only formatted when the simulator runs verbose.
+ *
+ *      Author: vishn
+ */
+
+#ifndef SIM_SHIM_APP_LOG_H_
+#define SIM_SHIM_APP_LOG_H_
+
+#include "sim_api.h"
+
+#define app_log(...)          sim_app_log(__VA_ARGS__)
+#define app_log_append(...)   sim_app_log(__VA_ARGS__)
+#define app_log_debug(...)    sim_app_log(__VA_ARGS__)
+#define app_log_info(...)     sim_app_log(__VA_ARGS__)
+#define app_log_warning(...)  sim_app_log(__VA_ARGS__)
+#define app_log_error(...)    sim_app_log(__VA_ARGS__)
+#define app_log_critical(...) sim_app_log(__VA_ARGS__)
+
+#endif /* SIM_SHIM_APP_LOG_H_ */
@@ -0,0 +1,13 @@
+/*
+ * em_cmu.h
+ *
+ *  Host stand-in for the emlib header of the same name, used by the mesh
+ *  simulator. Nothing from it is referenced by the application sources.
+ *
+ *      Author: vishn
+ */
+
+#ifndef SIM_SHIM_EM_CMU_H_
+#define SIM_SHIM_EM_CMU_H_
+
+#endif /* SIM_SHIM_EM_CMU_H_ */
@@ -0,0 +1,24 @@
+/*
+ * em_common.h
+ *
+ *  Host stand-in for the emlib header of the same name, used by the mesh
+ *  simulator. Only carries what the application sources use so they build
+ *  without the device/CMSIS headers.
+ *
+ *      Author: vishn
+ */
+
+#ifndef SIM_SHIM_EM_COMMON_H_
+#define SIM_SHIM_EM_COMMON_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SL_WEAK             __attribute__((weak))
+#define SL_UNUSED           __attribute__((unused))
+#define SL_ATTRIBUTE_PACKED __attribute__((packed))
+
+#define SL_MIN(a, b)        (((a) < (b)) ? (a) : (b))
+#define SL_MAX(a, b)        (((a) > (b)) ? (a) : (b))
+
+#endif /* SIM_SHIM_EM_COMMON_H_ */
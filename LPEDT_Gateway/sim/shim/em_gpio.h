@@ -0,0 +1,21 @@
+/*
+ * em_gpio.h
+ *
+ *  Host stand-in for emlib GPIO used by the mesh simulator. The application
+ *  only references the port names through app.h.
+ *
+ *      Author: vishn
+ */
+
+#ifndef SIM_SHIM_EM_GPIO_H_
+#define SIM_SHIM_EM_GPIO_H_
+
+typedef enum {
+  gpioPortA = 0,
+  gpioPortB = 1,
+  gpioPortC = 2,
+  gpioPortD = 3,
+  gpioPortF = 5,
+} GPIO_Port_TypeDef;
+
+#endif /* SIM_SHIM_EM_GPIO_H_ */
@@ -0,0 +1,62 @@
+/*
+ * sl_power_manager.h
+ *
+ *  Host stand-in for the power manager service used by the mesh simulator.
+ *  Requirements are tracked per node so the report can show the same
+ *  counters the real service keeps (and asserts on at UINT8_MAX).
+ *
+ *      Author: vishn
+ */
+
+#ifndef SIM_SHIM_SL_POWER_MANAGER_H_
+#define SIM_SHIM_SL_POWER_MANAGER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+  SL_POWER_MANAGER_EM0 = 0,
+  SL_POWER_MANAGER_EM1,
+  SL_POWER_MANAGER_EM2,
+  SL_POWER_MANAGER_EM3,
+  SL_POWER_MANAGER_EM4,
+} sl_power_manager_em_t;
+
+typedef enum {
+  SL_POWER_MANAGER_IGNORE = (1UL << 0),
+  SL_POWER_MANAGER_SLEEP  = (1UL << 1),
+  SL_POWER_MANAGER_WAKEUP = (1UL << 2),
+} sl_power_manager_on_isr_exit_t;
+
+#define SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM0     (1 << 0)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM0      (1 << 1)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM1     (1 << 2)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM1      (1 << 3)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM2     (1 << 4)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM2      (1 << 5)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM3     (1 << 6)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM3      (1 << 7)
+
+typedef uint32_t sl_power_manager_em_transition_event_t;
+
+typedef void (*sl_power_manager_em_transition_on_event_t)(sl_power_manager_em_t from,
+                                                          sl_power_manager_em_t to);
+
+typedef struct {
+  const sl_power_manager_em_transition_event_t event_mask;
+  const sl_power_manager_em_transition_on_event_t on_event;
+} sl_power_manager_em_transition_event_info_t;
+
+typedef struct {
+  void *node;
+  sl_power_manager_em_transition_event_info_t *info;
+} sl_power_manager_em_transition_event_handle_t;
+
+void sl_power_manager_add_em_requirement(sl_power_manager_em_t em);
+void sl_power_manager_remove_em_requirement(sl_power_manager_em_t em);
+
+// Nodes never sleep in the simulator, subscribers see no transitions
+void sl_power_manager_subscribe_em_transition_event(sl_power_manager_em_transition_event_handle_t *event_handle,
+                                                    const sl_power_manager_em_transition_event_info_t *event_info);
+
+#endif /* SIM_SHIM_SL_POWER_MANAGER_H_ */
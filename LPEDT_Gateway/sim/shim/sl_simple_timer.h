@@ -0,0 +1,41 @@
+/*
+ * sl_simple_timer.h
+ *
+ *  Host stand-in for the simple timer component used by the mesh simulator.
+ *  Same API as the SDK, expiries are scheduled on the simulated clock of the
+ *  node that started the timer.
+ *
+ *      Author: vishn
+ */
+
+#ifndef SIM_SHIM_SL_SIMPLE_TIMER_H_
+#define SIM_SHIM_SL_SIMPLE_TIMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sl_status.h"
+#include "sl_power_manager.h"
+
+typedef struct sl_simple_timer sl_simple_timer_t;
+
+typedef void (*sl_simple_timer_callback_t)(sl_simple_timer_t *timer, void *data);
+
+struct sl_simple_timer {
+  sl_simple_timer_callback_t callback;
+  void *callback_data;
+  uint32_t timeout_ms;
+  uint32_t generation; // bumped on every start/stop, stale expiries are ignored
+  bool periodic;
+  bool running;
+};
+
+sl_status_t sl_simple_timer_start(sl_simple_timer_t *timer,
+                                  uint32_t timeout_ms,
+                                  sl_simple_timer_callback_t callback,
+                                  void *callback_data,
+                                  bool is_periodic);
+
+sl_status_t sl_simple_timer_stop(sl_simple_timer_t *timer);
+
+#endif /* SIM_SHIM_SL_SIMPLE_TIMER_H_ */
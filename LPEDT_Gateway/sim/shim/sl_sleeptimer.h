@@ -0,0 +1,42 @@
+/*
+ * sl_sleeptimer.h
+ *
+ *  Host stand-in for the sleep timer service used by the mesh simulator,
+ *  ticks are derived from the simulated clock and timers expire on it.
+ *
+ *      Author: vishn
+ */
+
+#ifndef SIM_SHIM_SL_SLEEPTIMER_H_
+#define SIM_SHIM_SL_SLEEPTIMER_H_
+
+#include <stdint.h>
+
+#include "sl_status.h"
+
+#define SIM_SLEEPTIMER_HZ  (32768)
+
+typedef struct sl_sleeptimer_timer_handle sl_sleeptimer_timer_handle_t;
+
+typedef void (*sl_sleeptimer_timer_callback_t)(sl_sleeptimer_timer_handle_t *handle, void *data);
+
+struct sl_sleeptimer_timer_handle {
+  sl_sleeptimer_timer_callback_t callback;
+  void *callback_data;
+  uint32_t generation; // bumped on every start/stop, stale expiries are ignored
+  uint8_t running;
+};
+
+sl_status_t sl_sleeptimer_start_timer(sl_sleeptimer_timer_handle_t *handle,
+                                      uint32_t timeout,
+                                      sl_sleeptimer_timer_callback_t callback,
+                                      void *callback_data,
+                                      uint8_t priority,
+                                      uint16_t option_flags);
+sl_status_t sl_sleeptimer_stop_timer(sl_sleeptimer_timer_handle_t *handle);
+
+uint32_t sl_sleeptimer_get_tick_count(void);
+uint64_t sl_sleeptimer_get_tick_count64(void);
+uint32_t sl_sleeptimer_get_timer_frequency(void);
+
+#endif /* SIM_SHIM_SL_SLEEPTIMER_H_ */
@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    sim_api.h
+ * @brief   C interface between the stubbed SDK layer (sim_stubs.c), which is
+ *          built against the real BGAPI headers, and the simulator core
+ *          (mesh_sim.cpp). Everything the stubs need from the core acts on
+ *          the node that is currently running application code.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef LPEDT_GATEWAY_SIM_API_H_
+#define LPEDT_GATEWAY_SIM_API_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest vendor payload the simulator carries in one message
+#define SIM_MAX_PAYLOAD   (32)
+
+typedef struct {
+  uint16_t source_address;
+  uint16_t destination_address;
+  uint8_t  opcode;
+  uint8_t  nonrelayed;
+  uint8_t  len;
+  uint8_t  payload[SIM_MAX_PAYLOAD];
+} sim_vendor_msg_t;
+
+typedef struct {
+  int temp;
+  int humidity;
+  int acc[3];
+  int gyro[3];
+  int gas;
+  int pressure;
+} sim_sensor_values_t;
+
+/*
+ * Implemented by the core, called from the stub layer
+ */
+
+// Clock of the current node and identity
+uint64_t sim_now_us(void);
+uint16_t sim_identity_address(void);
+
+// Node / provisioning
+void     sim_node_init(void);
+uint16_t sim_set_provisioning_data(uint16_t address, uint16_t netkey_index, uint32_t iv_index);
+void     sim_node_reset(void);
+void     sim_system_reset(void);
+
+// Local configuration (sl_btmesh_test_*)
+uint16_t sim_get_local_model_pub(uint16_t *pub_address, uint8_t *ttl);
+uint16_t sim_add_local_key(uint16_t key_index);
+uint16_t sim_bind_local_model_app(uint16_t appkey_index);
+uint16_t sim_set_local_model_pub(uint16_t pub_address, uint8_t ttl);
+uint16_t sim_add_local_model_sub(uint16_t sub_address);
+uint16_t sim_set_relay(uint8_t enabled, uint8_t count, uint8_t interval);
+uint16_t sim_set_nettx(uint8_t count, uint8_t interval);
+
+// User NVM keys (sl_bt_nvm_*), kept across resets
+uint16_t sim_nvm_save(uint16_t key, size_t len, const uint8_t *value);
+uint16_t sim_nvm_load(uint16_t key, size_t max_len, size_t *len, uint8_t *value);
+uint16_t sim_nvm_erase(uint16_t key);
+
+// Vendor model
+uint16_t sim_vendor_model_init(uint16_t vendor_id, uint16_t model_id);
+uint16_t sim_set_publication(uint8_t opcode, size_t len, const uint8_t *payload);
+uint16_t sim_publish(void);
+uint16_t sim_send(uint16_t dst, uint8_t nonrelayed, uint8_t opcode, size_t len, const uint8_t *payload);
+
+// Timers, the core calls sim_dispatch_timer() / sim_dispatch_sleeptimer()
+// back on expiry
+void     sim_timer_schedule(void *timer, uint32_t generation, uint32_t timeout_ms);
+void     sim_sleeptimer_schedule(void *timer, uint32_t generation, uint64_t timeout_us);
+
+// Power manager
+void     sim_em_requirement(int em, int add);
+
+// Sensors.c replacements
+void     sim_sensor_init_start(void);    // done sensor_init_ms later
+int      sim_sensor_init_done(void);
+void     sim_sensor_read(sim_sensor_values_t *values);
+void     sim_emergency_state(void);
+
+// app_log / app_assert
+int      sim_log_verbose(void);
+void     sim_log_count(void);
+void     sim_log_prefix(void);
+void     sim_assert_failed(const char *file, int line, uint32_t sc);
+
+void     sim_app_log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/*
+ * Implemented by the stub layer, called from the core to enter the
+ * application of the node that is currently running
+ */
+typedef void (*sim_event_handler_t)(void *evt);
+
+void sim_dispatch_boot(sim_event_handler_t on_bt_event);
+void sim_dispatch_node_initialized(sim_event_handler_t on_mesh_event, uint8_t provisioned,
+                                   uint16_t address, uint32_t iv_index);
+void sim_dispatch_vendor_receive(sim_event_handler_t on_mesh_event, uint16_t vendor_id,
+                                 uint16_t model_id, const sim_vendor_msg_t *msg);
+void sim_dispatch_friendship_established(sim_event_handler_t on_mesh_event, uint16_t friend_address);
+void sim_dispatch_friendship_failed(sim_event_handler_t on_mesh_event, uint16_t reason);
+void sim_dispatch_friendship_terminated(sim_event_handler_t on_mesh_event, uint16_t reason);
+// Return non zero if the timer was still armed and its callback ran
+int  sim_dispatch_timer(void *timer, uint32_t generation);
+int  sim_dispatch_sleeptimer(void *timer, uint32_t generation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LPEDT_GATEWAY_SIM_API_H_ */
@@ -0,0 +1,565 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    sim_stubs.c
+ * @brief   Stubbed sl_bt_* / sl_btmesh_* / sl_simple_timer / power manager and
+ *          Sensors.c API the helmet application links against inside the mesh
+ *          simulator. Built against the real BGAPI headers so the events the
+ *          application sees have the exact SDK layout. Every call is forwarded
+ *          to the simulator core for the node that is currently running.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sl_status.h"
+#include "sl_bt_api.h"
+#include "sl_btmesh_api.h"
+#include "sl_simple_timer.h"
+#include "sl_power_manager.h"
+#include "sl_sleeptimer.h"
+#include "Sensors.h"
+
+#include "sim_api.h"
+
+// Room for the largest event the simulator builds, payload follows the struct
+typedef union {
+  sl_btmesh_msg_t msg;
+  uint8_t         raw[sizeof(sl_btmesh_msg_t) + SIM_MAX_PAYLOAD];
+} sim_btmesh_evt_buf_t;
+
+/*
+ * Bluetooth system
+ */
+void sl_bt_system_reset(uint8_t dfu)
+{
+  (void)dfu;
+  sim_system_reset();
+}
+
+sl_status_t sl_bt_nvm_save(uint16_t key, size_t value_len, const uint8_t *value)
+{
+  return sim_nvm_save(key, value_len, value);
+}
+
+sl_status_t sl_bt_nvm_load(uint16_t key, size_t max_value_size, size_t *value_len, uint8_t *value)
+{
+  return sim_nvm_load(key, max_value_size, value_len, value);
+}
+
+sl_status_t sl_bt_nvm_erase(uint16_t key)
+{
+  return sim_nvm_erase(key);
+}
+
+sl_status_t sl_bt_system_get_identity_address(bd_addr *address, uint8_t *type)
+{
+  uint16_t identity = sim_identity_address();
+
+  memset(address, 0, sizeof(*address));
+  address->addr[0] = (uint8_t)identity;
+  address->addr[1] = (uint8_t)(identity >> 8);
+  address->addr[5] = 0xC0; // static random
+  if (type != NULL)
+    *type = 1;
+
+  return SL_STATUS_OK;
+}
+
+/*
+ * Mesh node
+ */
+sl_status_t sl_btmesh_node_init()
+{
+  sim_node_init();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_btmesh_node_set_provisioning_data(aes_key_128 device_key,
+                                                 aes_key_128 network_key,
+                                                 uint16_t netkey_index,
+                                                 uint32_t iv_index,
+                                                 uint16_t address,
+                                                 uint8_t kr_in_progress)
+{
+  (void)device_key;
+  (void)network_key;
+  (void)kr_in_progress;
+  return sim_set_provisioning_data(address, netkey_index, iv_index);
+}
+
+sl_status_t sl_btmesh_node_reset()
+{
+  sim_node_reset();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_btmesh_node_start_unprov_beaconing(uint8_t bearer)
+{
+  (void)bearer;
+  return SL_STATUS_OK;
+}
+
+/*
+ * Local configuration
+ */
+sl_status_t sl_btmesh_test_get_local_model_pub(uint16_t elem_index,
+                                               uint16_t vendor_id,
+                                               uint16_t model_id,
+                                               uint16_t *appkey_index,
+                                               uint16_t *pub_address,
+                                               uint8_t *ttl,
+                                               uint8_t *period,
+                                               uint8_t *retrans,
+                                               uint8_t *credentials)
+{
+  (void)elem_index;
+  (void)vendor_id;
+  (void)model_id;
+  *appkey_index = 0;
+  *period = 0;
+  *retrans = 0;
+  *credentials = 0;
+  return sim_get_local_model_pub(pub_address, ttl);
+}
+
+sl_status_t sl_btmesh_test_add_local_key(uint8_t key_type,
+                                         aes_key_128 key,
+                                         uint16_t key_index,
+                                         uint16_t netkey_index)
+{
+  (void)key_type;
+  (void)key;
+  (void)netkey_index;
+  return sim_add_local_key(key_index);
+}
+
+sl_status_t sl_btmesh_test_bind_local_model_app(uint16_t elem_index,
+                                                uint16_t appkey_index,
+                                                uint16_t vendor_id,
+                                                uint16_t model_id)
+{
+  (void)elem_index;
+  (void)vendor_id;
+  (void)model_id;
+  return sim_bind_local_model_app(appkey_index);
+}
+
+sl_status_t sl_btmesh_test_set_local_model_pub(uint16_t elem_index,
+                                               uint16_t appkey_index,
+                                               uint16_t vendor_id,
+                                               uint16_t model_id,
+                                               uint16_t pub_address,
+                                               uint8_t ttl,
+                                               uint8_t period,
+                                               uint8_t retrans,
+                                               uint8_t credentials)
+{
+  (void)elem_index;
+  (void)appkey_index;
+  (void)vendor_id;
+  (void)model_id;
+  (void)period;
+  (void)retrans;
+  (void)credentials;
+  return sim_set_local_model_pub(pub_address, ttl);
+}
+
+sl_status_t sl_btmesh_test_add_local_model_sub(uint16_t elem_index,
+                                               uint16_t vendor_id,
+                                               uint16_t model_id,
+                                               uint16_t sub_address)
+{
+  (void)elem_index;
+  (void)vendor_id;
+  (void)model_id;
+  return sim_add_local_model_sub(sub_address);
+}
+
+sl_status_t sl_btmesh_test_set_relay(uint8_t enabled, uint8_t count, uint8_t interval)
+{
+  return sim_set_relay(enabled, count, interval);
+}
+
+sl_status_t sl_btmesh_test_set_nettx(uint8_t count, uint8_t interval)
+{
+  return sim_set_nettx(count, interval);
+}
+
+/*
+ * Vendor model
+ */
+sl_status_t sl_btmesh_vendor_model_init(uint16_t elem_index,
+                                        uint16_t vendor_id,
+                                        uint16_t model_id,
+                                        uint8_t publish,
+                                        size_t opcodes_len,
+                                        const uint8_t* opcodes)
+{
+  (void)elem_index;
+  (void)publish;
+  (void)opcodes_len;
+  (void)opcodes;
+  return sim_vendor_model_init(vendor_id, model_id);
+}
+
+sl_status_t sl_btmesh_vendor_model_set_publication(uint16_t elem_index,
+                                                   uint16_t vendor_id,
+                                                   uint16_t model_id,
+                                                   uint8_t opcode,
+                                                   uint8_t final,
+                                                   size_t payload_len,
+                                                   const uint8_t* payload)
+{
+  (void)elem_index;
+  (void)vendor_id;
+  (void)model_id;
+  (void)final;
+  return sim_set_publication(opcode, payload_len, payload);
+}
+
+sl_status_t sl_btmesh_vendor_model_publish(uint16_t elem_index,
+                                           uint16_t vendor_id,
+                                           uint16_t model_id)
+{
+  (void)elem_index;
+  (void)vendor_id;
+  (void)model_id;
+  return sim_publish();
+}
+
+sl_status_t sl_btmesh_vendor_model_send(uint16_t destination_address,
+                                        int8_t va_index,
+                                        uint16_t appkey_index,
+                                        uint16_t elem_index,
+                                        uint16_t vendor_id,
+                                        uint16_t model_id,
+                                        uint8_t nonrelayed,
+                                        uint8_t opcode,
+                                        uint8_t final,
+                                        size_t payload_len,
+                                        const uint8_t* payload)
+{
+  (void)va_index;
+  (void)appkey_index;
+  (void)elem_index;
+  (void)vendor_id;
+  (void)model_id;
+  (void)final;
+  return sim_send(destination_address, nonrelayed, opcode, payload_len, payload);
+}
+
+/*
+ * Simple timer
+ */
+sl_status_t sl_simple_timer_start(sl_simple_timer_t *timer,
+                                  uint32_t timeout_ms,
+                                  sl_simple_timer_callback_t callback,
+                                  void *callback_data,
+                                  bool is_periodic)
+{
+  if (timer == NULL)
+    return SL_STATUS_NULL_POINTER;
+
+  timer->callback = callback;
+  timer->callback_data = callback_data;
+  timer->timeout_ms = timeout_ms;
+  timer->periodic = is_periodic;
+  timer->running = true;
+  timer->generation++;
+
+  sim_timer_schedule(timer, timer->generation, timeout_ms);
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_simple_timer_stop(sl_simple_timer_t *timer)
+{
+  if (timer == NULL)
+    return SL_STATUS_NULL_POINTER;
+
+  timer->running = false;
+  timer->generation++;
+  return SL_STATUS_OK;
+}
+
+int sim_dispatch_timer(void *handle, uint32_t generation)
+{
+  sl_simple_timer_t *timer = (sl_simple_timer_t *)handle;
+
+  if (!timer->running || timer->generation != generation)
+    return 0;
+
+  // Periodic timers are rearmed from the expiry, like the sleeptimer does
+  if (timer->periodic)
+    sim_timer_schedule(timer, generation, timer->timeout_ms);
+  else
+    timer->running = false;
+
+  if (timer->callback != NULL)
+    timer->callback(timer, timer->callback_data);
+  return 1;
+}
+
+/*
+ * Power manager
+ */
+void sl_power_manager_add_em_requirement(sl_power_manager_em_t em)
+{
+  sim_em_requirement((int)em, 1);
+}
+
+void sl_power_manager_remove_em_requirement(sl_power_manager_em_t em)
+{
+  sim_em_requirement((int)em, 0);
+}
+
+void sl_power_manager_subscribe_em_transition_event(sl_power_manager_em_transition_event_handle_t *event_handle,
+                                                    const sl_power_manager_em_transition_event_info_t *event_info)
+{
+  (void)event_handle;
+  (void)event_info;
+}
+
+/*
+ * Sleep timer, a 32768 Hz tick count of simulated time
+ */
+uint32_t sl_sleeptimer_get_tick_count(void)
+{
+  return (uint32_t)sl_sleeptimer_get_tick_count64();
+}
+
+uint64_t sl_sleeptimer_get_tick_count64(void)
+{
+  return sim_now_us() * SIM_SLEEPTIMER_HZ / 1000000;
+}
+
+sl_status_t sl_sleeptimer_start_timer(sl_sleeptimer_timer_handle_t *handle,
+                                      uint32_t timeout,
+                                      sl_sleeptimer_timer_callback_t callback,
+                                      void *callback_data,
+                                      uint8_t priority,
+                                      uint16_t option_flags)
+{
+  (void)priority;
+  (void)option_flags;
+
+  if (handle == NULL)
+    return SL_STATUS_NULL_POINTER;
+
+  handle->callback = callback;
+  handle->callback_data = callback_data;
+  handle->running = 1;
+  handle->generation++;
+
+  // Expiry on the first simulated microsecond at or after the tick
+  uint64_t now = sl_sleeptimer_get_tick_count64();
+  uint64_t at_us = ((now + timeout) * 1000000 + SIM_SLEEPTIMER_HZ - 1) / SIM_SLEEPTIMER_HZ;
+  sim_sleeptimer_schedule(handle, handle->generation, at_us - sim_now_us());
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_sleeptimer_stop_timer(sl_sleeptimer_timer_handle_t *handle)
+{
+  if (handle == NULL)
+    return SL_STATUS_NULL_POINTER;
+  if (!handle->running)
+    return SL_STATUS_INVALID_STATE;
+
+  handle->running = 0;
+  handle->generation++;
+  return SL_STATUS_OK;
+}
+
+int sim_dispatch_sleeptimer(void *timer, uint32_t generation)
+{
+  sl_sleeptimer_timer_handle_t *handle = (sl_sleeptimer_timer_handle_t *)timer;
+
+  if (!handle->running || handle->generation != generation)
+    return 0;
+
+  handle->running = 0;
+  if (handle->callback != NULL)
+    handle->callback(handle, handle->callback_data);
+  return 1;
+}
+
+uint32_t sl_sleeptimer_get_timer_frequency(void)
+{
+  return SIM_SLEEPTIMER_HZ;
+}
+
+/*
+ * Sensors.c
+ */
+void Sensors_Init()
+{
+}
+
+void Sensors_Init_Start()
+{
+  sim_sensor_init_start();
+}
+
+bool Sensors_Init_Step()
+{
+  return sim_sensor_init_done() != 0;
+}
+
+void Get_Temp(int *data)
+{
+  sim_sensor_values_t v;
+  sim_sensor_read(&v);
+  *data = v.temp;
+}
+
+void Get_Humidity(int *data)
+{
+  sim_sensor_values_t v;
+  sim_sensor_read(&v);
+  *data = v.humidity;
+}
+
+void Get_IMU_data(int *a_x, int *a_y, int *a_z, int *g_x, int *g_y, int *g_z)
+{
+  sim_sensor_values_t v;
+  sim_sensor_read(&v);
+  *a_x = v.acc[0];
+  *a_y = v.acc[1];
+  *a_z = v.acc[2];
+  *g_x = v.gyro[0];
+  *g_y = v.gyro[1];
+  *g_z = v.gyro[2];
+}
+
+void Get_Gas(int *data)
+{
+  sim_sensor_values_t v;
+  sim_sensor_read(&v);
+  *data = v.gas;
+}
+
+void Get_Pressure(int *data)
+{
+  sim_sensor_values_t v;
+  sim_sensor_read(&v);
+  *data = v.pressure;
+}
+
+uint8_t Sensors_Degraded()
+{
+  return 0;
+}
+
+void Emergency_State()
+{
+  sim_emergency_state();
+}
+
+/*
+ * app_log
+ */
+void sim_app_log(const char *fmt, ...)
+{
+  sim_log_count();
+  if (!sim_log_verbose())
+    return;
+
+  va_list args;
+  va_start(args, fmt);
+  sim_log_prefix();
+  vprintf(fmt, args);
+  va_end(args);
+}
+
+/*
+ * Event dispatch into the application
+ */
+void sim_dispatch_boot(sim_event_handler_t on_bt_event)
+{
+  sl_bt_msg_t evt;
+
+  memset(&evt, 0, sizeof(evt));
+  evt.header = sl_bt_evt_system_boot_id;
+  evt.data.evt_system_boot.major = 3;
+  evt.data.evt_system_boot.minor = 2;
+  on_bt_event(&evt);
+}
+
+void sim_dispatch_node_initialized(sim_event_handler_t on_mesh_event, uint8_t provisioned,
+                                   uint16_t address, uint32_t iv_index)
+{
+  sim_btmesh_evt_buf_t buf;
+
+  memset(&buf, 0, sizeof(buf));
+  buf.msg.header = sl_btmesh_evt_node_initialized_id;
+  buf.msg.data.evt_node_initialized.provisioned = provisioned;
+  buf.msg.data.evt_node_initialized.address = address;
+  buf.msg.data.evt_node_initialized.iv_index = iv_index;
+  on_mesh_event(&buf.msg);
+}
+
+void sim_dispatch_vendor_receive(sim_event_handler_t on_mesh_event, uint16_t vendor_id,
+                                 uint16_t model_id, const sim_vendor_msg_t *msg)
+{
+  sim_btmesh_evt_buf_t buf;
+  sl_btmesh_evt_vendor_model_receive_t *rx;
+
+  memset(&buf, 0, sizeof(buf));
+  buf.msg.header = sl_btmesh_evt_vendor_model_receive_id;
+  rx = &buf.msg.data.evt_vendor_model_receive;
+  rx->destination_address = msg->destination_address;
+  rx->elem_index = 0;
+  rx->vendor_id = vendor_id;
+  rx->model_id = model_id;
+  rx->source_address = msg->source_address;
+  rx->va_index = -1;
+  rx->appkey_index = 0;
+  rx->nonrelayed = msg->nonrelayed;
+  rx->opcode = msg->opcode;
+  rx->final = 1;
+  rx->payload.len = msg->len;
+  memcpy(rx->payload.data, msg->payload, msg->len);
+  on_mesh_event(&buf.msg);
+}
+
+void sim_dispatch_friendship_established(sim_event_handler_t on_mesh_event, uint16_t friend_address)
+{
+  sim_btmesh_evt_buf_t buf;
+
+  memset(&buf, 0, sizeof(buf));
+  buf.msg.header = sl_btmesh_evt_lpn_friendship_established_id;
+  buf.msg.data.evt_lpn_friendship_established.friend_address = friend_address;
+  on_mesh_event(&buf.msg);
+}
+
+void sim_dispatch_friendship_failed(sim_event_handler_t on_mesh_event, uint16_t reason)
+{
+  sim_btmesh_evt_buf_t buf;
+
+  memset(&buf, 0, sizeof(buf));
+  buf.msg.header = sl_btmesh_evt_lpn_friendship_failed_id;
+  buf.msg.data.evt_lpn_friendship_failed.reason = reason;
+  on_mesh_event(&buf.msg);
+}
+
+void sim_dispatch_friendship_terminated(sim_event_handler_t on_mesh_event, uint16_t reason)
+{
+  sim_btmesh_evt_buf_t buf;
+
+  memset(&buf, 0, sizeof(buf));
+  buf.msg.header = sl_btmesh_evt_lpn_friendship_terminated_id;
+  buf.msg.data.evt_lpn_friendship_terminated.reason = reason;
+  on_mesh_event(&buf.msg);
+}
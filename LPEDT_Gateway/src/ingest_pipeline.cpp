@@ -0,0 +1,471 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ingest_pipeline.cpp
+ * @brief   Staged ingest of the helmet vendor model traffic
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "ingest_pipeline.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <chrono>
+#include <cstring>
+
+#include "my_model_def.h"
+#include "Custom_Defines.h"
+
+extern "C" {
+#include "energy.h"
+#include "timesync.h"
+}
+
+namespace lpedt {
+
+// Empty/full polls before a waiting stage gives up its core
+#define INGEST_SPINS           (256)
+
+// Over temperature clears this far under TEMP_MAX
+#define INGEST_TEMP_HYST_MC    (1000)
+
+// Payload length per opcode, -1 for opcodes the model does not have.
+// set_emergency is 0 from firmware without time sync, get_rssi is 0 from
+// firmware without sensor health.
+static const int8_t expected_len[NUMBER_OF_OPCODES + 1] = {
+  -1,
+  0,                            // temperature_get
+  TEMP_DATA_LENGTH,             // temperature_status
+  0,                            // unit_get
+  UNIT_DATA_LENGTH,             // unit_set
+  UNIT_DATA_LENGTH,             // unit_set_unack
+  UNIT_DATA_LENGTH,             // unit_status
+  0,                            // update_interval_get
+  UPDATE_INTERVAL_LENGTH,       // update_interval_set
+  UPDATE_INTERVAL_LENGTH,       // update_interval_set_unack
+  UPDATE_INTERVAL_LENGTH,       // update_interval_status
+  SENSOR_STATUS_LENGTH,         // get_rssi
+  RSSI_DATA_LENGTH,             // get_rssi_status
+  0,                            // get_emergency
+  EMERGENCY_STATE_DATA_LENGTH,  // get_emergency_status
+  TIMESYNC_STAMP_LEN,           // set_emergency
+  EMERGENCY_STATE_DATA_LENGTH,  // set_emergency_status
+  ENERGY_REPORT_LEN,            // energy_status
+  TIMESYNC_REF_LEN,             // time_ref
+};
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+static inline void backoff(uint32_t &spins)
+{
+  if (++spins < INGEST_SPINS)
+    cpu_relax();
+  else
+    std::this_thread::yield();
+}
+
+template <typename T>
+static bool push_wait(spsc_queue<T> &q, const T &item)
+{
+  if (q.push(item))
+    return false;
+
+  uint32_t spins = 0;
+  while (!q.push(item))
+    backoff(spins);
+  return true;
+}
+
+/**
+ * Pops until the stage upstream is done and its ring is empty. done is
+ * set after the last push, so the ring is checked once more after seeing it.
+ */
+template <typename T, typename F>
+static void drain(spsc_queue<T> &in, const std::atomic<bool> &upstream_done, F &&fn)
+{
+  T item;
+  uint32_t spins = 0;
+
+  for (;;) {
+    if (in.pop(item)) {
+      spins = 0;
+      fn(item);
+      continue;
+    }
+    if (upstream_done.load(std::memory_order_acquire)) {
+      if (!in.pop(item))
+        break;
+      fn(item);
+      continue;
+    }
+    backoff(spins);
+  }
+}
+
+/*
+ * Latency histogram
+ */
+int latency_histogram::bucket_of(uint64_t ns)
+{
+  if (ns < (1u << SUB_BITS))
+    return (int)ns;
+
+  int e = 63 - __builtin_clzll(ns);
+  int sub = (int)((ns >> (e - SUB_BITS)) & ((1u << SUB_BITS) - 1));
+  return ((e - SUB_BITS + 1) << SUB_BITS) + sub;
+}
+
+uint64_t latency_histogram::bucket_top(int bucket)
+{
+  if (bucket < (1 << SUB_BITS))
+    return (uint64_t)bucket;
+
+  int e = (bucket >> SUB_BITS) - 1 + SUB_BITS;
+  uint64_t sub = (uint64_t)(bucket & ((1 << SUB_BITS) - 1));
+  uint64_t low = ((1ull << SUB_BITS) + sub) << (e - SUB_BITS);
+  return low + (1ull << (e - SUB_BITS)) - 1;
+}
+
+void latency_histogram::record(uint64_t ns)
+{
+  buckets_[bucket_of(ns)]++;
+  count_++;
+  sum_ += ns;
+  if (ns > max_)
+    max_ = ns;
+}
+
+void latency_histogram::merge(const latency_histogram &other)
+{
+  for (int i = 0; i < BUCKETS; i++)
+    buckets_[i] += other.buckets_[i];
+  count_ += other.count_;
+  sum_ += other.sum_;
+  if (other.max_ > max_)
+    max_ = other.max_;
+}
+
+uint64_t latency_histogram::percentile_ns(double p) const
+{
+  if (count_ == 0)
+    return 0;
+
+  uint64_t rank = (uint64_t)(p * (count_ - 1)) + 1;
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++) {
+    seen += buckets_[i];
+    if (seen >= rank)
+      return bucket_top(i) < max_ ? bucket_top(i) : max_;
+  }
+  return max_;
+}
+
+void latency_histogram::print(FILE *out, const char *name) const
+{
+  fprintf(out, "%-14s %llu samples", name, (unsigned long long)count_);
+  if (count_) {
+    fprintf(out, ", mean %.1f us, p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f us", mean_ns() / 1e3,
+            percentile_ns(0.5) / 1e3, percentile_ns(0.99) / 1e3, percentile_ns(0.999) / 1e3, max_ / 1e3);
+  }
+  fprintf(out, "\n");
+}
+
+const char *alarm_name(alarm_kind_t kind)
+{
+  switch (kind) {
+    case alarm_kind_t::emergency:        return "emergency";
+    case alarm_kind_t::over_temperature: return "over temperature";
+    case alarm_kind_t::sensor_degraded:  return "sensor degraded";
+    default:                             return "none";
+  }
+}
+
+/*
+ * Pipeline
+ */
+ingest_pipeline::ingest_pipeline(const ingest_config_t &config, ingest_sink *sink, alarm_handler_t on_alarm)
+  : config_(config),
+    sink_(sink),
+    on_alarm_(std::move(on_alarm)),
+    q_parse_(config.queue_depth),
+    q_validate_(config.queue_depth),
+    q_state_(config.queue_depth),
+    q_alarm_(config.queue_depth),
+    q_persist_(config.queue_depth),
+    helmets_(INGEST_MAX_ADDRESS),
+    latches_(INGEST_MAX_ADDRESS)
+{
+  for (auto &done : done_)
+    done.store(false);
+}
+
+ingest_pipeline::~ingest_pipeline()
+{
+  if (!threads_.empty())
+    stop();
+}
+
+uint64_t ingest_pipeline::now_ns()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ingest_pipeline::pin(std::thread &t, int stage)
+{
+  if (!config_.pin)
+    return;
+
+  unsigned cpus = std::thread::hardware_concurrency();
+  if (cpus == 0)
+    cpus = 1;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET((config_.first_cpu + stage) % cpus, &set);
+  pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+}
+
+void ingest_pipeline::start()
+{
+  void (ingest_pipeline::*stages[INGEST_STAGES])() = {
+    &ingest_pipeline::run_parse,
+    &ingest_pipeline::run_validate,
+    &ingest_pipeline::run_state,
+    &ingest_pipeline::run_alarm,
+    &ingest_pipeline::run_persist,
+  };
+
+  for (int i = 0; i < INGEST_STAGES; i++) {
+    threads_.emplace_back(stages[i], this);
+    pin(threads_.back(), i);
+  }
+}
+
+void ingest_pipeline::feed(const uint8_t *data, size_t len, uint64_t arrival_ns)
+{
+  framed_.clear();
+  framer_.feed(data, len, arrival_ns, framed_);
+
+  for (const ncp_frame_t &frame : framed_) {
+    if (push_wait(q_parse_, frame))
+      stats_.reader_waits++;
+  }
+}
+
+void ingest_pipeline::stop()
+{
+  done_[0].store(true, std::memory_order_release);
+  for (std::thread &t : threads_)
+    t.join();
+  threads_.clear();
+
+  stats_.ncp = framer_.stats();
+}
+
+/*
+ * Stages. Counters are kept on the stage's own stack and stored when it
+ * ends, so stages never write to a shared cache line.
+ */
+void ingest_pipeline::run_parse()
+{
+  uint64_t frames = 0, other = 0;
+  ingest_item_t item{};
+
+  drain(q_parse_, done_[0], [&](const ncp_frame_t &frame) {
+    frames++;
+    if (!ncp_decode_vendor(frame, item.msg)) {
+      other++;
+      return;
+    }
+    item.arrival_ns = frame.arrival_ns;
+    push_wait(q_validate_, item);
+  });
+
+  stats_.frames = frames;
+  stats_.other_events = other;
+  done_[1].store(true, std::memory_order_release);
+}
+
+void ingest_pipeline::run_validate()
+{
+  uint64_t bad_model = 0, bad_opcode = 0, bad_length = 0, bad_source = 0, accepted = 0;
+  std::array<uint64_t, 32> per_opcode{};
+
+  drain(q_validate_, done_[1], [&](const ingest_item_t &item) {
+    const vendor_msg_t &msg = item.msg;
+
+    if (msg.vendor_id != MY_VENDOR_ID ||
+        (msg.model_id != MY_MODEL_CLIENT_ID && msg.model_id != MY_MODEL_SERVER_ID) || !msg.final) {
+      bad_model++;
+      return;
+    }
+    if (msg.opcode == 0 || msg.opcode > NUMBER_OF_OPCODES || expected_len[msg.opcode] < 0) {
+      bad_opcode++;
+      return;
+    }
+    if (msg.len != expected_len[msg.opcode] &&
+        !((msg.opcode == set_emergency || msg.opcode == get_rssi) && msg.len == 0)) {
+      bad_length++;
+      return;
+    }
+    if (msg.src == 0 || msg.src >= INGEST_MAX_ADDRESS) {
+      bad_source++;
+      return;
+    }
+
+    accepted++;
+    per_opcode[msg.opcode]++;
+    push_wait(q_state_, item);
+  });
+
+  stats_.bad_model = bad_model;
+  stats_.bad_opcode = bad_opcode;
+  stats_.bad_length = bad_length;
+  stats_.bad_source = bad_source;
+  stats_.accepted = accepted;
+  stats_.per_opcode = per_opcode;
+  done_[2].store(true, std::memory_order_release);
+}
+
+void ingest_pipeline::run_state()
+{
+  drain(q_state_, done_[2], [&](ingest_item_t &item) {
+    const vendor_msg_t &msg = item.msg;
+    helmet_state_t &h = helmets_[msg.src];
+
+    h.last_seen_ns = item.arrival_ns;
+    h.frames++;
+    item.network_ms = 0;
+    item.stamp_error_ms = TIMESYNC_UNSYNCED;
+
+    switch (msg.opcode) {
+      case temperature_status:
+        h.temp_mc = (int32_t)timesync_get_u32(msg.payload);
+        h.temp_valid = true;
+        break;
+
+      case set_emergency:
+        h.emergency = 1;
+        if (msg.len == TIMESYNC_STAMP_LEN) {
+          item.network_ms = timesync_get_u32(msg.payload);
+          item.stamp_error_ms = msg.payload[4];
+        }
+        break;
+
+      case get_rssi:
+        if (msg.len == SENSOR_STATUS_LENGTH)
+          h.sensors_degraded = msg.payload[0];
+        break;
+
+      case energy_status:
+        for (int i = 0; i < ENERGY_NUM_SUBSYSTEMS; i++)
+          h.charge_nah += (uint64_t)(msg.payload[2 * i] | (msg.payload[2 * i + 1] << 8)) * ENERGY_REPORT_UNIT_NAH;
+        break;
+
+      default:
+        break;
+    }
+
+    item.temp_mc = h.temp_mc;
+    item.temp_valid = h.temp_valid;
+    item.frames = h.frames;
+    item.sensors_degraded = h.sensors_degraded;
+    push_wait(q_alarm_, item);
+  });
+
+  done_[3].store(true, std::memory_order_release);
+}
+
+void ingest_pipeline::run_alarm()
+{
+  uint64_t alarms = 0;
+
+  drain(q_alarm_, done_[3], [&](ingest_item_t &item) {
+    const vendor_msg_t &msg = item.msg;
+    alarm_latch_t &latch = latches_[msg.src];
+
+    item.alarm = alarm_kind_t::none;
+    if (msg.opcode == set_emergency && !latch.emergency) {
+      latch.emergency = true;
+      item.alarm = alarm_kind_t::emergency;
+    }
+    else if (msg.opcode == temperature_status) {
+      if (!latch.hot && item.temp_mc > TEMP_MAX * 1000) {
+        latch.hot = true;
+        item.alarm = alarm_kind_t::over_temperature;
+      }
+      else if (latch.hot && item.temp_mc < TEMP_MAX * 1000 - INGEST_TEMP_HYST_MC) {
+        latch.hot = false;
+      }
+    }
+    else if (msg.opcode == get_rssi) {
+      // Raised once per fault, clears when every sensor is back
+      if (!latch.degraded && item.sensors_degraded) {
+        latch.degraded = true;
+        item.alarm = alarm_kind_t::sensor_degraded;
+      }
+      else if (latch.degraded && !item.sensors_degraded) {
+        latch.degraded = false;
+      }
+    }
+
+    if (item.alarm != alarm_kind_t::none) {
+      alarms++;
+      if (on_alarm_) {
+        ingest_alarm_t alarm;
+        alarm.kind = item.alarm;
+        alarm.helmet = msg.src;
+        alarm.network_ms = item.network_ms;
+        alarm.temp_mc = item.temp_mc;
+        alarm.temp_valid = item.temp_valid;
+        alarm.sensors_degraded = item.sensors_degraded;
+        alarm.arrival_ns = item.arrival_ns;
+        on_alarm_(alarm);
+      }
+      alarm_latency_.record(now_ns() - item.arrival_ns);
+    }
+    frame_latency_.record(now_ns() - item.arrival_ns);
+
+    push_wait(q_persist_, item);
+  });
+
+  stats_.alarms = alarms;
+  done_[4].store(true, std::memory_order_release);
+}
+
+void ingest_pipeline::run_persist()
+{
+  uint64_t persisted = 0;
+
+  drain(q_persist_, done_[4], [&](const ingest_item_t &item) {
+    if (sink_)
+      sink_->write(item);
+    persisted++;
+  });
+
+  if (sink_)
+    sink_->flush();
+  stats_.persisted = persisted;
+  done_[5].store(true, std::memory_order_release);
+}
+
+} // namespace lpedt
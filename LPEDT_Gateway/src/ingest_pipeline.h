@@ -0,0 +1,228 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ingest_pipeline.h
+ * @brief   Gateway telemetry ingest, NCP packets in, helmet state, alarms
+ *          and a persisted record of every message out.
+ *
+ *          The thread calling feed() frames the byte stream and stamps the
+ *          arrival time. Five stages follow, each on its own thread, pinned
+ *          to its own core, connected by spsc_queue rings:
+ *
+ *            parse     vendor_model_receive decoded, other events counted
+ *            validate  vendor/model, opcode and length per opcode
+ *            state     per helmet state (last seen, temperature, energy,
+ *                      emergency) folded in and snapshot into the item
+ *            alarm     emergency and over temperature rules, latched per
+ *                      helmet, the alarm handler is called here
+ *            persist   the ingest_sink gets every valid message
+ *
+ *          A full ring makes the stage upstream wait, nothing is dropped
+ *          inside the pipeline, a slow sink throttles the reader and the
+ *          NCP bytes pile up in the serial driver.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef LPEDT_GATEWAY_INGEST_PIPELINE_H_
+#define LPEDT_GATEWAY_INGEST_PIPELINE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ncp_frame.h"
+#include "spsc_queue.h"
+
+namespace lpedt {
+
+#define INGEST_STAGES          (5)
+#define INGEST_MAX_ADDRESS     (0x8000)  // unicast addresses only
+
+/**
+ * Log-linear latency histogram, 8 sub-buckets per power of two, so any
+ * value is within 12.5 % of its bucket. Not thread safe, one per stage.
+ */
+class latency_histogram {
+public:
+  void     record(uint64_t ns);
+  void     merge(const latency_histogram &other);
+  uint64_t count() const { return count_; }
+  uint64_t max_ns() const { return max_; }
+  double   mean_ns() const { return count_ ? (double)sum_ / count_ : 0.0; }
+  uint64_t percentile_ns(double p) const;
+  void     print(FILE *out, const char *name) const;
+
+private:
+  static constexpr int SUB_BITS = 3;
+  static constexpr int BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+
+  static int      bucket_of(uint64_t ns);
+  static uint64_t bucket_top(int bucket);
+
+  std::array<uint64_t, BUCKETS> buckets_{};
+  uint64_t count_ = 0;
+  uint64_t sum_   = 0;
+  uint64_t max_   = 0;
+};
+
+enum class alarm_kind_t : uint8_t {
+  none = 0,
+  emergency,        // set_emergency from a helmet
+  over_temperature, // temperature_status above TEMP_MAX
+  sensor_degraded   // get_rssi with a degraded sensor mask
+};
+
+const char *alarm_name(alarm_kind_t kind);
+
+// One message as it moves down the pipeline
+struct ingest_item_t {
+  uint64_t     arrival_ns;
+  vendor_msg_t msg;
+
+  // Filled in by the state stage, the helmet after this message
+  uint32_t     network_ms;      // stamp of a set_emergency, 0 if none
+  uint8_t      stamp_error_ms;  // TIMESYNC_UNSYNCED if unsynced or unstamped
+  int32_t      temp_mc;         // milli degrees, last temperature_status
+  bool         temp_valid;
+  uint32_t     frames;          // messages from this source so far
+  uint8_t      sensors_degraded; // Sensors_Degraded() mask, last get_rssi
+
+  alarm_kind_t alarm;           // raised by this message
+};
+
+struct ingest_alarm_t {
+  alarm_kind_t kind;
+  uint16_t     helmet;
+  uint32_t     network_ms;      // helmet stamp, 0 if the helmet sent none
+  int32_t      temp_mc;
+  bool         temp_valid;
+  uint8_t      sensors_degraded;
+  uint64_t     arrival_ns;
+};
+
+/**
+ * Where the persist stage puts every valid message, called from the persist
+ * thread only
+ */
+class ingest_sink {
+public:
+  virtual ~ingest_sink() = default;
+  virtual void write(const ingest_item_t &item) = 0;
+  virtual void flush() {}
+};
+
+using alarm_handler_t = std::function<void(const ingest_alarm_t &alarm)>;
+
+struct ingest_config_t {
+  size_t   queue_depth = 4096;  // per ring
+  bool     pin         = true;
+  int      first_cpu   = 1;     // stages go on first_cpu, first_cpu + 1, ... wrapping
+};
+
+struct ingest_stats_t {
+  ncp_stats_t ncp;
+  uint64_t frames        = 0;   // packets handed to parse
+  uint64_t other_events  = 0;   // not vendor_model_receive
+  uint64_t bad_model     = 0;   // another vendor or model, or a partial chunk
+  uint64_t bad_opcode    = 0;
+  uint64_t bad_length    = 0;
+  uint64_t bad_source    = 0;   // not a unicast address
+  uint64_t accepted      = 0;
+  uint64_t alarms        = 0;
+  uint64_t persisted     = 0;
+  uint64_t reader_waits  = 0;   // times feed() found the parse ring full
+  std::array<uint64_t, 32> per_opcode{};
+};
+
+class ingest_pipeline {
+public:
+  ingest_pipeline(const ingest_config_t &config, ingest_sink *sink, alarm_handler_t on_alarm);
+  ~ingest_pipeline();
+
+  void start();
+
+  /**
+   * @brief   Arrival stage, frame bytes read from the NCP and queue the
+   *          packets. Waits while the parse ring is full.
+   * @param   arrival_ns  when the bytes were read, steady clock
+   */
+  void feed(const uint8_t *data, size_t len, uint64_t arrival_ns);
+
+  // Let everything queued drain through and join the stages
+  void stop();
+
+  // Valid after stop()
+  const ingest_stats_t    &stats() const { return stats_; }
+  const latency_histogram &frame_latency() const { return frame_latency_; }
+  const latency_histogram &alarm_latency() const { return alarm_latency_; }
+
+  static uint64_t now_ns();
+
+private:
+  struct helmet_state_t {
+    uint64_t last_seen_ns = 0;
+    uint32_t frames       = 0;
+    int32_t  temp_mc      = 0;
+    bool     temp_valid   = false;
+    uint8_t  emergency    = 0;
+    uint64_t charge_nah   = 0;  // energy_status totals
+    uint8_t  sensors_degraded = 0;
+  };
+
+  struct alarm_latch_t {
+    bool emergency = false;
+    bool hot       = false;
+    bool degraded  = false;
+  };
+
+  void run_parse();
+  void run_validate();
+  void run_state();
+  void run_alarm();
+  void run_persist();
+
+  void pin(std::thread &t, int stage);
+
+  ingest_config_t config_;
+  ingest_sink    *sink_;
+  alarm_handler_t on_alarm_;
+
+  ncp_framer                 framer_;
+  std::vector<ncp_frame_t>   framed_;
+
+  spsc_queue<ncp_frame_t>    q_parse_;
+  spsc_queue<ingest_item_t>  q_validate_;
+  spsc_queue<ingest_item_t>  q_state_;
+  spsc_queue<ingest_item_t>  q_alarm_;
+  spsc_queue<ingest_item_t>  q_persist_;
+
+  // done_[i], stage i will push nothing more, done_[0] is the reader
+  std::array<std::atomic<bool>, INGEST_STAGES + 1> done_{};
+  std::vector<std::thread> threads_;
+
+  std::vector<helmet_state_t> helmets_;
+  std::vector<alarm_latch_t>  latches_;
+
+  ingest_stats_t    stats_;
+  latency_histogram frame_latency_;
+  latency_histogram alarm_latency_;
+};
+
+} // namespace lpedt
+
+#endif /* LPEDT_GATEWAY_INGEST_PIPELINE_H_ */
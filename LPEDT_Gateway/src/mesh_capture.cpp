@@ -0,0 +1,220 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    mesh_capture.cpp
+ * @brief   Capture file writer and reader
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "mesh_capture.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include "my_model_def.h"
+
+namespace lpedt {
+
+// 10 bytes of LEB128 hold any uint64_t
+#define CAPTURE_RECORD_MAX  (10 + 8 + NCP_VENDOR_PAYLOAD_MAX)
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/*
+ * capture_writer
+ */
+capture_writer::~capture_writer()
+{
+  close();
+}
+
+bool capture_writer::open(const std::string &path, const capture_header_t &header, std::string &error)
+{
+  close();
+
+  f_ = fopen(path.c_str(), "wb");
+  if (!f_) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+  setvbuf(f_, nullptr, _IOFBF, 1 << 16);
+
+  uint8_t h[CAPTURE_HEADER_LEN] = {};
+  memcpy(h, CAPTURE_MAGIC, 8);
+  for (int i = 0; i < 4; i++)
+    h[8 + i] = (uint8_t)(header.flags >> (8 * i));
+  for (int i = 0; i < 8; i++)
+    h[16 + i] = (uint8_t)(header.wall_start_ns >> (8 * i));
+
+  if (fwrite(h, 1, sizeof(h), f_) != sizeof(h)) {
+    error = path + ": write failed";
+    close();
+    return false;
+  }
+
+  last_us_ = 0;
+  records_ = 0;
+  bytes_ = sizeof(h);
+  return true;
+}
+
+bool capture_writer::write(const capture_record_t &rec)
+{
+  if (!f_ || rec.len > NCP_VENDOR_PAYLOAD_MAX)
+    return false;
+
+  uint8_t buf[CAPTURE_RECORD_MAX];
+  size_t n = 0;
+
+  uint64_t delta = rec.t_us > last_us_ ? rec.t_us - last_us_ : 0;
+  last_us_ += delta;
+  do {
+    uint8_t b = delta & 0x7f;
+    delta >>= 7;
+    buf[n++] = delta ? (b | 0x80) : b;
+  } while (delta);
+
+  put_u16(&buf[n], rec.src);
+  put_u16(&buf[n + 2], rec.dst);
+  buf[n + 4] = rec.opcode;
+  buf[n + 5] = (uint8_t)rec.rssi;
+  buf[n + 6] = rec.flags;
+  buf[n + 7] = rec.len;
+  n += 8;
+  memcpy(&buf[n], rec.payload, rec.len);
+  n += rec.len;
+
+  if (fwrite(buf, 1, n, f_) != n)
+    return false;
+  records_++;
+  bytes_ += n;
+  return true;
+}
+
+void capture_writer::close()
+{
+  if (f_) {
+    fclose(f_);
+    f_ = nullptr;
+  }
+}
+
+/*
+ * Reading
+ */
+bool capture_load(const std::string &path, capture_header_t &header, std::vector<capture_record_t> &records,
+                  std::string &error)
+{
+  error.clear();
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t chunk[1 << 16];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+    data.insert(data.end(), chunk, chunk + n);
+  fclose(f);
+
+  if (data.size() < CAPTURE_HEADER_LEN || memcmp(data.data(), CAPTURE_MAGIC, 8) != 0) {
+    error = path + ": not a capture";
+    return false;
+  }
+
+  header.flags = 0;
+  header.wall_start_ns = 0;
+  for (int i = 0; i < 4; i++)
+    header.flags |= (uint32_t)data[8 + i] << (8 * i);
+  for (int i = 0; i < 8; i++)
+    header.wall_start_ns |= (uint64_t)data[16 + i] << (8 * i);
+
+  records.clear();
+  size_t pos = CAPTURE_HEADER_LEN;
+  uint64_t t_us = 0;
+  while (pos < data.size()) {
+    uint64_t delta = 0;
+    int shift = 0;
+    size_t p = pos;
+    while (p < data.size() && shift < 64) {
+      uint8_t b = data[p++];
+      delta |= (uint64_t)(b & 0x7f) << shift;
+      shift += 7;
+      if (!(b & 0x80))
+        break;
+    }
+    if (p + 8 > data.size() || p + 8 + data[p + 7] > data.size() || data[p + 7] > NCP_VENDOR_PAYLOAD_MAX) {
+      error = path + ": last record cut short";
+      break;
+    }
+
+    capture_record_t rec;
+    t_us += delta;
+    rec.t_us = t_us;
+    rec.src = get_u16(&data[p]);
+    rec.dst = get_u16(&data[p + 2]);
+    rec.opcode = data[p + 4];
+    rec.rssi = (int8_t)data[p + 5];
+    rec.flags = data[p + 6];
+    rec.len = data[p + 7];
+    memcpy(rec.payload, &data[p + 8], rec.len);
+    records.push_back(rec);
+
+    pos = p + 8 + rec.len;
+  }
+
+  return true;
+}
+
+void capture_from_msg(const vendor_msg_t &msg, uint64_t t_us, int8_t rssi, uint8_t alarm, capture_record_t &rec)
+{
+  rec.t_us = t_us;
+  rec.src = msg.src;
+  rec.dst = msg.dst;
+  rec.opcode = msg.opcode;
+  rec.rssi = rssi;
+  rec.flags = (uint8_t)((msg.nonrelayed ? CAPTURE_NONRELAYED : 0) |
+                        (msg.model_id == MY_MODEL_CLIENT_ID ? CAPTURE_CLIENT_MODEL : 0) |
+                        ((alarm << CAPTURE_ALARM_SHIFT) & CAPTURE_ALARM_MASK));
+  rec.len = msg.len <= NCP_VENDOR_PAYLOAD_MAX ? msg.len : NCP_VENDOR_PAYLOAD_MAX;
+  memcpy(rec.payload, msg.payload, rec.len);
+}
+
+void capture_to_msg(const capture_record_t &rec, vendor_msg_t &msg)
+{
+  msg.dst = rec.dst;
+  msg.elem_index = 0;
+  msg.vendor_id = MY_VENDOR_ID;
+  msg.model_id = (rec.flags & CAPTURE_CLIENT_MODEL) ? MY_MODEL_CLIENT_ID : MY_MODEL_SERVER_ID;
+  msg.src = rec.src;
+  msg.va_index = -1;
+  msg.appkey_index = 0;
+  msg.nonrelayed = (rec.flags & CAPTURE_NONRELAYED) ? 1 : 0;
+  msg.opcode = rec.opcode;
+  msg.final = 1;
+  msg.len = rec.len;
+  memcpy(msg.payload, rec.payload, rec.len);
+}
+
+} // namespace lpedt
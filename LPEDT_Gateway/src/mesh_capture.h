@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    mesh_capture.h
+ * @brief   Compact capture of the vendor model traffic a gateway hears, for
+ *          replay on a workstation (mesh_replay).
+ *
+ *          A CAPTURE_HEADER_LEN byte file header:
+ *
+ *            magic[8]       CAPTURE_MAGIC
+ *            flags          u32, CAPTURE_HAS_ALARMS, CAPTURE_FROM_SIM
+ *            reserved       u32
+ *            wall_start_ns  u64, wall clock of t = 0
+ *
+ *          then one record per message, little endian:
+ *
+ *            delta_us       LEB128, time since the previous record
+ *            src, dst       u16
+ *            opcode         u8
+ *            rssi           i8, CAPTURE_RSSI_UNKNOWN if the source of the
+ *                           capture has none (the NCP event carries none)
+ *            flags          u8, CAPTURE_NONRELAYED, CAPTURE_CLIENT_MODEL and
+ *                           the alarm_kind_t the gateway raised on it
+ *            len            u8
+ *            payload        len bytes
+ *
+ *          A temperature_status is 14 or 15 bytes against the 25 of the NCP
+ *          packet, with its arrival time.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef LPEDT_GATEWAY_MESH_CAPTURE_H_
+#define LPEDT_GATEWAY_MESH_CAPTURE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ncp_frame.h"
+
+namespace lpedt {
+
+#define CAPTURE_MAGIC           "LPCAP001"
+#define CAPTURE_HEADER_LEN      (24)
+#define CAPTURE_RSSI_UNKNOWN    (127)
+
+// File flags
+#define CAPTURE_HAS_ALARMS      (0x01)  // records carry the gateway alarm decisions
+#define CAPTURE_FROM_SIM        (0x02)  // written by mesh_sim, not a gateway
+
+// Record flags
+#define CAPTURE_NONRELAYED      (0x01)
+#define CAPTURE_CLIENT_MODEL    (0x02)  // received on the client model, else the server model
+#define CAPTURE_ALARM_SHIFT     (2)     // alarm_kind_t, 2 bits
+#define CAPTURE_ALARM_MASK      (0x0C)
+
+struct capture_record_t {
+  uint64_t t_us;        // since the start of the capture
+  uint16_t src;
+  uint16_t dst;
+  uint8_t  opcode;
+  int8_t   rssi;
+  uint8_t  flags;
+  uint8_t  len;
+  uint8_t  payload[NCP_VENDOR_PAYLOAD_MAX];
+};
+
+struct capture_header_t {
+  uint32_t flags         = 0;
+  uint64_t wall_start_ns = 0;
+};
+
+class capture_writer {
+public:
+  capture_writer() = default;
+  ~capture_writer();
+
+  capture_writer(const capture_writer &) = delete;
+  capture_writer &operator=(const capture_writer &) = delete;
+
+  bool open(const std::string &path, const capture_header_t &header, std::string &error);
+
+  // Records must come in time order, an older one is written at the time of the last
+  bool write(const capture_record_t &rec);
+  void close();
+
+  bool     is_open() const { return f_ != nullptr; }
+  uint64_t records() const { return records_; }
+  uint64_t bytes() const { return bytes_; }
+
+private:
+  FILE    *f_ = nullptr;
+  uint64_t last_us_ = 0;
+  uint64_t records_ = 0;
+  uint64_t bytes_ = 0;
+};
+
+/**
+ * @brief   Read a whole capture
+ * @return  false with error set if the file is not a capture. A record cut
+ *          short at the end is dropped and reported in error, with true.
+ */
+bool capture_load(const std::string &path, capture_header_t &header, std::vector<capture_record_t> &records,
+                  std::string &error);
+
+// Between a record and the vendor_model_receive it came from
+void capture_from_msg(const vendor_msg_t &msg, uint64_t t_us, int8_t rssi, uint8_t alarm, capture_record_t &rec);
+void capture_to_msg(const capture_record_t &rec, vendor_msg_t &msg);
+
+} // namespace lpedt
+
+#endif /* LPEDT_GATEWAY_MESH_CAPTURE_H_ */
@@ -0,0 +1,152 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ncp_frame.cpp
+ * @brief   BGAPI packet framing and vendor_model_receive decoding
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "ncp_frame.h"
+
+#include <cstring>
+
+namespace lpedt {
+
+// Event or command/response of the Bluetooth or mesh device, not encrypted
+static bool header_type_ok(uint8_t b)
+{
+  uint8_t dev = b & 0x78;
+  return dev == 0x20 || dev == 0x28;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+void ncp_framer::feed(const uint8_t *data, size_t len, uint64_t arrival_ns, std::vector<ncp_frame_t> &out)
+{
+  while (len) {
+    if (skip_) {
+      size_t n = skip_ < len ? skip_ : len;
+      skip_ -= (uint16_t)n;
+      data += n;
+      len -= n;
+      continue;
+    }
+
+    // Header byte by byte so noise costs one byte, then the payload in one go
+    if (frame_.len < NCP_HEADER_LEN) {
+      uint8_t b = *data++;
+      len--;
+      if (frame_.len == 0 && !header_type_ok(b)) {
+        stats_.skipped++;
+        continue;
+      }
+      frame_.data[frame_.len++] = b;
+      if (frame_.len < NCP_HEADER_LEN)
+        continue;
+
+      uint32_t hdr = frame_.data[0] | (frame_.data[1] << 8) | (frame_.data[2] << 16) | ((uint32_t)frame_.data[3] << 24);
+      uint16_t payload = (uint16_t)NCP_MSG_LEN(hdr);
+      if (NCP_HEADER_LEN + payload > NCP_FRAME_MAX) {
+        stats_.oversize++;
+        skip_ = payload;
+        frame_.len = 0;
+        continue;
+      }
+      need_ = payload;
+    }
+    else {
+      size_t n = need_ < len ? need_ : len;
+      memcpy(&frame_.data[frame_.len], data, n);
+      frame_.len += (uint16_t)n;
+      need_ -= (uint16_t)n;
+      data += n;
+      len -= n;
+    }
+
+    if (frame_.len >= NCP_HEADER_LEN && need_ == 0) {
+      frame_.arrival_ns = arrival_ns;
+      out.push_back(frame_);
+      stats_.packets++;
+      frame_.len = 0;
+    }
+  }
+}
+
+bool ncp_decode_vendor(const ncp_frame_t &frame, vendor_msg_t &msg)
+{
+  if (frame.len < NCP_HEADER_LEN + NCP_VENDOR_RECEIVE_FIXED)
+    return false;
+
+  const uint8_t *p = frame.data;
+  uint32_t hdr = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  if (NCP_MSG_ID(hdr) != NCP_VENDOR_RECEIVE_ID)
+    return false;
+
+  p += NCP_HEADER_LEN;
+  msg.dst          = get_u16(p);
+  msg.elem_index   = get_u16(p + 2);
+  msg.vendor_id    = get_u16(p + 4);
+  msg.model_id     = get_u16(p + 6);
+  msg.src          = get_u16(p + 8);
+  msg.va_index     = (int8_t)p[10];
+  msg.appkey_index = get_u16(p + 11);
+  msg.nonrelayed   = p[13];
+  msg.opcode       = p[14];
+  msg.final        = p[15];
+  msg.len          = p[16];
+
+  if (NCP_HEADER_LEN + NCP_VENDOR_RECEIVE_FIXED + msg.len > frame.len)
+    return false;
+  memcpy(msg.payload, p + NCP_VENDOR_RECEIVE_FIXED, msg.len);
+  return true;
+}
+
+size_t ncp_encode_vendor(const vendor_msg_t &msg, uint8_t *out)
+{
+  if (msg.len > NCP_VENDOR_PAYLOAD_MAX)
+    return 0;
+
+  uint16_t payload = NCP_VENDOR_RECEIVE_FIXED + msg.len;
+  uint32_t hdr = NCP_VENDOR_RECEIVE_ID | ((payload & 0xff) << 8) | (payload >> 8);
+  out[0] = (uint8_t)hdr;
+  out[1] = (uint8_t)(hdr >> 8);
+  out[2] = (uint8_t)(hdr >> 16);
+  out[3] = (uint8_t)(hdr >> 24);
+
+  uint8_t *p = out + NCP_HEADER_LEN;
+  put_u16(p, msg.dst);
+  put_u16(p + 2, msg.elem_index);
+  put_u16(p + 4, msg.vendor_id);
+  put_u16(p + 6, msg.model_id);
+  put_u16(p + 8, msg.src);
+  p[10] = (uint8_t)msg.va_index;
+  put_u16(p + 11, msg.appkey_index);
+  p[13] = msg.nonrelayed;
+  p[14] = msg.opcode;
+  p[15] = msg.final;
+  p[16] = msg.len;
+  memcpy(p + NCP_VENDOR_RECEIVE_FIXED, msg.payload, msg.len);
+
+  return NCP_HEADER_LEN + payload;
+}
+
+} // namespace lpedt
@@ -0,0 +1,114 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ncp_frame.h
+ * @brief   BGAPI framing of the serial NCP stream the gateway listens to.
+ *
+ *          The NCP forwards every stack event as a BGAPI packet, a 4 byte
+ *          header (message type, device type and 11 bit length, class,
+ *          method) and the payload. The gateway only acts on
+ *          sl_btmesh_evt_vendor_model_receive, the vendor model messages of
+ *          my_model_def.h, the rest is framed and counted.
+ *
+ *          BGAPI has no sync byte or checksum, a header whose type byte is
+ *          not a plain Bluetooth or mesh packet is taken as line noise and
+ *          the framer moves on one byte.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef LPEDT_GATEWAY_NCP_FRAME_H_
+#define LPEDT_GATEWAY_NCP_FRAME_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lpedt {
+
+// Must match sl_bgapi.h and sl_btmesh_api.h of the SDK
+#define NCP_HEADER_LEN            (4)
+#define NCP_MAX_PAYLOAD           (2047)
+#define NCP_MSG_ID(hdr)           ((hdr) & 0xffff00f8)
+#define NCP_MSG_LEN(hdr)          ((((hdr) & 0x7) << 8) | (((hdr) & 0xff00) >> 8))
+#define NCP_VENDOR_RECEIVE_ID     (0x001900a8) // sl_btmesh_evt_vendor_model_receive_id
+
+// Fixed fields of the vendor_model_receive event before the payload bytes,
+// the uint8array length included
+#define NCP_VENDOR_RECEIVE_FIXED  (17)
+
+// Longest packet kept, vendor messages of this model are a few bytes. Longer
+// packets are skipped.
+#define NCP_FRAME_MAX             (96)
+#define NCP_VENDOR_PAYLOAD_MAX    (NCP_FRAME_MAX - NCP_HEADER_LEN - NCP_VENDOR_RECEIVE_FIXED)
+
+struct ncp_frame_t {
+  uint64_t arrival_ns;          // steady clock, when its last byte was read
+  uint16_t len;                 // header included
+  uint8_t  data[NCP_FRAME_MAX];
+};
+
+// sl_btmesh_evt_vendor_model_receive_t
+struct vendor_msg_t {
+  uint16_t dst;
+  uint16_t elem_index;
+  uint16_t vendor_id;
+  uint16_t model_id;
+  uint16_t src;
+  int8_t   va_index;
+  uint16_t appkey_index;
+  uint8_t  nonrelayed;
+  uint8_t  opcode;
+  uint8_t  final;
+  uint8_t  len;
+  uint8_t  payload[NCP_VENDOR_PAYLOAD_MAX];
+};
+
+struct ncp_stats_t {
+  uint64_t packets      = 0;
+  uint64_t skipped      = 0;  // bytes dropped while looking for a header
+  uint64_t oversize     = 0;  // packets longer than NCP_FRAME_MAX
+};
+
+class ncp_framer {
+public:
+  /**
+   * @brief   Frame a chunk of the NCP stream. Complete packets are appended
+   *          to out, stamped with arrival_ns.
+   */
+  void feed(const uint8_t *data, size_t len, uint64_t arrival_ns, std::vector<ncp_frame_t> &out);
+
+  const ncp_stats_t &stats() const { return stats_; }
+
+private:
+  ncp_stats_t stats_;
+  ncp_frame_t frame_{};
+  uint16_t    need_ = NCP_HEADER_LEN;  // bytes still missing in frame_
+  uint16_t    skip_ = 0;               // bytes left of an oversize packet
+};
+
+/**
+ * @brief   Decode a vendor_model_receive packet
+ * @return  false if the packet is another event or is cut short
+ */
+bool ncp_decode_vendor(const ncp_frame_t &frame, vendor_msg_t &msg);
+
+/**
+ * @brief   Build the packet the NCP sends for msg, for replay files and the
+ *          synthetic load
+ * @return  packet length, 0 if msg.len is over NCP_VENDOR_PAYLOAD_MAX
+ */
+size_t ncp_encode_vendor(const vendor_msg_t &msg, uint8_t *out);
+
+} // namespace lpedt
+
+#endif /* LPEDT_GATEWAY_NCP_FRAME_H_ */
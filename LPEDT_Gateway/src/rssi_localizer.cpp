@@ -0,0 +1,214 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    rssi_localizer.cpp
+ * @brief   Sliding window RSSI aggregation and weighted centroid localization
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "rssi_localizer.h"
+
+#include <cmath>
+
+namespace lpedt {
+
+void rssi_window::expire(uint64_t now_ms, uint32_t window_ms)
+{
+  // Differences are taken on the low 32 bits so the stored timestamps can
+  // stay 32 bits wide, a window is always far shorter than the 49 day wrap.
+  // They are compared signed: relays deliver out of order, and a sample
+  // older than the head must not wrap to a huge age and flush the window.
+  while (count_ && (int32_t)((uint32_t)now_ms - time_ms_[head_]) > (int32_t)window_ms) {
+    sum_ -= rssi_[head_];
+    head_ = (head_ + 1) % LOC_WINDOW_SAMPLES;
+    count_--;
+  }
+}
+
+void rssi_window::add(uint64_t timestamp_ms, int8_t rssi, uint32_t window_ms)
+{
+  expire(timestamp_ms, window_ms);
+
+  if (count_ == LOC_WINDOW_SAMPLES) {
+    sum_ -= rssi_[head_];
+    head_ = (head_ + 1) % LOC_WINDOW_SAMPLES;
+    count_--;
+  }
+
+  uint8_t tail = (head_ + count_) % LOC_WINDOW_SAMPLES;
+  time_ms_[tail] = (uint32_t)timestamp_ms;
+  rssi_[tail] = rssi;
+  sum_ += rssi;
+  count_++;
+
+  if (timestamp_ms > newest_ms_)
+    newest_ms_ = timestamp_ms;
+}
+
+rssi_localizer::rssi_localizer(const localizer_config_t &config)
+  : config_(config)
+{
+  // Weight of an anchor is 1/d^2 with d from the log-distance model
+  //   d = 10 ^ ((tx_power_1m - rssi) / (10 * n))
+  // so the weight is 10 ^ ((rssi - tx_power_1m) / (5 * n)). Precompute it per
+  // integer dBm, the hot path only interpolates.
+  for (size_t i = 0; i < weight_lut_.size(); i++) {
+    float rssi = -(float)i;
+    weight_lut_[i] = std::pow(10.0f, (rssi - config_.tx_power_1m_dbm) / (5.0f * config_.path_loss_exp));
+  }
+}
+
+void rssi_localizer::add_anchor(const anchor_t &anchor)
+{
+  auto it = anchor_index_.find(anchor.address);
+  if (it != anchor_index_.end()) {
+    anchors_[it->second] = anchor;
+    return;
+  }
+
+  anchor_index_[anchor.address] = (uint16_t)anchors_.size();
+  anchors_.push_back(anchor);
+}
+
+float rssi_localizer::weight_for(float mean_rssi) const
+{
+  float pos = -mean_rssi;
+  if (pos <= 0.0f)
+    return weight_lut_[0];
+  if (pos >= (float)(weight_lut_.size() - 1))
+    return weight_lut_[weight_lut_.size() - 1];
+
+  size_t idx  = (size_t)pos;
+  float  frac = pos - (float)idx;
+  return weight_lut_[idx] + (weight_lut_[idx + 1] - weight_lut_[idx]) * frac;
+}
+
+bool rssi_localizer::ingest(const rssi_observation_t &obs, location_estimate_t *estimate)
+{
+  auto anchor = anchor_index_.find(obs.anchor);
+  if (anchor == anchor_index_.end() || obs.rssi < config_.min_rssi_dbm) {
+    dropped_++;
+    return false;
+  }
+
+  helmet_state_t &state = helmets_[obs.helmet];
+
+  pair_slot_t *slot = nullptr;
+  for (uint8_t i = 0; i < state.slot_count; i++) {
+    if (state.slots[i].anchor_index == anchor->second) {
+      slot = &state.slots[i];
+      break;
+    }
+  }
+
+  if (slot == nullptr) {
+    if (state.slot_count < LOC_MAX_ANCHORS_PER_HELMET) {
+      slot = &state.slots[state.slot_count++];
+    }
+    else {
+      // Table is full, take over the slot of the weakest anchor
+      slot = &state.slots[0];
+      for (uint8_t i = 1; i < state.slot_count; i++) {
+        if (state.slots[i].window.empty() ||
+            (!slot->window.empty() && state.slots[i].window.mean() < slot->window.mean()))
+          slot = &state.slots[i];
+      }
+    }
+    slot->anchor_index = anchor->second;
+    slot->window = rssi_window();
+  }
+
+  slot->window.add(obs.timestamp_ms, obs.rssi, config_.window_ms);
+
+  if (estimate != nullptr)
+    compute(obs.helmet, state, obs.timestamp_ms, estimate);
+
+  return true;
+}
+
+bool rssi_localizer::estimate(uint16_t helmet, uint64_t now_ms, location_estimate_t *estimate)
+{
+  auto it = helmets_.find(helmet);
+  if (it == helmets_.end())
+    return false;
+
+  compute(helmet, it->second, now_ms, estimate);
+  return true;
+}
+
+void rssi_localizer::compute(uint16_t helmet, helmet_state_t &state, uint64_t now_ms,
+                             location_estimate_t *estimate)
+{
+  struct zone_weight_t {
+    uint16_t zone;
+    float    weight;
+  };
+  zone_weight_t zones[LOC_MAX_ANCHORS_PER_HELMET];
+  uint8_t zone_count = 0;
+
+  float    sum_w = 0.0f, sum_x = 0.0f, sum_y = 0.0f;
+  uint64_t newest = 0;
+
+  uint8_t i = 0;
+  while (i < state.slot_count) {
+    pair_slot_t &slot = state.slots[i];
+    slot.window.expire(now_ms, config_.window_ms);
+
+    // Drop anchors that no longer hear the helmet, the last slot moves in
+    if (slot.window.empty()) {
+      state.slots[i] = state.slots[--state.slot_count];
+      continue;
+    }
+
+    const anchor_t &anchor = anchors_[slot.anchor_index];
+    float w = weight_for(slot.window.mean());
+
+    sum_w += w;
+    sum_x += w * anchor.x_m;
+    sum_y += w * anchor.y_m;
+    if (slot.window.newest_ms() > newest)
+      newest = slot.window.newest_ms();
+
+    uint8_t z = 0;
+    while (z < zone_count && zones[z].zone != anchor.zone)
+      z++;
+    if (z == zone_count)
+      zones[zone_count++] = { anchor.zone, 0.0f };
+    zones[z].weight += w;
+
+    i++;
+  }
+
+  estimate->helmet       = helmet;
+  estimate->anchor_count = state.slot_count;
+  estimate->timestamp_ms = newest;
+
+  if (state.slot_count == 0) {
+    estimate->zone = LOC_ZONE_NONE;
+    estimate->x_m  = 0.0f;
+    estimate->y_m  = 0.0f;
+    return;
+  }
+
+  estimate->x_m = sum_x / sum_w;
+  estimate->y_m = sum_y / sum_w;
+
+  uint8_t best = 0;
+  for (uint8_t z = 1; z < zone_count; z++) {
+    if (zones[z].weight > zones[best].weight)
+      best = z;
+  }
+  estimate->zone = zones[best].zone;
+}
+
+} // namespace lpedt
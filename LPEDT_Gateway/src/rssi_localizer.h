@@ -0,0 +1,147 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    rssi_localizer.h
+ * @brief   Gateway side zone/position estimation for helmets from the RSSI
+ *          values reported by the fixed anchor nodes (get_rssi_status).
+ *
+ *          Every (helmet, anchor) pair keeps a time bounded sliding window of
+ *          RSSI samples with a running sum, so adding a sample and reading the
+ *          window mean are both O(1). The position of a helmet is the weighted
+ *          centroid of the anchors that currently hear it, weighted by the
+ *          inverse square of the log-distance path loss range estimate.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef LPEDT_GATEWAY_RSSI_LOCALIZER_H_
+#define LPEDT_GATEWAY_RSSI_LOCALIZER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace lpedt {
+
+// Max number of anchors tracked per helmet. A helmet is rarely heard by more
+// than a handful of anchors, the weakest one is replaced once this is full.
+#define LOC_MAX_ANCHORS_PER_HELMET  (16)
+
+// Max number of samples kept in one (helmet, anchor) window
+#define LOC_WINDOW_SAMPLES          (16)
+
+#define LOC_ZONE_NONE               (0xFFFF)
+
+struct anchor_t {
+  uint16_t address;   // mesh unicast address of the anchor node
+  uint16_t zone;      // zone the anchor is installed in
+  float    x_m;       // position in meters
+  float    y_m;
+};
+
+struct rssi_observation_t {
+  uint64_t timestamp_ms;
+  uint16_t helmet;    // mesh unicast address of the helmet
+  uint16_t anchor;    // mesh unicast address of the anchor that heard it
+  int8_t   rssi;      // dBm
+};
+
+struct location_estimate_t {
+  uint16_t helmet;
+  uint16_t zone;          // LOC_ZONE_NONE if no anchor hears the helmet
+  uint8_t  anchor_count;  // anchors that contributed to the estimate
+  float    x_m;
+  float    y_m;
+  uint64_t timestamp_ms;  // time of the newest sample used
+};
+
+struct localizer_config_t {
+  uint32_t window_ms        = 5000;   // samples older than this are dropped
+  float    tx_power_1m_dbm  = -59.0f; // RSSI at 1 m from the anchor
+  float    path_loss_exp    = 2.7f;   // log-distance path loss exponent
+  int8_t   min_rssi_dbm     = -100;   // samples below this are ignored
+};
+
+/**
+ * Fixed capacity ring of RSSI samples with a running sum. Samples are evicted
+ * once they fall out of the time window or the ring wraps.
+ */
+class rssi_window {
+public:
+  void     add(uint64_t timestamp_ms, int8_t rssi, uint32_t window_ms);
+  void     expire(uint64_t now_ms, uint32_t window_ms);
+  bool     empty() const { return count_ == 0; }
+  uint8_t  count() const { return count_; }
+  float    mean() const { return (float)sum_ / (float)count_; }
+  uint64_t newest_ms() const { return newest_ms_; }
+
+private:
+  std::array<uint32_t, LOC_WINDOW_SAMPLES> time_ms_{}; // low 32 bits are enough inside a window
+  std::array<int8_t, LOC_WINDOW_SAMPLES>   rssi_{};
+  int32_t  sum_   = 0;
+  uint8_t  head_  = 0;   // oldest sample
+  uint8_t  count_ = 0;
+  uint64_t newest_ms_ = 0;
+};
+
+class rssi_localizer {
+public:
+  explicit rssi_localizer(const localizer_config_t &config = localizer_config_t());
+
+  // Anchors must be registered before observations referencing them arrive,
+  // observations from unknown anchors are counted and dropped.
+  void add_anchor(const anchor_t &anchor);
+
+  /**
+   * @brief   Feed one RSSI observation and update the estimate of its helmet
+   * @param   obs       the observation
+   * @param   estimate  optional, receives the updated estimate
+   * @return  true if the observation was used
+   */
+  bool ingest(const rssi_observation_t &obs, location_estimate_t *estimate = nullptr);
+
+  /**
+   * @brief   Current estimate of a helmet, with windows expired against now_ms
+   * @return  false if the helmet has never been seen
+   */
+  bool estimate(uint16_t helmet, uint64_t now_ms, location_estimate_t *estimate);
+
+  size_t   helmet_count() const { return helmets_.size(); }
+  uint64_t dropped_count() const { return dropped_; }
+
+private:
+  struct pair_slot_t {
+    uint16_t    anchor_index;
+    rssi_window window;
+  };
+
+  struct helmet_state_t {
+    std::array<pair_slot_t, LOC_MAX_ANCHORS_PER_HELMET> slots;
+    uint8_t slot_count = 0;
+  };
+
+  float weight_for(float mean_rssi) const;
+  void  compute(uint16_t helmet, helmet_state_t &state, uint64_t now_ms, location_estimate_t *estimate);
+
+  localizer_config_t                             config_;
+  std::vector<anchor_t>                          anchors_;
+  std::unordered_map<uint16_t, uint16_t>         anchor_index_;
+  std::unordered_map<uint16_t, helmet_state_t>   helmets_;
+  std::array<float, 129>                         weight_lut_{}; // index = -rssi, 0..-128 dBm
+  uint64_t                                       dropped_ = 0;
+};
+
+} // namespace lpedt
+
+#endif /* LPEDT_GATEWAY_RSSI_LOCALIZER_H_ */
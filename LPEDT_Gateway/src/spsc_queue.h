@@ -0,0 +1,102 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    spsc_queue.h
+ * @brief   Bounded lock-free single producer, single consumer ring.
+ *
+ *          Each side owns one index and keeps a cached copy of the other
+ *          one, so the shared cache line is only read when the cached copy
+ *          says the ring looks full (producer) or empty (consumer). The two
+ *          sides live on separate cache lines.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef LPEDT_GATEWAY_SPSC_QUEUE_H_
+#define LPEDT_GATEWAY_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace lpedt {
+
+#define SPSC_CACHE_LINE  (64)
+
+template <typename T>
+class spsc_queue {
+public:
+  // Capacity is rounded up to a power of two
+  explicit spsc_queue(size_t capacity)
+  {
+    size_t size = 2;
+    while (size < capacity)
+      size <<= 1;
+    slots_.resize(size);
+    mask_ = size - 1;
+  }
+
+  spsc_queue(const spsc_queue &) = delete;
+  spsc_queue &operator=(const spsc_queue &) = delete;
+
+  // Producer side, false if the ring is full
+  bool push(const T &item)
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_)
+        return false;
+    }
+    slots_[tail & mask_] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, false if the ring is empty
+  bool pop(T &item)
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_)
+        return false;
+    }
+    item = slots_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Either side, exact only while the other one is idle
+  size_t size() const
+  {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+
+private:
+  // Consumer
+  alignas(SPSC_CACHE_LINE) std::atomic<size_t> head_{0};
+  size_t tail_cache_ = 0;
+
+  // Producer
+  alignas(SPSC_CACHE_LINE) std::atomic<size_t> tail_{0};
+  size_t head_cache_ = 0;
+
+  alignas(SPSC_CACHE_LINE) std::vector<T> slots_;
+  size_t mask_ = 0;
+};
+
+} // namespace lpedt
+
+#endif /* LPEDT_GATEWAY_SPSC_QUEUE_H_ */
@@ -0,0 +1,488 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    tlog_decoder.cpp
+ * @brief   ELF string table extraction and tokenized log frame decoding
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "tlog_decoder.h"
+
+#include <elf.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace lpedt {
+
+// Shortest run of printable bytes kept as a constant string
+#define TLOG_MIN_STRING  (2)
+
+static std::string escape(const std::string &s)
+{
+  std::string out;
+  for (unsigned char c : s) {
+    switch (c) {
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (c < 0x20 || c >= 0x7F) {
+          char hex[5];
+          snprintf(hex, sizeof(hex), "\\x%02X", c);
+          out += hex;
+        }
+        else {
+          out += (char)c;
+        }
+    }
+  }
+  return out;
+}
+
+static std::string unescape(const std::string &s)
+{
+  std::string out;
+  for (size_t i = 0; i < s.size(); i++) {
+    if (s[i] != '\\' || i + 1 == s.size()) {
+      out += s[i];
+      continue;
+    }
+    switch (s[++i]) {
+      case 'n': out += '\n'; break;
+      case 'r': out += '\r'; break;
+      case 't': out += '\t'; break;
+      case 'x':
+        out += (char)strtoul(s.substr(i + 1, 2).c_str(), nullptr, 16);
+        i += 2;
+        break;
+      default: out += s[i]; break;
+    }
+  }
+  return out;
+}
+
+static bool printable(unsigned char c)
+{
+  return (c >= 0x20 && c < 0x7F) || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Section walk shared by the 32 bit target image and 64 bit host builds
+template <typename ehdr_t, typename shdr_t>
+static bool read_sections(const std::vector<uint8_t> &elf,
+                          std::map<uint32_t, std::string> &formats,
+                          std::map<uint32_t, std::string> &strings,
+                          std::string &error)
+{
+  if (elf.size() < sizeof(ehdr_t)) {
+    error = "truncated ELF header";
+    return false;
+  }
+  ehdr_t eh;
+  memcpy(&eh, elf.data(), sizeof(eh));
+
+  if (eh.e_shentsize != sizeof(shdr_t) || eh.e_shstrndx >= eh.e_shnum
+      || eh.e_shoff + (uint64_t)eh.e_shnum * sizeof(shdr_t) > elf.size()) {
+    error = "bad section header table";
+    return false;
+  }
+
+  std::vector<shdr_t> sh(eh.e_shnum);
+  memcpy(sh.data(), &elf[eh.e_shoff], eh.e_shnum * sizeof(shdr_t));
+
+  const shdr_t &names = sh[eh.e_shstrndx];
+  bool found = false;
+
+  for (const shdr_t &s : sh) {
+    if (s.sh_type != SHT_PROGBITS || s.sh_offset + s.sh_size > elf.size()
+        || s.sh_name >= names.sh_size) {
+      continue;
+    }
+    const char *name = (const char *)&elf[names.sh_offset + s.sh_name];
+    const uint8_t *data = &elf[s.sh_offset];
+    bool fmt = strcmp(name, TLOG_FMT_SECTION) == 0;
+
+    // Formats: every string in the section. Constant strings: printable
+    // runs ending in a NUL in read only loaded sections, .rodata is folded
+    // into .text by the Silicon Labs linker script.
+    if (!fmt && (!(s.sh_flags & SHF_ALLOC) || (s.sh_flags & SHF_WRITE))) {
+      continue;
+    }
+    found |= fmt;
+
+    size_t start = 0;
+    for (size_t i = 0; i < s.sh_size; i++) {
+      if (data[i] == 0) {
+        if (i - start >= (fmt ? 1 : TLOG_MIN_STRING)) {
+          std::string str((const char *)&data[start], i - start);
+          (fmt ? formats : strings)[(uint32_t)(s.sh_addr + start)] = str;
+        }
+        start = i + 1;
+      }
+      else if (!fmt && !printable(data[i])) {
+        start = i + 1;
+      }
+    }
+  }
+
+  if (!found) {
+    error = "no " TLOG_FMT_SECTION " section, firmware built without TLOG_ENABLE?";
+    return false;
+  }
+  return true;
+}
+
+bool tlog_table::load_elf(const std::string &path, std::string &error)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    error = "cannot open " + path;
+    return false;
+  }
+  std::vector<uint8_t> elf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  if (elf.size() < EI_NIDENT || memcmp(elf.data(), ELFMAG, SELFMAG) != 0) {
+    error = path + " is not an ELF file";
+    return false;
+  }
+  if (elf[EI_DATA] != ELFDATA2LSB) {
+    error = "only little endian ELF files are supported";
+    return false;
+  }
+
+  if (elf[EI_CLASS] == ELFCLASS32)
+    return read_sections<Elf32_Ehdr, Elf32_Shdr>(elf, formats_, strings_, error);
+  return read_sections<Elf64_Ehdr, Elf64_Shdr>(elf, formats_, strings_, error);
+}
+
+bool tlog_table::load(const std::string &path, std::string &error)
+{
+  std::ifstream in(path);
+  if (!in) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  std::string line;
+  unsigned n = 0;
+  while (std::getline(in, line)) {
+    n++;
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    size_t sp = line.find(' ', 2);
+    if (line.size() < 4 || line[1] != ' ' || sp == std::string::npos
+        || (line[0] != 'F' && line[0] != 'S')) {
+      error = path + ":" + std::to_string(n) + ": malformed line";
+      return false;
+    }
+    uint32_t key = (uint32_t)strtoul(line.substr(2, sp - 2).c_str(), nullptr, 0);
+    (line[0] == 'F' ? formats_ : strings_)[key] = unescape(line.substr(sp + 1));
+  }
+  return true;
+}
+
+void tlog_table::save(FILE *out) const
+{
+  fprintf(out, "# tlog side table, F <token> <format> / S <address> <string>\n");
+  for (const auto &f : formats_)
+    fprintf(out, "F 0x%X %s\n", f.first, escape(f.second).c_str());
+  for (const auto &s : strings_)
+    fprintf(out, "S 0x%08X %s\n", s.first, escape(s.second).c_str());
+}
+
+const std::string *tlog_table::format(uint32_t token) const
+{
+  auto it = formats_.find(token);
+  return it == formats_.end() ? nullptr : &it->second;
+}
+
+bool tlog_table::flash_string(uint32_t addr, std::string &out) const
+{
+  // The pointer may be into the middle of a merged string
+  auto it = strings_.upper_bound(addr);
+  if (it == strings_.begin())
+    return false;
+  --it;
+  if (addr - it->first >= it->second.size())
+    return false;
+
+  out = it->second.substr(addr - it->first);
+  return true;
+}
+
+void tlog_decoder::feed(const uint8_t *data, size_t len, std::string &out)
+{
+  for (size_t i = 0; i < len; i++) {
+    uint8_t b = data[i];
+
+    switch (state_) {
+      case state_t::TEXT:
+        if (b == TLOG_SYNC_RECORD || b == TLOG_SYNC_DROPPED) {
+          sync_ = b;
+          state_ = state_t::LENGTH;
+        }
+        else {
+          out += (char)b;
+        }
+        break;
+
+      case state_t::LENGTH:
+        len_ = b;
+        payload_.clear();
+        state_ = len_ ? state_t::PAYLOAD : state_t::SUM;
+        break;
+
+      case state_t::PAYLOAD:
+        payload_.push_back(b);
+        if (payload_.size() == len_)
+          state_ = state_t::SUM;
+        break;
+
+      case state_t::SUM: {
+        uint8_t sum = 0;
+        for (uint8_t p : payload_)
+          sum += p;
+        state_ = state_t::TEXT;
+        if (sum != b) {
+          stats_.bad_frames++;
+          out += "<tlog: bad frame>\n";
+          break;
+        }
+        frame(out);
+        break;
+      }
+    }
+  }
+}
+
+static bool get_varint(const uint8_t *&p, const uint8_t *end, uint64_t &v)
+{
+  v = 0;
+  for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t b = *p++;
+    v |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+void tlog_decoder::frame(std::string &out)
+{
+  const uint8_t *p = payload_.data();
+  const uint8_t *end = p + payload_.size();
+
+  if (sync_ == TLOG_SYNC_DROPPED) {
+    uint64_t n = 0;
+    get_varint(p, end, n);
+    stats_.dropped += n;
+    out += "<tlog: " + std::to_string(n) + " records dropped>\n";
+    return;
+  }
+
+  record(p, payload_.size(), out);
+}
+
+void tlog_decoder::record(const uint8_t *p, size_t len, std::string &out)
+{
+  const uint8_t *end = p + len;
+  uint64_t token;
+
+  stats_.records++;
+  if (!get_varint(p, end, token)) {
+    stats_.bad_frames++;
+    out += "<tlog: bad frame>\n";
+    return;
+  }
+
+  const std::string *fmt = table_.format((uint32_t)token);
+  if (!fmt) {
+    char msg[48];
+    snprintf(msg, sizeof(msg), "<tlog: unknown token 0x%X>\n", (unsigned)token);
+    stats_.unknown++;
+    out += msg;
+    return;
+  }
+
+  bool truncated = false;
+  const char *f = fmt->c_str();
+
+  while (*f) {
+    if (*f != '%') {
+      out += *f++;
+      continue;
+    }
+    if (f[1] == '%') {
+      out += '%';
+      f += 2;
+      continue;
+    }
+
+    // %[flags][width][.precision][length]conversion, rebuilt for the host
+    // printf with the length replaced by the host type used below
+    std::string spec = "%";
+    f++;
+    while (*f && strchr("-+ #0", *f))
+      spec += *f++;
+
+    std::vector<long long> stars;
+    auto take_star = [&]() {
+      uint64_t v = 0;
+      if (!get_varint(p, end, v))
+        truncated = true;
+      stars.push_back((int32_t)v);
+      spec += '*';
+    };
+
+    if (*f == '*') {
+      take_star();
+      f++;
+    }
+    while (*f >= '0' && *f <= '9')
+      spec += *f++;
+    if (*f == '.') {
+      spec += *f++;
+      if (*f == '*') {
+        take_star();
+        f++;
+      }
+      while (*f >= '0' && *f <= '9')
+        spec += *f++;
+    }
+
+    // Target is ILP32, only ll/j are 64 bit
+    bool wide = false;
+    while (*f && strchr("hlLjzt", *f)) {
+      if ((f[0] == 'l' && f[1] == 'l') || f[0] == 'j') {
+        wide = true;
+      }
+      f += (f[0] == 'l' && f[1] == 'l') ? 2 : 1;
+    }
+
+    char conv = *f;
+    if (!conv)
+      break;
+    f++;
+
+    char buf[256];
+    int w0 = stars.size() > 0 ? (int)stars[0] : 0;
+    int w1 = stars.size() > 1 ? (int)stars[1] : 0;
+
+#define TLOG_PRINT(value) \
+    (stars.size() == 2 ? snprintf(buf, sizeof(buf), spec.c_str(), w0, w1, value) : \
+     stars.size() == 1 ? snprintf(buf, sizeof(buf), spec.c_str(), w0, value) : \
+                         snprintf(buf, sizeof(buf), spec.c_str(), value))
+
+    if (truncated || p >= end) {
+      truncated = true;
+      out += "<?>";
+      continue;
+    }
+
+    switch (conv) {
+      case 'd':
+      case 'i': {
+        uint64_t v = 0;
+        truncated |= !get_varint(p, end, v);
+        long long sv = wide ? (long long)v : (long long)(int32_t)(uint32_t)v;
+        spec += "ll";
+        spec += conv;
+        TLOG_PRINT(sv);
+        out += buf;
+        break;
+      }
+      case 'u': case 'o': case 'x': case 'X': {
+        uint64_t v = 0;
+        truncated |= !get_varint(p, end, v);
+        unsigned long long uv = wide ? v : (uint32_t)v;
+        spec += "ll";
+        spec += conv;
+        TLOG_PRINT(uv);
+        out += buf;
+        break;
+      }
+      case 'c': {
+        uint64_t v = 0;
+        truncated |= !get_varint(p, end, v);
+        spec += 'c';
+        TLOG_PRINT((int)(unsigned char)v);
+        out += buf;
+        break;
+      }
+      case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+        float v = 0;
+        if (end - p < (ptrdiff_t)sizeof(v)) {
+          truncated = true;
+          p = end;
+          out += "<?>";
+          break;
+        }
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        spec += conv;
+        TLOG_PRINT((double)v);
+        out += buf;
+        break;
+      }
+      case 's':
+      case 'p': {
+        // Pointers are always encoded as strings on the target
+        uint64_t tag = 0;
+        std::string s;
+        truncated |= !get_varint(p, end, tag);
+        if (tag == 0) {
+          uint32_t addr = 0;
+          if (end - p >= (ptrdiff_t)sizeof(addr)) {
+            memcpy(&addr, p, sizeof(addr));
+            p += sizeof(addr);
+          }
+          else {
+            truncated = true;
+            p = end;
+          }
+          if (!table_.flash_string(addr, s)) {
+            char a[16];
+            snprintf(a, sizeof(a), "<0x%08X>", addr);
+            s = a;
+          }
+        }
+        else {
+          size_t n = (size_t)tag - 1;
+          if ((size_t)(end - p) < n) {
+            truncated = true;
+            n = end - p;
+          }
+          s.assign((const char *)p, n);
+          p += n;
+        }
+        spec += 's';
+        TLOG_PRINT(s.c_str());
+        out += buf;
+        break;
+      }
+      default:
+        out += "<?" + std::string(1, conv) + ">";
+        break;
+    }
+#undef TLOG_PRINT
+  }
+
+  if (truncated)
+    stats_.truncated++;
+}
+
+} // namespace lpedt
@@ -0,0 +1,112 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    tlog_decoder.h
+ * @brief   Host side decoder for the tokenized VCOM log of the helmet and
+ *          miner firmware (tlog.h in the firmware projects).
+ *
+ *          The format strings live in the non allocated .tlog_fmt section of
+ *          the .axf, the token of a record is the offset of its string in
+ *          that section. %s arguments that point into flash are read from the
+ *          loaded sections of the same file. Both can be exported to a text
+ *          side table so a log can be decoded without the .axf.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef LPEDT_GATEWAY_TLOG_DECODER_H_
+#define LPEDT_GATEWAY_TLOG_DECODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace lpedt {
+
+// Must match tlog.h
+#define TLOG_SYNC_RECORD   (0xA5)
+#define TLOG_SYNC_DROPPED  (0xA6)
+#define TLOG_FMT_SECTION   ".tlog_fmt"
+
+class tlog_table {
+public:
+  /**
+   * @brief   Load the format strings and constant strings from an ELF file
+   * @return  false with error set if the file is unusable
+   */
+  bool load_elf(const std::string &path, std::string &error);
+
+  /**
+   * @brief   Load a side table written by save()
+   */
+  bool load(const std::string &path, std::string &error);
+
+  /**
+   * @brief   Write the side table, one "F <token> <format>" line per format
+   *          string and one "S <address> <string>" line per constant string,
+   *          with C escapes
+   */
+  void save(FILE *out) const;
+
+  const std::string *format(uint32_t token) const;
+
+  // Constant string at a flash address, false if unknown
+  bool flash_string(uint32_t addr, std::string &out) const;
+
+  size_t format_count() const { return formats_.size(); }
+
+private:
+  std::map<uint32_t, std::string> formats_;
+  std::map<uint32_t, std::string> strings_;
+};
+
+struct tlog_stats_t {
+  uint64_t records      = 0;
+  uint64_t dropped      = 0;  // records the firmware reported lost
+  uint64_t bad_frames   = 0;  // checksum errors
+  uint64_t unknown      = 0;  // tokens missing from the table
+  uint64_t truncated    = 0;  // records with fewer arguments than the format
+};
+
+/**
+ * Stream decoder. Bytes outside frames are passed through unchanged, so the
+ * plain text the stack or app_assert() print stays readable.
+ */
+class tlog_decoder {
+public:
+  explicit tlog_decoder(const tlog_table &table) : table_(table) {}
+
+  // Decode a chunk of the VCOM stream, text is appended to out
+  void feed(const uint8_t *data, size_t len, std::string &out);
+
+  const tlog_stats_t &stats() const { return stats_; }
+
+private:
+  enum class state_t { TEXT, LENGTH, PAYLOAD, SUM };
+
+  void frame(std::string &out);
+  void record(const uint8_t *p, size_t len, std::string &out);
+
+  const tlog_table     &table_;
+  tlog_stats_t          stats_;
+  state_t               state_ = state_t::TEXT;
+  uint8_t               sync_  = 0;
+  uint8_t               len_   = 0;
+  std::vector<uint8_t>  payload_;
+};
+
+} // namespace lpedt
+
+#endif /* LPEDT_GATEWAY_TLOG_DECODER_H_ */
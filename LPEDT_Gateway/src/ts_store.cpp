@@ -0,0 +1,479 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ts_store.cpp
+ * @brief   Chunk encoding, the mapped file and the queries of ts_store
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "ts_store.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace lpedt {
+
+// File grows in steps of this many blocks, and is trimmed on close
+#define TS_GROW_BLOCKS      (256)
+
+// Longest sample in the bit stream, 4 + 32 bits of time and 4 + 33 of value
+#define TS_MAX_SAMPLE_BITS  (73)
+
+struct ts_store::file_header_t {
+  char     magic[8];
+  uint32_t block_size;
+  uint32_t blocks;        // in use, this one included
+};
+
+struct ts_store::chunk_header_t {
+  uint32_t magic;
+  uint16_t helmet;
+  uint8_t  signal;
+  uint8_t  sealed;
+  uint32_t count;
+  uint32_t bits;          // used in the stream
+  int64_t  t_first;
+  int64_t  t_last;
+  int32_t  v_first;
+  int32_t  v_last;
+  int32_t  v_min;
+  int32_t  v_max;
+  int64_t  v_sum;
+  int64_t  last_delta;    // ms between the last two samples, for the encoder
+};
+
+#define TS_CHUNK_HEADER_SIZE  (64)
+#define TS_STREAM_BITS        ((TS_BLOCK_SIZE - TS_CHUNK_HEADER_SIZE) * 8)
+
+static const char *signal_names[] = {
+  "temperature", "humidity", "gas", "pressure",
+  "acc_x", "acc_y", "acc_z", "gyro_x", "gyro_y", "gyro_z",
+};
+
+const char *ts_signal_name(ts_signal_t signal)
+{
+  return signal < ts_signal_t::count ? signal_names[(int)signal] : "?";
+}
+
+/*
+ * Bit stream, most significant bit first. Blocks come zeroed from
+ * ftruncate(), so writing only has to OR bits in.
+ */
+static inline uint64_t zigzag(int64_t v)
+{
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v)
+{
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static void put_bits(uint8_t *p, uint32_t &pos, uint64_t v, int n)
+{
+  while (n > 0) {
+    int room = 8 - (int)(pos & 7);
+    int take = n < room ? n : room;
+    uint8_t bits = (uint8_t)((v >> (n - take)) & ((1u << take) - 1));
+    p[pos >> 3] |= (uint8_t)(bits << (room - take));
+    pos += take;
+    n -= take;
+  }
+}
+
+static uint64_t get_bits(const uint8_t *p, uint32_t &pos, int n)
+{
+  uint64_t v = 0;
+  while (n > 0) {
+    int room = 8 - (int)(pos & 7);
+    int take = n < room ? n : room;
+    uint8_t bits = (uint8_t)((p[pos >> 3] >> (room - take)) & ((1u << take) - 1));
+    v = (v << take) | bits;
+    pos += take;
+    n -= take;
+  }
+  return v;
+}
+
+// Number of leading 1 bits, at most max
+static int get_prefix(const uint8_t *p, uint32_t &pos, int max)
+{
+  int n = 0;
+  while (n < max && get_bits(p, pos, 1))
+    n++;
+  return n;
+}
+
+// Payload bits per prefix class, class 0 is a zero and carries none
+static const int time_class_bits[]  = { 0, 7, 9, 12, 32 };
+static const int value_class_bits[] = { 0, 4, 8, 16, 33 };
+
+static void put_class(uint8_t *p, uint32_t &pos, uint64_t zz, const int *class_bits)
+{
+  int c = 0;
+  if (zz != 0) {
+    c = 1;
+    while (c < 4 && zz >= (1ull << class_bits[c]))
+      c++;
+  }
+
+  // c ones, then a terminating zero below the last class
+  put_bits(p, pos, (1u << c) - 1, c);
+  if (c < 4)
+    put_bits(p, pos, 0, 1);
+  put_bits(p, pos, zz, class_bits[c]);
+}
+
+static uint64_t get_class(const uint8_t *p, uint32_t &pos, const int *class_bits)
+{
+  int c = get_prefix(p, pos, 4);
+  return get_bits(p, pos, class_bits[c]);
+}
+
+/*
+ * File
+ */
+ts_store::~ts_store()
+{
+  close();
+}
+
+ts_store::chunk_header_t *ts_store::chunk(uint32_t block)
+{
+  static_assert(sizeof(chunk_header_t) == TS_CHUNK_HEADER_SIZE, "chunk header layout");
+  return (chunk_header_t *)(map_ + (size_t)block * TS_BLOCK_SIZE);
+}
+
+const ts_store::chunk_header_t *ts_store::chunk(uint32_t block) const
+{
+  return (const chunk_header_t *)(map_ + (size_t)block * TS_BLOCK_SIZE);
+}
+
+bool ts_store::open(const std::string &path, std::string &error)
+{
+  close();
+
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ < 0) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  fstat(fd_, &st);
+  bool fresh = st.st_size == 0;
+  size_t bytes = fresh ? (size_t)TS_GROW_BLOCKS * TS_BLOCK_SIZE : (size_t)st.st_size;
+
+  if ((fresh && ftruncate(fd_, (off_t)bytes) != 0) || bytes % TS_BLOCK_SIZE != 0) {
+    error = path + ": not a store, or cannot be sized";
+    close();
+    return false;
+  }
+
+  void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (map == MAP_FAILED) {
+    error = path + ": mmap: " + strerror(errno);
+    close();
+    return false;
+  }
+  map_ = (uint8_t *)map;
+  map_bytes_ = bytes;
+
+  file_header_t *hdr = (file_header_t *)map_;
+  if (fresh) {
+    memcpy(hdr->magic, TS_FILE_MAGIC, sizeof(hdr->magic));
+    hdr->block_size = TS_BLOCK_SIZE;
+    hdr->blocks = 1;
+    return true;
+  }
+
+  if (memcmp(hdr->magic, TS_FILE_MAGIC, sizeof(hdr->magic)) != 0 || hdr->block_size != TS_BLOCK_SIZE ||
+      (size_t)hdr->blocks * TS_BLOCK_SIZE > map_bytes_) {
+    error = path + ": not a store";
+    close();
+    return false;
+  }
+
+  // Rebuild the index, blocks of a series are in time order in the file
+  for (uint32_t b = 1; b < hdr->blocks; b++) {
+    const chunk_header_t *c = chunk(b);
+    if (c->magic != TS_CHUNK_MAGIC || c->count == 0) {
+      error = path + ": bad chunk at block " + std::to_string(b);
+      close();
+      return false;
+    }
+    series_[key(c->helmet, (ts_signal_t)c->signal)].blocks.push_back(b);
+  }
+  return true;
+}
+
+void ts_store::close()
+{
+  if (map_) {
+    size_t used = (size_t)((file_header_t *)map_)->blocks * TS_BLOCK_SIZE;
+    msync(map_, used, MS_SYNC);
+    munmap(map_, map_bytes_);
+    if (ftruncate(fd_, (off_t)used) != 0) {
+      // Spare blocks stay in the file, they are ignored on open
+    }
+    map_ = nullptr;
+    map_bytes_ = 0;
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  series_.clear();
+  refused_ = 0;
+}
+
+void ts_store::sync()
+{
+  if (map_)
+    msync(map_, (size_t)((file_header_t *)map_)->blocks * TS_BLOCK_SIZE, MS_ASYNC);
+}
+
+bool ts_store::grow(uint32_t blocks)
+{
+  file_header_t *hdr = (file_header_t *)map_;
+  size_t need = (size_t)(hdr->blocks + blocks) * TS_BLOCK_SIZE;
+  if (need <= map_bytes_)
+    return true;
+
+  size_t bytes = std::max(need, map_bytes_ + (size_t)TS_GROW_BLOCKS * TS_BLOCK_SIZE);
+  bytes = std::max(bytes, map_bytes_ * 2);
+  if (ftruncate(fd_, (off_t)bytes) != 0)
+    return false;
+
+  void *map = mremap(map_, map_bytes_, bytes, MREMAP_MAYMOVE);
+  if (map == MAP_FAILED)
+    return false;
+  map_ = (uint8_t *)map;
+  map_bytes_ = bytes;
+  return true;
+}
+
+uint32_t ts_store::new_chunk(uint16_t helmet, ts_signal_t signal, int64_t t_ms, int32_t value)
+{
+  if (!grow(1))
+    return 0;
+
+  file_header_t *hdr = (file_header_t *)map_;
+  uint32_t block = hdr->blocks;
+
+  chunk_header_t *c = chunk(block);
+  c->magic = TS_CHUNK_MAGIC;
+  c->helmet = helmet;
+  c->signal = (uint8_t)signal;
+  c->sealed = 0;
+  c->count = 1;
+  c->bits = 0;
+  c->t_first = c->t_last = t_ms;
+  c->v_first = c->v_last = c->v_min = c->v_max = value;
+  c->v_sum = value;
+  c->last_delta = 0;
+
+  hdr->blocks = block + 1;
+  return block;
+}
+
+bool ts_store::append(uint16_t helmet, ts_signal_t signal, int64_t t_ms, int32_t value)
+{
+  if (!map_)
+    return false;
+
+  series_t &s = series_[key(helmet, signal)];
+  if (s.blocks.empty()) {
+    uint32_t block = new_chunk(helmet, signal, t_ms, value);
+    if (!block)
+      return false;
+    s.blocks.push_back(block);
+    return true;
+  }
+
+  chunk_header_t *c = chunk(s.blocks.back());
+  if (t_ms < c->t_last) {
+    refused_++;
+    return false;
+  }
+
+  int64_t delta = t_ms - c->t_last;
+  uint64_t t_zz = zigzag(delta - c->last_delta);
+
+  // A gap the time classes cannot hold, or a full stream, starts a chunk
+  if (t_zz >= (1ull << 32) || c->bits + TS_MAX_SAMPLE_BITS > TS_STREAM_BITS) {
+    c->sealed = 1;
+    uint32_t block = new_chunk(helmet, signal, t_ms, value);
+    if (!block)
+      return false;
+    s.blocks.push_back(block);
+    return true;
+  }
+
+  uint8_t *stream = (uint8_t *)(c + 1);
+  uint32_t pos = c->bits;
+  put_class(stream, pos, t_zz, time_class_bits);
+  put_class(stream, pos, zigzag((int64_t)value - c->v_last), value_class_bits);
+
+  c->bits = pos;
+  c->count++;
+  c->t_last = t_ms;
+  c->last_delta = delta;
+  c->v_last = value;
+  c->v_min = std::min(c->v_min, value);
+  c->v_max = std::max(c->v_max, value);
+  c->v_sum += value;
+  return true;
+}
+
+/*
+ * Queries
+ */
+void ts_store::decode(const chunk_header_t *c, int64_t from_ms, int64_t to_ms, std::vector<ts_sample_t> &out) const
+{
+  const uint8_t *stream = (const uint8_t *)(c + 1);
+  uint32_t pos = 0;
+  int64_t t = c->t_first, delta = 0;
+  int64_t v = c->v_first;
+
+  for (uint32_t i = 0;; i++) {
+    if (t >= to_ms)
+      return;
+    if (t >= from_ms)
+      out.push_back({ t, (int32_t)v });
+    if (i + 1 == c->count)
+      return;
+
+    delta += unzigzag(get_class(stream, pos, time_class_bits));
+    t += delta;
+    v += unzigzag(get_class(stream, pos, value_class_bits));
+  }
+}
+
+size_t ts_store::read(uint16_t helmet, ts_signal_t signal, int64_t from_ms, int64_t to_ms,
+                      std::vector<ts_sample_t> &out) const
+{
+  auto it = series_.find(key(helmet, signal));
+  if (it == series_.end() || from_ms >= to_ms)
+    return 0;
+
+  // First chunk still holding samples at or after from_ms
+  const std::vector<uint32_t> &blocks = it->second.blocks;
+  auto first = std::partition_point(blocks.begin(), blocks.end(),
+                                    [&](uint32_t b) { return chunk(b)->t_last < from_ms; });
+
+  size_t before = out.size();
+  for (auto b = first; b != blocks.end(); ++b) {
+    const chunk_header_t *c = chunk(*b);
+    if (c->t_first >= to_ms)
+      break;
+    decode(c, from_ms, to_ms, out);
+  }
+  return out.size() - before;
+}
+
+size_t ts_store::aggregate(uint16_t helmet, ts_signal_t signal, int64_t from_ms, int64_t to_ms, int64_t step_ms,
+                           std::vector<ts_aggregate_t> &out) const
+{
+  auto it = series_.find(key(helmet, signal));
+  if (it == series_.end() || from_ms >= to_ms || step_ms <= 0)
+    return 0;
+
+  struct acc_t {
+    int64_t  bucket = -1;
+    uint64_t count = 0;
+    int64_t  sum = 0;
+    int32_t  min = INT32_MAX;
+    int32_t  max = INT32_MIN;
+  } acc;
+
+  size_t before = out.size();
+  auto flush = [&]() {
+    if (acc.count) {
+      out.push_back({ from_ms + acc.bucket * step_ms, (uint32_t)acc.count, acc.min, acc.max,
+                      (double)acc.sum / (double)acc.count });
+    }
+    acc = acc_t();
+  };
+  auto fold = [&](int64_t bucket, uint64_t count, int64_t sum, int32_t min, int32_t max) {
+    if (bucket != acc.bucket) {
+      flush();
+      acc.bucket = bucket;
+    }
+    acc.count += count;
+    acc.sum += sum;
+    acc.min = std::min(acc.min, min);
+    acc.max = std::max(acc.max, max);
+  };
+
+  const std::vector<uint32_t> &blocks = it->second.blocks;
+  auto first = std::partition_point(blocks.begin(), blocks.end(),
+                                    [&](uint32_t b) { return chunk(b)->t_last < from_ms; });
+
+  std::vector<ts_sample_t> samples;
+  for (auto b = first; b != blocks.end(); ++b) {
+    const chunk_header_t *c = chunk(*b);
+    if (c->t_first >= to_ms)
+      break;
+
+    // Inside the range and one bucket, the header has it all
+    int64_t bucket = (c->t_first - from_ms) / step_ms;
+    if (c->t_first >= from_ms && c->t_last < to_ms && (c->t_last - from_ms) / step_ms == bucket) {
+      fold(bucket, c->count, c->v_sum, c->v_min, c->v_max);
+      continue;
+    }
+
+    samples.clear();
+    decode(c, from_ms, to_ms, samples);
+    for (const ts_sample_t &s : samples)
+      fold((s.t_ms - from_ms) / step_ms, 1, s.value, s.value, s.value);
+  }
+  flush();
+
+  return out.size() - before;
+}
+
+ts_store_stats_t ts_store::stats() const
+{
+  ts_store_stats_t s;
+  if (!map_)
+    return s;
+
+  const file_header_t *hdr = (const file_header_t *)map_;
+  s.refused = refused_;
+  s.series = (uint32_t)series_.size();
+  s.chunks = hdr->blocks - 1;
+  s.file_bytes = (uint64_t)hdr->blocks * TS_BLOCK_SIZE;
+  for (uint32_t b = 1; b < hdr->blocks; b++) {
+    s.samples += chunk(b)->count;
+    s.stream_bits += chunk(b)->bits;
+  }
+  return s;
+}
+
+std::vector<uint32_t> ts_store::series() const
+{
+  std::vector<uint32_t> keys;
+  for (const auto &s : series_)
+    keys.push_back(s.first);
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+} // namespace lpedt
@@ -0,0 +1,165 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ts_store.h
+ * @brief   Append-only compressed time series store for helmet telemetry.
+ *
+ *          One memory mapped file of TS_BLOCK_SIZE blocks. Every (helmet,
+ *          signal) series owns a chain of chunk blocks, only the newest one
+ *          is open for appends. A chunk holds the first sample in its header
+ *          and every further one as a bit stream:
+ *
+ *            time    delta-of-delta in ms, zigzag, '0' for an unchanged
+ *                    period, otherwise a 7, 9, 12 or 32 bit class
+ *            value   delta to the previous value, zigzag, '0' for no
+ *                    change, otherwise a 4, 8, 16 or 33 bit class
+ *
+ *          Values are the integers the sensors report (milli degrees,
+ *          centi percent, hPa, mg, ...), so deltas are exact.
+ *
+ *          The header also keeps count, time span and min/max/sum, which is
+ *          the time range index: a range read skips whole chunks by their
+ *          span and an aggregate takes chunks that fall inside one bucket
+ *          from the header without decoding them. The index is rebuilt from
+ *          the block headers when the file is opened.
+ *
+ *          Samples of a series must come in time order, older ones are
+ *          refused. Not thread safe.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef LPEDT_GATEWAY_TS_STORE_H_
+#define LPEDT_GATEWAY_TS_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lpedt {
+
+#define TS_BLOCK_SIZE     (4096)
+#define TS_FILE_MAGIC     "LPTSDB01"
+#define TS_CHUNK_MAGIC    (0x4B4E4843u)  // "CHNK"
+
+enum class ts_signal_t : uint8_t {
+  temperature = 0,  // milli degrees C
+  humidity,         // centi percent RH
+  gas,
+  pressure,         // hPa
+  acc_x,            // mg
+  acc_y,
+  acc_z,
+  gyro_x,           // mdps
+  gyro_y,
+  gyro_z,
+  count
+};
+
+const char *ts_signal_name(ts_signal_t signal);
+
+struct ts_sample_t {
+  int64_t t_ms;
+  int32_t value;
+};
+
+struct ts_aggregate_t {
+  int64_t  t_ms;    // start of the bucket
+  uint32_t count;
+  int32_t  min;
+  int32_t  max;
+  double   mean;
+};
+
+struct ts_store_stats_t {
+  uint64_t samples     = 0;
+  uint64_t refused     = 0;   // out of order samples
+  uint32_t series      = 0;
+  uint32_t chunks      = 0;
+  uint64_t file_bytes  = 0;   // blocks in use
+  uint64_t stream_bits = 0;   // compressed sample bits, headers excluded
+};
+
+class ts_store {
+public:
+  ts_store() = default;
+  ~ts_store();
+
+  ts_store(const ts_store &) = delete;
+  ts_store &operator=(const ts_store &) = delete;
+
+  /**
+   * @brief   Open path, created if missing, the index is rebuilt from the
+   *          chunk headers
+   * @return  false with error set if the file is not a store
+   */
+  bool open(const std::string &path, std::string &error);
+  void close();
+
+  /**
+   * @brief   Append one sample
+   * @return  false if t_ms is older than the newest sample of the series or
+   *          the file cannot grow
+   */
+  bool append(uint16_t helmet, ts_signal_t signal, int64_t t_ms, int32_t value);
+
+  /**
+   * @brief   Samples of a series with from_ms <= t < to_ms, appended to out
+   * @return  number of samples added
+   */
+  size_t read(uint16_t helmet, ts_signal_t signal, int64_t from_ms, int64_t to_ms,
+              std::vector<ts_sample_t> &out) const;
+
+  /**
+   * @brief   Count, min, max and mean per step_ms bucket over
+   *          [from_ms, to_ms), empty buckets are left out
+   * @return  number of buckets added to out
+   */
+  size_t aggregate(uint16_t helmet, ts_signal_t signal, int64_t from_ms, int64_t to_ms, int64_t step_ms,
+                   std::vector<ts_aggregate_t> &out) const;
+
+  // Push the mapped pages to the file
+  void sync();
+
+  ts_store_stats_t stats() const;
+
+  // Series currently in the store, helmet << 8 | signal
+  std::vector<uint32_t> series() const;
+
+private:
+  struct file_header_t;
+  struct chunk_header_t;
+
+  struct series_t {
+    std::vector<uint32_t> blocks;   // chunk blocks in time order
+  };
+
+  static uint32_t key(uint16_t helmet, ts_signal_t signal) { return ((uint32_t)helmet << 8) | (uint8_t)signal; }
+
+  chunk_header_t       *chunk(uint32_t block);
+  const chunk_header_t *chunk(uint32_t block) const;
+  bool     grow(uint32_t blocks);
+  uint32_t new_chunk(uint16_t helmet, ts_signal_t signal, int64_t t_ms, int32_t value);
+  void     decode(const chunk_header_t *c, int64_t from_ms, int64_t to_ms, std::vector<ts_sample_t> &out) const;
+
+  int       fd_ = -1;
+  uint8_t  *map_ = nullptr;
+  size_t    map_bytes_ = 0;
+  uint64_t  refused_ = 0;
+  std::unordered_map<uint32_t, series_t> series_;
+};
+
+} // namespace lpedt
+
+#endif /* LPEDT_GATEWAY_TS_STORE_H_ */
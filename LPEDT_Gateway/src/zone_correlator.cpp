@@ -0,0 +1,494 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    zone_correlator.cpp
+ * @brief   Windowed aggregates, rule parsing and evaluation of zone_correlator
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "zone_correlator.h"
+
+#include <cstdio>
+#include <iterator>
+#include <sstream>
+
+#include "Custom_Defines.h"
+
+namespace lpedt {
+
+static const char *measure_names[] = {
+  "count", "mean", "max", "slope", "helmets_above", "helmets_silent",
+};
+
+static const char *op_names[] = { ">", ">=", "<", "<=" };
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+  int64_t q = a / b;
+  return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+/*
+ * corr_window_stats_t
+ */
+void corr_window_stats_t::add(int64_t tick, int32_t value)
+{
+  count++;
+  sum_v  += value;
+  sum_t  += tick;
+  sum_tt += tick * tick;
+  sum_tv += tick * value;
+  if (value > max)
+    max = value;
+}
+
+void corr_window_stats_t::remove(int64_t tick, int32_t value)
+{
+  count--;
+  sum_v  -= value;
+  sum_t  -= tick;
+  sum_tt -= tick * tick;
+  sum_tv -= tick * value;
+}
+
+double corr_window_stats_t::slope_per_min() const
+{
+  if (count < 2)
+    return 0.0;
+
+  // The sums are exact, only the final difference is taken in double
+  double n = count;
+  double den = n * (double)sum_tt - (double)sum_t * (double)sum_t;
+  if (den <= 0.0)
+    return 0.0;
+  double per_tick = (n * (double)sum_tv - (double)sum_t * (double)sum_v) / den;
+  return per_tick * (60000.0 / CORR_SLOPE_TICK_MS);
+}
+
+/*
+ * sliding_aggregate
+ */
+void sliding_aggregate::expire(int64_t now_ms, uint32_t window_ms)
+{
+  int64_t oldest = now_ms - (int64_t)window_ms;
+
+  while (!samples_.empty() && samples_.front().t_ms <= oldest) {
+    stats_.remove(tick(samples_.front().t_ms), samples_.front().value);
+    samples_.pop_front();
+  }
+  while (!max_.empty() && max_.front().t_ms <= oldest)
+    max_.pop_front();
+}
+
+void sliding_aggregate::add(int64_t t_ms, int32_t value, uint32_t window_ms)
+{
+  expire(t_ms, window_ms);
+
+  if (samples_.empty()) {
+    stats_ = corr_window_stats_t();
+    origin_ms_ = t_ms;
+  }
+
+  samples_.push_back({ t_ms, value });
+  stats_.add(tick(t_ms), value);
+
+  while (!max_.empty() && max_.back().value <= value)
+    max_.pop_back();
+  max_.push_back({ t_ms, value });
+}
+
+/*
+ * helmet_set
+ */
+void helmet_set::touch(uint16_t helmet, int64_t t_ms)
+{
+  auto it = index_.find(helmet);
+  if (it != index_.end()) {
+    it->second->t_ms = t_ms;
+    order_.splice(order_.end(), order_, it->second);
+    return;
+  }
+  order_.push_back({ helmet, t_ms });
+  index_[helmet] = std::prev(order_.end());
+}
+
+void helmet_set::erase(uint16_t helmet)
+{
+  auto it = index_.find(helmet);
+  if (it == index_.end())
+    return;
+  order_.erase(it->second);
+  index_.erase(it);
+}
+
+void helmet_set::expire(int64_t now_ms, uint32_t window_ms)
+{
+  int64_t oldest = now_ms - (int64_t)window_ms;
+  while (!order_.empty() && order_.front().t_ms <= oldest) {
+    index_.erase(order_.front().helmet);
+    order_.pop_front();
+  }
+}
+
+void helmet_set::clear()
+{
+  order_.clear();
+  index_.clear();
+}
+
+/*
+ * Rules
+ */
+bool corr_parse_rule(const std::string &line, corr_rule_t &rule, std::string &error)
+{
+  error.clear();
+  std::string text = line.substr(0, line.find('#'));
+  std::istringstream in(text);
+
+  std::string name, measure, signal, window, op;
+  double window_s, threshold;
+  if (!(in >> name))
+    return false;
+  if (!(in >> measure >> signal >> window >> window_s >> op >> threshold)) {
+    error = "expected: name measure signal sliding|tumbling window_s op threshold";
+    return false;
+  }
+  rule = corr_rule_t();
+  rule.name = name;
+  rule.threshold = threshold;
+
+  size_t m = 0;
+  while (m < sizeof(measure_names) / sizeof(measure_names[0]) && measure != measure_names[m])
+    m++;
+  if (m == sizeof(measure_names) / sizeof(measure_names[0])) {
+    error = "unknown measure '" + measure + "'";
+    return false;
+  }
+  rule.measure = (corr_measure_t)m;
+
+  if (signal == "any") {
+    rule.signal = CORR_SIGNAL_ANY;
+  }
+  else {
+    int s = 0;
+    while (s < (int)ts_signal_t::count && signal != ts_signal_name((ts_signal_t)s))
+      s++;
+    if (s == (int)ts_signal_t::count) {
+      error = "unknown signal '" + signal + "'";
+      return false;
+    }
+    rule.signal = (uint8_t)s;
+  }
+
+  if (window == "sliding")
+    rule.window = corr_window_t::sliding;
+  else if (window == "tumbling")
+    rule.window = corr_window_t::tumbling;
+  else {
+    error = "unknown window '" + window + "'";
+    return false;
+  }
+
+  if (!(window_s > 0.0) || window_s > 86400.0) {
+    error = "window must be 0 to 86400 s";
+    return false;
+  }
+  rule.window_ms = (uint32_t)(window_s * 1000.0 + 0.5);
+
+  size_t o = 0;
+  while (o < sizeof(op_names) / sizeof(op_names[0]) && op != op_names[o])
+    o++;
+  if (o == sizeof(op_names) / sizeof(op_names[0])) {
+    error = "unknown op '" + op + "'";
+    return false;
+  }
+  rule.op = (corr_op_t)o;
+
+  std::string key;
+  long long v;
+  while (in >> key) {
+    if (!(in >> v)) {
+      error = "missing value for '" + key + "'";
+      return false;
+    }
+    if (key == "limit")
+      rule.limit = (int32_t)v;
+    else if (key == "samples" && v > 0)
+      rule.samples = (uint32_t)v;
+    else {
+      error = "bad option '" + key + "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<corr_rule_t> corr_default_rules()
+{
+  char lines[4][128];
+  // Gas going up across the zone, GAS_MAX in twenty minutes
+  snprintf(lines[0], sizeof(lines[0]), "zone_gas_rising slope gas sliding 300 > %.3f samples 200", GAS_MAX / 20.0);
+  // Three helmets over the single helmet gas limit within a minute
+  snprintf(lines[1], sizeof(lines[1]), "zone_gas_spread helmets_above gas sliding 60 >= 3 limit %d", GAS_MAX);
+  // Zone average within 5 C of the helmet limit over a whole minute
+  snprintf(lines[2], sizeof(lines[2]), "zone_heat mean temperature tumbling 60 > %d samples 20",
+           (TEMP_MAX - 5) * 1000);
+  // Three helmets going quiet within half a minute
+  snprintf(lines[3], sizeof(lines[3]), "group_dropout helmets_silent any sliding 30 >= 3");
+
+  std::vector<corr_rule_t> rules;
+  for (const char *line : lines) {
+    corr_rule_t rule;
+    std::string error;
+    if (corr_parse_rule(line, rule, error))
+      rules.push_back(rule);
+  }
+  return rules;
+}
+
+/*
+ * zone_correlator
+ */
+zone_correlator::zone_correlator(const std::vector<corr_rule_t> &rules, const corr_config_t &config,
+                                 corr_handler_t on_alert)
+  : rules_(rules), config_(config), on_alert_(std::move(on_alert)), by_signal_((size_t)ts_signal_t::count + 1)
+{
+  for (size_t r = 0; r < rules_.size(); r++) {
+    const corr_rule_t &rule = rules_[r];
+    if (rule.measure == corr_measure_t::helmets_silent)
+      silence_rules_.push_back(r);
+    else if (rule.signal == CORR_SIGNAL_ANY)
+      by_signal_[(size_t)ts_signal_t::count].push_back(r);
+    else if (rule.signal < (uint8_t)ts_signal_t::count)
+      by_signal_[rule.signal].push_back(r);
+  }
+}
+
+zone_correlator::zone_t &zone_correlator::zone(uint16_t id)
+{
+  auto it = zones_.find(id);
+  if (it != zones_.end())
+    return it->second;
+
+  zone_t &z = zones_[id];
+  z.rules.resize(rules_.size());
+  return z;
+}
+
+void zone_correlator::evaluate(size_t r, rule_state_t &s, uint16_t zone_id, int64_t t_ms,
+                               const corr_window_stats_t &w, int32_t max, int64_t span_ms)
+{
+  const corr_rule_t &rule = rules_[r];
+  double value = 0.0;
+  bool valid = true;
+
+  switch (rule.measure) {
+    case corr_measure_t::count:
+      value = w.count;
+      break;
+    case corr_measure_t::mean:
+      valid = w.count >= rule.samples;
+      value = w.mean();
+      break;
+    case corr_measure_t::max:
+      valid = w.count >= rule.samples;
+      value = max;
+      break;
+    case corr_measure_t::slope:
+      // A fit over a few seconds of noise is not a trend
+      valid = w.count >= rule.samples && w.count >= 2 && span_ms * 2 >= rule.window_ms;
+      value = w.slope_per_min();
+      break;
+    case corr_measure_t::helmets_above:
+    case corr_measure_t::helmets_silent:
+      value = (double)s.helmets.size();
+      break;
+  }
+  stats_.evaluations++;
+
+  bool hit = false;
+  if (valid) {
+    switch (rule.op) {
+      case corr_op_t::gt: hit = value >  rule.threshold; break;
+      case corr_op_t::ge: hit = value >= rule.threshold; break;
+      case corr_op_t::lt: hit = value <  rule.threshold; break;
+      case corr_op_t::le: hit = value <= rule.threshold; break;
+    }
+  }
+
+  if (hit == s.latched)
+    return;
+
+  s.latched = hit;
+  if (hit)
+    stats_.raised++;
+  else
+    stats_.cleared++;
+  if (on_alert_)
+    on_alert_({ &rule, zone_id, t_ms, value, hit });
+}
+
+void zone_correlator::roll(size_t r, rule_state_t &s, uint16_t zone_id, int64_t now_ms)
+{
+  const corr_rule_t &rule = rules_[r];
+  int64_t start = floor_div(now_ms, rule.window_ms) * rule.window_ms;
+
+  if (s.bucket_start == INT64_MIN) {
+    s.bucket_start = start;
+    return;
+  }
+  if (start <= s.bucket_start)
+    return;
+
+  // Close the bucket, and judge the empty ones skipped over as one
+  int64_t end = s.bucket_start + rule.window_ms;
+  evaluate(r, s, zone_id, end, s.bucket, s.bucket.max, rule.window_ms);
+  s.bucket = corr_window_stats_t();
+  s.helmets.clear();
+  if (start > end)
+    evaluate(r, s, zone_id, start, s.bucket, s.bucket.max, rule.window_ms);
+
+  s.bucket_start = start;
+}
+
+void zone_correlator::update(size_t r, rule_state_t &s, uint16_t zone_id, const corr_event_t &event)
+{
+  const corr_rule_t &rule = rules_[r];
+  bool above = rule.measure == corr_measure_t::helmets_above;
+
+  if (rule.window == corr_window_t::sliding) {
+    if (above) {
+      if (event.value > rule.limit)
+        s.helmets.touch(event.helmet, event.t_ms);
+      s.helmets.expire(event.t_ms, rule.window_ms);
+      evaluate(r, s, zone_id, event.t_ms, s.sliding.stats(), 0, 0);
+    }
+    else {
+      s.sliding.add(event.t_ms, event.value, rule.window_ms);
+      evaluate(r, s, zone_id, event.t_ms, s.sliding.stats(), s.sliding.max(), s.sliding.span_ms());
+    }
+    return;
+  }
+
+  roll(r, s, zone_id, event.t_ms);
+  if (above) {
+    if (event.value > rule.limit)
+      s.helmets.touch(event.helmet, event.t_ms);
+  }
+  else {
+    s.bucket.add((event.t_ms - s.bucket_start) / CORR_SLOPE_TICK_MS, event.value);
+  }
+}
+
+void zone_correlator::silence(uint16_t helmet, helmet_live_t &live)
+{
+  live.silent = true;
+  live_order_.erase(live.order);
+  stats_.silences++;
+
+  int64_t t_ms = live.last_seen_ms + config_.silent_ms;
+  zone_t &z = zone(live.zone);
+  for (size_t r : silence_rules_) {
+    rule_state_t &s = z.rules[r];
+    if (rules_[r].window == corr_window_t::sliding) {
+      s.helmets.touch(helmet, t_ms);
+      s.helmets.expire(t_ms, rules_[r].window_ms);
+      evaluate(r, s, live.zone, t_ms, s.sliding.stats(), 0, 0);
+    }
+    else {
+      roll(r, s, live.zone, t_ms);
+      s.helmets.touch(helmet, t_ms);
+    }
+  }
+}
+
+void zone_correlator::on_event(const corr_event_t &event)
+{
+  stats_.events++;
+
+  auto it = helmets_.find(event.helmet);
+  if (it == helmets_.end()) {
+    live_order_.push_back(event.helmet);
+    helmets_[event.helmet] = { event.zone, event.t_ms, false, std::prev(live_order_.end()) };
+  }
+  else {
+    helmet_live_t &live = it->second;
+    if (live.silent) {
+      // Back on air, no longer counts as silent where it went quiet
+      live.silent = false;
+      live_order_.push_back(event.helmet);
+      live.order = std::prev(live_order_.end());
+
+      zone_t &old = zone(live.zone);
+      for (size_t r : silence_rules_) {
+        rule_state_t &s = old.rules[r];
+        s.helmets.erase(event.helmet);
+        if (rules_[r].window == corr_window_t::sliding)
+          evaluate(r, s, live.zone, event.t_ms, s.sliding.stats(), 0, 0);
+      }
+    }
+    else {
+      live_order_.splice(live_order_.end(), live_order_, live.order);
+    }
+    live.zone = event.zone;
+    live.last_seen_ms = event.t_ms;
+  }
+
+  if ((uint8_t)event.signal >= (uint8_t)ts_signal_t::count)
+    return;
+
+  zone_t &z = zone(event.zone);
+  for (size_t r : by_signal_[(size_t)event.signal])
+    update(r, z.rules[r], event.zone, event);
+  for (size_t r : by_signal_[(size_t)ts_signal_t::count])
+    update(r, z.rules[r], event.zone, event);
+}
+
+void zone_correlator::advance(int64_t now_ms)
+{
+  while (!live_order_.empty()) {
+    uint16_t helmet = live_order_.front();
+    helmet_live_t &live = helmets_[helmet];
+    if (live.last_seen_ms + (int64_t)config_.silent_ms > now_ms)
+      break;
+    silence(helmet, live);
+  }
+
+  for (auto &entry : zones_) {
+    for (size_t r = 0; r < rules_.size(); r++) {
+      const corr_rule_t &rule = rules_[r];
+      rule_state_t &s = entry.second.rules[r];
+
+      if (rule.window == corr_window_t::tumbling) {
+        roll(r, s, entry.first, now_ms);
+      }
+      else if (rule.measure == corr_measure_t::helmets_above || rule.measure == corr_measure_t::helmets_silent) {
+        s.helmets.expire(now_ms, rule.window_ms);
+        evaluate(r, s, entry.first, now_ms, s.sliding.stats(), 0, 0);
+      }
+      else {
+        s.sliding.expire(now_ms, rule.window_ms);
+        evaluate(r, s, entry.first, now_ms, s.sliding.stats(), s.sliding.max(), s.sliding.span_ms());
+      }
+    }
+  }
+}
+
+corr_stats_t zone_correlator::stats() const
+{
+  corr_stats_t s = stats_;
+  s.zones = (uint32_t)zones_.size();
+  return s;
+}
+
+} // namespace lpedt
@@ -0,0 +1,260 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    zone_correlator.h
+ * @brief   Multi-helmet alert correlation per zone.
+ *
+ *          The helmets only check their own readings against TEMP_MAX,
+ *          GAS_MAX and RSSI_THREASHOLD. This engine looks at a whole zone:
+ *          every rule runs once per zone, over a sliding or a tumbling
+ *          window, on one of
+ *
+ *            count           samples in the window
+ *            mean, max       of the values
+ *            slope           least squares, value per minute, once the
+ *                            window holds at least half its length
+ *            helmets_above   helmets with a value above the rule's limit
+ *            helmets_silent  helmets that went silent in the window and
+ *                            have not spoken since
+ *
+ *          and raises an alert when the measure crosses the threshold, and
+ *          clears it when it is back. Rules are text, one per line:
+ *
+ *            name measure signal sliding|tumbling window_s op threshold
+ *                 [limit N] [samples N]
+ *
+ *            zone_gas_rising  slope gas sliding 300 > 0.5 samples 200
+ *            group_dropout    helmets_silent any sliding 30 >= 3
+ *
+ *          signal is a ts_signal_name() or "any", op is >, >=, < or <=.
+ *
+ *          An event updates only the rules of its signal in its zone, and
+ *          every aggregate is kept as running sums, a monotonic max queue
+ *          and a time ordered helmet list, so an event is O(1) amortized.
+ *          advance() moves the clock for windows and helmets that get no
+ *          events, call it on a tick (e.g. once a second), it walks every
+ *          zone. Events are expected in time order. Not thread safe.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#ifndef LPEDT_GATEWAY_ZONE_CORRELATOR_H_
+#define LPEDT_GATEWAY_ZONE_CORRELATOR_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ts_store.h"
+
+namespace lpedt {
+
+#define CORR_SIGNAL_ANY     (0xFF)
+
+// Time unit of the slope sums, keeps them inside int64 for days
+#define CORR_SLOPE_TICK_MS  (100)
+
+enum class corr_measure_t : uint8_t {
+  count = 0,
+  mean,
+  max,
+  slope,
+  helmets_above,
+  helmets_silent
+};
+
+enum class corr_window_t : uint8_t {
+  sliding = 0,
+  tumbling
+};
+
+enum class corr_op_t : uint8_t {
+  gt = 0,
+  ge,
+  lt,
+  le
+};
+
+struct corr_rule_t {
+  std::string    name;
+  corr_measure_t measure   = corr_measure_t::count;
+  uint8_t        signal    = CORR_SIGNAL_ANY;   // ts_signal_t or CORR_SIGNAL_ANY
+  corr_window_t  window    = corr_window_t::sliding;
+  uint32_t       window_ms = 60000;
+  corr_op_t      op        = corr_op_t::gt;
+  double         threshold = 0.0;
+  int32_t        limit     = 0;   // helmets_above, a helmet counts above this
+  uint32_t       samples   = 1;   // mean, max and slope need this many
+};
+
+/**
+ * @brief   Parse one rule line, blank lines and '#' comments give false with
+ *          an empty error
+ */
+bool corr_parse_rule(const std::string &line, corr_rule_t &rule, std::string &error);
+
+// Zone rules derived from the helmet limits in Custom_Defines.h
+std::vector<corr_rule_t> corr_default_rules();
+
+struct corr_event_t {
+  int64_t     t_ms;
+  uint16_t    helmet;
+  uint16_t    zone;     // e.g. rssi_localizer's estimate
+  ts_signal_t signal;
+  int32_t     value;
+};
+
+struct corr_alert_t {
+  const corr_rule_t *rule;
+  uint16_t           zone;
+  int64_t            t_ms;
+  double             value;   // the measure when it crossed
+  bool               raised;  // false when it cleared
+};
+
+using corr_handler_t = std::function<void(const corr_alert_t &alert)>;
+
+struct corr_config_t {
+  uint32_t silent_ms = 5000;  // a helmet with no event for this long is silent
+};
+
+struct corr_stats_t {
+  uint64_t events      = 0;
+  uint64_t evaluations = 0;
+  uint64_t raised      = 0;
+  uint64_t cleared     = 0;
+  uint64_t silences    = 0;
+  uint32_t zones       = 0;
+};
+
+/**
+ * Count, sum, max and the least squares sums of one window
+ */
+struct corr_window_stats_t {
+  uint32_t count  = 0;
+  int64_t  sum_v  = 0;
+  int64_t  sum_t  = 0;    // CORR_SLOPE_TICK_MS ticks since the origin
+  int64_t  sum_tt = 0;
+  int64_t  sum_tv = 0;
+  int32_t  max    = INT32_MIN;
+
+  void   add(int64_t tick, int32_t value);
+  void   remove(int64_t tick, int32_t value);
+  double mean() const { return count ? (double)sum_v / count : 0.0; }
+  double slope_per_min() const;
+};
+
+/**
+ * Time bounded window with O(1) amortized add and expire. The max is the
+ * front of a queue of decreasing values.
+ */
+class sliding_aggregate {
+public:
+  void expire(int64_t now_ms, uint32_t window_ms);
+  void add(int64_t t_ms, int32_t value, uint32_t window_ms);
+
+  const corr_window_stats_t &stats() const { return stats_; }
+  int32_t max() const { return max_.empty() ? INT32_MIN : max_.front().value; }
+  int64_t span_ms() const { return samples_.empty() ? 0 : samples_.back().t_ms - samples_.front().t_ms; }
+
+private:
+  struct entry_t {
+    int64_t t_ms;
+    int32_t value;
+  };
+
+  int64_t tick(int64_t t_ms) const { return (t_ms - origin_ms_) / CORR_SLOPE_TICK_MS; }
+
+  std::deque<entry_t> samples_;
+  std::deque<entry_t> max_;
+  corr_window_stats_t stats_;
+  int64_t             origin_ms_ = 0;   // moved up whenever the window empties
+};
+
+/**
+ * Helmets ordered by their last hit, touch, erase and expire are O(1)
+ */
+class helmet_set {
+public:
+  void   touch(uint16_t helmet, int64_t t_ms);
+  void   erase(uint16_t helmet);
+  void   expire(int64_t now_ms, uint32_t window_ms);
+  void   clear();
+  size_t size() const { return index_.size(); }
+
+private:
+  struct hit_t {
+    uint16_t helmet;
+    int64_t  t_ms;
+  };
+
+  std::list<hit_t> order_;
+  std::unordered_map<uint16_t, std::list<hit_t>::iterator> index_;
+};
+
+class zone_correlator {
+public:
+  zone_correlator(const std::vector<corr_rule_t> &rules, const corr_config_t &config, corr_handler_t on_alert);
+
+  void on_event(const corr_event_t &event);
+
+  // Expire windows, close tumbling buckets and find silent helmets up to now_ms
+  void advance(int64_t now_ms);
+
+  const std::vector<corr_rule_t> &rules() const { return rules_; }
+  corr_stats_t stats() const;
+
+private:
+  struct rule_state_t {
+    sliding_aggregate   sliding;
+    corr_window_stats_t bucket;
+    int64_t             bucket_start = INT64_MIN;
+    helmet_set          helmets;
+    bool                latched = false;
+  };
+
+  struct zone_t {
+    std::vector<rule_state_t> rules;
+  };
+
+  struct helmet_live_t {
+    uint16_t zone;
+    int64_t  last_seen_ms;
+    bool     silent;
+    std::list<uint16_t>::iterator order;
+  };
+
+  zone_t &zone(uint16_t id);
+  void    update(size_t r, rule_state_t &s, uint16_t zone_id, const corr_event_t &event);
+  void    roll(size_t r, rule_state_t &s, uint16_t zone_id, int64_t now_ms);
+  void    evaluate(size_t r, rule_state_t &s, uint16_t zone_id, int64_t t_ms, const corr_window_stats_t &w,
+                   int32_t max, int64_t span_ms);
+  void    silence(uint16_t helmet, helmet_live_t &live);
+
+  std::vector<corr_rule_t>                       rules_;
+  corr_config_t                                  config_;
+  corr_handler_t                                 on_alert_;
+  std::vector<std::vector<size_t>>               by_signal_;   // ts_signal_t, then CORR_SIGNAL_ANY last
+  std::vector<size_t>                            silence_rules_;
+  std::unordered_map<uint16_t, zone_t>           zones_;
+  std::unordered_map<uint16_t, helmet_live_t>    helmets_;
+  std::list<uint16_t>                            live_order_;  // by last_seen_ms, silent helmets left out
+  corr_stats_t                                   stats_;
+};
+
+} // namespace lpedt
+
+#endif /* LPEDT_GATEWAY_ZONE_CORRELATOR_H_ */
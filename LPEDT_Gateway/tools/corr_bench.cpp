@@ -0,0 +1,268 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    corr_bench.cpp
+ * @brief   Shift long run of zone_correlator with injected area events.
+ *
+ *          Every helmet reports temperature and gas (the gas_baseline.h
+ *          index) once per CLIENT_SLEEP_TIME_MS, in zones that change now
+ *          and then. On top of the noise the shift has
+ *
+ *            gas_leak    gas climbs GAS_MAX / 10 per minute in one zone for
+ *                        12 minutes
+ *            dropout     5 helmets of one zone stop reporting for 3 minutes
+ *            heat        one zone warms to TEMP_MAX - 3 C for 5 minutes
+ *            lone_spike  a single helmet reads GAS_MAX + 5 for 2 minutes,
+ *                        the helmet alarms on that itself, no zone rule
+ *                        should
+ *
+ *          Alerts are matched to the incidents, anything else is counted as
+ *          false. Only the engine calls are timed.
+ *
+ *          usage: corr_bench [--zones N] [--helmets N] [--hours N] [--seed N]
+ *                            [--rules FILE] [--verbose]
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "zone_correlator.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Custom_Defines.h"
+
+using namespace lpedt;
+
+#define HELMET_BASE       (0x0100)
+#define ADVANCE_MS        (1000)
+#define MOVE_P            (0.0005)   // per helmet per period
+#define JITTER_MS         (3)
+
+struct incident_t {
+  const char *name;
+  const char *rule;      // expected to fire, nullptr if none should
+  uint16_t    zone;
+  int64_t     start_ms;
+  int64_t     end_ms;
+  int64_t     detected_ms;
+};
+
+static const char *arg_str(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return argv[i + 1];
+  }
+  return nullptr;
+}
+
+static long arg_long(int argc, char **argv, const char *name, long def)
+{
+  const char *s = arg_str(argc, argv, name);
+  return s ? strtol(s, NULL, 0) : def;
+}
+
+static bool arg_flag(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return true;
+  }
+  return false;
+}
+
+static void print_time(int64_t t_ms)
+{
+  int64_t s = t_ms / 1000;
+  printf("%lld:%02lld:%02lld", (long long)(s / 3600), (long long)(s / 60 % 60), (long long)(s % 60));
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t zones   = (uint32_t)arg_long(argc, argv, "--zones", 20);
+  uint32_t helmets = (uint32_t)arg_long(argc, argv, "--helmets", 500);
+  uint32_t hours   = (uint32_t)arg_long(argc, argv, "--hours", 8);
+  uint32_t seed    = (uint32_t)arg_long(argc, argv, "--seed", 1);
+  const char *rules_path = arg_str(argc, argv, "--rules");
+  bool verbose = arg_flag(argc, argv, "--verbose");
+
+  if (zones < 10 || helmets < 5 * zones || hours == 0) {
+    fprintf(stderr, "corr_bench: needs 10+ zones, 5+ helmets per zone and 1+ hours\n");
+    return 1;
+  }
+
+  std::vector<corr_rule_t> rules;
+  if (rules_path) {
+    FILE *f = fopen(rules_path, "r");
+    if (!f) {
+      fprintf(stderr, "corr_bench: cannot open %s\n", rules_path);
+      return 1;
+    }
+    char line[256];
+    int n = 0;
+    while (fgets(line, sizeof(line), f)) {
+      n++;
+      corr_rule_t rule;
+      std::string error;
+      if (corr_parse_rule(line, rule, error))
+        rules.push_back(rule);
+      else if (!error.empty()) {
+        fprintf(stderr, "%s:%d: %s\n", rules_path, n, error.c_str());
+        fclose(f);
+        return 1;
+      }
+    }
+    fclose(f);
+  }
+  else {
+    rules = corr_default_rules();
+  }
+
+  int64_t shift_ms = (int64_t)hours * 3600 * 1000;
+  std::vector<incident_t> incidents = {
+    { "gas_leak",   "zone_gas_rising", 3, shift_ms / 4,     shift_ms / 4 + 12 * 60000,     -1 },
+    { "dropout",    "group_dropout",   7, shift_ms / 2,     shift_ms / 2 + 3 * 60000,      -1 },
+    { "heat",       "zone_heat",       9, shift_ms * 5 / 8, shift_ms * 5 / 8 + 5 * 60000,  -1 },
+    { "lone_spike", nullptr,           5, shift_ms * 3 / 4, shift_ms * 3 / 4 + 2 * 60000,  -1 },
+  };
+  const incident_t &leak = incidents[0], &dropout = incidents[1], &heat = incidents[2], &spike = incidents[3];
+
+  // Helmets of the incidents, the first ones homed in the zone, kept there
+  uint16_t dropout_first = (uint16_t)dropout.zone, spike_helmet = (uint16_t)spike.zone;
+
+  uint64_t expected = 0, unexpected = 0;
+  auto on_alert = [&](const corr_alert_t &alert) {
+    if (!alert.raised)
+      return;
+
+    bool matched = false;
+    for (incident_t &inc : incidents) {
+      if (inc.rule && alert.zone == inc.zone && alert.rule->name == inc.rule &&
+          alert.t_ms >= inc.start_ms && alert.t_ms <= inc.end_ms + alert.rule->window_ms + 60000) {
+        if (inc.detected_ms < 0)
+          inc.detected_ms = alert.t_ms;
+        matched = true;
+      }
+      // The leak is meant to trip the spread rule as well
+      if (&inc == &leak && alert.zone == inc.zone && alert.rule->name == "zone_gas_spread" &&
+          alert.t_ms >= inc.start_ms && alert.t_ms <= inc.end_ms + 10 * 60000)
+        matched = true;
+    }
+    if (matched)
+      expected++;
+    else
+      unexpected++;
+
+    if (verbose || !matched) {
+      print_time(alert.t_ms);
+      printf("  zone %2u  %-16s %10.2f%s\n", alert.zone, alert.rule->name.c_str(), alert.value,
+             matched ? "" : "  (false)");
+    }
+  };
+
+  corr_config_t config;
+  zone_correlator engine(rules, config, on_alert);
+
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uni(0.0, 1.0);
+  std::normal_distribution<double> noise(0.0, 1.0);
+
+  std::vector<uint16_t> zone_of(helmets);
+  for (uint32_t h = 0; h < helmets; h++)
+    zone_of[h] = (uint16_t)(h % zones);
+
+  std::vector<corr_event_t> batch;
+  batch.reserve(2 * helmets);
+  double engine_s = 0.0;
+  uint64_t events = 0;
+  int64_t next_advance = ADVANCE_MS;
+
+  for (int64_t t0 = 0; t0 < shift_ms; t0 += CLIENT_SLEEP_TIME_MS) {
+    batch.clear();
+    for (uint32_t h = 0; h < helmets; h++) {
+      bool pinned = h == spike_helmet || (h % zones == dropout.zone && h < dropout_first + 5 * zones);
+      if (!pinned && uni(rng) < MOVE_P)
+        zone_of[h] = (uint16_t)(rng() % zones);
+      uint16_t zone = zone_of[h];
+
+      if (t0 >= dropout.start_ms && t0 < dropout.end_ms && h % zones == dropout.zone &&
+          h < dropout_first + 5 * zones)
+        continue;
+
+      int64_t t = t0 + (int64_t)(rng() % (2 * JITTER_MS + 1)) - JITTER_MS;
+      if (t < 0)
+        t = 0;
+
+      double temp_c = 25.0 + noise(rng) * 0.3 + (h % 7) * 0.5;
+      if (zone == heat.zone && t >= heat.start_ms && t < heat.end_ms)
+        temp_c = TEMP_MAX - 3 + noise(rng) * 0.3;
+
+      // In tenths of GAS_MAX
+      double gas = 2.0 + noise(rng) * 0.7;
+      if (zone == leak.zone && t >= leak.start_ms) {
+        double minutes = (t - leak.start_ms) / 60000.0;
+        double rise = minutes < 12 ? minutes : std::fmax(0.0, 12.0 - (minutes - 12.0) * 1.2);
+        gas += rise;
+      }
+      gas *= GAS_MAX / 10.0;
+      if (h == spike_helmet && t >= spike.start_ms && t < spike.end_ms)
+        gas = GAS_MAX + 5;
+
+      batch.push_back({ t, (uint16_t)(HELMET_BASE + h), zone, ts_signal_t::temperature,
+                        (int32_t)std::lround(temp_c * 1000) });
+      batch.push_back({ t, (uint16_t)(HELMET_BASE + h), zone, ts_signal_t::gas,
+                        (int32_t)std::lround(std::fmax(0.0, gas)) });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (const corr_event_t &e : batch)
+      engine.on_event(e);
+    while (next_advance <= t0) {
+      engine.advance(next_advance);
+      next_advance += ADVANCE_MS;
+    }
+    engine_s += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    events += batch.size();
+  }
+
+  corr_stats_t st = engine.stats();
+  printf("\nshift          %u h, %u helmets in %u zones, %zu rules\n", hours, helmets, zones, rules.size());
+  printf("events         %llu in %.2f s engine time, %.2f M events/s, %.0f ns/event\n", (unsigned long long)events,
+         engine_s, events / engine_s / 1e6, engine_s * 1e9 / events);
+  printf("shift rate     %.0f events/s needed, %.0fx headroom\n", events / (shift_ms / 1000.0),
+         (events / engine_s) / (events / (shift_ms / 1000.0)));
+  printf("evaluations    %llu, %.2f per event\n", (unsigned long long)st.evaluations,
+         (double)st.evaluations / events);
+  printf("alerts         %llu raised (%llu expected, %llu false), %llu cleared, %llu silences\n",
+         (unsigned long long)st.raised, (unsigned long long)expected, (unsigned long long)unexpected,
+         (unsigned long long)st.cleared, (unsigned long long)st.silences);
+
+  for (const incident_t &inc : incidents) {
+    printf("%-14s zone %2u at ", inc.name, inc.zone);
+    print_time(inc.start_ms);
+    if (!inc.rule)
+      printf("  no zone alert expected\n");
+    else if (inc.detected_ms < 0)
+      printf("  %s MISSED\n", inc.rule);
+    else
+      printf("  %s after %.1f s\n", inc.rule, (inc.detected_ms - inc.start_ms) / 1000.0);
+  }
+
+  return unexpected ? 1 : 0;
+}
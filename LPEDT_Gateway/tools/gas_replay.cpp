@@ -0,0 +1,401 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    gas_replay.cpp
+ * @brief   Runs gas traces through the helmet gas baseline (gas_baseline.c
+ *          of btmesh_vendor_client5_msg2) on the host and checks the alarm
+ *          that app.c raises on its index (gas_baseline_alarm(), set over
+ *          GAS_MAX and cleared GAS_ALARM_HYST under it).
+ *
+ *          A trace is CSV, one BME688 reading per line:
+ *
+ *            t_ms,ohms,humidity_pct[,gas_pct]
+ *
+ *          ohms 0 is a failed reading. gas_pct, when there, is how far gas
+ *          pulls the resistance under clean air, percent. With it every
+ *          alarm while gas_pct is under GAS_MAX / 2 (and was for the last
+ *          GAS_TAIL_MS) counts as false, and a stretch of gas_pct over
+ *          GAS_MAX + 10 with no alarm counts as missed. The delay is the
+ *          latest alarm after the gas went over GAS_MAX, negative when every
+ *          event was detected before it got there (early). Without gas_pct
+ *          the alarms are listed.
+ *
+ *          With no --trace the built in scenarios run, one reading every
+ *          CLIENT_SLEEP_TIME_MS: sensor burn-in, humidity swings, a slow
+ *          sensor drift, a fast leak with failed readings in it, and a slow
+ *          leak. --write-trace saves one of them for --trace.
+ *
+ *          Exits 1 on a false or missed alarm.
+ *
+ *          usage: gas_replay [--trace FILE] [--seed N] [--verbose]
+ *                 gas_replay --write-trace FILE --scenario NAME [--seed N]
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+extern "C" {
+#include "gas_baseline.h"
+}
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Custom_Defines.h"
+
+#define GAS_TAIL_MS         (60000)    // alarm allowed this long after the gas is gone
+#define CLEAN_OHM           (120000.0)
+#define HUM_SLOPE           (0.016)    // ln(ohm) per %RH, generator side
+
+struct reading_t {
+  int64_t  t_ms;
+  uint32_t ohms;
+  int32_t  humidity_pct;
+  int32_t  gas_pct;      // -1 if the trace has none
+};
+
+struct scenario_t {
+  const char *name;
+  const char *about;
+  std::vector<reading_t> (*make)(std::mt19937 &rng);
+};
+
+static const char *arg_str(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return argv[i + 1];
+  }
+  return nullptr;
+}
+
+static long arg_long(int argc, char **argv, const char *name, long def)
+{
+  const char *s = arg_str(argc, argv, name);
+  return s ? strtol(s, NULL, 0) : def;
+}
+
+static bool arg_flag(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return true;
+  }
+  return false;
+}
+
+/*
+ * Generator. The resistance is clean air times the humidity and gas
+ * factors, with 2 % reading noise. The humidity effect is modelled as
+ * exponential, the baseline compensates it linearly.
+ */
+static reading_t make_reading(std::mt19937 &rng, int64_t t_ms, double clean_ohm, double humidity, double gas_pct)
+{
+  std::normal_distribution<double> noise(0.0, 0.02);
+  double ohm = clean_ohm * std::exp(-HUM_SLOPE * (humidity - GAS_HUM_REF_PCT)) * (1.0 - gas_pct / 100.0);
+  ohm *= 1.0 + noise(rng);
+  return { t_ms, (uint32_t)std::lround(std::fmax(1.0, ohm)), (int32_t)std::lround(humidity),
+           (int32_t)std::lround(gas_pct) };
+}
+
+static double hours_ms(double h)
+{
+  return h * 3600.0 * 1000.0;
+}
+
+// Cold sensor, the resistance climbs to clean air over minutes
+static std::vector<reading_t> make_burn_in(std::mt19937 &rng)
+{
+  std::vector<reading_t> out;
+  for (int64_t t = 0; t < (int64_t)hours_ms(0.5); t += CLIENT_SLEEP_TIME_MS) {
+    double clean = CLEAN_OHM * (1.0 - 0.85 * std::exp(-t / 300000.0));
+    out.push_back(make_reading(rng, t, clean, 45.0, 0.0));
+  }
+  return out;
+}
+
+// 30 to 85 %RH, a slow swing and a step into a wet drift and back
+static std::vector<reading_t> make_humidity(std::mt19937 &rng)
+{
+  std::vector<reading_t> out;
+  for (int64_t t = 0; t < (int64_t)hours_ms(2.0); t += CLIENT_SLEEP_TIME_MS) {
+    double h = 50.0 + 20.0 * std::sin(2.0 * M_PI * t / 1200000.0);
+    if (t > hours_ms(1.0) && t < hours_ms(1.25))
+      h = 85.0;
+    out.push_back(make_reading(rng, t, CLEAN_OHM, h, 0.0));
+  }
+  return out;
+}
+
+// The sensor loses 25 % of its clean air resistance over a shift
+static std::vector<reading_t> make_drift(std::mt19937 &rng)
+{
+  std::vector<reading_t> out;
+  double shift = hours_ms(8.0);
+  for (int64_t t = 0; t < (int64_t)shift; t += CLIENT_SLEEP_TIME_MS)
+    out.push_back(make_reading(rng, t, CLEAN_OHM * (1.0 - 0.25 * t / shift), 45.0, 0.0));
+  return out;
+}
+
+// Down to 30 % in a minute, 10 minutes of it, 2 minutes to clear, 1 % failed readings
+static std::vector<reading_t> make_leak(std::mt19937 &rng)
+{
+  std::uniform_real_distribution<double> uni(0.0, 1.0);
+  std::vector<reading_t> out;
+  double start = hours_ms(1.0);
+  for (int64_t t = 0; t < (int64_t)hours_ms(1.5); t += CLIENT_SLEEP_TIME_MS) {
+    double gas = 0.0, dt = t - start;
+    if (dt >= 0 && dt < 60000)
+      gas = 70.0 * dt / 60000;
+    else if (dt >= 60000 && dt < 660000)
+      gas = 70.0;
+    else if (dt >= 660000 && dt < 780000)
+      gas = 70.0 * (1.0 - (dt - 660000) / 120000);
+    reading_t r = make_reading(rng, t, CLEAN_OHM, 45.0, gas);
+    if (uni(rng) < 0.01)
+      r.ohms = 0;
+    out.push_back(r);
+  }
+  return out;
+}
+
+// Down to 45 % over 15 minutes, held for 5
+static std::vector<reading_t> make_slow_leak(std::mt19937 &rng)
+{
+  std::vector<reading_t> out;
+  double start = hours_ms(1.0);
+  for (int64_t t = 0; t < (int64_t)hours_ms(1.5); t += CLIENT_SLEEP_TIME_MS) {
+    double gas = 0.0, dt = t - start;
+    if (dt >= 0 && dt < 900000)
+      gas = 55.0 * dt / 900000;
+    else if (dt >= 900000 && dt < 1200000)
+      gas = 55.0;
+    out.push_back(make_reading(rng, t, CLEAN_OHM, 45.0, gas));
+  }
+  return out;
+}
+
+static const scenario_t scenarios[] = {
+  { "burn_in",   "cold sensor, 15 % to 100 % of clean air", make_burn_in },
+  { "humidity",  "30 to 85 %RH swings and steps",            make_humidity },
+  { "drift",     "clean air resistance -25 % over 8 h",      make_drift },
+  { "leak",      "70 % drop in 60 s for 10 min, 1 % failed", make_leak },
+  { "slow_leak", "55 % drop over 15 min",                    make_slow_leak },
+};
+
+static bool load_trace(const char *path, std::vector<reading_t> &out)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return false;
+
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    long long t;
+    unsigned long ohms;
+    int hum, gas;
+    int n = sscanf(line, "%lld,%lu,%d,%d", &t, &ohms, &hum, &gas);
+    if (n < 3)
+      continue;   // header or blank
+    out.push_back({ (int64_t)t, (uint32_t)ohms, (int32_t)hum, n == 4 ? (int32_t)gas : -1 });
+  }
+  fclose(f);
+  return true;
+}
+
+static bool write_trace(const char *path, const std::vector<reading_t> &trace)
+{
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return false;
+  fprintf(f, "t_ms,ohms,humidity_pct,gas_pct\n");
+  for (const reading_t &r : trace)
+    fprintf(f, "%lld,%lu,%d,%d\n", (long long)r.t_ms, (unsigned long)r.ohms, r.humidity_pct, r.gas_pct);
+  fclose(f);
+  return true;
+}
+
+struct replay_result_t {
+  uint64_t alarms = 0;         // readings with the alarm set
+  uint32_t raised = 0;         // times it was set
+  uint64_t false_alarms = 0;
+  uint32_t events = 0;         // stretches of gas over GAS_MAX + 10
+  uint32_t missed = 0;
+  uint32_t early = 0;          // detected before the gas reached GAS_MAX
+  bool     has_delay = false;
+  int64_t  worst_delay_ms = 0; // alarm minus onset, negative if early
+  uint8_t  clean_index_max = 0;
+  double   ns_per_update = 0.0;
+  uint32_t baseline_ohm = 0;
+};
+
+static replay_result_t replay(const std::vector<reading_t> &trace, bool verbose)
+{
+  replay_result_t res;
+  gas_baseline_t gb;
+  gas_baseline_init(&gb);
+
+  std::vector<uint8_t> index(trace.size());
+  std::vector<bool> alarmed(trace.size());
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < trace.size(); i++) {
+    index[i] = gas_baseline_update(&gb, trace[i].ohms, trace[i].humidity_pct);
+    alarmed[i] = gas_baseline_alarm(&gb, GAS_MAX);
+  }
+  res.ns_per_update = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                      (trace.empty() ? 1 : trace.size());
+  res.baseline_ohm = gas_baseline_ohms(&gb);
+
+  int64_t gas_seen_ms = INT64_MIN / 2;   // last reading with gas at GAS_MAX / 2 or more
+  int64_t onset_ms = -1;                 // gas went over GAS_MAX
+  int64_t last_onset_ms = -1;            // onset of the event in progress
+  int64_t alarm_ms = -1;                 // first alarm since the gas came up
+  bool in_event = false, detected = false;
+  bool alarm = false;
+
+  for (size_t i = 0; i < trace.size(); i++) {
+    const reading_t &r = trace[i];
+    bool now = alarmed[i];
+    if (now) {
+      res.alarms++;
+      if (!alarm) {
+        res.raised++;
+        if (verbose || r.gas_pct < 0)
+          printf("    alarm at %8.1f s, index %u, gas %d %%\n", r.t_ms / 1000.0, index[i], r.gas_pct);
+      }
+    }
+    else if (alarm && (verbose || r.gas_pct < 0)) {
+      printf("    clear at %8.1f s, index %u, gas %d %%\n", r.t_ms / 1000.0, index[i], r.gas_pct);
+    }
+    alarm = now;
+    if (r.gas_pct < 0)
+      continue;
+
+    if (r.gas_pct >= GAS_MAX / 2)
+      gas_seen_ms = r.t_ms;
+    bool clean = r.gas_pct < GAS_MAX / 2 && r.t_ms - gas_seen_ms > GAS_TAIL_MS;
+    if (clean && index[i] > res.clean_index_max)
+      res.clean_index_max = index[i];
+    if (clean && now)
+      res.false_alarms++;
+
+    if (r.gas_pct > GAS_MAX && onset_ms < 0)
+      onset_ms = last_onset_ms = r.t_ms;
+    if (r.gas_pct <= GAS_MAX)
+      onset_ms = -1;
+    if (now && alarm_ms < 0)
+      alarm_ms = r.t_ms;
+    if (r.gas_pct < GAS_MAX / 2)
+      alarm_ms = -1;
+
+    if (r.gas_pct > GAS_MAX + 10 && !in_event) {
+      in_event = true;
+      detected = false;
+      res.events++;
+    }
+    if (in_event && now && !detected) {
+      detected = true;
+      // An alarm raised while the gas was still coming up is early, not
+      // 0 s late
+      int64_t delay = alarm_ms - last_onset_ms;
+      if (delay < 0)
+        res.early++;
+      if (!res.has_delay || delay > res.worst_delay_ms)
+        res.worst_delay_ms = delay;
+      res.has_delay = true;
+    }
+    if (in_event && r.gas_pct <= GAS_MAX) {
+      in_event = false;
+      if (!detected)
+        res.missed++;
+    }
+  }
+  if (in_event && !detected)
+    res.missed++;
+
+  return res;
+}
+
+static void print_result(const char *name, size_t readings, const replay_result_t &res, bool has_truth)
+{
+  printf("%-10s %8zu  %6llu  %6u", name, readings, (unsigned long long)res.alarms, res.raised);
+  if (has_truth) {
+    printf("  %5llu  %4u/%-4u  %5u  ", (unsigned long long)res.false_alarms, res.events - res.missed, res.events,
+           res.early);
+    if (res.has_delay)
+      printf("%+7.1f", res.worst_delay_ms / 1000.0);
+    else
+      printf("%7s", "-");
+    printf("  %5u", res.clean_index_max);
+  }
+  printf("  %8u  %6.1f\n", res.baseline_ohm, res.ns_per_update);
+}
+
+int main(int argc, char **argv)
+{
+  const char *trace_path = arg_str(argc, argv, "--trace");
+  const char *write_path = arg_str(argc, argv, "--write-trace");
+  const char *scenario   = arg_str(argc, argv, "--scenario");
+  uint32_t seed          = (uint32_t)arg_long(argc, argv, "--seed", 1);
+  bool verbose           = arg_flag(argc, argv, "--verbose");
+
+  if (write_path) {
+    for (const scenario_t &s : scenarios) {
+      if (scenario && strcmp(scenario, s.name) == 0) {
+        std::mt19937 rng(seed);
+        if (!write_trace(write_path, s.make(rng))) {
+          fprintf(stderr, "gas_replay: cannot write %s\n", write_path);
+          return 1;
+        }
+        return 0;
+      }
+    }
+    fprintf(stderr, "gas_replay: --write-trace needs --scenario burn_in|humidity|drift|leak|slow_leak\n");
+    return 1;
+  }
+
+  printf("alarm on index > GAS_MAX (%d), clear at %d, baseline warm-up %d readings\n\n", GAS_MAX,
+         GAS_MAX - GAS_ALARM_HYST, GAS_BASELINE_WARMUP);
+  printf("trace      readings  alarms  raised  false  detected  early  delay s  clean max  baseline ohm  ns/update\n");
+
+  uint64_t failures = 0;
+  if (trace_path) {
+    std::vector<reading_t> trace;
+    if (!load_trace(trace_path, trace)) {
+      fprintf(stderr, "gas_replay: cannot open %s\n", trace_path);
+      return 1;
+    }
+    bool has_truth = !trace.empty() && trace[0].gas_pct >= 0;
+    replay_result_t res = replay(trace, verbose);
+    print_result("trace", trace.size(), res, has_truth);
+    failures = res.false_alarms + res.missed;
+  }
+  else {
+    for (const scenario_t &s : scenarios) {
+      std::mt19937 rng(seed);
+      std::vector<reading_t> trace = s.make(rng);
+      replay_result_t res = replay(trace, verbose);
+      print_result(s.name, trace.size(), res, true);
+      failures += res.false_alarms + res.missed;
+    }
+    printf("\n");
+    for (const scenario_t &s : scenarios)
+      printf("%-10s %s\n", s.name, s.about);
+  }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,366 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    indq_bench.cpp
+ * @brief   Checks and benchmarks the miner board indication queue
+ *          (src/indication_queue.c of LPEDT_Miner_Safety_Project) on the host.
+ *
+ *          The checks run first and the tool exits with 1 if one fails:
+ *          random operations against a reference model (coalescing, full
+ *          and empty, byte counts) starting at several counter values so the
+ *          32 bit wrap is covered, then a producer and a consumer thread
+ *          passing numbered records through the queue.
+ *
+ *          The benchmark compares it with the fixed 16 slot ring ble.c used
+ *          before: write/read cost, get_queue_depth() cost against fill
+ *          level, and how stale the delivered readings are when the client
+ *          confirms indications slower than the sensors produce them.
+ *
+ *          usage: indq_bench [--ops N] [--seed N]
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+extern "C" {
+#include "indication_queue.h"
+}
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define LEGACY_DEPTH       (16)
+#define LEGACY_MAX_LENGTH  (5)
+
+#define HANDLE_HTM         (0x0012)   // 5 byte temperature measurement
+#define HANDLE_BUTTON      (0x0016)   // 1 byte button state
+
+/*
+ * The fixed slot ring ble.c used before, kept here as the baseline
+ */
+struct legacy_queue {
+  struct slot_t {
+    uint16_t charHandle;
+    uint32_t bufLength;
+    uint8_t  buffer[LEGACY_MAX_LENGTH];
+  } slots[LEGACY_DEPTH];
+  uint32_t wptr = 0, rptr = 0;
+  bool full = false, empty = true;
+
+  static uint32_t next(uint32_t ptr) { return (ptr + 1 == LEGACY_DEPTH) ? 0 : ptr + 1; }
+
+  bool write(uint16_t handle, uint32_t len, const uint8_t *buf)
+  {
+    if (full || len > LEGACY_MAX_LENGTH || len < 1)
+      return true;
+    if (next(wptr) == rptr)
+      full = true;
+    slots[wptr].charHandle = handle;
+    slots[wptr].bufLength = len;
+    for (uint32_t i = 0; i < len; i++)
+      slots[wptr].buffer[i] = buf[i];
+    empty = false;
+    if (!full)
+      wptr = next(wptr);
+    return false;
+  }
+
+  bool read(uint16_t *handle, uint32_t *len, uint8_t *buf)
+  {
+    if (empty)
+      return true;
+    if (next(rptr) == wptr)
+      empty = true;
+    *handle = slots[rptr].charHandle;
+    *len = slots[rptr].bufLength;
+    memcpy(buf, slots[rptr].buffer, slots[rptr].bufLength);
+    rptr = next(rptr);
+    if (full) {
+      full = false;
+      wptr = next(wptr);
+    }
+    return false;
+  }
+
+  uint32_t depth() const
+  {
+    if (empty)
+      return 0;
+    if (full)
+      return LEGACY_DEPTH;
+    uint32_t n = 0;
+    for (uint32_t i = rptr; i != wptr; i = next(i))
+      n++;
+    return n;
+  }
+};
+
+static int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      fprintf(stderr, "check failed, line %d: %s\n", __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+static uint32_t arg_u32(int argc, char **argv, const char *name, uint32_t def)
+{
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return (uint32_t)strtoul(argv[i + 1], NULL, 0);
+  }
+  return def;
+}
+
+/*
+ * Random writes and reads against a reference model. start sets the free
+ * running counters, so a start just below 2^32 wraps them.
+ */
+static void check_model(uint32_t seed, uint32_t ops, uint32_t start)
+{
+  struct record_t {
+    uint16_t handle;
+    std::vector<uint8_t> data;
+  };
+  std::deque<record_t> model;
+  uint32_t model_bytes = 0, model_coalesced = 0;
+
+  indication_queue_t q;
+  indication_queue_reset(&q);
+  q.wr = q.claim = q.rd = start;
+
+  std::mt19937 rng(seed);
+  for (uint32_t op = 0; op < ops && failures < 10; op++) {
+    if (rng() % 100 < 55) {
+      uint16_t handle = (uint16_t)(1 + rng() % 6);
+      uint8_t len = (uint8_t)(1 + rng() % LEGACY_MAX_LENGTH);
+      std::vector<uint8_t> data(len);
+      for (auto &b : data)
+        b = (uint8_t)rng();
+
+      bool expect = false;
+      bool merged = false;
+      for (auto &r : model) {
+        if (r.handle == handle && r.data.size() == len) {
+          r.data = data;
+          merged = true;
+          model_coalesced++;
+          break;
+        }
+      }
+      if (merged) {
+        expect = true;
+      }
+      else if (INDICATION_QUEUE_BYTES - model_bytes >= (uint32_t)(INDICATION_QUEUE_HEADER + len)) {
+        model.push_back({handle, data});
+        model_bytes += INDICATION_QUEUE_HEADER + len;
+        expect = true;
+      }
+      CHECK(indication_queue_write(&q, handle, data.data(), len) == expect);
+    }
+    else {
+      uint16_t handle = 0;
+      uint8_t buf[LEGACY_MAX_LENGTH], len = 0;
+      bool got = indication_queue_read(&q, &handle, buf, &len, sizeof(buf));
+      CHECK(got == !model.empty());
+      if (got && !model.empty()) {
+        const record_t &r = model.front();
+        CHECK(handle == r.handle);
+        CHECK(len == r.data.size());
+        CHECK(memcmp(buf, r.data.data(), len) == 0);
+        model_bytes -= INDICATION_QUEUE_HEADER + (uint32_t)r.data.size();
+        model.pop_front();
+      }
+    }
+    CHECK(indication_queue_depth(&q) == model.size());
+    CHECK(indication_queue_free(&q) == INDICATION_QUEUE_BYTES - model_bytes);
+  }
+  CHECK(q.coalesced == model_coalesced);
+
+  // A record longer than the reader's buffer stays queued
+  indication_queue_reset(&q);
+  uint8_t big[8] = {1, 2, 3, 4, 5, 6, 7, 8}, small[4], len;
+  uint16_t handle;
+  CHECK(indication_queue_write(&q, 7, big, sizeof(big)));
+  CHECK(!indication_queue_read(&q, &handle, small, &len, sizeof(small)));
+  CHECK(indication_queue_depth(&q) == 1);
+  CHECK(!indication_queue_write(&q, 7, big, 0));
+}
+
+/*
+ * Producer and consumer threads. Handles are never repeated while pending,
+ * so nothing coalesces and every record must arrive once, in order.
+ */
+static void check_threads(uint32_t count)
+{
+  static indication_queue_t q;
+  indication_queue_reset(&q);
+
+  std::thread producer([count] {
+    for (uint32_t i = 0; i < count; i++) {
+      uint8_t data[LEGACY_MAX_LENGTH];
+      uint8_t len = (uint8_t)(1 + i % LEGACY_MAX_LENGTH);
+      for (uint8_t b = 0; b < len; b++)
+        data[b] = (uint8_t)(i + b);
+      while (!indication_queue_write(&q, (uint16_t)i, data, len))
+        std::this_thread::yield();
+    }
+  });
+
+  uint32_t bad = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t handle;
+    uint8_t data[LEGACY_MAX_LENGTH], len;
+    while (!indication_queue_read(&q, &handle, data, &len, sizeof(data)))
+      std::this_thread::yield();
+    bool ok = (handle == (uint16_t)i) && (len == 1 + i % (uint32_t)LEGACY_MAX_LENGTH);
+    for (uint8_t b = 0; ok && b < len; b++)
+      ok = (data[b] == (uint8_t)(i + b));
+    if (!ok)
+      bad++;
+  }
+  producer.join();
+
+  CHECK(bad == 0);
+  CHECK(indication_queue_depth(&q) == 0);
+  CHECK(q.coalesced == 0);
+}
+
+template <typename F>
+static double time_ns(uint32_t iterations, F fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++)
+    fn(i);
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+}
+
+/*
+ * Sensors produce an HTM and a button reading every tick, the client
+ * confirms one indication every confirm_ticks ticks. Reports how old the
+ * delivered readings are and how many were refused because the queue was
+ * full.
+ */
+template <typename W, typename R>
+static void run_stale(const char *name, uint32_t ticks, uint32_t confirm_ticks, W write, R read)
+{
+  uint64_t delivered = 0, refused = 0, age_sum = 0;
+  uint32_t age_max = 0;
+
+  for (uint32_t t = 0; t < ticks; t++) {
+    // Each reading carries the tick it was taken at
+    uint8_t htm[5] = {0, (uint8_t)t, (uint8_t)(t >> 8), (uint8_t)(t >> 16), (uint8_t)(t >> 24)};
+    uint8_t button[1] = {(uint8_t)t};
+    refused += write(HANDLE_HTM, htm, 5) ? 0 : 1;
+    if (t % 4 == 0)
+      refused += write(HANDLE_BUTTON, button, 1) ? 0 : 1;
+
+    if (t % confirm_ticks == 0) {
+      uint16_t handle;
+      uint8_t data[5];
+      uint32_t len;
+      if (read(&handle, data, &len) && handle == HANDLE_HTM) {
+        uint32_t taken = data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t)data[4] << 24);
+        uint32_t age = t - taken;
+        age_sum += age;
+        if (age > age_max)
+          age_max = age;
+        delivered++;
+      }
+    }
+  }
+
+  printf("  %-10s refused %6llu, HTM delivered %6llu, age mean %7.1f max %6u ticks\n", name,
+         (unsigned long long)refused, (unsigned long long)delivered,
+         delivered ? (double)age_sum / delivered : 0.0, age_max);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t ops  = arg_u32(argc, argv, "--ops", 1000000);
+  uint32_t seed = arg_u32(argc, argv, "--seed", 1);
+
+  // Checks
+  const uint32_t starts[] = {0, 0x7FFFFFF0u, 0xFFFFFF80u, 0xFFFFFFFDu};
+  for (uint32_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++)
+    check_model(seed + i, ops / 4, starts[i]);
+  check_threads(ops);
+
+  printf("checks         %s\n", failures ? "FAILED" : "passed");
+  if (failures)
+    return 1;
+
+  // Write + read of one record
+  static indication_queue_t q;
+  static legacy_queue legacy;
+  volatile uint32_t sink = 0;
+  uint8_t data[5] = {1, 2, 3, 4, 5}, out[5], len8;
+  uint16_t handle;
+  uint32_t len32 = 0;
+
+  indication_queue_reset(&q);
+  double q_rw = time_ns(ops, [&](uint32_t i) {
+    indication_queue_write(&q, (uint16_t)(i & 1 ? HANDLE_HTM : HANDLE_BUTTON), data, i & 1 ? 5 : 1);
+    indication_queue_read(&q, &handle, out, &len8, sizeof(out));
+    sink += len8;
+  });
+  double l_rw = time_ns(ops, [&](uint32_t i) {
+    legacy.write((uint16_t)(i & 1 ? HANDLE_HTM : HANDLE_BUTTON), i & 1 ? 5 : 1, data);
+    legacy.read(&handle, &len32, out);
+    sink += len32;
+  });
+  printf("write + read   queue %6.1f ns, fixed slots %6.1f ns\n", q_rw, l_rw);
+
+  // Depth at several fill levels, distinct handles so nothing coalesces
+  printf("depth          fill  queue ns  fixed slots ns\n");
+  const uint32_t fills[] = {0, 4, 8, 15};
+  for (uint32_t f : fills) {
+    indication_queue_reset(&q);
+    legacy = legacy_queue();
+    for (uint32_t i = 0; i < f; i++) {
+      indication_queue_write(&q, (uint16_t)(0x100 + i), data, 5);
+      legacy.write((uint16_t)(0x100 + i), 5, data);
+    }
+    double qd = time_ns(ops, [&](uint32_t) { sink += indication_queue_depth(&q); });
+    double ld = time_ns(ops, [&](uint32_t) { sink += legacy.depth(); });
+    printf("               %4u  %8.2f  %14.2f\n", f, qd, ld);
+  }
+
+  // Staleness with a slow client
+  const uint32_t ticks = 100000, confirm_ticks = 3;
+  printf("slow client    %u ticks, HTM every tick, button every 4, one confirm every %u\n", ticks,
+         confirm_ticks);
+  indication_queue_reset(&q);
+  run_stale("queue", ticks, confirm_ticks,
+            [&](uint16_t h, const uint8_t *d, uint8_t l) { return indication_queue_write(&q, h, d, l); },
+            [&](uint16_t *h, uint8_t *d, uint32_t *l) {
+              uint8_t n;
+              bool ok = indication_queue_read(&q, h, d, &n, 5);
+              *l = n;
+              return ok;
+            });
+  legacy = legacy_queue();
+  run_stale("fixed", ticks, confirm_ticks,
+            [&](uint16_t h, const uint8_t *d, uint8_t l) { return !legacy.write(h, l, d); },
+            [&](uint16_t *h, uint8_t *d, uint32_t *l) { return !legacy.read(h, l, d); });
+
+  (void)sink;
+  return 0;
+}
@@ -0,0 +1,550 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ingest_daemon.cpp
+ * @brief   Gateway telemetry ingest service, runs ingest_pipeline on the
+ *          BGAPI stream of the mesh NCP.
+ *
+ *          The input is the serial device of the NCP, a capture of it, a
+ *          Unix socket a stand-in forwards the stream on, or stdin. A tty
+ *          input is switched to raw 8N1 at 115200 baud first, the line
+ *          discipline would otherwise rewrite CR/LF and eat control bytes
+ *          in the binary frames. Alarms go to stdout,
+ *          the messages to a CSV file with --out. --store keeps the
+ *          temperature of every helmet in a ts_store file, by wall clock
+ *          time of arrival. --capture writes every accepted message with
+ *          its arrival time and the alarm it raised, for mesh_replay.
+ *
+ *          --bench generates a synthetic helmet/anchor mix in memory instead
+ *          and feeds it flat out, or paced at --rate frames/s so the latency
+ *          histogram shows the pipeline rather than the backlog.
+ *          --write-capture saves the same mix as a replay file for --in.
+ *
+ *          usage: ingest_daemon [--in FILE | --socket PATH] [--out FILE]
+ *                               [--store FILE] [--capture FILE] [--queue N]
+ *                               [--cpu N] [--no-pin]
+ *                 ingest_daemon --bench N [--rate N] [--helmets N] [--seed N]
+ *                               [--out FILE] [--store FILE] [--capture FILE]
+ *                               [--queue N] [--cpu N] [--no-pin]
+ *                 ingest_daemon --write-capture FILE --bench N [--helmets N]
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "ingest_pipeline.h"
+#include "mesh_capture.h"
+#include "ts_store.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "my_model_def.h"
+#include "Custom_Defines.h"
+
+extern "C" {
+#include "energy.h"
+#include "timesync.h"
+}
+
+using namespace lpedt;
+
+#define BENCH_ANCHORS        (6)
+#define BENCH_HELMET_BASE    (0x0100)
+#define BENCH_ANCHOR_BASE    (0x0800)
+#define BENCH_CHUNK          (4096)   // bytes per feed() when not paced
+#define BENCH_NOISE_EVERY    (50000)  // frames between bursts of line noise
+#define NCP_BAUD             B115200  // sl_iostream_usart_vcom_config.h of the NCP
+
+static const char *arg_str(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return argv[i + 1];
+  }
+  return nullptr;
+}
+
+static long arg_long(int argc, char **argv, const char *name, long def)
+{
+  const char *s = arg_str(argc, argv, name);
+  return s ? strtol(s, NULL, 0) : def;
+}
+
+static bool arg_flag(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return true;
+  }
+  return false;
+}
+
+/*
+ * One CSV line per message
+ */
+class csv_sink : public ingest_sink {
+public:
+  explicit csv_sink(FILE *out) : out_(out)
+  {
+    fprintf(out_, "arrival_ns,src,dst,opcode,payload,alarm\n");
+  }
+
+  void write(const ingest_item_t &item) override
+  {
+    char hex[2 * NCP_VENDOR_PAYLOAD_MAX + 1];
+    for (uint8_t i = 0; i < item.msg.len; i++)
+      snprintf(&hex[2 * i], 3, "%02x", item.msg.payload[i]);
+    hex[2 * item.msg.len] = '\0';
+
+    fprintf(out_, "%llu,0x%04x,0x%04x,%u,%s,%s\n", (unsigned long long)item.arrival_ns, item.msg.src,
+            item.msg.dst, item.msg.opcode, hex,
+            item.alarm == alarm_kind_t::none ? "" : alarm_name(item.alarm));
+  }
+
+  void flush() override { fflush(out_); }
+
+private:
+  FILE *out_;
+};
+
+/*
+ * temperature_status into the time series store, everything is passed on to
+ * the next sink if there is one
+ */
+class store_sink : public ingest_sink {
+public:
+  store_sink(ts_store &store, ingest_sink *next) : store_(store), next_(next)
+  {
+    // arrival is on the steady clock, the store is by wall clock
+    int64_t wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+    wall_offset_ms_ = wall_ms - (int64_t)(ingest_pipeline::now_ns() / 1000000);
+  }
+
+  void write(const ingest_item_t &item) override
+  {
+    if (item.msg.opcode == temperature_status && item.temp_valid) {
+      int64_t t_ms = (int64_t)(item.arrival_ns / 1000000) + wall_offset_ms_;
+      store_.append(item.msg.src, ts_signal_t::temperature, t_ms, item.temp_mc);
+    }
+    if (next_)
+      next_->write(item);
+  }
+
+  void flush() override
+  {
+    store_.sync();
+    if (next_)
+      next_->flush();
+  }
+
+private:
+  ts_store    &store_;
+  ingest_sink *next_;
+  int64_t      wall_offset_ms_;
+};
+
+/*
+ * Every message into a capture file, passed on to the next sink
+ */
+class capture_sink : public ingest_sink {
+public:
+  capture_sink(capture_writer &writer, uint64_t start_ns, ingest_sink *next)
+    : writer_(writer), start_ns_(start_ns), next_(next)
+  {
+  }
+
+  void write(const ingest_item_t &item) override
+  {
+    capture_record_t rec;
+    uint64_t t_us = item.arrival_ns > start_ns_ ? (item.arrival_ns - start_ns_) / 1000 : 0;
+    capture_from_msg(item.msg, t_us, CAPTURE_RSSI_UNKNOWN, (uint8_t)item.alarm, rec);
+    writer_.write(rec);
+    if (next_)
+      next_->write(item);
+  }
+
+  void flush() override
+  {
+    if (next_)
+      next_->flush();
+  }
+
+private:
+  capture_writer &writer_;
+  uint64_t        start_ns_;
+  ingest_sink    *next_;
+};
+
+/*
+ * Synthetic traffic, roughly what the NCP of a gateway sees: helmets polling
+ * the anchors, the anchors answering, periodic temperature and energy
+ * reports and the odd emergency and over temperature reading
+ */
+struct bench_load_t {
+  std::vector<uint8_t>  bytes;
+  std::vector<uint32_t> frame_end;   // offset past the end of every packet
+  uint64_t emergencies = 0;
+  uint64_t hot_readings = 0;
+};
+
+static void bench_add(bench_load_t &load, const vendor_msg_t &msg)
+{
+  uint8_t buf[NCP_FRAME_MAX];
+  size_t n = ncp_encode_vendor(msg, buf);
+  load.bytes.insert(load.bytes.end(), buf, buf + n);
+  load.frame_end.push_back((uint32_t)load.bytes.size());
+}
+
+static bench_load_t bench_generate(uint64_t frames, uint32_t helmets, uint32_t seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uni(0.0, 1.0);
+  bench_load_t load;
+  load.bytes.reserve(frames * 24);
+  load.frame_end.reserve(frames);
+
+  vendor_msg_t msg{};
+  msg.vendor_id = MY_VENDOR_ID;
+  msg.model_id = MY_MODEL_SERVER_ID;
+  msg.appkey_index = 0;
+  msg.va_index = -1;
+  msg.final = 1;
+
+  uint32_t network_ms = 0;
+  for (uint64_t i = 0; i < frames; i++) {
+    double r = uni(rng);
+    uint16_t helmet = (uint16_t)(BENCH_HELMET_BASE + rng() % helmets);
+    network_ms += 1;
+
+    msg.src = helmet;
+    msg.dst = 0xC002;
+    msg.nonrelayed = (uint8_t)(rng() & 1);
+
+    if (r < 0.70) {
+      msg.opcode = get_rssi;
+      msg.len = SENSOR_STATUS_LENGTH;
+      msg.payload[0] = 0;
+    }
+    else if (r < 0.90) {
+      msg.src = (uint16_t)(BENCH_ANCHOR_BASE + rng() % BENCH_ANCHORS);
+      msg.dst = 0xC001;
+      msg.opcode = get_rssi_status;
+      msg.len = RSSI_DATA_LENGTH;
+      msg.payload[0] = (uint8_t)(int8_t)(-40 - (int)(rng() % 50));
+    }
+    else if (r < 0.97) {
+      int32_t temp_mc = 20000 + (int32_t)(rng() % 15000);
+      if (uni(rng) < 0.001) {
+        temp_mc = (TEMP_MAX + 5) * 1000;
+        load.hot_readings++;
+      }
+      msg.opcode = temperature_status;
+      msg.len = TEMP_DATA_LENGTH;
+      timesync_put_u32(msg.payload, (uint32_t)temp_mc);
+    }
+    else if (r < 0.99) {
+      msg.opcode = energy_status;
+      msg.len = ENERGY_REPORT_LEN;
+      for (int k = 0; k < ENERGY_REPORT_LEN; k++)
+        msg.payload[k] = (uint8_t)rng();
+    }
+    else if (r < 0.999) {
+      msg.opcode = get_emergency;
+      msg.len = 0;
+    }
+    else {
+      msg.opcode = set_emergency;
+      msg.len = TIMESYNC_STAMP_LEN;
+      timesync_put_u32(msg.payload, network_ms);
+      msg.payload[4] = 3;
+      load.emergencies++;
+    }
+    bench_add(load, msg);
+
+    // Line noise and an event the pipeline does not want
+    if (i % BENCH_NOISE_EVERY == BENCH_NOISE_EVERY - 1) {
+      static const uint8_t noise[] = { 0x55, 0x00, 0xff, 0xa0, 0x00, 0x01, 0x00 };
+      load.bytes.insert(load.bytes.end(), noise, noise + sizeof(noise));
+      load.frame_end.push_back((uint32_t)load.bytes.size());
+    }
+  }
+
+  return load;
+}
+
+static int open_socket(const char *path)
+{
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  if (connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/*
+ * Raw 8N1 at NCP_BAUD if fd is a tty, nothing to do for a file, pipe or
+ * socket. false with errno set if the tty could not be set up.
+ */
+static bool set_raw_tty(int fd)
+{
+  if (!isatty(fd))
+    return true;
+
+  termios tio;
+  if (tcgetattr(fd, &tio) != 0)
+    return false;
+
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cc[VMIN] = 1;   // read() blocks for at least one byte
+  tio.c_cc[VTIME] = 0;
+  if (cfsetspeed(&tio, NCP_BAUD) != 0)
+    return false;
+
+  return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+static void report(const ingest_pipeline &pipeline, double secs)
+{
+  const ingest_stats_t &s = pipeline.stats();
+
+  fprintf(stderr, "\nframes         %llu in %.3f s, %.0f frames/s\n", (unsigned long long)s.frames, secs,
+          secs > 0 ? s.frames / secs : 0.0);
+  fprintf(stderr, "ncp            %llu packets, %llu bytes skipped, %llu oversize\n",
+          (unsigned long long)s.ncp.packets, (unsigned long long)s.ncp.skipped, (unsigned long long)s.ncp.oversize);
+  fprintf(stderr, "dropped        %llu other events, %llu model, %llu opcode, %llu length, %llu source\n",
+          (unsigned long long)s.other_events, (unsigned long long)s.bad_model, (unsigned long long)s.bad_opcode,
+          (unsigned long long)s.bad_length, (unsigned long long)s.bad_source);
+  fprintf(stderr, "accepted       %llu, persisted %llu, alarms %llu\n", (unsigned long long)s.accepted,
+          (unsigned long long)s.persisted, (unsigned long long)s.alarms);
+  fprintf(stderr, "reader waits   %llu (parse ring full)\n", (unsigned long long)s.reader_waits);
+
+  fprintf(stderr, "per opcode    ");
+  for (size_t op = 0; op < s.per_opcode.size(); op++) {
+    if (s.per_opcode[op])
+      fprintf(stderr, " %zu:%llu", op, (unsigned long long)s.per_opcode[op]);
+  }
+  fprintf(stderr, "\n\narrival to alarm stage output\n");
+  pipeline.frame_latency().print(stderr, "  all frames");
+  pipeline.alarm_latency().print(stderr, "  alarms");
+}
+
+int main(int argc, char **argv)
+{
+  const char *input   = arg_str(argc, argv, "--in");
+  const char *sock    = arg_str(argc, argv, "--socket");
+  const char *output  = arg_str(argc, argv, "--out");
+  const char *capture = arg_str(argc, argv, "--write-capture");
+  const char *store_path = arg_str(argc, argv, "--store");
+  const char *capture_path = arg_str(argc, argv, "--capture");
+  uint64_t bench      = (uint64_t)arg_long(argc, argv, "--bench", 0);
+  uint64_t rate       = (uint64_t)arg_long(argc, argv, "--rate", 0);
+  uint32_t helmets    = (uint32_t)arg_long(argc, argv, "--helmets", 500);
+  uint32_t seed       = (uint32_t)arg_long(argc, argv, "--seed", 1);
+
+  ingest_config_t config;
+  config.queue_depth = (size_t)arg_long(argc, argv, "--queue", (long)config.queue_depth);
+  config.pin = !arg_flag(argc, argv, "--no-pin");
+  int reader_cpu = (int)arg_long(argc, argv, "--cpu", 0);
+  config.first_cpu = reader_cpu + 1;
+
+  if (helmets == 0 || helmets > INGEST_MAX_ADDRESS - BENCH_HELMET_BASE) {
+    fprintf(stderr, "ingest_daemon: bad --helmets\n");
+    return 1;
+  }
+
+  bench_load_t load;
+  if (bench) {
+    load = bench_generate(bench, helmets, seed);
+    fprintf(stderr, "synthetic      %llu frames, %zu bytes, %u helmets, %llu emergencies, %llu hot readings\n",
+            (unsigned long long)bench, load.bytes.size(), helmets, (unsigned long long)load.emergencies,
+            (unsigned long long)load.hot_readings);
+  }
+
+  if (capture) {
+    if (!bench) {
+      fprintf(stderr, "ingest_daemon: --write-capture needs --bench N\n");
+      return 1;
+    }
+    FILE *f = fopen(capture, "wb");
+    if (!f || fwrite(load.bytes.data(), 1, load.bytes.size(), f) != load.bytes.size()) {
+      fprintf(stderr, "ingest_daemon: cannot write %s\n", capture);
+      return 1;
+    }
+    fclose(f);
+    return 0;
+  }
+
+  FILE *out = nullptr;
+  std::unique_ptr<csv_sink> sink;
+  if (output) {
+    out = fopen(output, "w");
+    if (!out) {
+      fprintf(stderr, "ingest_daemon: cannot open %s\n", output);
+      return 1;
+    }
+    sink.reset(new csv_sink(out));
+  }
+
+  ts_store store;
+  std::unique_ptr<store_sink> stored;
+  if (store_path) {
+    std::string error;
+    if (!store.open(store_path, error)) {
+      fprintf(stderr, "ingest_daemon: %s\n", error.c_str());
+      return 1;
+    }
+    stored.reset(new store_sink(store, sink.get()));
+  }
+
+  capture_writer writer;
+  std::unique_ptr<capture_sink> captured;
+  if (capture_path) {
+    capture_header_t header;
+    header.flags = CAPTURE_HAS_ALARMS;
+    header.wall_start_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch()).count();
+    std::string error;
+    if (!writer.open(capture_path, header, error)) {
+      fprintf(stderr, "ingest_daemon: %s\n", error.c_str());
+      return 1;
+    }
+    captured.reset(new capture_sink(writer, ingest_pipeline::now_ns(),
+                                    stored ? (ingest_sink *)stored.get() : sink.get()));
+  }
+
+  ingest_sink *head = sink.get();
+  if (stored)
+    head = stored.get();
+  if (captured)
+    head = captured.get();
+
+  // Alarms are printed live, a benchmark only counts them
+  alarm_handler_t on_alarm;
+  if (!bench) {
+    on_alarm = [](const ingest_alarm_t &alarm) {
+      printf("ALARM %s helmet 0x%04x network %u ms", alarm_name(alarm.kind), alarm.helmet, alarm.network_ms);
+      if (alarm.temp_valid)
+        printf(" temp %.1f C", alarm.temp_mc / 1000.0);
+      if (alarm.kind == alarm_kind_t::sensor_degraded)
+        printf(" sensors 0x%02x", alarm.sensors_degraded);
+      printf("\n");
+      fflush(stdout);
+    };
+  }
+
+  if (config.pin) {
+    unsigned cpus = std::thread::hardware_concurrency();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(reader_cpu % (cpus ? cpus : 1), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  ingest_pipeline pipeline(config, head, on_alarm);
+  pipeline.start();
+  uint64_t start = ingest_pipeline::now_ns();
+
+  if (bench) {
+    const uint8_t *bytes = load.bytes.data();
+    if (rate) {
+      // One packet per feed() at its slot, arrival is when it was due
+      uint64_t period = 1000000000ull / rate;
+      uint32_t from = 0;
+      for (size_t i = 0; i < load.frame_end.size(); i++) {
+        uint64_t due = start + i * period;
+        while (ingest_pipeline::now_ns() < due) {
+        }
+        pipeline.feed(bytes + from, load.frame_end[i] - from, due);
+        from = load.frame_end[i];
+      }
+    }
+    else {
+      for (size_t off = 0; off < load.bytes.size(); off += BENCH_CHUNK) {
+        size_t n = std::min((size_t)BENCH_CHUNK, load.bytes.size() - off);
+        pipeline.feed(bytes + off, n, ingest_pipeline::now_ns());
+      }
+    }
+  }
+  else {
+    int fd = STDIN_FILENO;
+    if (sock)
+      fd = open_socket(sock);
+    else if (input)
+      fd = open(input, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+      fprintf(stderr, "ingest_daemon: cannot open %s\n", sock ? sock : input);
+      pipeline.stop();
+      return 1;
+    }
+    if (!set_raw_tty(fd)) {
+      fprintf(stderr, "ingest_daemon: cannot set %s raw at 115200 baud: %s\n",
+              input ? input : "stdin", strerror(errno));
+      if (fd != STDIN_FILENO)
+        close(fd);
+      pipeline.stop();
+      return 1;
+    }
+
+    // read() returns what is there, so a live NCP is ingested as it arrives
+    uint8_t buf[BENCH_CHUNK];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+      pipeline.feed(buf, (size_t)n, ingest_pipeline::now_ns());
+
+    if (fd != STDIN_FILENO)
+      close(fd);
+  }
+
+  pipeline.stop();
+  double secs = (ingest_pipeline::now_ns() - start) / 1e9;
+
+  report(pipeline, secs);
+  if (store_path) {
+    ts_store_stats_t st = store.stats();
+    fprintf(stderr, "store          %llu samples in %u series, %llu refused, %.1f kB\n",
+            (unsigned long long)st.samples, st.series, (unsigned long long)st.refused, st.file_bytes / 1e3);
+  }
+  if (capture_path) {
+    writer.close();
+    fprintf(stderr, "capture        %llu records, %.1f kB, %.1f bytes/record\n",
+            (unsigned long long)writer.records(), writer.bytes() / 1e3,
+            writer.records() ? (double)writer.bytes() / writer.records() : 0.0);
+  }
+  if (out)
+    fclose(out);
+  return 0;
+}
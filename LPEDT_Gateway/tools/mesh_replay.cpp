@@ -0,0 +1,421 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    mesh_replay.cpp
+ * @brief   Replay a mesh_capture.h file at real time, 100x or flat out, and
+ *          report the throughput and where the alarms came out different.
+ *
+ *          --target gateway (default) encodes every record back into the NCP
+ *          packet it came from and runs it through ingest_pipeline. Every
+ *          record must come out of the pipeline again, and when the capture
+ *          holds the alarm decisions of the gateway that wrote it
+ *          (ingest_daemon --capture) each must be taken again. --baseline
+ *          writes the capture with the decisions of this run, so a mesh_sim
+ *          capture, which has none, becomes a reference for the next change.
+ *
+ *          --target client runs the captured helmets in mesh_sim, with the
+ *          helmet app.c, and gives every helmet what the gateway heard when
+ *          it is addressed to it or to a group it subscribes to. What the
+ *          helmets publish is counted, not sent. Their first set_emergency
+ *          is compared with the captured one. A capture holds no sensor
+ *          readings, a captured alarm that no low get_rssi_status led to is
+ *          listed as sensor driven and not counted.
+ *
+ *          Exits 1 on any divergence.
+ *
+ *          usage: mesh_replay CAPTURE [--target gateway|client]
+ *                             [--speed 1|100|max] [--queue N] [--cpu N]
+ *                             [--no-pin] [--baseline FILE] [--app PATH]
+ *                             [--verbose]
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "mesh_capture.h"
+#include "ingest_pipeline.h"
+#include "mesh_sim.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "my_model_def.h"
+#include "Custom_Defines.h"
+
+using namespace lpedt;
+
+#define REPLAY_CHUNK          (4096)   // bytes per feed() flat out
+#define REPLAY_MAX_LISTED     (10)     // divergences printed
+#define REPLAY_ALARM_SLACK_MS (1000)   // client alarm time tolerance
+#define REPLAY_TAIL_MS        (5000)   // simulated past the last record
+
+static const char *arg_str(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return argv[i + 1];
+  }
+  return nullptr;
+}
+
+static long arg_long(int argc, char **argv, const char *name, long def)
+{
+  const char *s = arg_str(argc, argv, name);
+  return s ? strtol(s, NULL, 0) : def;
+}
+
+static bool arg_flag(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return true;
+  }
+  return false;
+}
+
+static uint8_t record_alarm(const capture_record_t &rec)
+{
+  return (uint8_t)((rec.flags & CAPTURE_ALARM_MASK) >> CAPTURE_ALARM_SHIFT);
+}
+
+static bool same_message(const capture_record_t &a, const capture_record_t &b)
+{
+  return a.src == b.src && a.dst == b.dst && a.opcode == b.opcode && a.len == b.len &&
+         memcmp(a.payload, b.payload, a.len) == 0;
+}
+
+/*
+ * What comes out of the pipeline, kept as records to compare after stop()
+ */
+class replay_sink : public ingest_sink {
+public:
+  explicit replay_sink(size_t expected) { out_.reserve(expected); }
+
+  void write(const ingest_item_t &item) override
+  {
+    capture_record_t rec;
+    capture_from_msg(item.msg, 0, CAPTURE_RSSI_UNKNOWN, (uint8_t)item.alarm, rec);
+    out_.push_back(rec);
+  }
+
+  const std::vector<capture_record_t> &out() const { return out_; }
+
+private:
+  std::vector<capture_record_t> out_;
+};
+
+static int replay_gateway(const capture_header_t &header, const std::vector<capture_record_t> &records,
+                          double speed, ingest_config_t config, int reader_cpu, const char *baseline,
+                          bool verbose)
+{
+  // Back into NCP packets, encoded up front so only the pipeline is timed
+  std::vector<uint8_t> bytes;
+  std::vector<uint32_t> frame_end;
+  bytes.reserve(records.size() * 24);
+  frame_end.reserve(records.size());
+  for (const capture_record_t &rec : records) {
+    vendor_msg_t msg;
+    uint8_t buf[NCP_FRAME_MAX];
+    capture_to_msg(rec, msg);
+    size_t n = ncp_encode_vendor(msg, buf);
+    bytes.insert(bytes.end(), buf, buf + n);
+    frame_end.push_back((uint32_t)bytes.size());
+  }
+
+  if (config.pin) {
+    unsigned cpus = std::thread::hardware_concurrency();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(reader_cpu % (cpus ? cpus : 1), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  replay_sink sink(records.size());
+  ingest_pipeline pipeline(config, &sink, alarm_handler_t());
+  pipeline.start();
+  uint64_t start = ingest_pipeline::now_ns();
+
+  if (speed > 0.0) {
+    // One packet per feed() at its captured time, sleep through the gaps
+    uint32_t from = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+      uint64_t due = start + (uint64_t)(records[i].t_us * 1000 / speed);
+      uint64_t now = ingest_pipeline::now_ns();
+      if (due > now + 2000000)
+        std::this_thread::sleep_for(std::chrono::nanoseconds(due - now - 1000000));
+      while (ingest_pipeline::now_ns() < due) {
+      }
+      pipeline.feed(&bytes[from], frame_end[i] - from, due);
+      from = frame_end[i];
+    }
+  }
+  else {
+    for (size_t off = 0; off < bytes.size(); off += REPLAY_CHUNK) {
+      size_t n = std::min((size_t)REPLAY_CHUNK, bytes.size() - off);
+      pipeline.feed(&bytes[off], n, ingest_pipeline::now_ns());
+    }
+  }
+
+  pipeline.stop();
+  double secs = (ingest_pipeline::now_ns() - start) / 1e9;
+  const std::vector<capture_record_t> &out = sink.out();
+
+  // The pipeline keeps the order, walk both together
+  bool check_alarms = header.flags & CAPTURE_HAS_ALARMS;
+  uint64_t divergences = 0, alarms_captured = 0, alarms_replayed = 0;
+  size_t j = 0;
+  auto diverge = [&](size_t i, const char *what) {
+    if (divergences++ < REPLAY_MAX_LISTED || verbose)
+      printf("  record %zu at %.3f s, src 0x%04x opcode %u: %s\n", i, records[i].t_us / 1e6, records[i].src,
+             records[i].opcode, what);
+  };
+
+  printf("divergences\n");
+  for (size_t i = 0; i < records.size(); i++) {
+    if (record_alarm(records[i]))
+      alarms_captured++;
+    if (j >= out.size() || !same_message(records[i], out[j])) {
+      diverge(i, "dropped by the pipeline");
+      continue;
+    }
+    uint8_t replayed = record_alarm(out[j]);
+    if (replayed)
+      alarms_replayed++;
+    if (check_alarms && replayed != record_alarm(records[i])) {
+      char what[64];
+      snprintf(what, sizeof(what), "alarm %s, was %s", alarm_name((alarm_kind_t)replayed),
+               alarm_name((alarm_kind_t)record_alarm(records[i])));
+      diverge(i, what);
+    }
+    j++;
+  }
+  if (j < out.size()) {
+    printf("  %zu messages out of the pipeline past the capture\n", out.size() - j);
+    divergences += out.size() - j;
+  }
+  if (!divergences)
+    printf("  none\n");
+
+  if (baseline) {
+    capture_header_t bh = header;
+    bh.flags |= CAPTURE_HAS_ALARMS;
+    capture_writer writer;
+    std::string error;
+    if (!writer.open(baseline, bh, error)) {
+      fprintf(stderr, "mesh_replay: %s\n", error.c_str());
+      return 1;
+    }
+    // The replayed decision on the captured record, dropped ones left as they were
+    j = 0;
+    for (const capture_record_t &rec : records) {
+      capture_record_t b = rec;
+      if (j < out.size() && same_message(rec, out[j])) {
+        b.flags = (uint8_t)((b.flags & ~CAPTURE_ALARM_MASK) | (out[j].flags & CAPTURE_ALARM_MASK));
+        j++;
+      }
+      writer.write(b);
+    }
+    writer.close();
+  }
+
+  const ingest_stats_t &s = pipeline.stats();
+  double span_s = records.empty() ? 0.0 : records.back().t_us / 1e6;
+  printf("\nreplay         %zu records over %.3f s of capture, gateway target\n", records.size(), span_s);
+  printf("speed          %s, %.3f s wall, %.0f frames/s, %.1fx capture time\n",
+         speed > 0.0 ? "paced" : "max", secs, secs > 0 ? s.frames / secs : 0.0, secs > 0 ? span_s / secs : 0.0);
+  printf("pipeline       %llu accepted, %llu dropped\n", (unsigned long long)s.accepted,
+         (unsigned long long)(s.frames - s.accepted));
+  if (check_alarms)
+    printf("alarms         %llu captured, %llu replayed\n", (unsigned long long)alarms_captured,
+           (unsigned long long)alarms_replayed);
+  else
+    printf("alarms         %llu replayed, the capture holds none to compare\n", (unsigned long long)alarms_replayed);
+  printf("divergences    %llu\n", (unsigned long long)divergences);
+  printf("\narrival to alarm stage output\n");
+  pipeline.frame_latency().print(stdout, "  all frames");
+  pipeline.alarm_latency().print(stdout, "  alarms");
+
+  return divergences ? 1 : 0;
+}
+
+static int replay_client(const std::vector<capture_record_t> &records, double speed, const char *app, bool verbose)
+{
+  // The helmets are whoever sends what only a helmet sends
+  std::vector<uint16_t> helmets;
+  for (const capture_record_t &rec : records) {
+    if (rec.opcode == get_rssi || rec.opcode == get_emergency || rec.opcode == temperature_status ||
+        rec.opcode == energy_status || rec.opcode == set_emergency)
+      helmets.push_back(rec.src);
+  }
+  std::sort(helmets.begin(), helmets.end());
+  helmets.erase(std::unique(helmets.begin(), helmets.end()), helmets.end());
+  if (helmets.empty()) {
+    fprintf(stderr, "mesh_replay: no helmet traffic in the capture\n");
+    return 1;
+  }
+
+  // Captured first set_emergency per helmet, and whether a low RSSI was heard before it
+  std::map<uint16_t, int64_t> captured_ms;
+  std::map<uint16_t, bool> rssi_driven;
+  int64_t first_low_ms = -1;
+  for (const capture_record_t &rec : records) {
+    if (rec.opcode == get_rssi_status && rec.len >= RSSI_DATA_LENGTH && (int8_t)rec.payload[0] < RSSI_THREASHOLD &&
+        first_low_ms < 0)
+      first_low_ms = (int64_t)(rec.t_us / 1000);
+    if (rec.opcode == set_emergency && !captured_ms.count(rec.src)) {
+      captured_ms[rec.src] = (int64_t)(rec.t_us / 1000);
+      rssi_driven[rec.src] = first_low_ms >= 0;
+    }
+  }
+
+  mesh_sim_config_t config;
+  config.helmets        = (uint32_t)helmets.size();
+  config.anchors        = 1;
+  config.provisioned    = true;
+  config.alarm_helmet   = -1;
+  config.replay         = &records;
+  config.replay_helmets = helmets;
+  config.replay_speed   = speed;
+  config.duration_ms    = config.replay_offset_ms + (uint32_t)(records.back().t_us / 1000) + REPLAY_TAIL_MS;
+  config.app_module     = app ? app : SIM_APP_MODULE;
+
+  mesh_sim sim(config);
+  std::string error;
+  if (!sim.setup(error)) {
+    fprintf(stderr, "mesh_replay: %s\n", error.c_str());
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  sim.run();
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  mesh_sim_replay_t r = sim.replay_summary();
+
+  uint64_t divergences = 0, sensor = 0, matched = 0;
+  printf("divergences\n");
+  for (size_t i = 0; i < helmets.size(); i++) {
+    auto c = captured_ms.find(helmets[i]);
+    int64_t captured = c == captured_ms.end() ? -1 : c->second;
+    int64_t replayed = r.first_alarm_ms[i];
+    const char *what = nullptr;
+
+    if (captured < 0 && replayed < 0)
+      continue;
+    if (captured >= 0 && replayed < 0) {
+      if (!rssi_driven[helmets[i]]) {
+        sensor++;
+        if (verbose)
+          printf("  helmet 0x%04x alarm at %.3f s, sensor driven, not replayable\n", helmets[i], captured / 1e3);
+        continue;
+      }
+      what = "captured only";
+    }
+    else if (captured < 0)
+      what = "replayed only";
+    else if (std::llabs(replayed - captured) > REPLAY_ALARM_SLACK_MS)
+      what = "late or early";
+
+    if (!what) {
+      matched++;
+      if (verbose)
+        printf("  helmet 0x%04x alarm at %.3f s, replayed at %.3f s\n", helmets[i], captured / 1e3, replayed / 1e3);
+      continue;
+    }
+    if (divergences++ < REPLAY_MAX_LISTED || verbose) {
+      printf("  helmet 0x%04x alarm %s:", helmets[i], what);
+      if (captured >= 0)
+        printf(" captured %.3f s", captured / 1e3);
+      if (replayed >= 0)
+        printf(" replayed %.3f s", replayed / 1e3);
+      printf("\n");
+    }
+  }
+  if (!divergences)
+    printf("  none\n");
+
+  double span_s = records.back().t_us / 1e6;
+  printf("\nreplay         %zu records over %.3f s of capture, client target, %zu helmets\n", records.size(), span_s,
+         helmets.size());
+  printf("speed          %s, %.3f s wall, %.0f records/s, %.1fx capture time\n", speed > 0.0 ? "paced" : "max",
+         secs, secs > 0 ? records.size() / secs : 0.0, secs > 0 ? span_s / secs : 0.0);
+  printf("deliveries     %llu to helmets, %llu helmet publications held back\n", (unsigned long long)r.delivered,
+         (unsigned long long)r.published);
+  printf("alarms         %zu captured, %llu matched within %u ms, %llu sensor driven\n", captured_ms.size(),
+         (unsigned long long)matched, REPLAY_ALARM_SLACK_MS, (unsigned long long)sensor);
+  printf("divergences    %llu\n", (unsigned long long)divergences);
+
+  return divergences ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2 || argv[1][0] == '-') {
+    fprintf(stderr, "usage: mesh_replay CAPTURE [--target gateway|client] [--speed 1|100|max] [--queue N]\n"
+                    "                   [--cpu N] [--no-pin] [--baseline FILE] [--app PATH] [--verbose]\n");
+    return 1;
+  }
+
+  const char *target   = arg_str(argc, argv, "--target");
+  const char *speed_s  = arg_str(argc, argv, "--speed");
+  const char *baseline = arg_str(argc, argv, "--baseline");
+  const char *app      = arg_str(argc, argv, "--app");
+  bool verbose         = arg_flag(argc, argv, "--verbose");
+
+  double speed = 0.0;
+  if (speed_s && strcmp(speed_s, "max") != 0) {
+    speed = strtod(speed_s, NULL);
+    if (speed <= 0.0) {
+      fprintf(stderr, "mesh_replay: bad --speed\n");
+      return 1;
+    }
+  }
+
+  capture_header_t header;
+  std::vector<capture_record_t> records;
+  std::string error;
+  if (!capture_load(argv[1], header, records, error)) {
+    fprintf(stderr, "mesh_replay: %s\n", error.c_str());
+    return 1;
+  }
+  if (!error.empty())
+    fprintf(stderr, "mesh_replay: %s\n", error.c_str());
+  if (records.empty()) {
+    fprintf(stderr, "mesh_replay: %s holds no records\n", argv[1]);
+    return 1;
+  }
+
+  if (!target || strcmp(target, "gateway") == 0) {
+    ingest_config_t config;
+    config.queue_depth = (size_t)arg_long(argc, argv, "--queue", (long)config.queue_depth);
+    config.pin = !arg_flag(argc, argv, "--no-pin");
+    int reader_cpu = (int)arg_long(argc, argv, "--cpu", 0);
+    config.first_cpu = reader_cpu + 1;
+    return replay_gateway(header, records, speed, config, reader_cpu, baseline, verbose);
+  }
+  if (strcmp(target, "client") == 0) {
+    if (baseline)
+      fprintf(stderr, "mesh_replay: --baseline is for the gateway target, ignored\n");
+    return replay_client(records, speed, app, verbose);
+  }
+
+  fprintf(stderr, "mesh_replay: unknown --target %s\n", target);
+  return 1;
+}
@@ -0,0 +1,163 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    mesh_sim.cpp
+ * @brief   Command line front end of the mesh simulator.
+ *
+ *          usage: mesh_sim [--helmets N] [--anchors N] [--spacing M] [--grid]
+ *                          [--duration-ms N] [--alarm-helmet N|-1]
+ *                          [--alarm-at-ms N] [--anchor-rssi DBM] [--measured-rssi]
+ *                          [--no-halt]
+ *                          [--lpn] [--poll-ms N] [--friend-queue N]
+ *                          [--relay-queue N] [--provisioned]
+ *                          [--sensor-init-ms N] [--seed N]
+ *                          [--time-ref-ms N] [--clock-ppm PPM] [--sync-sweep]
+ *                          [--capture FILE] [--verbose] [--app PATH]
+ *
+ *          --capture writes what the gateway (the first anchor) hears in the
+ *          mesh_capture.h format, for mesh_replay.
+ *
+ *          --sync-sweep runs the deployment once per time_ref period and
+ *          prints the sync error against the airtime the references cost.
+ *          Unless given, the alarm is off and each run is 900 s: the error
+ *          is taken over the second half, and a 30 s period needs that long
+ *          for enough references to reach the far end.
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "mesh_sim.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace lpedt;
+
+static const char *arg_str(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return argv[i + 1];
+  }
+  return NULL;
+}
+
+static long arg_long(int argc, char **argv, const char *name, long def)
+{
+  const char *s = arg_str(argc, argv, name);
+  return s ? strtol(s, NULL, 0) : def;
+}
+
+static bool arg_flag(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief   Runs config once per reference period and tabulates the sync
+ *          error against the time_ref airtime
+ * @return  0, 1 if a run could not be set up
+ */
+static int sync_sweep(mesh_sim_config_t config)
+{
+  static const uint32_t periods_ms[] = { 500, 1000, 2000, 5000, 10000, 30000 };
+
+  printf("time_ref period sweep, %u helmets, %u anchors, %.0f s, +-%.0f ppm\n\n",
+         config.helmets, config.anchors, config.duration_ms / 1000.0, config.clock_ppm);
+  printf("  period ms  refs  airtime ms/s  synced  |error| median    p95     max  bias ms\n");
+
+  for (uint32_t period : periods_ms) {
+    config.time_ref_ms = period;
+
+    mesh_sim sim(config);
+    std::string error;
+    if (!sim.setup(error)) {
+      fprintf(stderr, "mesh_sim: %s\n", error.c_str());
+      return 1;
+    }
+    sim.run();
+
+    mesh_sim_sync_t r = sim.sync_summary();
+    printf("  %9u %5llu %13.2f %4u/%-3u %13.1f %7.1f %7.1f %8.1f\n", period,
+           (unsigned long long)r.refs_sent, r.airtime_ms_per_s, r.helmets_synced, config.helmets,
+           r.abs_median_ms, r.abs_p95_ms, r.abs_max_ms, r.bias_ms);
+  }
+
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  mesh_sim_config_t config;
+
+  config.helmets          = (uint32_t)arg_long(argc, argv, "--helmets", config.helmets);
+  config.anchors          = (uint32_t)arg_long(argc, argv, "--anchors", config.anchors);
+  config.anchor_spacing_m = (float)arg_long(argc, argv, "--spacing", (long)config.anchor_spacing_m);
+  config.grid             = arg_flag(argc, argv, "--grid");
+  config.duration_ms      = (uint32_t)arg_long(argc, argv, "--duration-ms", config.duration_ms);
+  config.alarm_helmet     = (int32_t)arg_long(argc, argv, "--alarm-helmet", config.alarm_helmet);
+  config.alarm_at_ms      = (uint32_t)arg_long(argc, argv, "--alarm-at-ms", config.alarm_at_ms);
+  config.halt_on_emergency = !arg_flag(argc, argv, "--no-halt");
+  config.lpn              = arg_flag(argc, argv, "--lpn");
+  config.poll_ms          = (uint32_t)arg_long(argc, argv, "--poll-ms", config.poll_ms);
+  config.friend_queue     = (uint32_t)arg_long(argc, argv, "--friend-queue", config.friend_queue);
+  config.relay_txq        = (uint32_t)arg_long(argc, argv, "--relay-queue", config.relay_txq);
+  config.provisioned      = arg_flag(argc, argv, "--provisioned");
+  config.sensor_init_ms   = (uint32_t)arg_long(argc, argv, "--sensor-init-ms", config.sensor_init_ms);
+  config.seed             = (uint32_t)arg_long(argc, argv, "--seed", config.seed);
+  config.verbose          = arg_flag(argc, argv, "--verbose");
+  config.time_ref_ms      = (uint32_t)arg_long(argc, argv, "--time-ref-ms", config.time_ref_ms);
+
+  const char *ppm = arg_str(argc, argv, "--clock-ppm");
+  if (ppm)
+    config.clock_ppm = strtof(ppm, NULL);
+
+  config.anchor_rssi       = (int8_t)arg_long(argc, argv, "--anchor-rssi", config.anchor_rssi);
+  config.anchor_rssi_fixed = !arg_flag(argc, argv, "--measured-rssi");
+
+  const char *app = arg_str(argc, argv, "--app");
+  config.app_module = app ? app : SIM_APP_MODULE;
+
+  const char *capture = arg_str(argc, argv, "--capture");
+  if (capture)
+    config.capture_path = capture;
+
+  if (arg_flag(argc, argv, "--sync-sweep")) {
+    if (!arg_str(argc, argv, "--alarm-helmet"))
+      config.alarm_helmet = -1;
+    if (!arg_str(argc, argv, "--duration-ms"))
+      config.duration_ms = 900000;
+    return sync_sweep(config);
+  }
+
+  mesh_sim sim(config);
+  std::string error;
+  if (!sim.setup(error)) {
+    fprintf(stderr, "mesh_sim: %s\n", error.c_str());
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  sim.run();
+  auto stop = std::chrono::steady_clock::now();
+
+  sim.report(stdout);
+  printf("\nwall clock     %.2f s\n", std::chrono::duration<double>(stop - start).count());
+
+  return 0;
+}
@@ -0,0 +1,194 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    rssi_bench.cpp
+ * @brief   Synthetic workload and throughput benchmark for rssi_localizer.
+ *
+ *          Anchors are laid out on a square grid, helmets random walk through
+ *          it and every anchor in range reports the helmet once per helmet
+ *          publish period (CLIENT_SLEEP_TIME_MS) with log-distance path loss
+ *          plus gaussian shadowing. All observations are generated up front so
+ *          only the localizer is timed.
+ *
+ *          usage: rssi_bench [--helmets N] [--anchors N] [--obs N]
+ *                            [--window-ms N] [--seed N]
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "rssi_localizer.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Custom_Defines.h"
+
+using namespace lpedt;
+
+#define ANCHOR_SPACING_M   (20.0f)
+#define ANCHORS_PER_ZONE   (2)      // zone is a 2x2 block of anchors
+#define HELMET_SPEED_MPS   (1.2f)
+#define SHADOWING_SIGMA_DB (4.0f)
+#define RANGE_RSSI_DBM     (-95.0f) // anchors below this never hear the helmet
+
+struct helmet_truth_t {
+  float x_m;
+  float y_m;
+  float heading;
+};
+
+static uint32_t arg_u32(int argc, char **argv, const char *name, uint32_t def)
+{
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return (uint32_t)strtoul(argv[i + 1], NULL, 0);
+  }
+  return def;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t helmets   = arg_u32(argc, argv, "--helmets", 200);
+  uint32_t anchors   = arg_u32(argc, argv, "--anchors", 64);
+  uint32_t obs_total = arg_u32(argc, argv, "--obs", 2000000);
+  uint32_t window_ms = arg_u32(argc, argv, "--window-ms", 2000);
+  uint32_t seed      = arg_u32(argc, argv, "--seed", 1);
+
+  if (helmets == 0 || anchors == 0 || obs_total == 0) {
+    fprintf(stderr, "helmets, anchors and obs must be non zero\n");
+    return 1;
+  }
+
+  localizer_config_t config;
+  config.window_ms = window_ms;
+  rssi_localizer localizer(config);
+
+  // Anchor grid
+  uint32_t side = (uint32_t)std::ceil(std::sqrt((double)anchors));
+  uint32_t zones_per_row = (side + ANCHORS_PER_ZONE - 1) / ANCHORS_PER_ZONE;
+  std::vector<anchor_t> grid;
+  for (uint32_t i = 0; i < anchors; i++) {
+    uint32_t col = i % side, row = i / side;
+    anchor_t a;
+    a.address = (uint16_t)(0x0100 + i);
+    a.zone    = (uint16_t)((row / ANCHORS_PER_ZONE) * zones_per_row + col / ANCHORS_PER_ZONE);
+    a.x_m     = col * ANCHOR_SPACING_M;
+    a.y_m     = row * ANCHOR_SPACING_M;
+    grid.push_back(a);
+    localizer.add_anchor(a);
+  }
+  float extent = (side - 1) * ANCHOR_SPACING_M;
+
+  // Pre-generate observations together with the true helmet position
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> uni(0.0f, 1.0f);
+  std::normal_distribution<float> shadow(0.0f, SHADOWING_SIGMA_DB);
+
+  std::vector<helmet_truth_t> truth(helmets);
+  for (auto &h : truth) {
+    h.x_m = uni(rng) * extent;
+    h.y_m = uni(rng) * extent;
+    h.heading = uni(rng) * 6.2831853f;
+  }
+
+  std::vector<rssi_observation_t> obs;
+  std::vector<helmet_truth_t>     obs_truth;
+  obs.reserve(obs_total);
+  obs_truth.reserve(obs_total);
+
+  const float step_m = HELMET_SPEED_MPS * CLIENT_SLEEP_TIME_MS / 1000.0f;
+  uint64_t now_ms = 0;
+  while (obs.size() < obs_total) {
+    now_ms += CLIENT_SLEEP_TIME_MS;
+    for (uint32_t h = 0; h < helmets && obs.size() < obs_total; h++) {
+      helmet_truth_t &t = truth[h];
+      t.heading += (uni(rng) - 0.5f) * 0.8f;
+      t.x_m = std::fmin(std::fmax(t.x_m + step_m * std::cos(t.heading), 0.0f), extent);
+      t.y_m = std::fmin(std::fmax(t.y_m + step_m * std::sin(t.heading), 0.0f), extent);
+
+      for (const anchor_t &a : grid) {
+        float d = std::hypot(t.x_m - a.x_m, t.y_m - a.y_m);
+        if (d < 1.0f)
+          d = 1.0f;
+        float rssi = config.tx_power_1m_dbm - 10.0f * config.path_loss_exp * std::log10(d) + shadow(rng);
+        if (rssi < RANGE_RSSI_DBM)
+          continue;
+
+        rssi_observation_t o;
+        o.timestamp_ms = now_ms;
+        o.helmet = (uint16_t)(0x0001 + h);
+        o.anchor = a.address;
+        o.rssi   = (int8_t)std::lround(std::fmax(rssi, -128.0f));
+        obs.push_back(o);
+        obs_truth.push_back(t);
+        if (obs.size() == obs_total)
+          break;
+      }
+    }
+  }
+
+  // Timed run
+  std::vector<location_estimate_t> est(obs.size());
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < obs.size(); i++)
+    localizer.ingest(obs[i], &est[i]);
+  auto stop = std::chrono::steady_clock::now();
+
+  double secs = std::chrono::duration<double>(stop - start).count();
+
+  // Accuracy, only on the last observation of each helmet report so that
+  // every anchor of that period has been folded in
+  double   err_sum = 0.0;
+  uint64_t scored = 0, zone_hits = 0;
+  for (size_t i = 0; i < obs.size(); i++) {
+    bool last_of_report = (i + 1 == obs.size()) ||
+                          (obs[i + 1].helmet != obs[i].helmet) ||
+                          (obs[i + 1].timestamp_ms != obs[i].timestamp_ms);
+    if (!last_of_report || est[i].zone == LOC_ZONE_NONE)
+      continue;
+
+    const helmet_truth_t &t = obs_truth[i];
+    err_sum += std::hypot(est[i].x_m - t.x_m, est[i].y_m - t.y_m);
+
+    // True zone is the zone of the nearest anchor
+    const anchor_t *nearest = &grid[0];
+    float best = 1e30f;
+    for (const anchor_t &a : grid) {
+      float d = std::hypot(t.x_m - a.x_m, t.y_m - a.y_m);
+      if (d < best) {
+        best = d;
+        nearest = &a;
+      }
+    }
+    if (nearest->zone == est[i].zone)
+      zone_hits++;
+    scored++;
+  }
+
+  printf("helmets        %u\n", helmets);
+  printf("anchors        %u (%u x %u grid, %.0f m spacing)\n", anchors, side, side, ANCHOR_SPACING_M);
+  printf("window         %u ms\n", window_ms);
+  printf("observations   %zu (%llu dropped)\n", obs.size(), (unsigned long long)localizer.dropped_count());
+  printf("throughput     %.0f obs/s\n", obs.size() / secs);
+  printf("latency        %.1f ns/obs\n", secs * 1e9 / obs.size());
+  if (scored) {
+    printf("mean error     %.2f m\n", err_sum / scored);
+    printf("zone accuracy  %.1f %%\n", 100.0 * zone_hits / scored);
+  }
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    tlog_decode.cpp
+ * @brief   Turns the tokenized VCOM log of a helmet or miner board back into
+ *          text.
+ *
+ *          The strings come from the .axf of the running firmware (--elf) or
+ *          from a side table exported with --dump-table. The input is a raw
+ *          capture or the serial device itself (set it raw first, e.g.
+ *          stty -F /dev/ttyACM0 115200 raw), stdin if --in is not given.
+ *
+ *          usage: tlog_decode (--elf FILE | --table FILE) [--in FILE]
+ *                 tlog_decode --elf FILE --dump-table > FILE
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "tlog_decoder.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <unistd.h>
+
+using namespace lpedt;
+
+static const char *arg_str(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return argv[i + 1];
+  }
+  return nullptr;
+}
+
+static bool arg_flag(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return true;
+  }
+  return false;
+}
+
+int main(int argc, char **argv)
+{
+  const char *elf   = arg_str(argc, argv, "--elf");
+  const char *table = arg_str(argc, argv, "--table");
+  const char *input = arg_str(argc, argv, "--in");
+
+  if (!elf && !table) {
+    fprintf(stderr, "usage: tlog_decode (--elf FILE | --table FILE) [--in FILE]\n"
+                    "       tlog_decode --elf FILE --dump-table > FILE\n");
+    return 1;
+  }
+
+  tlog_table strings;
+  std::string error;
+  if ((elf && !strings.load_elf(elf, error)) || (table && !strings.load(table, error))) {
+    fprintf(stderr, "tlog_decode: %s\n", error.c_str());
+    return 1;
+  }
+
+  if (arg_flag(argc, argv, "--dump-table")) {
+    strings.save(stdout);
+    return 0;
+  }
+
+  FILE *in = input ? fopen(input, "rb") : stdin;
+  if (!in) {
+    fprintf(stderr, "tlog_decode: cannot open %s\n", input);
+    return 1;
+  }
+
+  tlog_decoder decoder(strings);
+  uint8_t buf[256];
+  std::string text;
+  ssize_t n;
+
+  // read() returns what is there, so a live serial port is decoded as it arrives
+  while ((n = read(fileno(in), buf, sizeof(buf))) > 0) {
+    text.clear();
+    decoder.feed(buf, (size_t)n, text);
+    fwrite(text.data(), 1, text.size(), stdout);
+    fflush(stdout);
+  }
+
+  const tlog_stats_t &stats = decoder.stats();
+  fprintf(stderr, "tlog_decode: %llu records, %llu dropped, %llu bad frames, %llu unknown tokens, "
+                  "%llu truncated\n",
+          (unsigned long long)stats.records, (unsigned long long)stats.dropped,
+          (unsigned long long)stats.bad_frames, (unsigned long long)stats.unknown,
+          (unsigned long long)stats.truncated);
+
+  if (in != stdin)
+    fclose(in);
+  return 0;
+}
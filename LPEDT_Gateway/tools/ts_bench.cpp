@@ -0,0 +1,235 @@
+/*******************************************************************************
+ * Copyright (C) 2024 by Vishnu Kumar Thoodur Venkatachalapathy
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Vishnu Kumar Thoodur Venkatachalapathy and the University of
+ * Colorado are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ts_bench.cpp
+ * @brief   Ingest, size and scan benchmark for ts_store.
+ *
+ *          Every helmet samples all signals once per CLIENT_SLEEP_TIME_MS
+ *          for the given shift length, with a few ms of scheduling jitter
+ *          and the odd missed period. Temperature, humidity, gas and
+ *          pressure random walk slowly, the IMU axes are noise around the
+ *          helmet orientation. The samples are generated up front so only
+ *          the store is timed.
+ *
+ *          After the ingest the file is closed and opened again, and every
+ *          series is read back and compared with what was written.
+ *
+ *          usage: ts_bench [--helmets N] [--hours N] [--file PATH] [--seed N]
+ *
+ * @author  Vishnu Kumar Thoodur Venkatachalapathy
+ * @date    Oct 18, 2026
+ */
+
+#include "ts_store.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Custom_Defines.h"
+
+using namespace lpedt;
+
+#define SIGNALS            ((int)ts_signal_t::count)
+#define JITTER_MS          (3)
+#define MISSED_PERIOD_P    (0.002)
+#define RAW_SAMPLE_BYTES   (12)      // int64 time + int32 value
+
+struct bench_sample_t {
+  uint16_t helmet;
+  uint8_t  signal;
+  int64_t  t_ms;
+  int32_t  value;
+};
+
+static const char *arg_str(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], name) == 0)
+      return argv[i + 1];
+  }
+  return nullptr;
+}
+
+static long arg_long(int argc, char **argv, const char *name, long def)
+{
+  const char *s = arg_str(argc, argv, name);
+  return s ? strtol(s, NULL, 0) : def;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t helmets = (uint32_t)arg_long(argc, argv, "--helmets", 50);
+  uint32_t hours   = (uint32_t)arg_long(argc, argv, "--hours", 2);
+  uint32_t seed    = (uint32_t)arg_long(argc, argv, "--seed", 1);
+  const char *path = arg_str(argc, argv, "--file");
+  std::string file = path ? path : "/tmp/ts_bench.lpts";
+
+  if (helmets == 0 || hours == 0) {
+    fprintf(stderr, "helmets and hours must be non zero\n");
+    return 1;
+  }
+
+  // Samples in arrival order, helmet by helmet within a period
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uni(0.0, 1.0);
+  std::normal_distribution<double> noise(0.0, 1.0);
+
+  struct walk_t {
+    double value[SIGNALS];
+  };
+  std::vector<walk_t> walk(helmets);
+  for (walk_t &w : walk) {
+    w.value[(int)ts_signal_t::temperature] = 22000 + uni(rng) * 6000;
+    w.value[(int)ts_signal_t::humidity]    = 4000 + uni(rng) * 2000;
+    w.value[(int)ts_signal_t::gas]         = 2;
+    w.value[(int)ts_signal_t::pressure]    = 1013;
+  }
+
+  uint64_t periods = (uint64_t)hours * 3600 * 1000 / CLIENT_SLEEP_TIME_MS;
+  std::vector<bench_sample_t> samples;
+  samples.reserve(periods * helmets * SIGNALS);
+
+  for (uint64_t p = 0; p < periods; p++) {
+    for (uint32_t h = 0; h < helmets; h++) {
+      if (uni(rng) < MISSED_PERIOD_P)
+        continue;
+
+      walk_t &w = walk[h];
+      int64_t t = (int64_t)(p * CLIENT_SLEEP_TIME_MS) + (int64_t)(rng() % (2 * JITTER_MS + 1)) - JITTER_MS;
+      if (t < 0)
+        t = 0;
+
+      w.value[(int)ts_signal_t::temperature] += noise(rng) * 5;
+      w.value[(int)ts_signal_t::humidity]    += noise(rng) * 2;
+      if (uni(rng) < 0.01)
+        w.value[(int)ts_signal_t::gas] = std::fmax(0, w.value[(int)ts_signal_t::gas] + (rng() % 3) - 1.0);
+      if (uni(rng) < 0.005)
+        w.value[(int)ts_signal_t::pressure] += (rng() % 3) - 1.0;
+
+      int32_t imu[6] = {
+        (int32_t)std::lround(12 + noise(rng) * 15),   (int32_t)std::lround(-30 + noise(rng) * 15),
+        (int32_t)std::lround(1000 + noise(rng) * 15), (int32_t)std::lround(noise(rng) * 200),
+        (int32_t)std::lround(noise(rng) * 200),       (int32_t)std::lround(noise(rng) * 200),
+      };
+
+      for (int s = 0; s < SIGNALS; s++) {
+        int32_t v = s < (int)ts_signal_t::acc_x ? (int32_t)std::lround(w.value[s]) : imu[s - (int)ts_signal_t::acc_x];
+        samples.push_back({ (uint16_t)(0x0100 + h), (uint8_t)s, t, v });
+      }
+    }
+  }
+
+  remove(file.c_str());
+  ts_store store;
+  std::string error;
+  if (!store.open(file, error)) {
+    fprintf(stderr, "ts_bench: %s\n", error.c_str());
+    return 1;
+  }
+
+  // Ingest
+  auto start = std::chrono::steady_clock::now();
+  for (const bench_sample_t &s : samples)
+    store.append(s.helmet, (ts_signal_t)s.signal, s.t_ms, s.value);
+  double ingest_s = seconds_since(start);
+
+  store.close();
+  if (!store.open(file, error)) {
+    fprintf(stderr, "ts_bench: reopen: %s\n", error.c_str());
+    return 1;
+  }
+  ts_store_stats_t st = store.stats();
+
+  // Full scan, every series decoded, and checked against the input
+  std::vector<std::vector<ts_sample_t>> expect((size_t)helmets * SIGNALS);
+  for (const bench_sample_t &s : samples)
+    expect[(size_t)(s.helmet - 0x0100) * SIGNALS + s.signal].push_back({ s.t_ms, s.value });
+
+  std::vector<ts_sample_t> out;
+  uint64_t scanned = 0, mismatches = 0;
+  double scan_s = 0.0;
+  for (uint32_t h = 0; h < helmets; h++) {
+    for (int s = 0; s < SIGNALS; s++) {
+      out.clear();
+      start = std::chrono::steady_clock::now();
+      store.read((uint16_t)(0x0100 + h), (ts_signal_t)s, INT64_MIN, INT64_MAX, out);
+      scan_s += seconds_since(start);
+      scanned += out.size();
+
+      const std::vector<ts_sample_t> &e = expect[(size_t)h * SIGNALS + s];
+      if (out.size() != e.size()) {
+        mismatches++;
+        continue;
+      }
+      for (size_t i = 0; i < out.size(); i++) {
+        if (out[i].t_ms != e[i].t_ms || out[i].value != e[i].value) {
+          mismatches++;
+          break;
+        }
+      }
+    }
+  }
+
+  // Ten minute range read, in the middle of the shift, on every series
+  int64_t mid = (int64_t)hours * 3600 * 1000 / 2;
+  uint64_t range_samples = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t h = 0; h < helmets; h++) {
+    for (int s = 0; s < SIGNALS; s++) {
+      out.clear();
+      range_samples += store.read((uint16_t)(0x0100 + h), (ts_signal_t)s, mid, mid + 600000, out);
+    }
+  }
+  double range_s = seconds_since(start);
+
+  // Whole shift in one minute and one hour buckets, temperature of every helmet
+  std::vector<ts_aggregate_t> agg;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t h = 0; h < helmets; h++)
+    store.aggregate((uint16_t)(0x0100 + h), ts_signal_t::temperature, 0, (int64_t)hours * 3600 * 1000, 60000, agg);
+  double agg_min_s = seconds_since(start);
+  size_t agg_min = agg.size();
+
+  agg.clear();
+  start = std::chrono::steady_clock::now();
+  for (uint32_t h = 0; h < helmets; h++)
+    store.aggregate((uint16_t)(0x0100 + h), ts_signal_t::temperature, 0, (int64_t)hours * 3600 * 1000, 3600000, agg);
+  double agg_hour_s = seconds_since(start);
+
+  printf("helmets        %u, %u h at %u ms, %d signals\n", helmets, hours, CLIENT_SLEEP_TIME_MS, SIGNALS);
+  printf("samples        %zu written, %llu stored, %llu refused\n", samples.size(),
+         (unsigned long long)st.samples, (unsigned long long)st.refused);
+  printf("ingest         %.2f M samples/s (%.1f ns/sample)\n", samples.size() / ingest_s / 1e6,
+         ingest_s * 1e9 / samples.size());
+  printf("file           %.1f MB, %u chunks in %u series\n", st.file_bytes / 1e6, st.chunks, st.series);
+  printf("size           %.2f bytes/sample on disk, %.2f in the streams, %.1fx vs %d byte raw\n",
+         (double)st.file_bytes / st.samples, st.stream_bits / 8.0 / st.samples,
+         (double)RAW_SAMPLE_BYTES * st.samples / st.file_bytes, RAW_SAMPLE_BYTES);
+  printf("full scan      %.1f M samples/s, %llu series mismatched after reopen\n", scanned / scan_s / 1e6,
+         (unsigned long long)mismatches);
+  printf("10 min range   %.1f us per series, %llu samples\n", range_s * 1e6 / (helmets * SIGNALS),
+         (unsigned long long)range_samples);
+  printf("aggregate      1 min buckets %.1f us per helmet (%zu buckets), 1 h buckets %.1f us\n",
+         agg_min_s * 1e6 / helmets, agg_min, agg_hour_s * 1e6 / helmets);
+
+  store.close();
+  return mismatches ? 1 : 0;
+}